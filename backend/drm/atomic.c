@@ -2,6 +2,8 @@
 #include <drm_fourcc.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <wlr/render/drm_syncobj.h>
 #include <wlr/util/log.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
@@ -147,17 +149,21 @@ bool create_gamma_lut_blob(struct wlr_drm_backend *drm,
 
 bool create_fb_damage_clips_blob(struct wlr_drm_backend *drm,
 		int width, int height, const pixman_region32_t *damage, uint32_t *blob_id) {
-	if (!pixman_region32_not_empty(damage)) {
-		*blob_id = 0;
-		return true;
-	}
-
 	pixman_region32_t clipped;
 	pixman_region32_init(&clipped);
 	pixman_region32_intersect_rect(&clipped, damage, 0, 0, width, height);
 
+	// A missing FB_DAMAGE_CLIPS blob means that the whole plane needs to be
+	// updated. Use a single empty rectangle instead, which doesn't intersect
+	// the plane and is skipped by the kernel.
+	static const pixman_box32_t empty = {0};
 	int rects_len;
 	const pixman_box32_t *rects = pixman_region32_rectangles(&clipped, &rects_len);
+	if (rects_len == 0) {
+		rects = &empty;
+		rects_len = 1;
+	}
+
 	int ret = drmModeCreatePropertyBlob(drm->fd, rects, sizeof(*rects) * rects_len, blob_id);
 	pixman_region32_fini(&clipped);
 	if (ret != 0) {
@@ -294,8 +300,9 @@ static bool atomic_crtc_commit(struct wlr_drm_connector *conn,
 		}
 	}
 
+	// Damage clips don't affect the outcome of test-only commits
 	uint32_t fb_damage_clips = 0;
-	if ((state->base->committed & WLR_OUTPUT_STATE_DAMAGE) &&
+	if (!test_only && (state->base->committed & WLR_OUTPUT_STATE_DAMAGE) &&
 			crtc->primary->props.fb_damage_clips != 0) {
 		create_fb_damage_clips_blob(drm, state->primary_fb->wlr_buf->width,
 			state->primary_fb->wlr_buf->height, &state->base->damage, &fb_damage_clips);
@@ -311,6 +318,27 @@ static bool atomic_crtc_commit(struct wlr_drm_connector *conn,
 		vrr_enabled = state->base->adaptive_sync_enabled;
 	}
 
+	int in_fence_fd = -1;
+	if (state->base->committed & WLR_OUTPUT_STATE_WAIT_TIMELINE) {
+		if (crtc->primary->props.in_fence_fd == 0) {
+			wlr_drm_conn_log(conn, WLR_DEBUG, "Plane IN_FENCE_FD property unavailable");
+			goto err_blobs;
+		}
+		in_fence_fd = wlr_drm_syncobj_timeline_export_sync_file(
+			state->base->wait_timeline, state->base->wait_point);
+		if (in_fence_fd < 0) {
+			goto err_blobs;
+		}
+	}
+
+	// Written by the kernel on successful non-test commits
+	int out_fence_fd = -1;
+	if ((state->base->committed & WLR_OUTPUT_STATE_SIGNAL_TIMELINE) &&
+			crtc->props.out_fence_ptr == 0) {
+		wlr_drm_conn_log(conn, WLR_DEBUG, "CRTC OUT_FENCE_PTR property unavailable");
+		goto err_in_fence;
+	}
+
 	if (test_only) {
 		flags |= DRM_MODE_ATOMIC_TEST_ONLY;
 	}
@@ -346,6 +374,14 @@ static bool atomic_crtc_commit(struct wlr_drm_connector *conn,
 		}
 		set_plane_props(&atom, drm, crtc->primary, state->primary_fb, crtc->id,
 			0, 0);
+		if (in_fence_fd >= 0) {
+			atomic_add(&atom, crtc->primary->id,
+				crtc->primary->props.in_fence_fd, in_fence_fd);
+		}
+		if (state->base->committed & WLR_OUTPUT_STATE_SIGNAL_TIMELINE) {
+			atomic_add(&atom, crtc->id, crtc->props.out_fence_ptr,
+				(uintptr_t)&out_fence_fd);
+		}
 		if (crtc->primary->props.fb_damage_clips != 0) {
 			atomic_add(&atom, crtc->primary->id,
 				crtc->primary->props.fb_damage_clips, fb_damage_clips);
@@ -368,6 +404,22 @@ static bool atomic_crtc_commit(struct wlr_drm_connector *conn,
 	bool ok = atomic_commit(&atom, conn, page_flip, flags);
 	atomic_finish(&atom);
 
+	if (ok && !test_only && out_fence_fd >= 0) {
+		// The commit went through: failing to forward the fence can't be
+		// reported to the caller anymore
+		if (!wlr_drm_syncobj_timeline_import_sync_file(
+				state->base->signal_timeline, state->base->signal_point,
+				out_fence_fd)) {
+			wlr_drm_conn_log(conn, WLR_ERROR, "Failed to signal timeline point");
+		}
+	}
+	if (out_fence_fd >= 0) {
+		close(out_fence_fd);
+	}
+	if (in_fence_fd >= 0) {
+		close(in_fence_fd);
+	}
+
 	if (ok && !test_only) {
 		commit_blob(drm, &crtc->mode_id, mode_id);
 		commit_blob(drm, &crtc->gamma_lut, gamma_lut);
@@ -390,6 +442,18 @@ static bool atomic_crtc_commit(struct wlr_drm_connector *conn,
 	}
 
 	return ok;
+
+err_in_fence:
+	if (in_fence_fd >= 0) {
+		close(in_fence_fd);
+	}
+err_blobs:
+	rollback_blob(drm, &crtc->mode_id, mode_id);
+	rollback_blob(drm, &crtc->gamma_lut, gamma_lut);
+	if (fb_damage_clips != 0) {
+		drmModeDestroyPropertyBlob(drm->fd, fb_damage_clips);
+	}
+	return false;
 }
 
 const struct wlr_drm_interface atomic_iface = {
@@ -101,6 +101,9 @@ static void handle_session_active(struct wl_listener *listener, void *data) {
 		wl_container_of(listener, drm, session_active);
 	struct wlr_session *session = drm->session;
 
+	// Another DRM master may have changed the KMS state
+	drm_test_cache_invalidate(drm);
+
 	if (session->active) {
 		wlr_log(WLR_INFO, "DRM fd resumed");
 		scan_drm_connectors(drm, NULL);
@@ -28,6 +28,7 @@
 #include "render/pixel_format.h"
 #include "render/drm_format_set.h"
 #include "render/wlr_renderer.h"
+#include "types/wlr_output.h"
 #include "util/env.h"
 #include "config.h"
 
@@ -42,7 +43,9 @@ static const uint32_t COMMIT_OUTPUT_STATE =
 	WLR_OUTPUT_STATE_ENABLED |
 	WLR_OUTPUT_STATE_GAMMA_LUT |
 	WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED |
-	WLR_OUTPUT_STATE_LAYERS;
+	WLR_OUTPUT_STATE_LAYERS |
+	WLR_OUTPUT_STATE_WAIT_TIMELINE |
+	WLR_OUTPUT_STATE_SIGNAL_TIMELINE;
 
 static const uint32_t SUPPORTED_OUTPUT_STATE =
 	WLR_OUTPUT_STATE_BACKEND_OPTIONAL | COMMIT_OUTPUT_STATE;
@@ -116,6 +119,19 @@ bool check_drm_features(struct wlr_drm_backend *drm) {
 		drm->supports_tearing_page_flips = drmGetCap(drm->fd, DRM_CAP_ASYNC_PAGE_FLIP, &cap) == 0 && cap == 1;
 	}
 
+	// Secondary GPUs blit the buffer to a local one before scan-out, the
+	// timeline points wouldn't apply to the buffer handed to KMS
+	if (drm->iface == &atomic_iface && drm->parent == NULL) {
+		drm->backend.features.timeline =
+			drmGetCap(drm->fd, DRM_CAP_SYNCOBJ_TIMELINE, &cap) == 0 && cap == 1;
+	}
+
+	drm->cursor_commits = !env_parse_bool("WLR_DRM_NO_CURSOR_COMMITS");
+	if (!drm->cursor_commits) {
+		wlr_log(WLR_DEBUG, "WLR_DRM_NO_CURSOR_COMMITS set, "
+			"committing cursor updates with regular frames only");
+	}
+
 	if (env_parse_bool("WLR_DRM_NO_MODIFIERS")) {
 		wlr_log(WLR_DEBUG, "WLR_DRM_NO_MODIFIERS set, disabling modifiers");
 	} else {
@@ -341,6 +357,7 @@ void finish_drm_resources(struct wlr_drm_backend *drm) {
 	for (size_t i = 0; i < drm->num_planes; ++i) {
 		struct wlr_drm_plane *plane = &drm->planes[i];
 		drm_plane_finish_surface(plane);
+		wlr_drm_format_finish(&plane->mgpu_format);
 		wlr_drm_format_set_finish(&plane->formats);
 	}
 
@@ -441,6 +458,10 @@ void drm_page_flip_destroy(struct wlr_drm_page_flip *page_flip) {
 	free(page_flip);
 }
 
+static bool drm_test_signature_init(struct wlr_drm_test_signature *sig,
+	struct wlr_drm_connector *conn,
+	const struct wlr_drm_connector_state *state);
+
 static bool drm_crtc_commit(struct wlr_drm_connector *conn,
 		const struct wlr_drm_connector_state *state,
 		uint32_t flags, bool test_only) {
@@ -459,7 +480,19 @@ static bool drm_crtc_commit(struct wlr_drm_connector *conn,
 
 	struct wlr_drm_backend *drm = conn->backend;
 	struct wlr_drm_crtc *crtc = conn->crtc;
+
+	// Cached test results only hold while the other CRTCs keep their planes
+	// as they are, see drm_connector_test()
+	struct wlr_drm_test_signature signature = {0};
+	if (!test_only && ((state->base->committed & WLR_OUTPUT_STATE_LAYERS) ||
+			!drm_test_signature_init(&signature, conn, state))) {
+		memset(&signature, 0, sizeof(signature));
+	}
+
 	bool ok = drm->iface->crtc_commit(conn, state, page_flip, flags, test_only);
+	if (!ok) {
+		drm_test_cache_invalidate(drm);
+	}
 	if (ok && !test_only) {
 		drm_fb_clear(&crtc->primary->queued_fb);
 		if (state->primary_fb != NULL) {
@@ -468,6 +501,7 @@ static bool drm_crtc_commit(struct wlr_drm_connector *conn,
 		if (crtc->cursor != NULL) {
 			drm_fb_move(&crtc->cursor->queued_fb, &conn->cursor_pending_fb);
 		}
+		conn->cursor_dirty = false;
 
 		struct wlr_drm_layer *layer;
 		wl_list_for_each(layer, &crtc->layers, link) {
@@ -475,6 +509,14 @@ static bool drm_crtc_commit(struct wlr_drm_connector *conn,
 		}
 
 		drm_connector_set_pending_page_flip(conn, page_flip);
+
+		// Layers aren't described by signatures: consider them as changed
+		if (state->modeset || signature.crtc_id == 0 ||
+				memcmp(&signature, &crtc->committed_signature,
+				sizeof(signature)) != 0) {
+			drm_test_cache_invalidate(drm);
+		}
+		crtc->committed_signature = signature;
 	} else {
 		// The set_cursor() hook is a bit special: it's not really synchronized
 		// to commit() or test(). Once set_cursor() returns true, the new
@@ -565,21 +607,12 @@ static bool drm_connector_state_update_primary_fb(struct wlr_drm_connector *conn
 
 	struct wlr_buffer *local_buf;
 	if (drm->parent) {
-		struct wlr_drm_format format = {0};
-		if (!drm_plane_pick_render_format(plane, &format, &drm->mgpu_renderer)) {
-			wlr_log(WLR_ERROR, "Failed to pick primary plane format");
-			return false;
+		const pixman_region32_t *damage = NULL;
+		if (state->base->committed & WLR_OUTPUT_STATE_DAMAGE) {
+			damage = &state->base->damage;
 		}
-
-		// TODO: fallback to modifier-less buffer allocation
-		bool ok = init_drm_surface(&plane->mgpu_surf, &drm->mgpu_renderer,
-			source_buf->width, source_buf->height, &format);
-		wlr_drm_format_finish(&format);
-		if (!ok) {
-			return false;
-		}
-
-		local_buf = drm_surface_blit(&plane->mgpu_surf, source_buf);
+		local_buf = drm_plane_blit(plane, &drm->mgpu_renderer, source_buf,
+			damage);
 		if (local_buf == NULL) {
 			return false;
 		}
@@ -634,6 +667,95 @@ static bool drm_connector_set_pending_layer_fbs(struct wlr_drm_connector *conn,
 
 static bool drm_connector_alloc_crtc(struct wlr_drm_connector *conn);
 
+void drm_test_cache_invalidate(struct wlr_drm_backend *drm) {
+	drm->test_cache_len = 0;
+	drm->test_cache_next = 0;
+}
+
+static bool get_fb_signature(struct wlr_drm_fb *fb, uint32_t *format,
+		uint64_t *modifier, int *width, int *height) {
+	if (fb == NULL) {
+		return true;
+	}
+
+	struct wlr_dmabuf_attributes attribs;
+	if (!wlr_buffer_get_dmabuf(fb->wlr_buf, &attribs)) {
+		return false;
+	}
+	*format = attribs.format;
+	*modifier = attribs.modifier;
+	*width = attribs.width;
+	*height = attribs.height;
+	return true;
+}
+
+static bool drm_test_signature_init(struct wlr_drm_test_signature *sig,
+		struct wlr_drm_connector *conn,
+		const struct wlr_drm_connector_state *state) {
+	const struct wlr_output_state *base = state->base;
+	struct wlr_drm_crtc *crtc = conn->crtc;
+
+	// Signatures are compared with memcmp(), padding included
+	memset(sig, 0, sizeof(*sig));
+
+	sig->conn_id = conn->id;
+	sig->crtc_id = crtc->id;
+	sig->active = state->active;
+	sig->modeset = state->modeset;
+	sig->mode = state->mode;
+	sig->tearing_page_flip = base->tearing_page_flip;
+	sig->wait_timeline = base->committed & WLR_OUTPUT_STATE_WAIT_TIMELINE;
+	sig->signal_timeline = base->committed & WLR_OUTPUT_STATE_SIGNAL_TIMELINE;
+
+	if (base->committed & WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED) {
+		sig->vrr_enabled = base->adaptive_sync_enabled;
+	} else {
+		sig->vrr_enabled = conn->output.adaptive_sync_status ==
+			WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED;
+	}
+
+	if (base->committed & WLR_OUTPUT_STATE_GAMMA_LUT) {
+		sig->gamma_lut = true;
+		sig->gamma_lut_size = base->gamma_lut_size;
+	}
+
+	if (!get_fb_signature(state->primary_fb, &sig->primary.format,
+			&sig->primary.modifier, &sig->primary.width, &sig->primary.height)) {
+		return false;
+	}
+
+	if (crtc->cursor != NULL && drm_connector_is_cursor_visible(conn) &&
+			!get_fb_signature(get_next_cursor_fb(conn), &sig->cursor.format,
+			&sig->cursor.modifier, &sig->cursor.width, &sig->cursor.height)) {
+		return false;
+	}
+
+	return true;
+}
+
+static const struct wlr_drm_test_cache_entry *drm_test_cache_find(
+		struct wlr_drm_backend *drm, const struct wlr_drm_test_signature *sig) {
+	for (size_t i = 0; i < drm->test_cache_len; i++) {
+		const struct wlr_drm_test_cache_entry *entry = &drm->test_cache[i];
+		if (memcmp(&entry->signature, sig, sizeof(*sig)) == 0) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static void drm_test_cache_add(struct wlr_drm_backend *drm,
+		const struct wlr_drm_test_signature *sig, bool ok) {
+	drm->test_cache[drm->test_cache_next] = (struct wlr_drm_test_cache_entry){
+		.signature = *sig,
+		.ok = ok,
+	};
+	drm->test_cache_next = (drm->test_cache_next + 1) % DRM_TEST_CACHE_SIZE;
+	if (drm->test_cache_len < DRM_TEST_CACHE_SIZE) {
+		drm->test_cache_len++;
+	}
+}
+
 static bool drm_connector_test(struct wlr_output *output,
 		const struct wlr_output_state *state) {
 	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
@@ -719,8 +841,27 @@ static bool drm_connector_test(struct wlr_output *output,
 		}
 	}
 
+	// Compositors test the same configuration every frame, e.g. when trying
+	// direct scanout: skip the round-trip to the kernel if the outcome is
+	// already known. Output layers aren't described by the signature.
+	struct wlr_drm_test_signature signature;
+	bool cacheable = !(state->committed & WLR_OUTPUT_STATE_LAYERS) &&
+		drm_test_signature_init(&signature, conn, &pending);
+	if (cacheable) {
+		const struct wlr_drm_test_cache_entry *entry =
+			drm_test_cache_find(conn->backend, &signature);
+		if (entry != NULL) {
+			ok = entry->ok;
+			goto out;
+		}
+	}
+
 	ok = drm_crtc_commit(conn, &pending, 0, true);
 
+	if (cacheable) {
+		drm_test_cache_add(conn->backend, &signature, ok);
+	}
+
 out:
 	drm_connector_state_finish(&pending);
 	return ok;
@@ -752,6 +893,64 @@ bool drm_connector_supports_vrr(struct wlr_drm_connector *conn) {
 	return true;
 }
 
+static uint64_t region_area(const pixman_region32_t *region) {
+	int rects_len;
+	const pixman_box32_t *rects = pixman_region32_rectangles(region, &rects_len);
+	uint64_t area = 0;
+	for (int i = 0; i < rects_len; i++) {
+		area += (uint64_t)(rects[i].x2 - rects[i].x1) * (rects[i].y2 - rects[i].y1);
+	}
+	return area;
+}
+
+static void drm_connector_update_damage_stats(struct wlr_drm_connector *conn,
+		const struct wlr_drm_connector_state *state) {
+	struct wlr_drm_backend *drm = conn->backend;
+	const struct wlr_output_state *base = state->base;
+	struct wlr_buffer *buffer = state->primary_fb->wlr_buf;
+
+	uint64_t total = (uint64_t)buffer->width * buffer->height;
+	uint64_t updated = total;
+
+	// The kernel ignores damage clips on modesets
+	if ((base->committed & WLR_OUTPUT_STATE_DAMAGE) && !state->modeset &&
+			drm->iface != &legacy_iface &&
+			conn->crtc->primary->props.fb_damage_clips != 0) {
+		pixman_region32_t clipped;
+		pixman_region32_init(&clipped);
+		pixman_region32_intersect_rect(&clipped, &base->damage,
+			0, 0, buffer->width, buffer->height);
+		updated = region_area(&clipped);
+		pixman_region32_fini(&clipped);
+
+		conn->damage_stats.partial_frames++;
+	}
+
+	conn->damage_stats.frames++;
+	conn->damage_stats.updated_pixels += updated;
+	conn->damage_stats.total_pixels += total;
+	conn->damage_stats.last_updated_pixels = updated;
+	conn->damage_stats.last_total_pixels = total;
+}
+
+void wlr_drm_connector_get_damage_stats(struct wlr_output *output,
+		struct wlr_drm_connector_damage_stats *stats) {
+	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
+	*stats = (struct wlr_drm_connector_damage_stats){
+		.frames = conn->damage_stats.frames,
+		.partial_frames = conn->damage_stats.partial_frames,
+	};
+	if (conn->damage_stats.last_total_pixels > 0) {
+		stats->last_updated_fraction =
+			(double)conn->damage_stats.last_updated_pixels /
+			conn->damage_stats.last_total_pixels;
+	}
+	if (conn->damage_stats.total_pixels > 0) {
+		stats->updated_fraction = (double)conn->damage_stats.updated_pixels /
+			conn->damage_stats.total_pixels;
+	}
+}
+
 bool drm_connector_commit_state(struct wlr_drm_connector *conn,
 		const struct wlr_output_state *base) {
 	struct wlr_drm_backend *drm = conn->backend;
@@ -785,7 +984,7 @@ bool drm_connector_commit_state(struct wlr_drm_connector *conn,
 	}
 	if (pending.base->committed & WLR_OUTPUT_STATE_LAYERS) {
 		if (!drm_connector_set_pending_layer_fbs(conn, pending.base)) {
-			return false;
+			goto out;
 		}
 	}
 
@@ -804,9 +1003,18 @@ bool drm_connector_commit_state(struct wlr_drm_connector *conn,
 	// we'll wait for all queued page-flips to complete, so we don't need this
 	// safeguard.
 	if (pending.nonblock && conn->pending_page_flip != NULL) {
-		wlr_drm_conn_log(conn, WLR_ERROR, "Failed to page-flip output: "
-			"a page-flip is already pending");
-		goto out;
+		if (!conn->pending_page_flip->cursor_only) {
+			wlr_drm_conn_log(conn, WLR_ERROR, "Failed to page-flip output: "
+				"a page-flip is already pending");
+			goto out;
+		}
+		// A cursor-only update committed by the backend on its own is in
+		// flight, see drm_connector_commit_cursor(): it must not get in the
+		// way of the compositor. Let the kernel wait for it, our page-flip
+		// event supersedes its own.
+		wlr_drm_conn_log(conn, WLR_DEBUG,
+			"Superseding in-flight cursor-only page-flip");
+		pending.nonblock = false;
 	}
 
 	uint32_t flags = 0;
@@ -822,6 +1030,10 @@ bool drm_connector_commit_state(struct wlr_drm_connector *conn,
 		goto out;
 	}
 
+	if (pending.active && (base->committed & WLR_OUTPUT_STATE_BUFFER)) {
+		drm_connector_update_damage_stats(conn, &pending);
+	}
+
 	if (!pending.active) {
 		drm_plane_finish_surface(conn->crtc->primary);
 		drm_plane_finish_surface(conn->crtc->cursor);
@@ -832,6 +1044,10 @@ bool drm_connector_commit_state(struct wlr_drm_connector *conn,
 	}
 
 out:
+	if (!ok && drm->parent && conn->crtc != NULL &&
+			(base->committed & WLR_OUTPUT_STATE_BUFFER)) {
+		drm_surface_discard_blit(&conn->crtc->primary->mgpu_surf);
+	}
 	drm_connector_state_finish(&pending);
 	return ok;
 }
@@ -956,6 +1172,55 @@ const drmModeModeInfo *wlr_drm_mode_get_info(struct wlr_output_mode *wlr_mode) {
 	return &mode->drm_mode;
 }
 
+/**
+ * Commit the latest cursor state on its own, so that cursor updates don't
+ * require the compositor to render a new frame. This is only possible while
+ * the output is idle.
+ */
+static bool drm_connector_commit_cursor(struct wlr_drm_connector *conn) {
+	struct wlr_drm_backend *drm = conn->backend;
+	struct wlr_output *output = &conn->output;
+	if (!drm->cursor_commits || !drm->session->active || !output->enabled ||
+			conn->crtc == NULL || output->frame_pending || output->needs_frame ||
+			conn->pending_page_flip != NULL) {
+		return false;
+	}
+
+	// The legacy interface updates the cursor right away, no page-flip is
+	// needed and nothing stays in flight
+	bool legacy = drm->iface == &legacy_iface;
+
+	struct wlr_output_state base;
+	wlr_output_state_init(&base);
+	struct wlr_drm_connector_state pending;
+	drm_connector_state_init(&pending, conn, &base);
+	// The primary plane keeps its current FB
+	pending.nonblock = true;
+
+	bool ok = pending.primary_fb != NULL && drm_crtc_commit(conn, &pending,
+		legacy ? 0 : DRM_MODE_PAGE_FLIP_EVENT, false);
+	if (ok && !legacy) {
+		conn->pending_page_flip->cursor_only = true;
+		output_begin_backend_update(output);
+	}
+
+	drm_connector_state_finish(&pending);
+	wlr_output_state_finish(&base);
+	return ok;
+}
+
+static void drm_connector_update_cursor(struct wlr_drm_connector *conn) {
+	conn->cursor_dirty = true;
+	if (drm_connector_commit_cursor(conn)) {
+		return;
+	}
+	// The cursor will be committed once the pending page-flip completes
+	if (conn->pending_page_flip != NULL) {
+		return;
+	}
+	wlr_output_update_needs_frame(&conn->output);
+}
+
 static bool drm_connector_set_cursor(struct wlr_output *output,
 		struct wlr_buffer *buffer, int hotspot_x, int hotspot_y) {
 	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
@@ -990,20 +1255,7 @@ static bool drm_connector_set_cursor(struct wlr_output *output,
 
 		struct wlr_buffer *local_buf;
 		if (drm->parent) {
-			struct wlr_drm_format format = {0};
-			if (!drm_plane_pick_render_format(plane, &format, &drm->mgpu_renderer)) {
-				wlr_log(WLR_ERROR, "Failed to pick cursor plane format");
-				return false;
-			}
-
-			bool ok = init_drm_surface(&plane->mgpu_surf, &drm->mgpu_renderer,
-				buffer->width, buffer->height, &format);
-			wlr_drm_format_finish(&format);
-			if (!ok) {
-				return false;
-			}
-
-			local_buf = drm_surface_blit(&plane->mgpu_surf, buffer);
+			local_buf = drm_plane_blit(plane, &drm->mgpu_renderer, buffer, NULL);
 			if (local_buf == NULL) {
 				return false;
 			}
@@ -1023,7 +1275,7 @@ static bool drm_connector_set_cursor(struct wlr_output *output,
 		conn->cursor_height = buffer->height;
 	}
 
-	wlr_output_update_needs_frame(output);
+	drm_connector_update_cursor(conn);
 	return true;
 }
 
@@ -1053,7 +1305,7 @@ static bool drm_connector_move_cursor(struct wlr_output *output,
 	conn->cursor_x = box.x;
 	conn->cursor_y = box.y;
 
-	wlr_output_update_needs_frame(output);
+	drm_connector_update_cursor(conn);
 	return true;
 }
 
@@ -1131,6 +1383,28 @@ static const struct wlr_drm_format_set *drm_connector_get_primary_formats(
 	return &conn->crtc->primary->formats;
 }
 
+static bool drm_connector_preimport_buffer(struct wlr_output *output,
+		struct wlr_buffer *buffer) {
+	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
+	struct wlr_drm_backend *drm = conn->backend;
+
+	// Secondary GPUs scan out a copy of the buffer
+	if (drm->parent != NULL || conn->crtc == NULL || !drm->session->active) {
+		return false;
+	}
+
+	uint64_t misses = drm->fb_cache_stats.misses;
+	struct wlr_drm_fb *fb = NULL;
+	if (!drm_fb_import(&fb, drm, buffer, &conn->crtc->primary->formats)) {
+		return false;
+	}
+	if (drm->fb_cache_stats.misses != misses) {
+		drm->fb_cache_stats.preimports++;
+	}
+	drm_fb_clear(&fb);
+	return true;
+}
+
 static const struct wlr_output_impl output_impl = {
 	.set_cursor = drm_connector_set_cursor,
 	.move_cursor = drm_connector_move_cursor,
@@ -1141,12 +1415,26 @@ static const struct wlr_output_impl output_impl = {
 	.get_cursor_formats = drm_connector_get_cursor_formats,
 	.get_cursor_size = drm_connector_get_cursor_size,
 	.get_primary_formats = drm_connector_get_primary_formats,
+	.preimport_buffer = drm_connector_preimport_buffer,
 };
 
 bool wlr_output_is_drm(struct wlr_output *output) {
 	return output->impl == &output_impl;
 }
 
+void wlr_drm_backend_get_fb_cache_stats(struct wlr_backend *backend,
+		struct wlr_drm_fb_cache_stats *stats) {
+	struct wlr_drm_backend *drm = get_drm_backend_from_backend(backend);
+	*stats = (struct wlr_drm_fb_cache_stats){
+		.len = drm->fbs_len,
+		.capacity = DRM_FB_CACHE_CAP,
+		.hits = drm->fb_cache_stats.hits,
+		.misses = drm->fb_cache_stats.misses,
+		.evictions = drm->fb_cache_stats.evictions,
+		.preimports = drm->fb_cache_stats.preimports,
+	};
+}
+
 uint32_t wlr_drm_connector_get_id(struct wlr_output *output) {
 	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
 	return conn->id;
@@ -1559,6 +1847,8 @@ void scan_drm_connectors(struct wlr_drm_backend *drm,
 		wlr_log(WLR_INFO, "Scanning DRM connectors on %s", drm->name);
 	}
 
+	drm_test_cache_invalidate(drm);
+
 	drmModeRes *res = drmModeGetResources(drm->fd);
 	if (!res) {
 		wlr_log_errno(WLR_ERROR, "Failed to get DRM resources");
@@ -1704,6 +1994,20 @@ void scan_drm_leases(struct wlr_drm_backend *drm) {
 	drmFree(list);
 }
 
+/**
+ * Apply cursor updates which happened while a page-flip was pending, unless
+ * the compositor has committed them along with a new frame.
+ */
+static void drm_connector_handle_cursor_dirty(struct wlr_drm_connector *conn) {
+	if (!conn->cursor_dirty || conn->pending_page_flip != NULL ||
+			!conn->backend->session->active) {
+		return;
+	}
+	if (!drm_connector_commit_cursor(conn)) {
+		wlr_output_update_needs_frame(&conn->output);
+	}
+}
+
 static int mhz_to_nsec(int mhz) {
 	return 1000000000000LL / mhz;
 }
@@ -1716,6 +2020,7 @@ static void handle_page_flip(int fd, unsigned seq,
 	if (conn != NULL) {
 		conn->pending_page_flip = NULL;
 	}
+	bool cursor_only = page_flip->cursor_only;
 	drm_page_flip_destroy(page_flip);
 
 	if (conn == NULL) {
@@ -1744,6 +2049,15 @@ static void handle_page_flip(int fd, unsigned seq,
 		drm_fb_move(&layer->current_fb, &layer->queued_fb);
 	}
 
+	if (cursor_only) {
+		// No frame has been submitted, so don't send a present event
+		if (drm->session->active) {
+			output_finish_backend_update(&conn->output);
+		}
+		drm_connector_handle_cursor_dirty(conn);
+		return;
+	}
+
 	uint32_t present_flags = WLR_OUTPUT_PRESENT_VSYNC |
 		WLR_OUTPUT_PRESENT_HW_CLOCK | WLR_OUTPUT_PRESENT_HW_COMPLETION;
 	/* Don't report ZERO_COPY in multi-gpu situations, because we had to copy
@@ -1773,6 +2087,7 @@ static void handle_page_flip(int fd, unsigned seq,
 	if (drm->session->active) {
 		wlr_output_send_frame(&conn->output);
 	}
+	drm_connector_handle_cursor_dirty(conn);
 }
 
 int handle_drm_event(int fd, uint32_t mask, void *data) {
@@ -1898,6 +2213,7 @@ struct wlr_drm_lease *wlr_drm_create_lease(struct wlr_output **outputs,
 	*lease_fd_ptr = lease_fd;
 
 	wlr_log(WLR_DEBUG, "Issued DRM lease %"PRIu32, lease->lessee_id);
+	drm_test_cache_invalidate(drm);
 	for (size_t i = 0; i < n_outputs; ++i) {
 		struct wlr_drm_connector *conn =
 				get_drm_connector_from_output(outputs[i]);
@@ -1924,6 +2240,7 @@ void drm_lease_destroy(struct wlr_drm_lease *lease) {
 	struct wlr_drm_backend *drm = lease->backend;
 
 	wl_signal_emit_mutable(&lease->events.destroy, NULL);
+	drm_test_cache_invalidate(drm);
 
 	struct wlr_drm_connector *conn;
 	wl_list_for_each(conn, &drm->connectors, link) {
@@ -1,3 +1,4 @@
+#include <assert.h>
 #include <drm_fourcc.h>
 #include <stdlib.h>
 #include <wlr/render/drm_format_set.h>
@@ -16,12 +17,15 @@ void drm_fb_clear(struct wlr_drm_fb **fb_ptr) {
 	}
 
 	struct wlr_drm_fb *fb = *fb_ptr;
+	assert(fb->n_locks > 0);
+	fb->n_locks--;
 	wlr_buffer_unlock(fb->wlr_buf); // may destroy the buffer
 
 	*fb_ptr = NULL;
 }
 
 struct wlr_drm_fb *drm_fb_lock(struct wlr_drm_fb *fb) {
+	fb->n_locks++;
 	wlr_buffer_lock(fb->wlr_buf);
 	return fb;
 }
@@ -199,6 +203,7 @@ static struct wlr_drm_fb *drm_fb_create(struct wlr_drm_backend *drm,
 
 	wlr_addon_init(&fb->addon, &buf->addons, drm, &fb_addon_impl);
 	wl_list_insert(&drm->fbs, &fb->link);
+	drm->fbs_len++;
 
 	return fb;
 
@@ -213,6 +218,7 @@ void drm_fb_destroy(struct wlr_drm_fb *fb) {
 	struct wlr_drm_backend *drm = fb->backend;
 
 	wl_list_remove(&fb->link);
+	drm->fbs_len--;
 	wlr_addon_finish(&fb->addon);
 
 	int ret = drmModeCloseFB(drm->fd, fb->id);
@@ -226,21 +232,45 @@ void drm_fb_destroy(struct wlr_drm_fb *fb) {
 	free(fb);
 }
 
+/**
+ * Destroy the least recently used FBs which aren't in use anymore, until the
+ * cache is back within its capacity. The buffers stay alive, and will be
+ * imported again if needed.
+ */
+static void drm_fb_cache_evict(struct wlr_drm_backend *drm) {
+	struct wlr_drm_fb *fb, *tmp;
+	wl_list_for_each_reverse_safe(fb, tmp, &drm->fbs, link) {
+		if (drm->fbs_len <= DRM_FB_CACHE_CAP) {
+			break;
+		}
+		if (fb->n_locks == 0) {
+			drm_fb_destroy(fb);
+			drm->fb_cache_stats.evictions++;
+		}
+	}
+}
+
 bool drm_fb_import(struct wlr_drm_fb **fb_ptr, struct wlr_drm_backend *drm,
 		struct wlr_buffer *buf, const struct wlr_drm_format_set *formats) {
 	struct wlr_drm_fb *fb;
 	struct wlr_addon *addon = wlr_addon_find(&buf->addons, drm, &fb_addon_impl);
 	if (addon != NULL) {
 		fb = wl_container_of(addon, fb, addon);
+		wl_list_remove(&fb->link);
+		wl_list_insert(&drm->fbs, &fb->link);
+		drm->fb_cache_stats.hits++;
 	} else {
 		fb = drm_fb_create(drm, buf, formats);
 		if (!fb) {
 			return false;
 		}
+		drm->fb_cache_stats.misses++;
 	}
 
-	wlr_buffer_lock(buf);
+	drm_fb_lock(fb);
 	drm_fb_move(fb_ptr, &fb);
+
+	drm_fb_cache_evict(drm);
 	return true;
 }
 
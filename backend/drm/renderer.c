@@ -2,6 +2,7 @@
 #include <drm_fourcc.h>
 #include <wlr/render/swapchain.h>
 #include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_damage_ring.h>
 #include <wlr/util/log.h>
 #include "backend/drm/drm.h"
 #include "backend/drm/fb.h"
@@ -44,6 +45,7 @@ void finish_drm_surface(struct wlr_drm_surface *surf) {
 		return;
 	}
 
+	wlr_damage_ring_finish(&surf->damage_ring);
 	wlr_swapchain_destroy(surf->swapchain);
 
 	*surf = (struct wlr_drm_surface){0};
@@ -66,13 +68,27 @@ bool init_drm_surface(struct wlr_drm_surface *surf,
 		return false;
 	}
 
+	// Allocate the first buffer right away, so that callers can fall back to
+	// another format if the allocator can't handle this one
+	struct wlr_buffer *buffer = wlr_swapchain_acquire(surf->swapchain, NULL);
+	if (buffer == NULL) {
+		wlr_log(WLR_DEBUG, "Failed to allocate swapchain buffer");
+		wlr_swapchain_destroy(surf->swapchain);
+		surf->swapchain = NULL;
+		return false;
+	}
+	wlr_buffer_unlock(buffer);
+
 	surf->renderer = renderer;
 
+	wlr_damage_ring_init(&surf->damage_ring);
+	wlr_damage_ring_set_bounds(&surf->damage_ring, width, height);
+
 	return true;
 }
 
 struct wlr_buffer *drm_surface_blit(struct wlr_drm_surface *surf,
-		struct wlr_buffer *buffer) {
+		struct wlr_buffer *buffer, const pixman_region32_t *damage) {
 	struct wlr_renderer *renderer = surf->renderer->wlr_rend;
 
 	if (surf->swapchain->width != buffer->width ||
@@ -87,12 +103,24 @@ struct wlr_buffer *drm_surface_blit(struct wlr_drm_surface *surf,
 		return NULL;
 	}
 
+	if (damage != NULL) {
+		wlr_damage_ring_add(&surf->damage_ring, damage);
+	} else {
+		wlr_damage_ring_add_whole(&surf->damage_ring);
+	}
+
 	struct wlr_buffer *dst = wlr_swapchain_acquire(surf->swapchain, NULL);
 	if (!dst) {
 		wlr_log(WLR_ERROR, "Failed to acquire multi-GPU swapchain buffer");
 		goto error_tex;
 	}
 
+	// Only copy the regions which changed since the destination buffer was
+	// last blitted to
+	pixman_region32_t clip;
+	pixman_region32_init(&clip);
+	wlr_damage_ring_rotate_buffer(&surf->damage_ring, dst, &clip);
+
 	struct wlr_render_pass *pass = wlr_renderer_begin_buffer_pass(renderer, dst, NULL);
 	if (pass == NULL) {
 		wlr_log(WLR_ERROR, "Failed to begin render pass with multi-GPU destination buffer");
@@ -102,34 +130,39 @@ struct wlr_buffer *drm_surface_blit(struct wlr_drm_surface *surf,
 	wlr_render_pass_add_texture(pass, &(struct wlr_render_texture_options){
 		.texture = tex,
 		.blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+		.clip = &clip,
 	});
 	if (!wlr_render_pass_submit(pass)) {
 		wlr_log(WLR_ERROR, "Failed to submit multi-GPU render pass");
 		goto error_dst;
 	}
 
+	pixman_region32_fini(&clip);
 	wlr_texture_destroy(tex);
 
 	return dst;
 
 error_dst:
+	// The contents of the destination buffer are now unknown
+	wlr_damage_ring_add_whole(&surf->damage_ring);
+	pixman_region32_fini(&clip);
 	wlr_buffer_unlock(dst);
 error_tex:
 	wlr_texture_destroy(tex);
 	return NULL;
 }
 
-bool drm_plane_pick_render_format(struct wlr_drm_plane *plane,
-		struct wlr_drm_format *fmt, struct wlr_drm_renderer *renderer) {
-	const struct wlr_drm_format_set *render_formats =
-		wlr_renderer_get_render_formats(renderer->wlr_rend);
-	if (render_formats == NULL) {
-		wlr_log(WLR_ERROR, "Failed to get render formats");
-		return false;
+void drm_surface_discard_blit(struct wlr_drm_surface *surf) {
+	if (surf->swapchain == NULL) {
+		return;
 	}
 
-	const struct wlr_drm_format_set *plane_formats = &plane->formats;
+	// The frame damage is relative to the last committed frame, but the ring
+	// has been rotated as if the blitted buffer was the new current one
+	wlr_damage_ring_add_whole(&surf->damage_ring);
+}
 
+static uint32_t plane_pick_format_code(struct wlr_drm_plane *plane) {
 	uint32_t format = DRM_FORMAT_ARGB8888;
 	if (!wlr_drm_format_set_get(&plane->formats, format)) {
 		const struct wlr_pixel_format_info *format_info =
@@ -138,6 +171,21 @@ bool drm_plane_pick_render_format(struct wlr_drm_plane *plane,
 			format_info->opaque_substitute != DRM_FORMAT_INVALID);
 		format = format_info->opaque_substitute;
 	}
+	return format;
+}
+
+bool drm_plane_pick_render_format(struct wlr_drm_plane *plane,
+		struct wlr_drm_format *fmt, struct wlr_drm_renderer *renderer) {
+	const struct wlr_drm_format_set *render_formats =
+		wlr_renderer_get_render_formats(renderer->wlr_rend);
+	if (render_formats == NULL) {
+		wlr_log(WLR_ERROR, "Failed to get render formats");
+		return false;
+	}
+
+	const struct wlr_drm_format_set *plane_formats = &plane->formats;
+
+	uint32_t format = plane_pick_format_code(plane);
 
 	const struct wlr_drm_format *render_format =
 		wlr_drm_format_set_get(render_formats, format);
@@ -168,3 +216,71 @@ bool drm_plane_pick_render_format(struct wlr_drm_plane *plane,
 
 	return true;
 }
+
+static bool plane_pick_linear_format(struct wlr_drm_plane *plane,
+		struct wlr_drm_format *fmt, struct wlr_drm_renderer *renderer) {
+	const struct wlr_drm_format_set *render_formats =
+		wlr_renderer_get_render_formats(renderer->wlr_rend);
+	if (render_formats == NULL) {
+		return false;
+	}
+
+	uint32_t format = plane_pick_format_code(plane);
+	if (!wlr_drm_format_set_has(render_formats, format, DRM_FORMAT_MOD_LINEAR) ||
+			!wlr_drm_format_set_has(&plane->formats, format, DRM_FORMAT_MOD_LINEAR)) {
+		wlr_log(WLR_DEBUG, "Plane %"PRIu32" or renderer doesn't support "
+			"linear format 0x%"PRIX32, plane->id, format);
+		return false;
+	}
+
+	wlr_drm_format_init(fmt, format);
+	if (!wlr_drm_format_add(fmt, DRM_FORMAT_MOD_LINEAR)) {
+		wlr_drm_format_finish(fmt);
+		return false;
+	}
+	return true;
+}
+
+static bool plane_fallback_linear_format(struct wlr_drm_plane *plane,
+		struct wlr_drm_renderer *renderer) {
+	if (plane->mgpu_format_linear) {
+		return false;
+	}
+
+	struct wlr_drm_format linear = {0};
+	if (!plane_pick_linear_format(plane, &linear, renderer)) {
+		return false;
+	}
+
+	wlr_log(WLR_INFO, "Falling back to linear multi-GPU buffers for plane %"PRIu32,
+		plane->id);
+	wlr_drm_format_finish(&plane->mgpu_format);
+	plane->mgpu_format = linear;
+	plane->mgpu_format_linear = true;
+	return true;
+}
+
+struct wlr_buffer *drm_plane_blit(struct wlr_drm_plane *plane,
+		struct wlr_drm_renderer *renderer, struct wlr_buffer *buffer,
+		const pixman_region32_t *damage) {
+	// The plane and renderer formats never change, so negotiate the format
+	// once and keep using it
+	if (plane->mgpu_format.len == 0 &&
+			!drm_plane_pick_render_format(plane, &plane->mgpu_format, renderer) &&
+			!plane_fallback_linear_format(plane, renderer)) {
+		wlr_log(WLR_ERROR, "Failed to pick multi-GPU format for plane %"PRIu32,
+			plane->id);
+		return NULL;
+	}
+
+	if (!init_drm_surface(&plane->mgpu_surf, renderer, buffer->width,
+			buffer->height, &plane->mgpu_format)) {
+		if (!plane_fallback_linear_format(plane, renderer) ||
+				!init_drm_surface(&plane->mgpu_surf, renderer, buffer->width,
+				buffer->height, &plane->mgpu_format)) {
+			return NULL;
+		}
+	}
+
+	return drm_surface_blit(&plane->mgpu_surf, buffer, damage);
+}
@@ -6,10 +6,12 @@
 #include <wlr/util/log.h>
 #include "backend/headless.h"
 #include "types/wlr_output.h"
+#include "util/time.h"
 
 static const uint32_t SUPPORTED_OUTPUT_STATE =
 	WLR_OUTPUT_STATE_BACKEND_OPTIONAL |
 	WLR_OUTPUT_STATE_BUFFER |
+	WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED |
 	WLR_OUTPUT_STATE_ENABLED |
 	WLR_OUTPUT_STATE_MODE;
 
@@ -33,6 +35,9 @@ static void output_update_refresh(struct wlr_headless_output *output,
 
 static bool output_test(struct wlr_output *wlr_output,
 		const struct wlr_output_state *state) {
+	struct wlr_headless_output *output =
+		headless_output_from_output(wlr_output);
+
 	uint32_t unsupported = state->committed & ~SUPPORTED_OUTPUT_STATE;
 	if (unsupported != 0) {
 		wlr_log(WLR_DEBUG, "Unsupported output state fields: 0x%"PRIx32,
@@ -44,6 +49,12 @@ static bool output_test(struct wlr_output *wlr_output,
 		assert(state->mode_type == WLR_OUTPUT_STATE_MODE_CUSTOM);
 	}
 
+	if ((state->committed & WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED) &&
+			state->adaptive_sync_enabled && output->vrr_max_refresh == 0) {
+		wlr_log(WLR_DEBUG, "Adaptive sync is not supported");
+		return false;
+	}
+
 	if (state->committed & WLR_OUTPUT_STATE_LAYERS) {
 		for (size_t i = 0; i < state->layers_len; i++) {
 			state->layers[i].accepted = true;
@@ -66,14 +77,41 @@ static bool output_commit(struct wlr_output *wlr_output,
 		output_update_refresh(output, state->custom_mode.refresh);
 	}
 
+	if (state->committed & WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED) {
+		wlr_output->adaptive_sync_status = state->adaptive_sync_enabled ?
+			WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED : WLR_OUTPUT_ADAPTIVE_SYNC_DISABLED;
+	}
+
 	if (output_pending_enabled(wlr_output, state)) {
+		bool vrr = wlr_output->adaptive_sync_status ==
+			WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED;
+
 		struct wlr_output_event_present present_event = {
 			.commit_seq = wlr_output->commit_seq + 1,
 			.presented = true,
+			// The next refresh cycle is unknown with adaptive sync
+			.refresh = vrr ? 0 : (int64_t)output->frame_delay * 1000000,
 		};
 		output_defer_present(wlr_output, present_event);
 
-		wl_event_source_timer_update(output->frame_timer, output->frame_delay);
+		int delay = output->frame_delay;
+		int64_t elapsed = -1;
+		if (output->last_frame_msec != 0) {
+			elapsed = get_current_time_msec() - output->last_frame_msec;
+		}
+		if (vrr) {
+			// With adaptive sync, a refresh cycle starts as soon as a frame
+			// is committed, provided that the previous one lasted at least
+			// the shortest cycle supported by the virtual panel
+			int min_delay = 1000000 / output->vrr_max_refresh;
+			delay = elapsed >= 0 && elapsed < min_delay ? min_delay - elapsed : 1;
+		} else if (elapsed >= 0) {
+			// Frames are aligned on a fixed grid, like vblanks on real
+			// hardware, so that a commit late in the refresh cycle doesn't
+			// delay the next frame by a full cycle
+			delay = output->frame_delay - elapsed % output->frame_delay;
+		}
+		wl_event_source_timer_update(output->frame_timer, delay);
 	}
 
 	return true;
@@ -96,8 +134,25 @@ bool wlr_output_is_headless(struct wlr_output *wlr_output) {
 	return wlr_output->impl == &output_impl;
 }
 
+void wlr_headless_output_set_vrr_range(struct wlr_output *wlr_output,
+		int32_t min_refresh, int32_t max_refresh) {
+	struct wlr_headless_output *output =
+		headless_output_from_output(wlr_output);
+
+	if (min_refresh <= 0 || max_refresh < min_refresh) {
+		min_refresh = max_refresh = 0;
+	}
+	output->vrr_min_refresh = min_refresh;
+	output->vrr_max_refresh = max_refresh;
+
+	if (max_refresh == 0) {
+		wlr_output->adaptive_sync_status = WLR_OUTPUT_ADAPTIVE_SYNC_DISABLED;
+	}
+}
+
 static int signal_frame(void *data) {
 	struct wlr_headless_output *output = data;
+	output->last_frame_msec = get_current_time_msec();
 	wlr_output_send_frame(&output->wlr_output);
 	return 0;
 }
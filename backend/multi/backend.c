@@ -146,10 +146,22 @@ static void new_output_reemit(struct wl_listener *listener, void *data) {
 	wl_signal_emit_mutable(&state->container->events.new_output, data);
 }
 
+static void multi_backend_refresh_features(struct wlr_multi_backend *multi) {
+	multi->backend.features.timeline = !wl_list_empty(&multi->backends);
+
+	struct subbackend_state *sub = NULL;
+	wl_list_for_each(sub, &multi->backends, link) {
+		multi->backend.features.timeline = multi->backend.features.timeline &&
+			sub->backend->features.timeline;
+	}
+}
+
 static void handle_subbackend_destroy(struct wl_listener *listener,
 		void *data) {
 	struct subbackend_state *state = wl_container_of(listener, state, destroy);
+	struct wlr_multi_backend *multi = multi_backend_from_backend(state->container);
 	subbackend_state_destroy(state);
+	multi_backend_refresh_features(multi);
 }
 
 static struct subbackend_state *multi_backend_get_subbackend(struct wlr_multi_backend *multi,
@@ -194,6 +206,7 @@ bool wlr_multi_backend_add(struct wlr_backend *_multi,
 	wl_signal_add(&backend->events.new_output, &sub->new_output);
 	sub->new_output.notify = new_output_reemit;
 
+	multi_backend_refresh_features(multi);
 	wl_signal_emit_mutable(&multi->events.backend_add, backend);
 	return true;
 }
@@ -208,6 +221,7 @@ void wlr_multi_backend_remove(struct wlr_backend *_multi,
 	if (sub) {
 		wl_signal_emit_mutable(&multi->events.backend_remove, backend);
 		subbackend_state_destroy(sub);
+		multi_backend_refresh_features(multi);
 	}
 }
 
@@ -0,0 +1,269 @@
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include "input-latency-bench.h"
+#include "wlr-virtual-pointer-unstable-v1-client-protocol.h"
+#include "xdg-shell-client-protocol.h"
+
+/* Client side of the input latency benchmark.
+ *
+ * Every pointer event is answered with a new buffer. Once that buffer has
+ * been displayed (the frame callback is done), the next pointer motion is
+ * injected through the virtual pointer, closing the loop. */
+
+struct client {
+	struct wl_display *display;
+	struct wl_compositor *compositor;
+	struct wl_shm *shm;
+	struct wl_seat *seat;
+	struct xdg_wm_base *wm_base;
+	struct zwlr_virtual_pointer_manager_v1 *pointer_manager;
+
+	struct wl_surface *surface;
+	struct xdg_surface *xdg_surface;
+	struct xdg_toplevel *xdg_toplevel;
+	struct wl_pointer *pointer;
+	struct zwlr_virtual_pointer_v1 *virtual_pointer;
+
+	int width, height;
+	struct wl_buffer *buffers[2];
+	int frame;
+	bool configured;
+	bool running;
+};
+
+static uint32_t get_time_msec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static struct wl_buffer *create_buffer(struct client *client, uint32_t color) {
+	int stride = client->width * 4;
+	int size = stride * client->height;
+
+	char name[64];
+	snprintf(name, sizeof(name), "/wlroots-input-latency-bench-%d", getpid());
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0) {
+		return NULL;
+	}
+	shm_unlink(name);
+	if (ftruncate(fd, size) < 0) {
+		close(fd);
+		return NULL;
+	}
+
+	uint32_t *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		close(fd);
+		return NULL;
+	}
+	for (int i = 0; i < client->width * client->height; i++) {
+		data[i] = color;
+	}
+	munmap(data, size);
+
+	struct wl_shm_pool *pool = wl_shm_create_pool(client->shm, fd, size);
+	struct wl_buffer *buffer = wl_shm_pool_create_buffer(pool, 0,
+		client->width, client->height, stride, WL_SHM_FORMAT_XRGB8888);
+	wl_shm_pool_destroy(pool);
+	close(fd);
+	return buffer;
+}
+
+static void inject_motion(struct client *client) {
+	// Alternate between two positions, so that every event moves the pointer
+	uint32_t x = client->width / 2 + client->frame % 2;
+	uint32_t y = client->height / 2;
+	zwlr_virtual_pointer_v1_motion_absolute(client->virtual_pointer,
+		get_time_msec(), x, y, client->width, client->height);
+	zwlr_virtual_pointer_v1_frame(client->virtual_pointer);
+}
+
+static void frame_handle_done(void *data, struct wl_callback *callback,
+		uint32_t time) {
+	struct client *client = data;
+	wl_callback_destroy(callback);
+	inject_motion(client);
+}
+
+static const struct wl_callback_listener frame_listener = {
+	.done = frame_handle_done,
+};
+
+static void draw(struct client *client) {
+	struct wl_callback *callback = wl_surface_frame(client->surface);
+	wl_callback_add_listener(callback, &frame_listener, client);
+
+	wl_surface_attach(client->surface, client->buffers[client->frame % 2], 0, 0);
+	wl_surface_damage_buffer(client->surface, 0, 0, INT32_MAX, INT32_MAX);
+	wl_surface_commit(client->surface);
+	client->frame++;
+}
+
+static void pointer_handle_enter(void *data, struct wl_pointer *pointer,
+		uint32_t serial, struct wl_surface *surface, wl_fixed_t sx,
+		wl_fixed_t sy) {
+	draw(data);
+}
+
+static void pointer_handle_leave(void *data, struct wl_pointer *pointer,
+		uint32_t serial, struct wl_surface *surface) {
+	// No-op
+}
+
+static void pointer_handle_motion(void *data, struct wl_pointer *pointer,
+		uint32_t time, wl_fixed_t sx, wl_fixed_t sy) {
+	draw(data);
+}
+
+static void pointer_handle_button(void *data, struct wl_pointer *pointer,
+		uint32_t serial, uint32_t time, uint32_t button, uint32_t state) {
+	// No-op
+}
+
+static void pointer_handle_axis(void *data, struct wl_pointer *pointer,
+		uint32_t time, uint32_t axis, wl_fixed_t value) {
+	// No-op
+}
+
+static const struct wl_pointer_listener pointer_listener = {
+	.enter = pointer_handle_enter,
+	.leave = pointer_handle_leave,
+	.motion = pointer_handle_motion,
+	.button = pointer_handle_button,
+	.axis = pointer_handle_axis,
+};
+
+static void xdg_surface_handle_configure(void *data,
+		struct xdg_surface *xdg_surface, uint32_t serial) {
+	struct client *client = data;
+	xdg_surface_ack_configure(xdg_surface, serial);
+	if (!client->configured) {
+		client->configured = true;
+		draw(client);
+	}
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+	.configure = xdg_surface_handle_configure,
+};
+
+static void xdg_toplevel_handle_configure(void *data,
+		struct xdg_toplevel *xdg_toplevel, int32_t width, int32_t height,
+		struct wl_array *states) {
+	// The toplevel keeps its size
+}
+
+static void xdg_toplevel_handle_close(void *data,
+		struct xdg_toplevel *xdg_toplevel) {
+	struct client *client = data;
+	client->running = false;
+}
+
+static const struct xdg_toplevel_listener xdg_toplevel_listener = {
+	.configure = xdg_toplevel_handle_configure,
+	.close = xdg_toplevel_handle_close,
+};
+
+static void wm_base_handle_ping(void *data, struct xdg_wm_base *wm_base,
+		uint32_t serial) {
+	xdg_wm_base_pong(wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+	.ping = wm_base_handle_ping,
+};
+
+static void registry_handle_global(void *data, struct wl_registry *registry,
+		uint32_t name, const char *interface, uint32_t version) {
+	struct client *client = data;
+	if (strcmp(interface, wl_compositor_interface.name) == 0) {
+		client->compositor = wl_registry_bind(registry, name,
+			&wl_compositor_interface, 4);
+	} else if (strcmp(interface, wl_shm_interface.name) == 0) {
+		client->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+	} else if (strcmp(interface, wl_seat_interface.name) == 0 &&
+			client->seat == NULL) {
+		client->seat = wl_registry_bind(registry, name, &wl_seat_interface, 1);
+	} else if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
+		client->wm_base = wl_registry_bind(registry, name,
+			&xdg_wm_base_interface, 1);
+		xdg_wm_base_add_listener(client->wm_base, &wm_base_listener, client);
+	} else if (strcmp(interface,
+			zwlr_virtual_pointer_manager_v1_interface.name) == 0) {
+		client->pointer_manager = wl_registry_bind(registry, name,
+			&zwlr_virtual_pointer_manager_v1_interface, 1);
+	}
+}
+
+static void registry_handle_global_remove(void *data,
+		struct wl_registry *registry, uint32_t name) {
+	// No-op
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = registry_handle_global,
+	.global_remove = registry_handle_global_remove,
+};
+
+int run_client(int fd, int width, int height) {
+	struct client client = {
+		.width = width,
+		.height = height,
+		.running = true,
+	};
+
+	client.display = wl_display_connect_to_fd(fd);
+	if (client.display == NULL) {
+		fprintf(stderr, "Failed to connect to the compositor\n");
+		return EXIT_FAILURE;
+	}
+
+	struct wl_registry *registry = wl_display_get_registry(client.display);
+	wl_registry_add_listener(registry, &registry_listener, &client);
+	wl_display_roundtrip(client.display);
+	if (client.compositor == NULL || client.shm == NULL ||
+			client.seat == NULL || client.wm_base == NULL ||
+			client.pointer_manager == NULL) {
+		fprintf(stderr, "Missing required globals\n");
+		return EXIT_FAILURE;
+	}
+
+	client.buffers[0] = create_buffer(&client, 0xFF204080);
+	client.buffers[1] = create_buffer(&client, 0xFF804020);
+	if (client.buffers[0] == NULL || client.buffers[1] == NULL) {
+		fprintf(stderr, "Failed to create buffers\n");
+		return EXIT_FAILURE;
+	}
+
+	client.pointer = wl_seat_get_pointer(client.seat);
+	wl_pointer_add_listener(client.pointer, &pointer_listener, &client);
+	client.virtual_pointer = zwlr_virtual_pointer_manager_v1_create_virtual_pointer(
+		client.pointer_manager, client.seat);
+
+	client.surface = wl_compositor_create_surface(client.compositor);
+	client.xdg_surface = xdg_wm_base_get_xdg_surface(client.wm_base,
+		client.surface);
+	xdg_surface_add_listener(client.xdg_surface, &xdg_surface_listener, &client);
+	client.xdg_toplevel = xdg_surface_get_toplevel(client.xdg_surface);
+	xdg_toplevel_add_listener(client.xdg_toplevel, &xdg_toplevel_listener,
+		&client);
+	wl_surface_commit(client.surface);
+
+	while (client.running && wl_display_dispatch(client.display) != -1) {
+		// This space intentionally left blank
+	}
+
+	wl_display_disconnect(client.display);
+	return EXIT_SUCCESS;
+}
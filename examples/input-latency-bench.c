@@ -0,0 +1,360 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/pixman.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_input_latency.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_pointer.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/types/wlr_seat.h>
+#include <wlr/types/wlr_shm.h>
+#include <wlr/types/wlr_virtual_pointer_v1.h>
+#include <wlr/types/wlr_xdg_shell.h>
+#include <wlr/util/log.h>
+#include "input-latency-bench.h"
+
+/* Input-to-photon latency benchmark on the headless backend with the pixman
+ * renderer.
+ *
+ * A client process maps a toplevel and injects pointer motion events through
+ * wlr-virtual-pointer-unstable-v1, redrawing in response to each of them.
+ * The latency of every response, from the input event timestamp to the
+ * presentation of the output frame which includes it, is measured with
+ * wlr_input_latency_tracker and printed as JSON on stdout. */
+
+#define OUTPUT_WIDTH 1280
+#define OUTPUT_HEIGHT 720
+#define TOPLEVEL_SIZE 256
+#define TIMEOUT_MS (60 * 1000)
+
+struct bench {
+	struct wl_display *display;
+	struct wlr_backend *backend;
+	struct wlr_renderer *renderer;
+	struct wlr_allocator *allocator;
+	struct wlr_scene *scene;
+	struct wlr_seat *seat;
+	struct wlr_input_latency_tracker *tracker;
+
+	struct wlr_output *output;
+	struct wlr_scene_output *scene_output;
+
+	int warmup, samples, refresh;
+	bool warm;
+	bool timed_out;
+
+	struct wl_listener new_output;
+	struct wl_listener output_frame;
+	struct wl_listener new_toplevel;
+	struct wl_listener new_virtual_pointer;
+};
+
+struct toplevel {
+	struct wlr_xdg_toplevel *xdg_toplevel;
+	struct wl_listener commit;
+	struct wl_listener destroy;
+};
+
+struct virtual_pointer {
+	struct bench *bench;
+	struct wl_listener motion_absolute;
+	struct wl_listener frame;
+	struct wl_listener destroy;
+};
+
+static void output_handle_frame(struct wl_listener *listener, void *data) {
+	struct bench *bench = wl_container_of(listener, bench, output_frame);
+
+	if (!wlr_scene_output_commit(bench->scene_output, NULL)) {
+		return;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	wlr_scene_output_send_frame_done(bench->scene_output, &now);
+
+	struct wlr_input_latency_stats stats;
+	if (!wlr_input_latency_tracker_get_stats(bench->tracker, bench->output,
+			&stats)) {
+		return;
+	}
+	if (!bench->warm) {
+		if (stats.samples >= (uint64_t)bench->warmup) {
+			wlr_input_latency_tracker_reset_stats(bench->tracker);
+			bench->warm = true;
+		}
+	} else if (stats.samples >= (uint64_t)bench->samples) {
+		wl_display_terminate(bench->display);
+	}
+}
+
+static void handle_new_output(struct wl_listener *listener, void *data) {
+	struct bench *bench = wl_container_of(listener, bench, new_output);
+	struct wlr_output *output = data;
+
+	wlr_output_init_render(output, bench->allocator, bench->renderer);
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	wlr_output_state_set_enabled(&state, true);
+	wlr_output_state_set_custom_mode(&state, OUTPUT_WIDTH, OUTPUT_HEIGHT,
+		bench->refresh);
+	wlr_output_commit_state(output, &state);
+	wlr_output_state_finish(&state);
+
+	bench->output = output;
+	bench->scene_output = wlr_scene_output_create(bench->scene, output);
+
+	bench->output_frame.notify = output_handle_frame;
+	wl_signal_add(&output->events.frame, &bench->output_frame);
+}
+
+static void toplevel_handle_commit(struct wl_listener *listener, void *data) {
+	struct toplevel *toplevel = wl_container_of(listener, toplevel, commit);
+	if (toplevel->xdg_toplevel->base->initial_commit) {
+		wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel, 0, 0);
+	}
+}
+
+static void toplevel_handle_destroy(struct wl_listener *listener, void *data) {
+	struct toplevel *toplevel = wl_container_of(listener, toplevel, destroy);
+	wl_list_remove(&toplevel->commit.link);
+	wl_list_remove(&toplevel->destroy.link);
+	free(toplevel);
+}
+
+static void handle_new_toplevel(struct wl_listener *listener, void *data) {
+	struct bench *bench = wl_container_of(listener, bench, new_toplevel);
+	struct wlr_xdg_toplevel *xdg_toplevel = data;
+
+	struct toplevel *toplevel = calloc(1, sizeof(*toplevel));
+	if (toplevel == NULL) {
+		return;
+	}
+	toplevel->xdg_toplevel = xdg_toplevel;
+	toplevel->commit.notify = toplevel_handle_commit;
+	wl_signal_add(&xdg_toplevel->base->surface->events.commit, &toplevel->commit);
+	toplevel->destroy.notify = toplevel_handle_destroy;
+	wl_signal_add(&xdg_toplevel->events.destroy, &toplevel->destroy);
+
+	wlr_scene_xdg_surface_create(&bench->scene->tree, xdg_toplevel->base);
+}
+
+static void pointer_handle_motion_absolute(struct wl_listener *listener,
+		void *data) {
+	struct virtual_pointer *pointer =
+		wl_container_of(listener, pointer, motion_absolute);
+	struct bench *bench = pointer->bench;
+	struct wlr_pointer_motion_absolute_event *event = data;
+
+	// The pointer is confined to the toplevel, mapped at the origin
+	double lx = event->x * TOPLEVEL_SIZE;
+	double ly = event->y * TOPLEVEL_SIZE;
+
+	double sx, sy;
+	struct wlr_scene_node *node =
+		wlr_scene_node_at(&bench->scene->tree.node, lx, ly, &sx, &sy);
+	struct wlr_scene_surface *scene_surface = NULL;
+	if (node != NULL && node->type == WLR_SCENE_NODE_BUFFER) {
+		scene_surface = wlr_scene_surface_try_from_buffer(
+			wlr_scene_buffer_from_node(node));
+	}
+	if (scene_surface == NULL) {
+		wlr_seat_pointer_clear_focus(bench->seat);
+		return;
+	}
+
+	wlr_seat_pointer_notify_enter(bench->seat, scene_surface->surface, sx, sy);
+	wlr_seat_pointer_notify_motion(bench->seat, event->time_msec, sx, sy);
+}
+
+static void pointer_handle_frame(struct wl_listener *listener, void *data) {
+	struct virtual_pointer *pointer = wl_container_of(listener, pointer, frame);
+	wlr_seat_pointer_notify_frame(pointer->bench->seat);
+}
+
+static void pointer_handle_destroy(struct wl_listener *listener, void *data) {
+	struct virtual_pointer *pointer = wl_container_of(listener, pointer, destroy);
+	wl_list_remove(&pointer->motion_absolute.link);
+	wl_list_remove(&pointer->frame.link);
+	wl_list_remove(&pointer->destroy.link);
+	free(pointer);
+}
+
+static void handle_new_virtual_pointer(struct wl_listener *listener,
+		void *data) {
+	struct bench *bench = wl_container_of(listener, bench, new_virtual_pointer);
+	struct wlr_virtual_pointer_v1_new_pointer_event *event = data;
+	struct wlr_pointer *wlr_pointer = &event->new_pointer->pointer;
+
+	struct virtual_pointer *pointer = calloc(1, sizeof(*pointer));
+	if (pointer == NULL) {
+		return;
+	}
+	pointer->bench = bench;
+	pointer->motion_absolute.notify = pointer_handle_motion_absolute;
+	wl_signal_add(&wlr_pointer->events.motion_absolute,
+		&pointer->motion_absolute);
+	pointer->frame.notify = pointer_handle_frame;
+	wl_signal_add(&wlr_pointer->events.frame, &pointer->frame);
+	pointer->destroy.notify = pointer_handle_destroy;
+	wl_signal_add(&wlr_pointer->base.events.destroy, &pointer->destroy);
+}
+
+static int handle_timeout(void *data) {
+	struct bench *bench = data;
+	bench->timed_out = true;
+	wl_display_terminate(bench->display);
+	return 0;
+}
+
+static const char usage[] =
+	"usage: input-latency-bench [options...]\n"
+	"  -n <count>   number of measured samples (default: 1000)\n"
+	"  -w <count>   number of warm-up samples (default: 60)\n"
+	"  -r <mHz>     output refresh rate (default: 60000)\n"
+	"  -h           show this help\n";
+
+int main(int argc, char *argv[]) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	struct bench bench = {
+		.warmup = 60,
+		.samples = 1000,
+		.refresh = 60000,
+	};
+
+	int c;
+	while ((c = getopt(argc, argv, "n:w:r:h")) != -1) {
+		switch (c) {
+		case 'n':
+			bench.samples = atoi(optarg);
+			break;
+		case 'w':
+			bench.warmup = atoi(optarg);
+			break;
+		case 'r':
+			bench.refresh = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "%s", usage);
+			return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (bench.samples <= 0 || bench.warmup < 0 || bench.refresh <= 0) {
+		fprintf(stderr, "%s", usage);
+		return EXIT_FAILURE;
+	}
+
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0) {
+		perror("socketpair");
+		return EXIT_FAILURE;
+	}
+
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return EXIT_FAILURE;
+	} else if (pid == 0) {
+		close(sockets[0]);
+		_exit(run_client(sockets[1], TOPLEVEL_SIZE, TOPLEVEL_SIZE));
+	}
+	close(sockets[1]);
+
+	bench.display = wl_display_create();
+	bench.backend = wlr_headless_backend_create(bench.display);
+	bench.renderer = wlr_pixman_renderer_create();
+	if (bench.backend == NULL || bench.renderer == NULL) {
+		return EXIT_FAILURE;
+	}
+	bench.allocator = wlr_allocator_autocreate(bench.backend, bench.renderer);
+	if (bench.allocator == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	wlr_compositor_create(bench.display, 5, bench.renderer);
+	wlr_shm_create_with_renderer(bench.display, 1, bench.renderer);
+	struct wlr_xdg_shell *xdg_shell = wlr_xdg_shell_create(bench.display, 3);
+	struct wlr_virtual_pointer_manager_v1 *pointer_manager =
+		wlr_virtual_pointer_manager_v1_create(bench.display);
+	bench.seat = wlr_seat_create(bench.display, "seat0");
+	wlr_seat_set_capabilities(bench.seat, WL_SEAT_CAPABILITY_POINTER);
+	bench.tracker = wlr_input_latency_tracker_create(bench.seat);
+	bench.scene = wlr_scene_create();
+
+	bench.new_output.notify = handle_new_output;
+	wl_signal_add(&bench.backend->events.new_output, &bench.new_output);
+	bench.new_toplevel.notify = handle_new_toplevel;
+	wl_signal_add(&xdg_shell->events.new_toplevel, &bench.new_toplevel);
+	bench.new_virtual_pointer.notify = handle_new_virtual_pointer;
+	wl_signal_add(&pointer_manager->events.new_virtual_pointer,
+		&bench.new_virtual_pointer);
+
+	if (!wlr_backend_start(bench.backend)) {
+		return EXIT_FAILURE;
+	}
+	wlr_headless_add_output(bench.backend, OUTPUT_WIDTH, OUTPUT_HEIGHT);
+	if (bench.output == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	if (wl_client_create(bench.display, sockets[0]) == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	struct wl_event_source *timeout = wl_event_loop_add_timer(
+		wl_display_get_event_loop(bench.display), handle_timeout, &bench);
+	wl_event_source_timer_update(timeout, TIMEOUT_MS);
+
+	wl_display_run(bench.display);
+
+	struct wlr_input_latency_stats stats = {0};
+	bool ok = !bench.timed_out &&
+		wlr_input_latency_tracker_get_stats(bench.tracker, bench.output, &stats);
+	if (ok) {
+		printf("{\n");
+		printf("\t\"refresh_mhz\": %d,\n", bench.refresh);
+		printf("\t\"samples\": %" PRIu64 ",\n", stats.samples);
+		printf("\t\"p50_ns\": %" PRId64 ",\n", stats.p50_ns);
+		printf("\t\"p99_ns\": %" PRId64 ",\n", stats.p99_ns);
+		printf("\t\"max_ns\": %" PRId64 ",\n", stats.max_ns);
+		printf("\t\"compositor_mean_ns\": %" PRId64 ",\n",
+			stats.compositor_mean_ns);
+		printf("\t\"client_mean_ns\": %" PRId64 ",\n", stats.client_mean_ns);
+		printf("\t\"display_mean_ns\": %" PRId64 "\n", stats.display_mean_ns);
+		printf("}\n");
+	} else {
+		fprintf(stderr, "No latency sample recorded before the timeout\n");
+	}
+
+	wl_event_source_remove(timeout);
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+
+	wl_list_remove(&bench.new_output.link);
+	wl_list_remove(&bench.output_frame.link);
+	wl_list_remove(&bench.new_toplevel.link);
+	wl_list_remove(&bench.new_virtual_pointer.link);
+	wl_display_destroy_clients(bench.display);
+	wlr_scene_node_destroy(&bench.scene->tree.node);
+	wlr_backend_destroy(bench.backend);
+	wlr_allocator_destroy(bench.allocator);
+	wlr_renderer_destroy(bench.renderer);
+	wl_display_destroy(bench.display);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,11 @@
+#ifndef _INPUT_LATENCY_BENCH_H
+#define _INPUT_LATENCY_BENCH_H
+
+/**
+ * Run the benchmark client on the Wayland connection fd. The client maps a
+ * toplevel of the given size, then injects a virtual pointer motion event
+ * every time its previous response has been displayed.
+ */
+int run_client(int fd, int width, int height);
+
+#endif
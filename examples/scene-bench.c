@@ -0,0 +1,489 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <drm_fourcc.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/interfaces/wlr_buffer.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/pixman.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/util/log.h>
+
+/* Scene-graph benchmark on the headless backend with the pixman renderer.
+ *
+ * Builds synthetic scenes, drives frames while moving and damaging nodes, and
+ * prints per-phase timings as JSON on stdout:
+ *
+ * - update: scene node moves and buffer damage (visibility update)
+ * - pre_render: wlr_scene_output_build_state() up to the render pass,
+ *   including the render list build
+ * - render: the render pass
+ * - commit: wlr_output_commit_state()
+ *
+ * along with the scene scratch storage growths reported by the scene timer
+ * (allocations made internally by pixman are not included). */
+
+#define OUTPUT_WIDTH 1920
+#define OUTPUT_HEIGHT 1080
+
+struct mem_buffer {
+	struct wlr_buffer base;
+	uint32_t format;
+	size_t stride;
+	void *data;
+};
+
+static void mem_buffer_destroy(struct wlr_buffer *wlr_buffer) {
+	struct mem_buffer *buffer = wl_container_of(wlr_buffer, buffer, base);
+	free(buffer->data);
+	free(buffer);
+}
+
+static bool mem_buffer_begin_data_ptr_access(struct wlr_buffer *wlr_buffer,
+		uint32_t flags, void **data, uint32_t *format, size_t *stride) {
+	struct mem_buffer *buffer = wl_container_of(wlr_buffer, buffer, base);
+	*data = buffer->data;
+	*format = buffer->format;
+	*stride = buffer->stride;
+	return true;
+}
+
+static void mem_buffer_end_data_ptr_access(struct wlr_buffer *wlr_buffer) {
+}
+
+static const struct wlr_buffer_impl mem_buffer_impl = {
+	.destroy = mem_buffer_destroy,
+	.begin_data_ptr_access = mem_buffer_begin_data_ptr_access,
+	.end_data_ptr_access = mem_buffer_end_data_ptr_access,
+};
+
+static struct wlr_buffer *mem_buffer_create(int width, int height,
+		uint32_t format, uint32_t color) {
+	struct mem_buffer *buffer = calloc(1, sizeof(*buffer));
+	if (buffer == NULL) {
+		return NULL;
+	}
+
+	wlr_buffer_init(&buffer->base, &mem_buffer_impl, width, height);
+	buffer->format = format;
+	buffer->stride = width * 4;
+	buffer->data = malloc(buffer->stride * height);
+	if (buffer->data == NULL) {
+		free(buffer);
+		return NULL;
+	}
+
+	uint32_t *pixels = buffer->data;
+	for (size_t i = 0; i < (size_t)width * height; i++) {
+		pixels[i] = color;
+	}
+
+	return &buffer->base;
+}
+
+struct bench {
+	struct wl_display *display;
+	struct wlr_backend *backend;
+	struct wlr_renderer *renderer;
+	struct wlr_allocator *allocator;
+	struct wlr_output *output;
+
+	struct wl_listener new_output;
+
+	int toplevels;
+	int depth;
+	int frames;
+	bool first_result;
+};
+
+enum bench_scene {
+	BENCH_SCENE_TOPLEVELS,
+	BENCH_SCENE_RECTS,
+	BENCH_SCENE_PARTIAL_OPAQUE,
+};
+
+static const char *bench_scene_names[] = {
+	[BENCH_SCENE_TOPLEVELS] = "toplevels",
+	[BENCH_SCENE_RECTS] = "overlapping-rects",
+	[BENCH_SCENE_PARTIAL_OPAQUE] = "partial-opaque",
+};
+
+struct bench_samples {
+	int64_t *update, *pre_render, *render, *commit;
+	size_t scratch_growths;
+	int len;
+};
+
+static int64_t get_time_ns(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void add_subsurfaces(struct wlr_scene_tree *parent, int depth,
+		int width, int height) {
+	if (depth == 0 || width < 16 || height < 16) {
+		return;
+	}
+
+	struct wlr_scene_tree *tree = wlr_scene_tree_create(parent);
+	wlr_scene_node_set_position(&tree->node, width / 4, height / 4);
+
+	struct wlr_buffer *buffer = mem_buffer_create(width / 2, height / 2,
+		DRM_FORMAT_ARGB8888, 0x80208020);
+	if (buffer != NULL) {
+		wlr_scene_buffer_create(tree, buffer);
+		wlr_buffer_drop(buffer);
+	}
+
+	add_subsurfaces(tree, depth - 1, width / 2, height / 2);
+}
+
+static void build_scene(struct bench *bench, struct wlr_scene *scene,
+		enum bench_scene type) {
+	// Wallpaper
+	struct wlr_buffer *wallpaper = mem_buffer_create(OUTPUT_WIDTH, OUTPUT_HEIGHT,
+		DRM_FORMAT_XRGB8888, 0xff303030);
+	if (wallpaper != NULL) {
+		wlr_scene_buffer_create(&scene->tree, wallpaper);
+		wlr_buffer_drop(wallpaper);
+	}
+
+	for (int i = 0; i < bench->toplevels; i++) {
+		int x = (i * 97) % (OUTPUT_WIDTH - 400);
+		int y = (i * 61) % (OUTPUT_HEIGHT - 300);
+		int width = 320 + (i * 37) % 480;
+		int height = 240 + (i * 53) % 360;
+
+		struct wlr_scene_tree *tree = wlr_scene_tree_create(&scene->tree);
+		wlr_scene_node_set_position(&tree->node, x, y);
+
+		struct wlr_buffer *buffer;
+		struct wlr_scene_buffer *scene_buffer;
+		switch (type) {
+		case BENCH_SCENE_TOPLEVELS:;
+			float border[4] = { 0.2, 0.2, 0.6, 1 };
+			wlr_scene_rect_create(tree, width + 4, height + 4, border);
+
+			buffer = mem_buffer_create(width, height,
+				DRM_FORMAT_XRGB8888, 0xff000000 | (i * 0x102030));
+			if (buffer != NULL) {
+				scene_buffer = wlr_scene_buffer_create(tree, buffer);
+				wlr_scene_node_set_position(&scene_buffer->node, 2, 2);
+				wlr_buffer_drop(buffer);
+			}
+
+			add_subsurfaces(tree, bench->depth, width, height);
+			break;
+		case BENCH_SCENE_RECTS:;
+			float color[4] = { 0.1 * (i % 10), 0.5, 0.2, 0.5 };
+			wlr_scene_rect_create(tree, width, height, color);
+			break;
+		case BENCH_SCENE_PARTIAL_OPAQUE:;
+			buffer = mem_buffer_create(width, height, DRM_FORMAT_ARGB8888,
+				0xc0000000 | (i * 0x102030));
+			if (buffer == NULL) {
+				break;
+			}
+
+			scene_buffer = wlr_scene_buffer_create(tree, buffer);
+			wlr_buffer_drop(buffer);
+
+			// Opaque content with translucent decorations around it
+			pixman_region32_t opaque;
+			pixman_region32_init_rect(&opaque, 8, 24, width - 16, height - 32);
+			wlr_scene_buffer_set_opaque_region(scene_buffer, &opaque);
+			pixman_region32_fini(&opaque);
+			break;
+		}
+	}
+}
+
+static struct wlr_scene_node *nth_toplevel(struct wlr_scene *scene, int n) {
+	// Skip the wallpaper
+	int i = -1;
+	struct wlr_scene_node *node;
+	wl_list_for_each(node, &scene->tree.children, link) {
+		if (i == n) {
+			return node;
+		}
+		i++;
+	}
+	return NULL;
+}
+
+static struct wlr_scene_buffer *first_buffer(struct wlr_scene_node *node) {
+	if (node->type == WLR_SCENE_NODE_BUFFER) {
+		return wlr_scene_buffer_from_node(node);
+	} else if (node->type != WLR_SCENE_NODE_TREE) {
+		return NULL;
+	}
+
+	struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
+	struct wlr_scene_node *child;
+	wl_list_for_each(child, &tree->children, link) {
+		struct wlr_scene_buffer *buffer = first_buffer(child);
+		if (buffer != NULL) {
+			return buffer;
+		}
+	}
+	return NULL;
+}
+
+static void update_scene(struct wlr_scene_node *moved,
+		struct wlr_scene_buffer *scene_buffer, int frame) {
+	if (moved != NULL) {
+		wlr_scene_node_set_position(moved, (moved->x + 7) % (OUTPUT_WIDTH - 400),
+			(moved->y + 5) % (OUTPUT_HEIGHT - 300));
+	}
+
+	if (scene_buffer != NULL && scene_buffer->buffer != NULL) {
+		pixman_region32_t damage;
+		pixman_region32_init_rect(&damage, frame % 64, frame % 48, 64, 48);
+		wlr_scene_buffer_set_buffer_with_damage(scene_buffer,
+			scene_buffer->buffer, &damage);
+		pixman_region32_fini(&damage);
+	}
+}
+
+static bool run_frames(struct bench *bench, struct wlr_scene *scene,
+		struct wlr_scene_output *scene_output, struct bench_samples *samples) {
+	for (int frame = 0; frame < bench->frames; frame++) {
+		// Move one toplevel around, and damage part of another one
+		struct wlr_scene_node *moved = nth_toplevel(scene, frame % bench->toplevels);
+		struct wlr_scene_node *damaged =
+			nth_toplevel(scene, (frame * 7 + 3) % bench->toplevels);
+		struct wlr_scene_buffer *scene_buffer =
+			damaged != NULL ? first_buffer(damaged) : NULL;
+
+		int64_t start = get_time_ns();
+		update_scene(moved, scene_buffer, frame);
+		samples->update[frame] = get_time_ns() - start;
+
+		struct wlr_scene_timer timer = {0};
+		struct wlr_output_state state;
+		wlr_output_state_init(&state);
+
+		start = get_time_ns();
+		bool ok = wlr_scene_output_build_state(scene_output, &state,
+			&(struct wlr_scene_output_state_options){ .timer = &timer });
+		int64_t build_duration = get_time_ns() - start;
+
+		samples->pre_render[frame] = timer.pre_render_duration;
+		samples->render[frame] = build_duration - timer.pre_render_duration;
+		samples->scratch_growths += timer.scratch_growths;
+		wlr_scene_timer_finish(&timer);
+
+		start = get_time_ns();
+		ok = ok && wlr_output_commit_state(bench->output, &state);
+		samples->commit[frame] = get_time_ns() - start;
+
+		wlr_output_state_finish(&state);
+		if (!ok) {
+			wlr_log(WLR_ERROR, "Failed to commit frame %d", frame);
+			return false;
+		}
+	}
+
+	samples->len = bench->frames;
+	return true;
+}
+
+static int compare_int64(const void *_a, const void *_b) {
+	int64_t a = *(const int64_t *)_a, b = *(const int64_t *)_b;
+	return (a > b) - (a < b);
+}
+
+static void print_phase(const char *name, int64_t *values, int len, bool last) {
+	qsort(values, len, sizeof(values[0]), compare_int64);
+
+	int64_t sum = 0;
+	for (int i = 0; i < len; i++) {
+		sum += values[i];
+	}
+
+	printf("\t\t\t\"%s\": { \"mean_ns\": %" PRId64 ", \"min_ns\": %" PRId64
+		", \"p50_ns\": %" PRId64 ", \"p99_ns\": %" PRId64 ", \"max_ns\": %" PRId64
+		" }%s\n", name, sum / len, values[0], values[len / 2],
+		values[len * 99 / 100], values[len - 1], last ? "" : ",");
+}
+
+static const char *transform_name(enum wl_output_transform transform) {
+	static const char *names[] = {
+		"normal", "90", "180", "270",
+		"flipped", "flipped-90", "flipped-180", "flipped-270",
+	};
+	return names[transform];
+}
+
+static bool run_bench(struct bench *bench, enum bench_scene type, float scale,
+		enum wl_output_transform transform) {
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	wlr_output_state_set_scale(&state, scale);
+	wlr_output_state_set_transform(&state, transform);
+	bool ok = wlr_output_commit_state(bench->output, &state);
+	wlr_output_state_finish(&state);
+	if (!ok) {
+		wlr_log(WLR_ERROR, "Failed to configure output");
+		return false;
+	}
+
+	struct wlr_scene *scene = wlr_scene_create();
+	if (scene == NULL) {
+		return false;
+	}
+	struct wlr_scene_output *scene_output =
+		wlr_scene_output_create(scene, bench->output);
+	if (scene_output == NULL) {
+		wlr_scene_node_destroy(&scene->tree.node);
+		return false;
+	}
+	build_scene(bench, scene, type);
+
+	struct bench_samples samples = {
+		.update = calloc(bench->frames, sizeof(int64_t)),
+		.pre_render = calloc(bench->frames, sizeof(int64_t)),
+		.render = calloc(bench->frames, sizeof(int64_t)),
+		.commit = calloc(bench->frames, sizeof(int64_t)),
+	};
+	if (samples.update == NULL || samples.pre_render == NULL ||
+			samples.render == NULL || samples.commit == NULL) {
+		ok = false;
+	} else {
+		ok = run_frames(bench, scene, scene_output, &samples);
+	}
+
+	if (ok) {
+		printf("%s\t\t{\n", bench->first_result ? "" : ",\n");
+		bench->first_result = false;
+		printf("\t\t\t\"scene\": \"%s\",\n", bench_scene_names[type]);
+		printf("\t\t\t\"scale\": %g,\n", scale);
+		printf("\t\t\t\"transform\": \"%s\",\n", transform_name(transform));
+		printf("\t\t\t\"frames\": %d,\n", samples.len);
+		printf("\t\t\t\"scratch_growths_per_frame\": %g,\n",
+			(double)samples.scratch_growths / samples.len);
+		print_phase("update", samples.update, samples.len, false);
+		print_phase("pre_render", samples.pre_render, samples.len, false);
+		print_phase("render", samples.render, samples.len, false);
+		print_phase("commit", samples.commit, samples.len, true);
+		printf("\t\t}");
+	}
+
+	free(samples.update);
+	free(samples.pre_render);
+	free(samples.render);
+	free(samples.commit);
+	wlr_scene_node_destroy(&scene->tree.node);
+	return ok;
+}
+
+static void handle_new_output(struct wl_listener *listener, void *data) {
+	struct bench *bench = wl_container_of(listener, bench, new_output);
+	struct wlr_output *output = data;
+
+	wlr_output_init_render(output, bench->allocator, bench->renderer);
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	wlr_output_state_set_enabled(&state, true);
+	wlr_output_commit_state(output, &state);
+	wlr_output_state_finish(&state);
+
+	bench->output = output;
+}
+
+static const char usage[] =
+	"usage: scene-bench [options...]\n"
+	"  -n <count>   number of toplevels (default: 64)\n"
+	"  -d <depth>   depth of the subsurface trees (default: 3)\n"
+	"  -f <count>   frames per configuration (default: 300)\n"
+	"  -h           show this help\n";
+
+int main(int argc, char *argv[]) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	struct bench bench = {
+		.toplevels = 64,
+		.depth = 3,
+		.frames = 300,
+		.first_result = true,
+	};
+
+	int c;
+	while ((c = getopt(argc, argv, "n:d:f:h")) != -1) {
+		switch (c) {
+		case 'n':
+			bench.toplevels = atoi(optarg);
+			break;
+		case 'd':
+			bench.depth = atoi(optarg);
+			break;
+		case 'f':
+			bench.frames = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "%s", usage);
+			return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (bench.toplevels <= 0 || bench.depth < 0 || bench.frames <= 0) {
+		fprintf(stderr, "%s", usage);
+		return EXIT_FAILURE;
+	}
+
+	bench.display = wl_display_create();
+	bench.backend = wlr_headless_backend_create(bench.display);
+	bench.renderer = wlr_pixman_renderer_create();
+	if (bench.backend == NULL || bench.renderer == NULL) {
+		return EXIT_FAILURE;
+	}
+	bench.allocator = wlr_allocator_autocreate(bench.backend, bench.renderer);
+	if (bench.allocator == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	bench.new_output.notify = handle_new_output;
+	wl_signal_add(&bench.backend->events.new_output, &bench.new_output);
+
+	if (!wlr_backend_start(bench.backend)) {
+		return EXIT_FAILURE;
+	}
+	wlr_headless_add_output(bench.backend, OUTPUT_WIDTH, OUTPUT_HEIGHT);
+	if (bench.output == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	printf("{\n\t\"toplevels\": %d,\n\t\"depth\": %d,\n\t\"results\": [\n",
+		bench.toplevels, bench.depth);
+
+	bool ok = true;
+	static const float scales[] = { 1, 1.5, 2 };
+	for (enum bench_scene type = 0; ok && type <= BENCH_SCENE_PARTIAL_OPAQUE; type++) {
+		for (size_t i = 0; ok && i < sizeof(scales) / sizeof(scales[0]); i++) {
+			ok = run_bench(&bench, type, scales[i], WL_OUTPUT_TRANSFORM_NORMAL);
+		}
+	}
+	for (int transform = WL_OUTPUT_TRANSFORM_90;
+			ok && transform <= WL_OUTPUT_TRANSFORM_FLIPPED_270; transform++) {
+		ok = run_bench(&bench, BENCH_SCENE_TOPLEVELS, 1, transform);
+	}
+
+	printf("\n\t]\n}\n");
+
+	wl_list_remove(&bench.new_output.link);
+	wlr_backend_destroy(bench.backend);
+	wlr_allocator_destroy(bench.allocator);
+	wlr_renderer_destroy(bench.renderer);
+	wl_display_destroy(bench.display);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
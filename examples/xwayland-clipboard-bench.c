@@ -0,0 +1,721 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/pixman.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_data_device.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_seat.h>
+#include <wlr/util/log.h>
+#include <wlr/xwayland.h>
+#include <xcb/xcb.h>
+
+/* Xwayland clipboard throughput benchmark.
+ *
+ * Starts a headless compositor with Xwayland, then forks an X11 client which
+ * takes the CLIPBOARD selection and serves a large payload with the INCR
+ * protocol. The compositor reads it through the Wayland data source created
+ * by the XWM. Then the compositor sets a Wayland selection with a payload of
+ * the same size, which the X11 client reads back, again with INCR.
+ *
+ * Meanwhile, a 1 ms timer measures how late the compositor's event loop
+ * dispatches it, to check that transfers don't block the compositor.
+ *
+ * Results are printed as JSON on stdout. */
+
+#define MIME_TYPE "application/x-wlr-clipboard-bench"
+// Chunk size used by the X11 client for INCR transfers
+#define X11_CHUNK_SIZE (256 * 1024)
+#define PAYLOAD_CHUNK_SIZE (64 * 1024)
+#define TICK_MS 1
+// Lateness above this threshold counts as a stall
+#define STALL_NSEC (4 * 1000 * 1000)
+
+struct transfer_report {
+	uint64_t bytes;
+	int64_t duration_ns;
+};
+
+struct bench {
+	size_t size;
+
+	struct wl_display *display;
+	struct wl_event_loop *event_loop;
+	struct wlr_backend *backend;
+	struct wlr_renderer *renderer;
+	struct wlr_allocator *allocator;
+	struct wlr_seat *seat;
+	struct wlr_xwayland *xwayland;
+	struct wl_event_source *tick;
+	struct wl_event_source *sigchld;
+
+	pid_t child;
+	int child_status;
+	int report_fd;
+	bool activated;
+
+	// X11 to Wayland
+	int read_fd;
+	struct wl_event_source *read_source;
+	struct transfer_report x11_to_wl;
+	int64_t x11_to_wl_start;
+
+	// Wayland to X11, as measured by the X11 client
+	int write_fd;
+	struct wl_event_source *write_source;
+	uint64_t written;
+	struct transfer_report wl_to_x11;
+
+	int64_t start, end;
+	int64_t tick_due;
+	uint64_t stalls;
+	int64_t max_lateness;
+
+	struct wl_listener new_output;
+	struct wl_listener xwayland_ready;
+	struct wl_listener new_surface;
+	struct wl_listener request_set_selection;
+	struct wl_listener set_selection;
+};
+
+struct bench_data_source {
+	struct wlr_data_source base;
+	struct bench *bench;
+};
+
+static char payload[PAYLOAD_CHUNK_SIZE];
+
+static int64_t get_current_time_nsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static int handle_tick(void *data) {
+	struct bench *bench = data;
+	int64_t now = get_current_time_nsec();
+
+	int64_t lateness = now - bench->tick_due;
+	if (lateness > bench->max_lateness) {
+		bench->max_lateness = lateness;
+	}
+	if (lateness > STALL_NSEC) {
+		bench->stalls++;
+	}
+
+	bench->tick_due = now + TICK_MS * 1000000;
+	wl_event_source_timer_update(bench->tick, TICK_MS);
+	return 0;
+}
+
+static xcb_atom_t intern_atom(xcb_connection_t *conn, const char *name) {
+	xcb_intern_atom_cookie_t cookie =
+		xcb_intern_atom(conn, 0, strlen(name), name);
+	xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(conn, cookie, NULL);
+	if (reply == NULL) {
+		return XCB_ATOM_NONE;
+	}
+	xcb_atom_t atom = reply->atom;
+	free(reply);
+	return atom;
+}
+
+struct x11_client {
+	xcb_connection_t *conn;
+	xcb_window_t window;
+	xcb_atom_t clipboard, targets, incr, mime_type, property;
+	size_t size;
+
+	// Outgoing INCR transfer
+	xcb_window_t requestor;
+	xcb_atom_t requestor_property;
+	size_t sent;
+	bool sending;
+};
+
+static void x11_send_notify(struct x11_client *client,
+		xcb_selection_request_event_t *req, bool success) {
+	xcb_selection_notify_event_t notify = {
+		.response_type = XCB_SELECTION_NOTIFY,
+		.time = req->time,
+		.requestor = req->requestor,
+		.selection = req->selection,
+		.target = req->target,
+		.property = success ? req->property : XCB_ATOM_NONE,
+	};
+	xcb_send_event(client->conn, 0, req->requestor, XCB_EVENT_MASK_NO_EVENT,
+		(const char *)&notify);
+}
+
+static void x11_send_chunk(struct x11_client *client) {
+	static char chunk[X11_CHUNK_SIZE];
+
+	size_t len = client->size - client->sent;
+	if (len > sizeof(chunk)) {
+		len = sizeof(chunk);
+	}
+	// The last chunk is empty and terminates the transfer
+	xcb_change_property(client->conn, XCB_PROP_MODE_REPLACE, client->requestor,
+		client->requestor_property, client->mime_type, 8, len, chunk);
+	client->sent += len;
+	if (len == 0) {
+		client->sending = false;
+	}
+}
+
+static void x11_handle_selection_request(struct x11_client *client,
+		xcb_selection_request_event_t *req) {
+	if (req->target == client->targets) {
+		xcb_atom_t targets[] = { client->targets, client->mime_type };
+		xcb_change_property(client->conn, XCB_PROP_MODE_REPLACE,
+			req->requestor, req->property, XCB_ATOM_ATOM, 32,
+			sizeof(targets) / sizeof(targets[0]), targets);
+		x11_send_notify(client, req, true);
+	} else if (req->target == client->mime_type && !client->sending) {
+		client->requestor = req->requestor;
+		client->requestor_property = req->property;
+		client->sent = 0;
+		client->sending = true;
+
+		// Each deletion of the property by the requestor asks for a new chunk
+		uint32_t mask = XCB_EVENT_MASK_PROPERTY_CHANGE;
+		xcb_change_window_attributes(client->conn, req->requestor,
+			XCB_CW_EVENT_MASK, &mask);
+		uint32_t size = client->size;
+		xcb_change_property(client->conn, XCB_PROP_MODE_REPLACE,
+			req->requestor, req->property, client->incr, 32, 1, &size);
+		x11_send_notify(client, req, true);
+	} else {
+		x11_send_notify(client, req, false);
+	}
+	xcb_flush(client->conn);
+}
+
+/**
+ * Serve the CLIPBOARD selection until the compositor takes it over.
+ */
+static bool x11_serve_selection(struct x11_client *client) {
+	xcb_set_selection_owner(client->conn, client->window, client->clipboard,
+		XCB_CURRENT_TIME);
+	xcb_flush(client->conn);
+
+	xcb_generic_event_t *event;
+	while ((event = xcb_wait_for_event(client->conn)) != NULL) {
+		switch (event->response_type & ~0x80) {
+		case XCB_SELECTION_REQUEST:
+			x11_handle_selection_request(client,
+				(xcb_selection_request_event_t *)event);
+			break;
+		case XCB_PROPERTY_NOTIFY:;
+			xcb_property_notify_event_t *notify =
+				(xcb_property_notify_event_t *)event;
+			if (client->sending && notify->state == XCB_PROPERTY_DELETE &&
+					notify->window == client->requestor &&
+					notify->atom == client->requestor_property) {
+				x11_send_chunk(client);
+				xcb_flush(client->conn);
+			}
+			break;
+		case XCB_SELECTION_CLEAR:
+			free(event);
+			return true;
+		}
+		free(event);
+	}
+	return false;
+}
+
+static xcb_generic_event_t *x11_wait_for_event(struct x11_client *client,
+		uint8_t type) {
+	xcb_generic_event_t *event;
+	while ((event = xcb_wait_for_event(client->conn)) != NULL) {
+		if ((event->response_type & ~0x80) == type) {
+			return event;
+		}
+		free(event);
+	}
+	return NULL;
+}
+
+/**
+ * Read the CLIPBOARD selection, owned by the compositor.
+ */
+static bool x11_read_selection(struct x11_client *client,
+		struct transfer_report *report) {
+	int64_t start = get_current_time_nsec();
+
+	xcb_convert_selection(client->conn, client->window, client->clipboard,
+		client->mime_type, client->property, XCB_CURRENT_TIME);
+	xcb_flush(client->conn);
+
+	xcb_selection_notify_event_t *notify = (xcb_selection_notify_event_t *)
+		x11_wait_for_event(client, XCB_SELECTION_NOTIFY);
+	if (notify == NULL || notify->property == XCB_ATOM_NONE) {
+		free(notify);
+		return false;
+	}
+	free(notify);
+
+	bool incr = false;
+	while (true) {
+		xcb_get_property_cookie_t cookie = xcb_get_property(client->conn, 1,
+			client->window, client->property, XCB_GET_PROPERTY_TYPE_ANY,
+			0, UINT32_MAX / 4);
+		xcb_get_property_reply_t *reply =
+			xcb_get_property_reply(client->conn, cookie, NULL);
+		if (reply == NULL) {
+			return false;
+		}
+
+		xcb_atom_t type = reply->type;
+		int len = xcb_get_property_value_length(reply);
+		free(reply);
+
+		if (type == client->incr && !incr) {
+			incr = true;
+		} else if (type != XCB_ATOM_NONE) {
+			report->bytes += len;
+			if (!incr || len == 0) {
+				break;
+			}
+		}
+		// Otherwise, this is a stale notification for a deleted property
+
+		xcb_property_notify_event_t *event;
+		do {
+			event = (xcb_property_notify_event_t *)
+				x11_wait_for_event(client, XCB_PROPERTY_NOTIFY);
+			if (event == NULL) {
+				return false;
+			}
+			bool new_value = event->window == client->window &&
+				event->atom == client->property &&
+				event->state == XCB_PROPERTY_NEW_VALUE;
+			free(event);
+			if (new_value) {
+				break;
+			}
+		} while (true);
+	}
+
+	report->duration_ns = get_current_time_nsec() - start;
+	return true;
+}
+
+/**
+ * X11 client side of the benchmark, running in a child process.
+ */
+static int run_client(const char *display_name, size_t size, int report_fd) {
+	struct x11_client client = { .size = size };
+
+	client.conn = xcb_connect(display_name, NULL);
+	if (xcb_connection_has_error(client.conn)) {
+		fprintf(stderr, "Failed to connect to Xwayland\n");
+		return EXIT_FAILURE;
+	}
+	xcb_screen_t *screen =
+		xcb_setup_roots_iterator(xcb_get_setup(client.conn)).data;
+
+	client.clipboard = intern_atom(client.conn, "CLIPBOARD");
+	client.targets = intern_atom(client.conn, "TARGETS");
+	client.incr = intern_atom(client.conn, "INCR");
+	client.mime_type = intern_atom(client.conn, MIME_TYPE);
+	client.property = intern_atom(client.conn, "_WLR_CLIPBOARD_BENCH");
+
+	client.window = xcb_generate_id(client.conn);
+	uint32_t mask = XCB_EVENT_MASK_PROPERTY_CHANGE;
+	xcb_create_window(client.conn, XCB_COPY_FROM_PARENT, client.window,
+		screen->root, 0, 0, 64, 64, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT,
+		screen->root_visual, XCB_CW_EVENT_MASK, &mask);
+	xcb_map_window(client.conn, client.window);
+
+	if (!x11_serve_selection(&client)) {
+		fprintf(stderr, "Lost the X11 connection while sending\n");
+		return EXIT_FAILURE;
+	}
+
+	struct transfer_report report = {0};
+	if (!x11_read_selection(&client, &report)) {
+		fprintf(stderr, "Failed to read the Wayland selection\n");
+		return EXIT_FAILURE;
+	}
+	if (write(report_fd, &report, sizeof(report)) != sizeof(report)) {
+		return EXIT_FAILURE;
+	}
+
+	xcb_disconnect(client.conn);
+	return report.bytes == size ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void finish_write(struct bench *bench) {
+	if (bench->write_source != NULL) {
+		wl_event_source_remove(bench->write_source);
+		bench->write_source = NULL;
+	}
+	if (bench->write_fd >= 0) {
+		close(bench->write_fd);
+		bench->write_fd = -1;
+	}
+}
+
+static int handle_selection_writable(int fd, uint32_t mask, void *data) {
+	struct bench *bench = data;
+
+	while (bench->written < bench->size) {
+		size_t len = bench->size - bench->written;
+		if (len > sizeof(payload)) {
+			len = sizeof(payload);
+		}
+		ssize_t n = write(fd, payload, len);
+		if (n < 0 && errno == EAGAIN) {
+			return 0;
+		} else if (n < 0) {
+			wlr_log_errno(WLR_ERROR, "Failed to write selection");
+			break;
+		}
+		bench->written += n;
+	}
+
+	finish_write(bench);
+	return 0;
+}
+
+static void data_source_send(struct wlr_data_source *wlr_source,
+		const char *mime_type, int32_t fd) {
+	struct bench_data_source *source =
+		wl_container_of(wlr_source, source, base);
+	struct bench *bench = source->bench;
+
+	finish_write(bench);
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+	bench->write_fd = fd;
+	bench->written = 0;
+	bench->write_source = wl_event_loop_add_fd(bench->event_loop, fd,
+		WL_EVENT_WRITABLE, handle_selection_writable, bench);
+}
+
+static void data_source_destroy(struct wlr_data_source *wlr_source) {
+	struct bench_data_source *source =
+		wl_container_of(wlr_source, source, base);
+	free(source);
+}
+
+static const struct wlr_data_source_impl data_source_impl = {
+	.send = data_source_send,
+	.destroy = data_source_destroy,
+};
+
+static void set_wayland_selection(struct bench *bench) {
+	struct bench_data_source *source = calloc(1, sizeof(*source));
+	if (source == NULL) {
+		wl_display_terminate(bench->display);
+		return;
+	}
+	wlr_data_source_init(&source->base, &data_source_impl);
+	source->bench = bench;
+
+	char **mime_type = wl_array_add(&source->base.mime_types,
+		sizeof(*mime_type));
+	if (mime_type == NULL || (*mime_type = strdup(MIME_TYPE)) == NULL) {
+		wlr_data_source_destroy(&source->base);
+		wl_display_terminate(bench->display);
+		return;
+	}
+
+	wlr_seat_set_selection(bench->seat, &source->base,
+		wl_display_next_serial(bench->display));
+}
+
+static int handle_selection_readable(int fd, uint32_t mask, void *data) {
+	struct bench *bench = data;
+
+	static char buf[PAYLOAD_CHUNK_SIZE];
+	while (true) {
+		ssize_t n = read(fd, buf, sizeof(buf));
+		if (n < 0 && errno == EAGAIN) {
+			return 0;
+		} else if (n < 0) {
+			wlr_log_errno(WLR_ERROR, "Failed to read selection");
+			break;
+		} else if (n == 0) {
+			break;
+		}
+		bench->x11_to_wl.bytes += n;
+	}
+
+	bench->x11_to_wl.duration_ns =
+		get_current_time_nsec() - bench->x11_to_wl_start;
+	wl_event_source_remove(bench->read_source);
+	bench->read_source = NULL;
+	close(bench->read_fd);
+	bench->read_fd = -1;
+
+	// Now send data the other way around
+	set_wayland_selection(bench);
+	return 0;
+}
+
+static void handle_request_set_selection(struct wl_listener *listener,
+		void *data) {
+	struct bench *bench =
+		wl_container_of(listener, bench, request_set_selection);
+	struct wlr_seat_request_set_selection_event *event = data;
+	wlr_seat_set_selection(bench->seat, event->source, event->serial);
+}
+
+static void handle_set_selection(struct wl_listener *listener, void *data) {
+	struct bench *bench = wl_container_of(listener, bench, set_selection);
+	struct wlr_data_source *source = bench->seat->selection_source;
+	if (source == NULL || source->impl == &data_source_impl ||
+			bench->x11_to_wl_start != 0) {
+		return;
+	}
+
+	int fds[2];
+	if (pipe(fds) != 0) {
+		wl_display_terminate(bench->display);
+		return;
+	}
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+	bench->x11_to_wl_start = get_current_time_nsec();
+	bench->read_fd = fds[0];
+	bench->read_source = wl_event_loop_add_fd(bench->event_loop, fds[0],
+		WL_EVENT_READABLE, handle_selection_readable, bench);
+	// The data source takes ownership of the write end
+	wlr_data_source_send(source, MIME_TYPE, fds[1]);
+}
+
+static int handle_sigchld(int signal_number, void *data) {
+	struct bench *bench = data;
+	if (bench->child <= 0 ||
+			waitpid(bench->child, &bench->child_status, WNOHANG) != bench->child) {
+		return 0;
+	}
+
+	if (read(bench->report_fd, &bench->wl_to_x11, sizeof(bench->wl_to_x11)) !=
+			sizeof(bench->wl_to_x11)) {
+		bench->wl_to_x11 = (struct transfer_report){0};
+	}
+
+	bench->end = get_current_time_nsec();
+	wl_display_terminate(bench->display);
+	return 0;
+}
+
+static void handle_xwayland_ready(struct wl_listener *listener, void *data) {
+	struct bench *bench = wl_container_of(listener, bench, xwayland_ready);
+
+	int fds[2];
+	if (pipe(fds) != 0) {
+		wl_display_terminate(bench->display);
+		return;
+	}
+
+	bench->child = fork();
+	if (bench->child < 0) {
+		wlr_log_errno(WLR_ERROR, "fork failed");
+		wl_display_terminate(bench->display);
+		return;
+	} else if (bench->child == 0) {
+		close(fds[0]);
+		_exit(run_client(bench->xwayland->display_name, bench->size, fds[1]));
+	}
+	close(fds[1]);
+	bench->report_fd = fds[0];
+
+	bench->start = get_current_time_nsec();
+	bench->tick_due = bench->start + TICK_MS * 1000000;
+	wl_event_source_timer_update(bench->tick, TICK_MS);
+}
+
+static void handle_new_surface(struct wl_listener *listener, void *data) {
+	struct bench *bench = wl_container_of(listener, bench, new_surface);
+	struct wlr_xwayland_surface *xsurface = data;
+
+	// The XWM only exchanges selections while an X11 window is focused
+	if (!bench->activated && !xsurface->override_redirect) {
+		wlr_xwayland_surface_activate(xsurface, true);
+		bench->activated = true;
+	}
+}
+
+static void handle_new_output(struct wl_listener *listener, void *data) {
+	struct bench *bench = wl_container_of(listener, bench, new_output);
+	struct wlr_output *output = data;
+
+	wlr_output_init_render(output, bench->allocator, bench->renderer);
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	wlr_output_state_set_enabled(&state, true);
+	wlr_output_commit_state(output, &state);
+	wlr_output_state_finish(&state);
+
+	wlr_output_create_global(output, bench->display);
+}
+
+static void print_transfer(const char *name, struct transfer_report *report,
+		bool last) {
+	double mib_per_sec = 0;
+	if (report->duration_ns > 0) {
+		mib_per_sec = (double)report->bytes / (1024 * 1024) *
+			1000000000.0 / report->duration_ns;
+	}
+
+	printf("\t\"%s\": {\n", name);
+	printf("\t\t\"bytes\": %" PRIu64 ",\n", report->bytes);
+	printf("\t\t\"duration_ms\": %" PRId64 ",\n", report->duration_ns / 1000000);
+	printf("\t\t\"mib_per_s\": %.1f\n", mib_per_sec);
+	printf("\t}%s\n", last ? "" : ",");
+}
+
+static void print_results(struct bench *bench) {
+	int exit_status = WIFEXITED(bench->child_status) ?
+		WEXITSTATUS(bench->child_status) : -1;
+
+	printf("{\n");
+	printf("\t\"size\": %zu,\n", bench->size);
+	printf("\t\"client_status\": %d,\n", exit_status);
+	printf("\t\"duration_ms\": %" PRId64 ",\n",
+		(bench->end - bench->start) / 1000000);
+	printf("\t\"max_lateness_us\": %" PRId64 ",\n", bench->max_lateness / 1000);
+	printf("\t\"stalls\": %" PRIu64 ",\n", bench->stalls);
+	print_transfer("x11_to_wayland", &bench->x11_to_wl, false);
+	print_transfer("wayland_to_x11", &bench->wl_to_x11, true);
+	printf("}\n");
+}
+
+static const char usage[] =
+	"usage: xwayland-clipboard-bench [options...]\n"
+	"  -s <MiB>     payload size (default: 100)\n"
+	"  -h           show this help\n";
+
+int main(int argc, char *argv[]) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	struct bench bench = {
+		.size = 100,
+		.report_fd = -1,
+		.read_fd = -1,
+		.write_fd = -1,
+	};
+
+	int c;
+	while ((c = getopt(argc, argv, "s:h")) != -1) {
+		switch (c) {
+		case 's':
+			bench.size = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "%s", usage);
+			return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (bench.size == 0 || bench.size > 4095) {
+		fprintf(stderr, "%s", usage);
+		return EXIT_FAILURE;
+	}
+	bench.size *= 1024 * 1024;
+
+	for (size_t i = 0; i < sizeof(payload); i++) {
+		payload[i] = i % 251;
+	}
+
+	bench.display = wl_display_create();
+	bench.event_loop = wl_display_get_event_loop(bench.display);
+	bench.backend = wlr_headless_backend_create(bench.display);
+	bench.renderer = wlr_pixman_renderer_create();
+	if (bench.backend == NULL || bench.renderer == NULL) {
+		return EXIT_FAILURE;
+	}
+	wlr_renderer_init_wl_display(bench.renderer, bench.display);
+	bench.allocator = wlr_allocator_autocreate(bench.backend, bench.renderer);
+	if (bench.allocator == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	struct wlr_compositor *compositor =
+		wlr_compositor_create(bench.display, 5, bench.renderer);
+	wlr_data_device_manager_create(bench.display);
+
+	bench.seat = wlr_seat_create(bench.display, "seat0");
+	bench.request_set_selection.notify = handle_request_set_selection;
+	wl_signal_add(&bench.seat->events.request_set_selection,
+		&bench.request_set_selection);
+	bench.set_selection.notify = handle_set_selection;
+	wl_signal_add(&bench.seat->events.set_selection, &bench.set_selection);
+
+	bench.new_output.notify = handle_new_output;
+	wl_signal_add(&bench.backend->events.new_output, &bench.new_output);
+
+	bench.tick = wl_event_loop_add_timer(bench.event_loop, handle_tick, &bench);
+	bench.sigchld = wl_event_loop_add_signal(bench.event_loop, SIGCHLD,
+		handle_sigchld, &bench);
+
+	bench.xwayland = wlr_xwayland_create(bench.display, compositor, false);
+	if (bench.xwayland == NULL) {
+		fprintf(stderr, "Failed to start Xwayland\n");
+		return EXIT_FAILURE;
+	}
+	wlr_xwayland_set_seat(bench.xwayland, bench.seat);
+	bench.xwayland_ready.notify = handle_xwayland_ready;
+	wl_signal_add(&bench.xwayland->events.ready, &bench.xwayland_ready);
+	bench.new_surface.notify = handle_new_surface;
+	wl_signal_add(&bench.xwayland->events.new_surface, &bench.new_surface);
+
+	if (!wlr_backend_start(bench.backend)) {
+		return EXIT_FAILURE;
+	}
+	wlr_headless_add_output(bench.backend, 1920, 1080);
+
+	wl_display_run(bench.display);
+
+	bool ok = bench.end != 0 && bench.x11_to_wl.bytes == bench.size &&
+		bench.wl_to_x11.bytes == bench.size;
+	if (bench.end != 0) {
+		print_results(&bench);
+	} else {
+		fprintf(stderr, "Benchmark didn't complete\n");
+	}
+
+	finish_write(&bench);
+	if (bench.read_source != NULL) {
+		wl_event_source_remove(bench.read_source);
+		close(bench.read_fd);
+	}
+	if (bench.report_fd >= 0) {
+		close(bench.report_fd);
+	}
+	wl_list_remove(&bench.xwayland_ready.link);
+	wl_list_remove(&bench.new_surface.link);
+	wlr_xwayland_destroy(bench.xwayland);
+	wl_list_remove(&bench.request_set_selection.link);
+	wl_list_remove(&bench.set_selection.link);
+	wl_event_source_remove(bench.tick);
+	wl_event_source_remove(bench.sigchld);
+	wl_display_destroy_clients(bench.display);
+	wlr_backend_destroy(bench.backend);
+	wlr_allocator_destroy(bench.allocator);
+	wlr_renderer_destroy(bench.renderer);
+	wl_display_destroy(bench.display);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,432 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/pixman.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+#include <wlr/xwayland.h>
+#include <xcb/xcb.h>
+
+/* Xwayland window manager stress benchmark.
+ *
+ * Starts a headless compositor with Xwayland, then forks an X11 client which
+ * repeatedly creates, maps, updates and destroys batches of windows carrying
+ * the usual ICCCM and EWMH properties. Meanwhile, a 1 ms timer measures how
+ * late the compositor's event loop dispatches it: any time spent blocked in
+ * the XWM shows up as timer lateness.
+ *
+ * With many windows (e.g. -n 5000), the run is dominated by window lookups
+ * and client list maintenance in the XWM.
+ *
+ * Results are printed as JSON on stdout. */
+
+#define TICK_MS 1
+// Lateness histogram: 100 µs buckets, up to one second
+#define BUCKET_NSEC (100 * 1000)
+#define BUCKET_COUNT 10000
+// Lateness above this threshold counts as a stall
+#define STALL_NSEC (4 * 1000 * 1000)
+
+struct bench {
+	int windows;
+	int rounds;
+	int updates;
+
+	struct wl_display *display;
+	struct wl_event_loop *event_loop;
+	struct wlr_backend *backend;
+	struct wlr_renderer *renderer;
+	struct wlr_allocator *allocator;
+	struct wlr_xwayland *xwayland;
+	struct wl_event_source *tick;
+	struct wl_event_source *sigchld;
+
+	pid_t child;
+	int child_status;
+
+	int64_t start, end;
+	int64_t tick_due;
+	uint64_t ticks;
+	uint64_t stalls;
+	int64_t stalled_ns;
+	int64_t max_lateness;
+	uint64_t histogram[BUCKET_COUNT];
+
+	uint64_t surfaces, associated;
+
+	struct wl_listener new_output;
+	struct wl_listener xwayland_ready;
+	struct wl_listener new_surface;
+};
+
+struct bench_surface {
+	struct bench *bench;
+	struct wl_listener associate;
+	struct wl_listener destroy;
+};
+
+static int64_t get_current_time_nsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static int64_t histogram_percentile(struct bench *bench, double p) {
+	uint64_t rank = bench->ticks * p;
+	uint64_t n = 0;
+	for (size_t i = 0; i < BUCKET_COUNT; i++) {
+		n += bench->histogram[i];
+		if (n > rank) {
+			return (int64_t)(i + 1) * BUCKET_NSEC;
+		}
+	}
+	return bench->max_lateness;
+}
+
+static int handle_tick(void *data) {
+	struct bench *bench = data;
+	int64_t now = get_current_time_nsec();
+
+	int64_t lateness = now - bench->tick_due;
+	if (lateness < 0) {
+		lateness = 0;
+	}
+	size_t bucket = lateness / BUCKET_NSEC;
+	if (bucket >= BUCKET_COUNT) {
+		bucket = BUCKET_COUNT - 1;
+	}
+	bench->histogram[bucket]++;
+	bench->ticks++;
+	if (lateness > bench->max_lateness) {
+		bench->max_lateness = lateness;
+	}
+	if (lateness > STALL_NSEC) {
+		bench->stalls++;
+		bench->stalled_ns += lateness;
+	}
+
+	bench->tick_due = now + TICK_MS * 1000000;
+	wl_event_source_timer_update(bench->tick, TICK_MS);
+	return 0;
+}
+
+static xcb_atom_t intern_atom(xcb_connection_t *conn, const char *name) {
+	xcb_intern_atom_cookie_t cookie =
+		xcb_intern_atom(conn, 0, strlen(name), name);
+	xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(conn, cookie, NULL);
+	if (reply == NULL) {
+		return XCB_ATOM_NONE;
+	}
+	xcb_atom_t atom = reply->atom;
+	free(reply);
+	return atom;
+}
+
+static void set_string_property(xcb_connection_t *conn, xcb_window_t window,
+		xcb_atom_t property, xcb_atom_t type, const char *value, size_t len) {
+	xcb_change_property(conn, XCB_PROP_MODE_REPLACE, window, property, type,
+		8, len, value);
+}
+
+static void sync_connection(xcb_connection_t *conn) {
+	free(xcb_get_input_focus_reply(conn, xcb_get_input_focus(conn), NULL));
+}
+
+/**
+ * X11 client side of the benchmark, running in a child process.
+ */
+static int run_client(const char *display_name, int windows, int rounds,
+		int updates) {
+	xcb_connection_t *conn = xcb_connect(display_name, NULL);
+	if (xcb_connection_has_error(conn)) {
+		fprintf(stderr, "Failed to connect to Xwayland\n");
+		return EXIT_FAILURE;
+	}
+	xcb_screen_t *screen = xcb_setup_roots_iterator(xcb_get_setup(conn)).data;
+
+	xcb_atom_t utf8_string = intern_atom(conn, "UTF8_STRING");
+	xcb_atom_t net_wm_name = intern_atom(conn, "_NET_WM_NAME");
+	xcb_atom_t net_wm_pid = intern_atom(conn, "_NET_WM_PID");
+	xcb_atom_t net_wm_window_type = intern_atom(conn, "_NET_WM_WINDOW_TYPE");
+	xcb_atom_t net_wm_window_type_normal =
+		intern_atom(conn, "_NET_WM_WINDOW_TYPE_NORMAL");
+	xcb_atom_t wm_protocols = intern_atom(conn, "WM_PROTOCOLS");
+	xcb_atom_t wm_delete_window = intern_atom(conn, "WM_DELETE_WINDOW");
+	xcb_atom_t wm_window_role = intern_atom(conn, "WM_WINDOW_ROLE");
+	xcb_atom_t bench_custom = intern_atom(conn, "_WLR_STALL_BENCH");
+
+	xcb_window_t *ids = calloc(windows, sizeof(*ids));
+	if (ids == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	static const char class[] = "stall-bench\0StallBench";
+	uint32_t pid = getpid();
+	char name[64];
+	for (int round = 0; round < rounds; round++) {
+		for (int i = 0; i < windows; i++) {
+			ids[i] = xcb_generate_id(conn);
+			xcb_create_window(conn, XCB_COPY_FROM_PARENT, ids[i], screen->root,
+				(i % 16) * 32, (i / 16) * 32, 64, 64, 0,
+				XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual, 0, NULL);
+
+			int len = snprintf(name, sizeof(name), "window %d.%d", round, i);
+			set_string_property(conn, ids[i], XCB_ATOM_WM_NAME,
+				XCB_ATOM_STRING, name, len);
+			set_string_property(conn, ids[i], net_wm_name, utf8_string,
+				name, len);
+			set_string_property(conn, ids[i], XCB_ATOM_WM_CLASS,
+				XCB_ATOM_STRING, class, sizeof(class));
+			set_string_property(conn, ids[i], wm_window_role,
+				XCB_ATOM_STRING, "bench", strlen("bench"));
+			xcb_change_property(conn, XCB_PROP_MODE_REPLACE, ids[i],
+				net_wm_pid, XCB_ATOM_CARDINAL, 32, 1, &pid);
+			xcb_change_property(conn, XCB_PROP_MODE_REPLACE, ids[i],
+				net_wm_window_type, XCB_ATOM_ATOM, 32, 1,
+				&net_wm_window_type_normal);
+			xcb_change_property(conn, XCB_PROP_MODE_REPLACE, ids[i],
+				wm_protocols, XCB_ATOM_ATOM, 32, 1, &wm_delete_window);
+			xcb_map_window(conn, ids[i]);
+		}
+		xcb_flush(conn);
+
+		// Property churn: titles, and a property the XWM doesn't know about
+		for (int update = 0; update < updates; update++) {
+			for (int i = 0; i < windows; i++) {
+				int len = snprintf(name, sizeof(name), "window %d.%d (%d)",
+					round, i, update);
+				set_string_property(conn, ids[i], net_wm_name, utf8_string,
+					name, len);
+				xcb_change_property(conn, XCB_PROP_MODE_REPLACE, ids[i],
+					bench_custom, XCB_ATOM_CARDINAL, 32, 1, &update);
+			}
+			xcb_flush(conn);
+		}
+		sync_connection(conn);
+
+		for (int i = 0; i < windows; i++) {
+			xcb_destroy_window(conn, ids[i]);
+		}
+		sync_connection(conn);
+	}
+
+	free(ids);
+	xcb_disconnect(conn);
+	return EXIT_SUCCESS;
+}
+
+static int handle_sigchld(int signal_number, void *data) {
+	struct bench *bench = data;
+	if (bench->child <= 0 ||
+			waitpid(bench->child, &bench->child_status, WNOHANG) != bench->child) {
+		return 0;
+	}
+
+	bench->end = get_current_time_nsec();
+	wl_display_terminate(bench->display);
+	return 0;
+}
+
+static void handle_xwayland_ready(struct wl_listener *listener, void *data) {
+	struct bench *bench = wl_container_of(listener, bench, xwayland_ready);
+
+	bench->child = fork();
+	if (bench->child < 0) {
+		wlr_log_errno(WLR_ERROR, "fork failed");
+		wl_display_terminate(bench->display);
+		return;
+	} else if (bench->child == 0) {
+		_exit(run_client(bench->xwayland->display_name, bench->windows,
+			bench->rounds, bench->updates));
+	}
+
+	bench->start = get_current_time_nsec();
+	bench->tick_due = bench->start + TICK_MS * 1000000;
+	wl_event_source_timer_update(bench->tick, TICK_MS);
+}
+
+static void surface_handle_associate(struct wl_listener *listener, void *data) {
+	struct bench_surface *surface =
+		wl_container_of(listener, surface, associate);
+	surface->bench->associated++;
+}
+
+static void surface_handle_destroy(struct wl_listener *listener, void *data) {
+	struct bench_surface *surface = wl_container_of(listener, surface, destroy);
+	wl_list_remove(&surface->associate.link);
+	wl_list_remove(&surface->destroy.link);
+	free(surface);
+}
+
+static void handle_new_surface(struct wl_listener *listener, void *data) {
+	struct bench *bench = wl_container_of(listener, bench, new_surface);
+	struct wlr_xwayland_surface *xsurface = data;
+
+	struct bench_surface *surface = calloc(1, sizeof(*surface));
+	if (surface == NULL) {
+		return;
+	}
+	surface->bench = bench;
+	surface->associate.notify = surface_handle_associate;
+	wl_signal_add(&xsurface->events.associate, &surface->associate);
+	surface->destroy.notify = surface_handle_destroy;
+	wl_signal_add(&xsurface->events.destroy, &surface->destroy);
+
+	bench->surfaces++;
+}
+
+static void handle_new_output(struct wl_listener *listener, void *data) {
+	struct bench *bench = wl_container_of(listener, bench, new_output);
+	struct wlr_output *output = data;
+
+	wlr_output_init_render(output, bench->allocator, bench->renderer);
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	wlr_output_state_set_enabled(&state, true);
+	wlr_output_commit_state(output, &state);
+	wlr_output_state_finish(&state);
+
+	wlr_output_create_global(output, bench->display);
+}
+
+static void print_results(struct bench *bench) {
+	int exit_status = WIFEXITED(bench->child_status) ?
+		WEXITSTATUS(bench->child_status) : -1;
+
+	printf("{\n");
+	printf("\t\"windows\": %d,\n", bench->windows);
+	printf("\t\"rounds\": %d,\n", bench->rounds);
+	printf("\t\"updates\": %d,\n", bench->updates);
+	printf("\t\"client_status\": %d,\n", exit_status);
+	printf("\t\"duration_ms\": %" PRId64 ",\n",
+		(bench->end - bench->start) / 1000000);
+	printf("\t\"surfaces\": %" PRIu64 ",\n", bench->surfaces);
+	printf("\t\"associated\": %" PRIu64 ",\n", bench->associated);
+	printf("\t\"lateness\": {\n");
+	printf("\t\t\"ticks\": %" PRIu64 ",\n", bench->ticks);
+	printf("\t\t\"p50_us\": %" PRId64 ",\n",
+		histogram_percentile(bench, 0.5) / 1000);
+	printf("\t\t\"p99_us\": %" PRId64 ",\n",
+		histogram_percentile(bench, 0.99) / 1000);
+	printf("\t\t\"p999_us\": %" PRId64 ",\n",
+		histogram_percentile(bench, 0.999) / 1000);
+	printf("\t\t\"max_us\": %" PRId64 ",\n", bench->max_lateness / 1000);
+	printf("\t\t\"stalls\": %" PRIu64 ",\n", bench->stalls);
+	printf("\t\t\"stalled_ms\": %" PRId64 "\n", bench->stalled_ns / 1000000);
+	printf("\t}\n");
+	printf("}\n");
+}
+
+static const char usage[] =
+	"usage: xwayland-stall-bench [options...]\n"
+	"  -n <count>   windows per round (default: 200)\n"
+	"  -r <count>   number of rounds (default: 10)\n"
+	"  -u <count>   property updates per window and round (default: 20)\n"
+	"  -h           show this help\n";
+
+int main(int argc, char *argv[]) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	struct bench bench = {
+		.windows = 200,
+		.rounds = 10,
+		.updates = 20,
+	};
+
+	int c;
+	while ((c = getopt(argc, argv, "n:r:u:h")) != -1) {
+		switch (c) {
+		case 'n':
+			bench.windows = atoi(optarg);
+			break;
+		case 'r':
+			bench.rounds = atoi(optarg);
+			break;
+		case 'u':
+			bench.updates = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "%s", usage);
+			return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (bench.windows <= 0 || bench.rounds <= 0 || bench.updates < 0) {
+		fprintf(stderr, "%s", usage);
+		return EXIT_FAILURE;
+	}
+
+	bench.display = wl_display_create();
+	bench.event_loop = wl_display_get_event_loop(bench.display);
+	bench.backend = wlr_headless_backend_create(bench.display);
+	bench.renderer = wlr_pixman_renderer_create();
+	if (bench.backend == NULL || bench.renderer == NULL) {
+		return EXIT_FAILURE;
+	}
+	wlr_renderer_init_wl_display(bench.renderer, bench.display);
+	bench.allocator = wlr_allocator_autocreate(bench.backend, bench.renderer);
+	if (bench.allocator == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	struct wlr_compositor *compositor =
+		wlr_compositor_create(bench.display, 5, bench.renderer);
+
+	bench.new_output.notify = handle_new_output;
+	wl_signal_add(&bench.backend->events.new_output, &bench.new_output);
+
+	bench.tick = wl_event_loop_add_timer(bench.event_loop, handle_tick, &bench);
+	bench.sigchld = wl_event_loop_add_signal(bench.event_loop, SIGCHLD,
+		handle_sigchld, &bench);
+
+	bench.xwayland = wlr_xwayland_create(bench.display, compositor, false);
+	if (bench.xwayland == NULL) {
+		fprintf(stderr, "Failed to start Xwayland\n");
+		return EXIT_FAILURE;
+	}
+	bench.xwayland_ready.notify = handle_xwayland_ready;
+	wl_signal_add(&bench.xwayland->events.ready, &bench.xwayland_ready);
+	bench.new_surface.notify = handle_new_surface;
+	wl_signal_add(&bench.xwayland->events.new_surface, &bench.new_surface);
+
+	if (!wlr_backend_start(bench.backend)) {
+		return EXIT_FAILURE;
+	}
+	wlr_headless_add_output(bench.backend, 1920, 1080);
+
+	wl_display_run(bench.display);
+
+	bool ok = bench.end != 0;
+	if (ok) {
+		print_results(&bench);
+	} else {
+		fprintf(stderr, "Benchmark didn't complete\n");
+	}
+
+	wl_list_remove(&bench.xwayland_ready.link);
+	wl_list_remove(&bench.new_surface.link);
+	wlr_xwayland_destroy(bench.xwayland);
+	wl_event_source_remove(bench.tick);
+	wl_event_source_remove(bench.sigchld);
+	wl_display_destroy_clients(bench.display);
+	wlr_backend_destroy(bench.backend);
+	wlr_allocator_destroy(bench.allocator);
+	wlr_renderer_destroy(bench.renderer);
+	wl_display_destroy(bench.display);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
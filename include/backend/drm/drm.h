@@ -21,6 +21,8 @@ struct wlr_drm_plane {
 
 	/* Only initialized on multi-GPU setups */
 	struct wlr_drm_surface mgpu_surf;
+	struct wlr_drm_format mgpu_format;
+	bool mgpu_format_linear;
 
 	/* Buffer submitted to the kernel, will be presented on next vblank */
 	struct wlr_drm_fb *queued_fb;
@@ -53,6 +55,25 @@ struct wlr_drm_layer {
 	bool *candidate_planes;
 };
 
+/**
+ * Compact description of the KMS state checked by a test-only commit for a
+ * connector. Buffers are only described by their format, modifier and size.
+ */
+struct wlr_drm_test_signature {
+	uint32_t conn_id, crtc_id;
+	bool active, modeset;
+	bool vrr_enabled, tearing_page_flip;
+	bool wait_timeline, signal_timeline;
+	bool gamma_lut;
+	size_t gamma_lut_size;
+	drmModeModeInfo mode;
+	struct {
+		uint32_t format;
+		uint64_t modifier;
+		int width, height;
+	} primary, cursor;
+};
+
 struct wlr_drm_crtc {
 	uint32_t id;
 	struct wlr_drm_lease *lease;
@@ -70,9 +91,19 @@ struct wlr_drm_crtc {
 	struct wlr_drm_plane *primary;
 	struct wlr_drm_plane *cursor;
 
+	// Last state committed to the kernel, zeroed if unknown
+	struct wlr_drm_test_signature committed_signature;
+
 	union wlr_drm_crtc_props props;
 };
 
+#define DRM_TEST_CACHE_SIZE 16
+
+struct wlr_drm_test_cache_entry {
+	struct wlr_drm_test_signature signature;
+	bool ok;
+};
+
 struct wlr_drm_backend {
 	struct wlr_backend backend;
 
@@ -102,6 +133,10 @@ struct wlr_drm_backend {
 	struct wl_listener dev_remove;
 
 	struct wl_list fbs; // wlr_drm_fb.link
+	size_t fbs_len;
+	struct {
+		uint64_t hits, misses, evictions, preimports;
+	} fb_cache_stats;
 	struct wl_list connectors; // wlr_drm_connector.link
 
 	struct wl_list page_flips; // wlr_drm_page_flip.link
@@ -116,6 +151,12 @@ struct wlr_drm_backend {
 	struct wlr_drm_format_set mgpu_formats;
 
 	bool supports_tearing_page_flips;
+	// Cursor updates may be committed on their own while the output is idle
+	bool cursor_commits;
+
+	// Results of recent test-only commits, see drm_connector_test()
+	struct wlr_drm_test_cache_entry test_cache[DRM_TEST_CACHE_SIZE];
+	size_t test_cache_len, test_cache_next;
 };
 
 struct wlr_drm_mode {
@@ -147,6 +188,8 @@ struct wlr_drm_connector_state {
 struct wlr_drm_page_flip {
 	struct wl_list link; // wlr_drm_connector.page_flips
 	struct wlr_drm_connector *conn;
+	// Only the cursor plane has been updated, see drm_connector_commit_cursor()
+	bool cursor_only;
 };
 
 struct wlr_drm_connector {
@@ -170,11 +213,19 @@ struct wlr_drm_connector {
 	int cursor_hotspot_x, cursor_hotspot_y;
 	/* Buffer to be submitted to the kernel on the next page-flip */
 	struct wlr_drm_fb *cursor_pending_fb;
+	// The cursor changed since the last commit
+	bool cursor_dirty;
 
 	struct wl_list link; // wlr_drm_backend.connectors
 
 	// Last committed page-flip
 	struct wlr_drm_page_flip *pending_page_flip;
+
+	struct {
+		uint64_t frames, partial_frames;
+		uint64_t updated_pixels, total_pixels;
+		uint64_t last_updated_pixels, last_total_pixels;
+	} damage_stats;
 };
 
 struct wlr_drm_backend *get_drm_backend_from_backend(
@@ -195,6 +246,12 @@ size_t drm_crtc_get_gamma_lut_size(struct wlr_drm_backend *drm,
 	struct wlr_drm_crtc *crtc);
 void drm_lease_destroy(struct wlr_drm_lease *lease);
 void drm_page_flip_destroy(struct wlr_drm_page_flip *page_flip);
+/**
+ * Forget cached test-only commit results. Must be called whenever the KMS
+ * state changes in a way which isn't captured by struct wlr_drm_test_signature,
+ * e.g. after a modeset, or when the planes of any CRTC change.
+ */
+void drm_test_cache_invalidate(struct wlr_drm_backend *drm);
 
 struct wlr_drm_fb *get_next_cursor_fb(struct wlr_drm_connector *conn);
 struct wlr_drm_layer *get_drm_layer(struct wlr_drm_backend *drm,
@@ -7,11 +7,15 @@ struct wlr_drm_fb {
 	struct wlr_buffer *wlr_buf;
 	struct wlr_addon addon;
 	struct wlr_drm_backend *backend;
-	struct wl_list link; // wlr_drm_backend.fbs
+	struct wl_list link; // wlr_drm_backend.fbs, most recently used first
 
 	uint32_t id;
+	size_t n_locks; // number of references held by the DRM backend
 };
 
+// Maximum number of unused FBs kept around for future imports
+#define DRM_FB_CACHE_CAP 64
+
 bool drm_fb_import(struct wlr_drm_fb **fb, struct wlr_drm_backend *drm,
 		struct wlr_buffer *buf, const struct wlr_drm_format_set *formats);
 void drm_fb_destroy(struct wlr_drm_fb *fb);
@@ -3,8 +3,10 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <pixman.h>
 #include <wlr/backend.h>
 #include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_damage_ring.h>
 #include <wlr/util/addon.h>
 
 struct wlr_drm_backend;
@@ -20,6 +22,8 @@ struct wlr_drm_renderer {
 struct wlr_drm_surface {
 	struct wlr_drm_renderer *renderer;
 	struct wlr_swapchain *swapchain;
+	// Damage accumulated since each swapchain buffer was last blitted to
+	struct wlr_damage_ring damage_ring;
 };
 
 bool init_drm_renderer(struct wlr_drm_backend *drm,
@@ -31,10 +35,30 @@ bool init_drm_surface(struct wlr_drm_surface *surf,
 	const struct wlr_drm_format *drm_format);
 void finish_drm_surface(struct wlr_drm_surface *surf);
 
+/**
+ * Copy a buffer into the next buffer of the surface's swapchain. Only the
+ * regions which changed since that buffer was last blitted to are copied.
+ * The damage is relative to the previously blitted buffer, NULL means that
+ * the whole buffer changed.
+ */
 struct wlr_buffer *drm_surface_blit(struct wlr_drm_surface *surf,
-	struct wlr_buffer *buffer);
+	struct wlr_buffer *buffer, const pixman_region32_t *damage);
+/**
+ * Drop the damage history of the surface, because the last blitted buffer
+ * won't be committed. The next blit copies the whole buffer.
+ */
+void drm_surface_discard_blit(struct wlr_drm_surface *surf);
 
 bool drm_plane_pick_render_format(struct wlr_drm_plane *plane,
 	struct wlr_drm_format *fmt, struct wlr_drm_renderer *renderer);
+/**
+ * Copy a buffer from the parent GPU into a buffer suitable for the plane.
+ *
+ * The format negotiated between the plane and the renderer is cached in the
+ * plane. Linear buffers are used if no other format can be allocated.
+ */
+struct wlr_buffer *drm_plane_blit(struct wlr_drm_plane *plane,
+	struct wlr_drm_renderer *renderer, struct wlr_buffer *buffer,
+	const pixman_region32_t *damage);
 
 #endif
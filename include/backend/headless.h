@@ -22,6 +22,9 @@ struct wlr_headless_output {
 
 	struct wl_event_source *frame_timer;
 	int frame_delay; // ms
+	int64_t last_frame_msec; // zero if no frame has been sent yet
+	// Virtual adaptive sync refresh rate range, zero if unsupported
+	int32_t vrr_min_refresh, vrr_max_refresh; // mHz
 };
 
 struct wlr_headless_backend *headless_backend_from_backend(
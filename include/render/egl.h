@@ -16,6 +16,9 @@ struct wlr_egl {
 		bool EXT_image_dma_buf_import_modifiers;
 		bool IMG_context_priority;
 		bool EXT_create_context_robustness;
+		bool KHR_fence_sync;
+		bool KHR_wait_sync;
+		bool ANDROID_native_fence_sync;
 
 		// Device extensions
 		bool EXT_device_drm;
@@ -38,6 +41,10 @@ struct wlr_egl {
 		PFNEGLQUERYDISPLAYATTRIBEXTPROC eglQueryDisplayAttribEXT;
 		PFNEGLQUERYDEVICESTRINGEXTPROC eglQueryDeviceStringEXT;
 		PFNEGLQUERYDEVICESEXTPROC eglQueryDevicesEXT;
+		PFNEGLCREATESYNCKHRPROC eglCreateSyncKHR;
+		PFNEGLDESTROYSYNCKHRPROC eglDestroySyncKHR;
+		PFNEGLDUPNATIVEFENCEFDANDROIDPROC eglDupNativeFenceFDANDROID;
+		PFNEGLWAITSYNCKHRPROC eglWaitSyncKHR;
 	} procs;
 
 	bool has_modifiers;
@@ -114,4 +121,26 @@ bool wlr_egl_unset_current(struct wlr_egl *egl);
 
 bool wlr_egl_is_current(struct wlr_egl *egl);
 
+/**
+ * Create a native fence sync object.
+ *
+ * If fence_fd is -1, a new fence is inserted in the command stream, and can
+ * be exported with wlr_egl_dup_fence_fd() after the commands are flushed.
+ * Otherwise, the sync object wraps the sync_file FD. The FD is duplicated,
+ * the caller keeps ownership of it.
+ */
+EGLSyncKHR wlr_egl_create_sync(struct wlr_egl *egl, int fence_fd);
+
+void wlr_egl_destroy_sync(struct wlr_egl *egl, EGLSyncKHR sync);
+
+/**
+ * Export the sync_file FD of a native fence sync object.
+ */
+int wlr_egl_dup_fence_fd(struct wlr_egl *egl, EGLSyncKHR sync);
+
+/**
+ * Make the GPU wait for a sync object before executing further commands.
+ */
+bool wlr_egl_wait_sync(struct wlr_egl *egl, EGLSyncKHR sync);
+
 #endif
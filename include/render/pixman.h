@@ -13,6 +13,9 @@ struct wlr_pixman_pixel_format {
 };
 
 struct wlr_pixman_buffer;
+struct wlr_pixman_tile_pool;
+
+#define WLR_PIXMAN_SOLID_FILLS_CAP 16
 
 struct wlr_pixman_renderer {
 	struct wlr_renderer wlr_renderer;
@@ -21,6 +24,15 @@ struct wlr_pixman_renderer {
 	struct wl_list textures; // wlr_pixman_texture.link
 
 	struct wlr_drm_format_set drm_formats;
+
+	struct wlr_pixman_tile_pool *tile_pool; // NULL if single-threaded
+
+	// Solid fill images reused across passes, replaced round-robin
+	struct {
+		struct pixman_color color;
+		pixman_image_t *image; // NULL if unused
+	} solid_fills[WLR_PIXMAN_SOLID_FILLS_CAP];
+	size_t solid_fills_next;
 };
 
 struct wlr_pixman_buffer {
@@ -49,6 +61,11 @@ struct wlr_pixman_texture {
 struct wlr_pixman_render_pass {
 	struct wlr_render_pass base;
 	struct wlr_pixman_buffer *buffer;
+
+	// Deferred passes record operations and composite them on submit
+	bool deferred;
+	struct wl_array ops; // struct pixman_pass_op
+	struct wl_array src_buffers; // struct wlr_buffer *, accessed until submit
 };
 
 pixman_format_code_t get_pixman_format_from_drm(uint32_t fmt);
@@ -61,4 +78,25 @@ bool begin_pixman_data_ptr_access(struct wlr_buffer *buffer, pixman_image_t **im
 struct wlr_pixman_render_pass *begin_pixman_render_pass(
 	struct wlr_pixman_buffer *buffer);
 
+/**
+ * Get a solid fill image for the color. The caller owns the returned
+ * reference. Must only be called from the thread recording render passes.
+ */
+pixman_image_t *pixman_renderer_get_solid_fill(
+	struct wlr_pixman_renderer *renderer, const struct pixman_color *color);
+
+typedef void (*pixman_tile_func_t)(void *data, int tile);
+
+/**
+ * A pool of worker threads used to composite the tiles of a render pass.
+ */
+struct wlr_pixman_tile_pool *pixman_tile_pool_create(int threads_len);
+void pixman_tile_pool_destroy(struct wlr_pixman_tile_pool *pool);
+/**
+ * Call func for each tile in [0, tiles_len) on the worker threads and the
+ * calling thread, and wait for all of them to complete.
+ */
+void pixman_tile_pool_run(struct wlr_pixman_tile_pool *pool,
+	pixman_tile_func_t func, void *data, int tiles_len);
+
 #endif
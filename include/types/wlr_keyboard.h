@@ -1,8 +1,31 @@
+#ifndef TYPES_WLR_KEYBOARD_H
+#define TYPES_WLR_KEYBOARD_H
+
+#include <wayland-util.h>
 #include <wlr/types/wlr_keyboard.h>
 
+/**
+ * A serialized keymap. Keyboards with identical keymaps share a single
+ * instance, and thus a single read-only file.
+ */
+struct wlr_shared_keymap {
+	char *string;
+	size_t size; // including the NUL terminator
+	int fd;
+	uint64_t hash;
+
+	size_t n_refs;
+	struct wl_list link; // keymap cache
+};
+
+struct wlr_shared_keymap *shared_keymap_ref(struct wlr_shared_keymap *keymap);
+void shared_keymap_unref(struct wlr_shared_keymap *keymap);
+
 void keyboard_key_update(struct wlr_keyboard *keyboard,
 		struct wlr_keyboard_key_event *event);
 
 bool keyboard_modifier_update(struct wlr_keyboard *keyboard);
 
 void keyboard_led_update(struct wlr_keyboard *keyboard);
+
+#endif
@@ -3,6 +3,8 @@
 
 #include <wlr/render/drm_format_set.h>
 #include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_frame_scheduler.h>
+#include <wlr/types/wlr_output_trace.h>
 
 void output_pending_resolution(struct wlr_output *output,
 	const struct wlr_output_state *state, int *width, int *height);
@@ -15,11 +17,79 @@ bool output_pick_format(struct wlr_output *output,
 bool output_ensure_buffer(struct wlr_output *output,
 	struct wlr_output_state *state, bool *new_back_buffer);
 
+/**
+ * Set the cursor image. If the texture was created from a buffer whose
+ * contents never change, the buffer can be passed to cache the cursor buffers
+ * rendered from it. Otherwise, buffer must be NULL.
+ */
 bool output_cursor_set_texture(struct wlr_output_cursor *cursor,
-	struct wlr_texture *texture, bool own_texture, const struct wlr_fbox *src_box,
-	int dst_width, int dst_height, enum wl_output_transform transform,
-	int32_t hotspot_x, int32_t hotspot_y);
+	struct wlr_buffer *buffer, struct wlr_texture *texture, bool own_texture,
+	const struct wlr_fbox *src_box, int dst_width, int dst_height,
+	enum wl_output_transform transform, int32_t hotspot_x, int32_t hotspot_y);
+
+/**
+ * Commit a state right away, ignoring the commit queue.
+ */
+bool output_commit_state(struct wlr_output *output,
+	const struct wlr_output_state *state);
+
+/**
+ * Apply all queued states followed by the provided one in a single commit.
+ */
+bool output_queue_commit_state(struct wlr_output *output,
+	const struct wlr_output_state *state);
+/**
+ * Submit the next queued state once the in-flight frame is done. Returns true
+ * if a new frame is in flight.
+ */
+bool output_queue_handle_frame(struct wlr_output *output);
+/**
+ * Resume the queue after the in-flight frame has been discarded.
+ */
+void output_queue_handle_discard(struct wlr_output *output);
+void output_queue_finish(struct wlr_output *output);
 
 void output_defer_present(struct wlr_output *output, struct wlr_output_event_present event);
 
+/**
+ * Mark the output as busy with an update committed by the backend on its own,
+ * e.g. a cursor-only update. Frame events and queued states are held back
+ * until output_finish_backend_update() is called.
+ */
+void output_begin_backend_update(struct wlr_output *output);
+void output_finish_backend_update(struct wlr_output *output);
+
+/**
+ * Send a frame event right away, bypassing the frame scheduler.
+ */
+void output_emit_frame(struct wlr_output *output);
+
+/**
+ * Delay the frame event sent by the backend after a vblank. Returns false if
+ * the frame event should be sent right away.
+ */
+bool output_frame_scheduler_delay_frame(
+	struct wlr_output_frame_scheduler *scheduler);
+void output_frame_scheduler_handle_frame(
+	struct wlr_output_frame_scheduler *scheduler);
+void output_frame_scheduler_handle_commit(
+	struct wlr_output_frame_scheduler *scheduler);
+void output_frame_scheduler_handle_present(
+	struct wlr_output_frame_scheduler *scheduler,
+	const struct wlr_output_event_present *event);
+
+void output_trace_record(struct wlr_output *output,
+	enum wlr_output_trace_stage stage, const struct timespec *when,
+	uint32_t commit_seq);
+
+/**
+ * Record a frame pipeline event, if the output is traced.
+ */
+static inline void output_trace(struct wlr_output *output,
+		enum wlr_output_trace_stage stage) {
+	if (output->trace != NULL) {
+		output_trace_record(output, stage, NULL, output->commit_seq + 1);
+	}
+}
+
 #endif
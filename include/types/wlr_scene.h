@@ -3,8 +3,93 @@
 
 #include <wlr/types/wlr_scene.h>
 
+typedef bool (*scene_node_box_iterator_func_t)(struct wlr_scene_node *node,
+	int sx, int sy, void *data);
+
+struct scene_index_cell;
+
+/**
+ * A spatial index over the enabled leaf nodes of a scene, used to speed up
+ * box queries on large scenes.
+ */
+struct scene_index {
+	struct scene_index_cell **buckets;
+	size_t buckets_len; // power of two
+	size_t cells_len;
+
+	struct wl_list large; // wlr_scene_node.index.large_link
+
+	struct wl_array candidates; // struct wlr_scene_node *
+	uint64_t query_seq;
+	bool querying;
+	bool order_dirty;
+};
+
+/**
+ * An output layer managed by a scene output.
+ */
+struct scene_output_layer {
+	struct wlr_scene_output *scene_output;
+	struct wlr_output_layer *layer;
+
+	// State of the layer in the last committed output state
+	struct wlr_scene_buffer *buffer; // may be NULL
+	struct wlr_box node_box; // layout-local
+	bool accepted;
+	bool sent_feedback; // the backend sent layer feedback for buffer
+
+	// Candidate for the output state being built
+	struct wlr_scene_buffer *pending_buffer;
+	struct wlr_box pending_node_box;
+	bool pending_feedback;
+
+	struct wl_listener buffer_destroy;
+	struct wl_listener pending_buffer_destroy;
+	struct wl_listener layer_feedback;
+};
+
 struct wlr_scene *scene_node_get_root(struct wlr_scene_node *node);
 
+void scene_output_pacing_init(struct wlr_scene_output *scene_output);
+void scene_output_pacing_finish(struct wlr_scene_output *scene_output);
+/**
+ * Track the update rate of this buffer, which covers the largest area of the
+ * output. May be NULL.
+ */
+void scene_output_pacing_set_content(struct wlr_scene_output *scene_output,
+	struct wlr_scene_buffer *scene_buffer);
+/**
+ * Record a new buffer attached to a scene buffer.
+ */
+void scene_buffer_pacing_handle_update(struct wlr_scene_buffer *scene_buffer);
+/**
+ * Check whether the next commit should be deferred to keep a stable cadence.
+ * If so, a frame is scheduled when the commit is due.
+ */
+bool scene_output_pacing_defer(struct wlr_scene_output *scene_output);
+
 void scene_surface_set_clip(struct wlr_scene_surface *surface, struct wlr_box *clip);
 
+struct scene_index *scene_index_create(void);
+void scene_index_destroy(struct scene_index *index);
+/**
+ * Insert or move a leaf node in the index. The box is in layout-local
+ * coordinates. An empty box removes the node from the index.
+ */
+void scene_index_update(struct scene_index *index, struct wlr_scene_node *node,
+	const struct wlr_box *box);
+void scene_index_remove(struct scene_index *index, struct wlr_scene_node *node);
+/**
+ * Mark the stacking order as stale. Must be called whenever nodes are added
+ * to the tree or moved within it.
+ */
+void scene_index_invalidate_order(struct scene_index *index);
+/**
+ * Call the iterator on each indexed node intersecting the box, from top to
+ * bottom, until it returns true.
+ */
+bool scene_index_nodes_in_box(struct scene_index *index,
+	struct wlr_scene_tree *root, const struct wlr_box *box,
+	scene_node_box_iterator_func_t iterator, void *user_data);
+
 #endif
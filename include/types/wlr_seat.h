@@ -30,4 +30,19 @@ void seat_client_create_inert_touch(struct wl_client *client,
 		uint32_t version, uint32_t id);
 void seat_client_destroy_touch(struct wl_resource *resource);
 
+/**
+ * Mark pointer motion as pending, when coalescing motion.
+ */
+void seat_pointer_defer_motion(struct wlr_seat *seat);
+/**
+ * Send the pending pointer motion, if any.
+ */
+void seat_pointer_flush_motion(struct wlr_seat *seat);
+
+/**
+ * Tag an input event sent to a surface, see wlr_input_latency_tracker.
+ */
+void input_latency_tracker_handle_input(struct wlr_input_latency_tracker *tracker,
+	struct wlr_surface *surface, uint32_t time_msec);
+
 #endif
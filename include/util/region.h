@@ -0,0 +1,25 @@
+#ifndef UTIL_REGION_H
+#define UTIL_REGION_H
+
+#include <pixman.h>
+#include <wayland-server-protocol.h>
+#include <wayland-util.h>
+
+/*
+ * Same as the wlr_region_* functions, but use the scratch array as storage for
+ * the intermediate rectangles instead of allocating it on each call. The
+ * destination region is rebuilt from these rectangles, so pixman still
+ * allocates its storage when it holds more than one rectangle.
+ */
+
+void region_scale_xy(pixman_region32_t *dst, const pixman_region32_t *src,
+	float scale_x, float scale_y, struct wl_array *scratch);
+
+void region_transform(pixman_region32_t *dst, const pixman_region32_t *src,
+	enum wl_output_transform transform, int width, int height,
+	struct wl_array *scratch);
+
+void region_expand(pixman_region32_t *dst, const pixman_region32_t *src,
+	int distance, struct wl_array *scratch);
+
+#endif
@@ -7,5 +7,11 @@
 int create_shm_file(void);
 int allocate_shm_file(size_t size);
 bool allocate_shm_file_pair(size_t size, int *rw_fd, int *ro_fd);
+/**
+ * Allocate a shared memory file holding a copy of data, which can't be
+ * modified through the returned FD. Where memfd sealing is available, the
+ * file is sealed against any modification.
+ */
+int allocate_sealed_shm_file(const void *data, size_t size);
 
 #endif
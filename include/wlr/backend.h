@@ -28,6 +28,15 @@ struct wlr_backend {
 		/** Raised when new outputs are added, passed the struct wlr_output */
 		struct wl_signal new_output;
 	} events;
+
+	struct {
+		/**
+		 * Whether wait/signal timelines are supported in output commits.
+		 *
+		 * See struct wlr_drm_syncobj_timeline.
+		 */
+		bool timeline;
+	} features;
 };
 
 /**
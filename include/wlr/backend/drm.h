@@ -53,6 +53,48 @@ struct wlr_backend *wlr_drm_backend_get_parent(struct wlr_backend *backend);
  */
 uint32_t wlr_drm_connector_get_id(struct wlr_output *output);
 
+struct wlr_drm_fb_cache_stats {
+	// Number of buffers currently imported as KMS framebuffers
+	size_t len;
+	// Maximum number of imported buffers kept when unused
+	size_t capacity;
+	// Imports which could reuse an existing framebuffer
+	uint64_t hits;
+	// Imports which had to create a framebuffer
+	uint64_t misses;
+	// Unused framebuffers destroyed to stay within capacity
+	uint64_t evictions;
+	// Framebuffers created via wlr_output_preimport_buffer()
+	uint64_t preimports;
+};
+
+/**
+ * Get statistics about the cache of buffers imported as KMS framebuffers.
+ */
+void wlr_drm_backend_get_fb_cache_stats(struct wlr_backend *backend,
+	struct wlr_drm_fb_cache_stats *stats);
+
+struct wlr_drm_connector_damage_stats {
+	// Number of page-flips with a new primary buffer
+	uint64_t frames;
+	// Number of these page-flips which only updated the damaged part of the
+	// primary plane, via FB_DAMAGE_CLIPS
+	uint64_t partial_frames;
+	// Fraction of the primary plane pixels updated by the last frame
+	double last_updated_fraction;
+	// Fraction of the primary plane pixels updated over all frames
+	double updated_fraction;
+};
+
+/**
+ * Get statistics about partial updates of the primary plane.
+ *
+ * Drivers for displays with a limited upload bandwidth (e.g. USB or SPI
+ * panels, virtual GPUs) only transfer the damaged regions of a buffer.
+ */
+void wlr_drm_connector_get_damage_stats(struct wlr_output *output,
+	struct wlr_drm_connector_damage_stats *stats);
+
 /**
  * Tries to open non-master DRM FD. The compositor must not call drmSetMaster()
  * on the returned FD.
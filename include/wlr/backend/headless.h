@@ -28,4 +28,14 @@ struct wlr_output *wlr_headless_add_output(struct wlr_backend *backend,
 bool wlr_backend_is_headless(struct wlr_backend *backend);
 bool wlr_output_is_headless(struct wlr_output *output);
 
+/**
+ * Allow adaptive sync to be enabled on a headless output, with a virtual
+ * refresh rate range in mHz. While adaptive sync is enabled, a refresh cycle
+ * starts on each commit, after the shortest refresh cycle allowed by the
+ * range has elapsed. Zero disables adaptive sync support, which is the
+ * default.
+ */
+void wlr_headless_output_set_vrr_range(struct wlr_output *output,
+	int32_t min_refresh, int32_t max_refresh);
+
 #endif
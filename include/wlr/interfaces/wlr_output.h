@@ -95,6 +95,12 @@ struct wlr_output_impl {
 	 */
 	const struct wlr_drm_format_set *(*get_primary_formats)(
 		struct wlr_output *output, uint32_t buffer_caps);
+	/**
+	 * Prepare a buffer for a later scan-out, e.g. by importing it.
+	 *
+	 * If unimplemented, buffers need no preparation.
+	 */
+	bool (*preimport_buffer)(struct wlr_output *output, struct wlr_buffer *buffer);
 };
 
 /**
@@ -0,0 +1,120 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_RENDER_DRM_SYNCOBJ_H
+#define WLR_RENDER_DRM_SYNCOBJ_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+/**
+ * A synchronization timeline.
+ *
+ * Timelines are used to synchronize accesses to buffers. Given a buffer,
+ * a timeline and a point on that timeline, the point tells when the buffer
+ * can be accessed, and a later point tells when the access is done.
+ *
+ * Timelines are backed by DRM timeline synchronization objects, and can be
+ * used without any GPU work: points can be signalled from the CPU, and
+ * converted from and to sync_files.
+ */
+struct wlr_drm_syncobj_timeline {
+	int drm_fd;
+	uint32_t handle;
+
+	// private state
+
+	size_t n_refs;
+};
+
+struct wlr_drm_syncobj_timeline_waiter {
+	struct {
+		struct wl_signal ready;
+	} events;
+
+	// private state
+
+	int ev_fd;
+	struct wl_event_source *event_source;
+};
+
+/**
+ * Create a new synchronization timeline.
+ */
+struct wlr_drm_syncobj_timeline *wlr_drm_syncobj_timeline_create(int drm_fd);
+/**
+ * Import a timeline from a drm_syncobj FD.
+ */
+struct wlr_drm_syncobj_timeline *wlr_drm_syncobj_timeline_import(int drm_fd,
+	int drm_syncobj_fd);
+/**
+ * Reference a synchronization timeline.
+ */
+struct wlr_drm_syncobj_timeline *wlr_drm_syncobj_timeline_ref(
+	struct wlr_drm_syncobj_timeline *timeline);
+/**
+ * Unreference a synchronization timeline.
+ */
+void wlr_drm_syncobj_timeline_unref(struct wlr_drm_syncobj_timeline *timeline);
+/**
+ * Export a drm_syncobj FD from a timeline.
+ */
+int wlr_drm_syncobj_timeline_export(struct wlr_drm_syncobj_timeline *timeline);
+/**
+ * Transfer a point from a timeline to another.
+ *
+ * The destination point will be signalled when the source point is signalled.
+ */
+bool wlr_drm_syncobj_timeline_transfer(struct wlr_drm_syncobj_timeline *dst,
+	uint64_t dst_point, struct wlr_drm_syncobj_timeline *src, uint64_t src_point);
+/**
+ * Check if a timeline point has been signalled or has materialized.
+ *
+ * Flags can be:
+ *
+ * - 0 to check if a point has been signalled
+ * - DRM_SYNCOBJ_WAIT_FLAGS_WAIT_AVAILABLE to only check if a point has
+ *   materialized
+ */
+bool wlr_drm_syncobj_timeline_check(struct wlr_drm_syncobj_timeline *timeline,
+	uint64_t point, uint32_t flags, bool *result);
+/**
+ * Signal a timeline point from the CPU.
+ */
+bool wlr_drm_syncobj_timeline_signal(struct wlr_drm_syncobj_timeline *timeline,
+	uint64_t point);
+/**
+ * Asynchronously wait for a timeline point.
+ *
+ * See wlr_drm_syncobj_timeline_check() for a definition of flags.
+ *
+ * A ready event will be emitted once the point has been signalled or has
+ * materialized, depending on the flags.
+ */
+bool wlr_drm_syncobj_timeline_waiter_init(struct wlr_drm_syncobj_timeline_waiter *waiter,
+	struct wlr_drm_syncobj_timeline *timeline, uint64_t point, uint32_t flags,
+	struct wl_event_loop *loop);
+/**
+ * Cancel a timeline waiter.
+ */
+void wlr_drm_syncobj_timeline_waiter_finish(struct wlr_drm_syncobj_timeline_waiter *waiter);
+/**
+ * Export a timeline point as a sync_file FD.
+ *
+ * The point must have materialized.
+ */
+int wlr_drm_syncobj_timeline_export_sync_file(struct wlr_drm_syncobj_timeline *timeline,
+	uint64_t src_point);
+/**
+ * Import a timeline point from a sync_file FD.
+ */
+bool wlr_drm_syncobj_timeline_import_sync_file(struct wlr_drm_syncobj_timeline *timeline,
+	uint64_t dst_point, int sync_file_fd);
+
+#endif
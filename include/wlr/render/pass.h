@@ -16,6 +16,7 @@
 
 struct wlr_renderer;
 struct wlr_buffer;
+struct wlr_drm_syncobj_timeline;
 
 /**
  * A render pass accumulates drawing operations until submitted to the GPU.
@@ -30,6 +31,14 @@ struct wlr_render_timer;
 struct wlr_buffer_pass_options {
 	/* Timer to measure the duration of the render pass */
 	struct wlr_render_timer *timer;
+
+	/* Signal a timeline synchronization point when the render pass completes.
+	 *
+	 * When a timeline is provided, the render pass submission is asynchronous:
+	 * the renderer may not have completed the work when wlr_render_pass_submit()
+	 * returns. Requires wlr_renderer.features.timeline. */
+	struct wlr_drm_syncobj_timeline *signal_timeline;
+	uint64_t signal_point;
 };
 
 /**
@@ -85,6 +94,11 @@ struct wlr_render_texture_options {
 	enum wlr_scale_filter_mode filter_mode;
 	/* Blend mode */
 	enum wlr_render_blend_mode blend_mode;
+
+	/* Wait for a timeline synchronization point before texturing. Requires
+	 * wlr_renderer.features.timeline. */
+	struct wlr_drm_syncobj_timeline *wait_timeline;
+	uint64_t wait_point;
 };
 
 /**
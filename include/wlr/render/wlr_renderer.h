@@ -36,6 +36,15 @@ struct wlr_renderer {
 		struct wl_signal lost;
 	} events;
 
+	struct {
+		/**
+		 * Whether wait/signal timelines are supported.
+		 *
+		 * See struct wlr_drm_syncobj_timeline.
+		 */
+		bool timeline;
+	} features;
+
 	// private state
 
 	const struct wlr_renderer_impl *impl;
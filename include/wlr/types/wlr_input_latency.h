@@ -0,0 +1,68 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_INPUT_LATENCY_H
+#define WLR_TYPES_WLR_INPUT_LATENCY_H
+
+#include <stdint.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_seat.h>
+
+/**
+ * An input-to-photon latency tracker.
+ *
+ * When a tracker is attached to a seat, input events sent through the seat
+ * are tagged with their timestamp and followed through the focused client's
+ * next surface commit, the output commit which includes it and finally its
+ * presentation. A latency histogram is kept for each output.
+ *
+ * Input timestamps come from the input device (for instance from libinput),
+ * and only have millisecond resolution.
+ *
+ * When no tracker is attached, tagging input events costs a single branch.
+ */
+struct wlr_input_latency_tracker;
+
+struct wlr_input_latency_stats {
+	// Number of presented frames which included a response to input
+	uint64_t samples;
+	// Input-to-presentation latency percentiles, rounded up to the histogram
+	// bucket size (500 µs)
+	int64_t p50_ns, p99_ns;
+	int64_t max_ns;
+	// Mean time between the input event and the seat dispatching it, plus the
+	// time between the client's commit and the output commit
+	int64_t compositor_mean_ns;
+	// Mean time between the seat dispatching the input event and the client
+	// committing a new surface state
+	int64_t client_mean_ns;
+	// Mean time between the output commit and presentation
+	int64_t display_mean_ns;
+};
+
+/**
+ * Start tracking input latency on a seat.
+ *
+ * At most one tracker can be attached to a seat. The tracker is destroyed
+ * along with the seat.
+ */
+struct wlr_input_latency_tracker *wlr_input_latency_tracker_create(
+	struct wlr_seat *seat);
+void wlr_input_latency_tracker_destroy(struct wlr_input_latency_tracker *tracker);
+/**
+ * Get the latency statistics for an output. Returns false if no sample has
+ * been recorded for this output.
+ */
+bool wlr_input_latency_tracker_get_stats(struct wlr_input_latency_tracker *tracker,
+	struct wlr_output *output, struct wlr_input_latency_stats *stats);
+/**
+ * Reset the latency statistics of all outputs.
+ */
+void wlr_input_latency_tracker_reset_stats(struct wlr_input_latency_tracker *tracker);
+
+#endif
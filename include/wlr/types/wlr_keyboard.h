@@ -40,6 +40,7 @@ enum wlr_keyboard_modifier {
 #define WLR_KEYBOARD_KEYS_CAP 32
 
 struct wlr_keyboard_impl;
+struct wlr_shared_keymap;
 
 struct wlr_keyboard_modifiers {
 	xkb_mod_mask_t depressed;
@@ -93,6 +94,11 @@ struct wlr_keyboard {
 	} events;
 
 	void *data;
+
+	// private state
+
+	// Owns keymap_string and keymap_fd
+	struct wlr_shared_keymap *shared_keymap;
 };
 
 struct wlr_keyboard_key_event {
@@ -65,6 +65,8 @@ enum wlr_output_state_field {
 	WLR_OUTPUT_STATE_RENDER_FORMAT = 1 << 8,
 	WLR_OUTPUT_STATE_SUBPIXEL = 1 << 9,
 	WLR_OUTPUT_STATE_LAYERS = 1 << 10,
+	WLR_OUTPUT_STATE_WAIT_TIMELINE = 1 << 11,
+	WLR_OUTPUT_STATE_SIGNAL_TIMELINE = 1 << 12,
 };
 
 enum wlr_output_state_mode_type {
@@ -108,9 +110,27 @@ struct wlr_output_state {
 
 	struct wlr_output_layer_state *layers;
 	size_t layers_len;
+
+	struct wlr_drm_syncobj_timeline *wait_timeline;
+	uint64_t wait_point;
+	struct wlr_drm_syncobj_timeline *signal_timeline;
+	uint64_t signal_point;
+};
+
+/**
+ * How states queued with wlr_output_queue_state() are submitted.
+ */
+enum wlr_output_commit_mode {
+	// Queued buffers are submitted in order, one per frame
+	WLR_OUTPUT_COMMIT_FIFO,
+	// Queued buffers replace each other, only the latest one is submitted
+	WLR_OUTPUT_COMMIT_MAILBOX,
 };
 
+struct wlr_drm_syncobj_timeline;
+struct wlr_output_frame_scheduler;
 struct wlr_output_impl;
+struct wlr_output_trace;
 struct wlr_render_pass;
 
 /**
@@ -197,6 +217,16 @@ struct wlr_output {
 
 	struct wl_list layers; // wlr_output_layer.link
 
+	struct wlr_output_trace *trace; // may be NULL
+	struct wlr_output_frame_scheduler *frame_scheduler; // may be NULL
+
+	enum wlr_output_commit_mode commit_mode;
+	// States waiting for the in-flight frame, see wlr_output_queue_state()
+	struct wl_list commit_queue;
+	size_t commit_queue_len;
+	bool commit_in_flight;
+	struct wl_event_source *commit_queue_idle;
+
 	struct wlr_allocator *allocator;
 	struct wlr_renderer *renderer;
 	struct wlr_swapchain *swapchain;
@@ -462,6 +492,34 @@ bool wlr_output_test_state(struct wlr_output *output,
  */
 bool wlr_output_commit_state(struct wlr_output *output,
 	const struct wlr_output_state *state);
+/**
+ * Submit a state without waiting for the in-flight frame.
+ *
+ * If no frame is in flight, the state is committed right away. Otherwise, the
+ * state is copied and submitted when the backend is ready for a new frame.
+ * States without a buffer are merged into the last queued state. How queued
+ * buffers are handled depends on the output's commit mode, see
+ * wlr_output_set_commit_mode(). Superseded buffers are never displayed, and
+ * their signal timeline point is signalled as soon as the buffer is ready.
+ *
+ * Returns false if the state couldn't be queued or, if it was committed right
+ * away, if the commit failed. Failures to commit a queued state are only
+ * logged. States with output layers can't be queued.
+ *
+ * Calling wlr_output_commit_state() applies queued states first.
+ */
+bool wlr_output_queue_state(struct wlr_output *output,
+	const struct wlr_output_state *state);
+/**
+ * Set how states queued with wlr_output_queue_state() are submitted.
+ *
+ * In FIFO mode, a small number of buffers are queued and displayed in order.
+ * When the queue is full, the last queued buffer is replaced. In mailbox mode,
+ * only the latest buffer is kept, which minimizes latency at the cost of
+ * dropping frames. The default is FIFO.
+ */
+void wlr_output_set_commit_mode(struct wlr_output *output,
+	enum wlr_output_commit_mode mode);
 /**
  * Manually schedules a `frame` event. If a `frame` event is already pending,
  * it is a no-op.
@@ -533,6 +591,19 @@ const struct wlr_drm_format_set *wlr_output_get_primary_formats(
  * during screen capture.
  */
 bool wlr_output_is_direct_scanout_allowed(struct wlr_output *output);
+/**
+ * Prepare a buffer which is likely to be scanned out on this output soon,
+ * e.g. a fullscreen client buffer.
+ *
+ * Backends may need to import buffers before scanning them out, which is
+ * expensive the first time a buffer is used. Calling this function outside of
+ * the frame path avoids a hitch when direct scan-out starts.
+ *
+ * This is only a hint. Returns false if the buffer can't be prepared or
+ * doesn't need preparation.
+ */
+bool wlr_output_preimport_buffer(struct wlr_output *output,
+	struct wlr_buffer *buffer);
 
 
 struct wlr_output_cursor *wlr_output_cursor_create(struct wlr_output *output);
@@ -675,6 +746,26 @@ void wlr_output_state_set_damage(struct wlr_output_state *state,
  */
 void wlr_output_state_set_layers(struct wlr_output_state *state,
 	struct wlr_output_layer_state *layers, size_t layers_len);
+/**
+ * Set a timeline point to wait for before displaying the buffer.
+ *
+ * The timeline must be kept valid by the caller until the commit completes.
+ * Requires wlr_backend.features.timeline.
+ * This state will be applied once wlr_output_commit_state() is called.
+ */
+void wlr_output_state_set_wait_timeline(struct wlr_output_state *state,
+	struct wlr_drm_syncobj_timeline *timeline, uint64_t point);
+/**
+ * Set a timeline point to be signalled when the buffer starts being
+ * displayed. At that point, the buffer of the previous commit is no longer
+ * being scanned out.
+ *
+ * The timeline must be kept valid by the caller until the commit completes.
+ * Requires wlr_backend.features.timeline.
+ * This state will be applied once wlr_output_commit_state() is called.
+ */
+void wlr_output_state_set_signal_timeline(struct wlr_output_state *state,
+	struct wlr_drm_syncobj_timeline *timeline, uint64_t point);
 
 /**
  * Copies the output state from src to dst. It is safe to then
@@ -0,0 +1,76 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_OUTPUT_FRAME_SCHEDULER_H
+#define WLR_TYPES_WLR_OUTPUT_FRAME_SCHEDULER_H
+
+#include <stdint.h>
+#include <wlr/types/wlr_output.h>
+
+/**
+ * A render-deadline frame scheduler.
+ *
+ * By default, backends emit the frame event right after a vblank, so the
+ * compositor renders early and the new frame waits for almost a full refresh
+ * cycle before being displayed.
+ *
+ * When a scheduler is attached to an output, the frame event following a
+ * vblank is delayed so that rendering completes shortly before the next
+ * vblank. The render duration is learned from the time between the frame
+ * event and the next buffer commit, and can be refined by the compositor with
+ * wlr_output_frame_scheduler_report_render_duration(), e.g. with the GPU
+ * duration measured by struct wlr_scene_timer. The next vblank is predicted
+ * from presentation feedback.
+ *
+ * If a delayed frame misses its deadline, frame events are sent right after
+ * vblank for the next few frames, and the slow frame is accounted for in
+ * later predictions.
+ */
+struct wlr_output_frame_scheduler;
+
+struct wlr_output_frame_scheduler_stats {
+	// Number of frame events sent
+	uint64_t frames;
+	// Number of frame events which have been delayed
+	uint64_t delayed_frames;
+	// Number of delayed frames committed after their target vblank
+	uint64_t missed_frames;
+	// Current render duration prediction, zero if unknown
+	int64_t predicted_render_ns;
+	// Delay applied to the last delayed frame event
+	int64_t last_delay_ns;
+};
+
+/**
+ * Attach a frame scheduler to an output.
+ *
+ * At most one scheduler can be attached to an output. The scheduler is
+ * destroyed along with the output.
+ */
+struct wlr_output_frame_scheduler *wlr_output_frame_scheduler_create(
+	struct wlr_output *output);
+void wlr_output_frame_scheduler_destroy(
+	struct wlr_output_frame_scheduler *scheduler);
+/**
+ * Set the safety margin left between the predicted end of rendering and the
+ * vblank. Defaults to 2 milliseconds.
+ */
+void wlr_output_frame_scheduler_set_margin(
+	struct wlr_output_frame_scheduler *scheduler, int64_t margin_ns);
+/**
+ * Report the render duration of the frame being committed next, if it
+ * exceeds the time between the frame event and the commit, e.g. because
+ * rendering continues on the GPU after the commit.
+ */
+void wlr_output_frame_scheduler_report_render_duration(
+	struct wlr_output_frame_scheduler *scheduler, int64_t duration_ns);
+void wlr_output_frame_scheduler_get_stats(
+	struct wlr_output_frame_scheduler *scheduler,
+	struct wlr_output_frame_scheduler_stats *stats);
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_OUTPUT_TRACE_H
+#define WLR_TYPES_WLR_OUTPUT_TRACE_H
+
+#include <stdint.h>
+#include <wlr/types/wlr_output.h>
+
+/**
+ * A frame pipeline trace.
+ *
+ * When a trace is attached to an output, timestamps are recorded into a ring
+ * buffer as frames go through the pipeline: frame scheduling, the frame event,
+ * scene rendering, the output commit, the backend commit and presentation.
+ * Compositors can periodically drain the ring buffer with
+ * wlr_output_trace_read() and export the events, e.g. as Chrome/Perfetto
+ * trace events.
+ *
+ * When no trace is attached, recording costs a single branch.
+ */
+struct wlr_output_trace;
+
+enum wlr_output_trace_stage {
+	// wlr_output_schedule_frame() was called
+	WLR_OUTPUT_TRACE_SCHEDULE_FRAME,
+	// The frame event is about to be emitted
+	WLR_OUTPUT_TRACE_FRAME,
+	// wlr_scene_output_build_state() started
+	WLR_OUTPUT_TRACE_BUILD_STATE_BEGIN,
+	// wlr_scene_output_build_state() started the render pass
+	WLR_OUTPUT_TRACE_RENDER_BEGIN,
+	// wlr_scene_output_build_state() successfully completed
+	WLR_OUTPUT_TRACE_BUILD_STATE_END,
+	// wlr_output_commit_state() started
+	WLR_OUTPUT_TRACE_COMMIT_BEGIN,
+	// The backend commit started
+	WLR_OUTPUT_TRACE_BACKEND_COMMIT_BEGIN,
+	// The backend commit successfully completed
+	WLR_OUTPUT_TRACE_BACKEND_COMMIT_END,
+	// wlr_output_commit_state() successfully completed
+	WLR_OUTPUT_TRACE_COMMIT_END,
+	// A commit has been presented, the timestamp is the presentation time
+	WLR_OUTPUT_TRACE_PRESENT,
+	// A commit has been discarded by the backend
+	WLR_OUTPUT_TRACE_DISCARD,
+};
+
+struct wlr_output_trace_event {
+	enum wlr_output_trace_stage stage;
+	int64_t time_ns; // CLOCK_MONOTONIC
+	// Commit sequence number the event relates to. For events preceding a
+	// commit, this is the sequence number the commit will be assigned.
+	uint32_t commit_seq;
+};
+
+/**
+ * Start tracing an output. The capacity is the maximum number of events kept
+ * in the ring buffer, older events are overwritten.
+ *
+ * At most one trace can be attached to an output. The trace is destroyed
+ * along with the output.
+ */
+struct wlr_output_trace *wlr_output_trace_create(struct wlr_output *output,
+	size_t capacity);
+void wlr_output_trace_destroy(struct wlr_output_trace *trace);
+/**
+ * Move up to len of the oldest recorded events into the events array. Returns
+ * the number of events read.
+ */
+size_t wlr_output_trace_read(struct wlr_output_trace *trace,
+	struct wlr_output_trace_event *events, size_t len);
+/**
+ * Get the number of events overwritten before they could be read.
+ */
+uint64_t wlr_output_trace_get_dropped(struct wlr_output_trace *trace);
+/**
+ * Get a human-readable name for a stage, e.g. for exporting events.
+ */
+const char *wlr_output_trace_stage_name(enum wlr_output_trace_stage stage);
+
+#endif
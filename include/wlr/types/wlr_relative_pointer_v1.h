@@ -55,6 +55,18 @@ struct wlr_relative_pointer_v1 {
 	struct wl_listener pointer_destroy;
 
 	void *data;
+
+	// private state
+
+	// Motion accumulated while the seat coalesces pointer motion
+	struct {
+		bool pending;
+		uint64_t time_usec;
+		double dx, dy;
+		double dx_unaccel, dy_unaccel;
+	} coalesced;
+
+	struct wl_listener seat_motion_flush;
 };
 
 struct wlr_relative_pointer_manager_v1 *wlr_relative_pointer_manager_v1_create(
@@ -35,6 +35,7 @@ struct wlr_xdg_surface;
 struct wlr_layer_surface_v1;
 struct wlr_drag_icon;
 struct wlr_surface;
+struct wlr_drm_syncobj_timeline;
 
 struct wlr_scene_node;
 struct wlr_scene_buffer;
@@ -44,6 +45,9 @@ struct wlr_presentation;
 struct wlr_linux_dmabuf_v1;
 struct wlr_output_state;
 
+struct scene_index;
+struct scene_output_layer;
+
 typedef bool (*wlr_scene_buffer_point_accepts_input_func_t)(
 	struct wlr_scene_buffer *buffer, double *sx, double *sy);
 
@@ -77,6 +81,14 @@ struct wlr_scene_node {
 	// private state
 
 	pixman_region32_t visible;
+
+	struct {
+		struct wlr_box box; // layout-local, valid if indexed
+		bool indexed, large;
+		struct wl_list large_link; // scene_index.large
+		uint64_t query_seq;
+		uint32_t order; // stacking order, higher is on top
+	} index;
 };
 
 enum wlr_scene_debug_damage_option {
@@ -110,6 +122,8 @@ struct wlr_scene {
 	enum wlr_scene_debug_damage_option debug_damage_option;
 	bool direct_scanout;
 	bool calculate_visibility;
+
+	struct scene_index *index; // may be NULL
 };
 
 /** A scene-graph node displaying a single surface. */
@@ -187,6 +201,9 @@ struct wlr_scene_buffer {
 	uint64_t active_outputs;
 	struct wlr_texture *texture;
 	struct wlr_linux_dmabuf_feedback_v1_init_options prev_feedback_options;
+
+	struct wlr_drm_syncobj_timeline *wait_timeline;
+	uint64_t wait_point;
 };
 
 /** A viewport for an output in the scene-graph */
@@ -218,11 +235,55 @@ struct wlr_scene_output {
 	struct wl_list damage_highlight_regions;
 
 	struct wl_array render_list;
+	// The render list is only rebuilt when a visibility update touches this box
+	struct wlr_box render_list_box;
+	bool render_list_dirty;
+
+	struct scene_output_layer *layers;
+	struct wlr_output_layer_state *layer_states;
+	size_t layers_len;
+
+	// Signalled by the renderer, waited on by the backend
+	struct wlr_drm_syncobj_timeline *in_timeline;
+	uint64_t in_point;
+
+	// Storage reused across frames by the region math of the render path.
+	// render_damage is held by the render pass, damage by short-lived helpers.
+	struct {
+		struct wl_array rects; // pixman_box32_t
+		pixman_region32_t damage, render_damage, render_region, opaque, background;
+		// Number of times the scene's own scratch storage (rects, render
+		// list, damage highlight regions) had to grow. Pixman may still
+		// allocate internally for multi-rectangle regions, that is not
+		// counted here.
+		size_t growths;
+	} scratch;
+
+	// Variable refresh rate frame pacing, see wlr_scene_output_set_vrr_range()
+	struct {
+		int64_t min_interval, max_interval; // nsec, zero if disabled
+		struct wl_event_source *timer;
+		struct wl_listener output_present;
+
+		// Buffer covering the largest area of the output, may be NULL
+		struct wlr_scene_buffer *content;
+		struct wl_listener content_destroy;
+		int64_t last_content; // nsec, zero if unknown
+		int64_t content_interval; // nsec, smoothed, zero if unknown
+		int content_samples;
+		int repeat; // number of refresh cycles per content frame
+
+		int64_t last_present; // nsec, zero if unknown
+	} pacing;
 };
 
 struct wlr_scene_timer {
 	int64_t pre_render_duration;
 	struct wlr_render_timer *render_timer;
+	// Scene scratch storage growths while building the state, see
+	// wlr_scene_output.scratch.growths. Does not include allocations made
+	// by pixman or the renderer.
+	size_t scratch_growths;
 };
 
 /** A layer shell scene helper */
@@ -404,6 +465,28 @@ void wlr_scene_buffer_set_buffer(struct wlr_scene_buffer *scene_buffer,
 void wlr_scene_buffer_set_buffer_with_damage(struct wlr_scene_buffer *scene_buffer,
 	struct wlr_buffer *buffer, const pixman_region32_t *region);
 
+/**
+ * Options for wlr_scene_buffer_set_buffer_with_options().
+ */
+struct wlr_scene_buffer_set_buffer_options {
+	// The damage region is in buffer-local coordinates. If the region is NULL,
+	// the whole buffer node will be damaged.
+	const pixman_region32_t *damage;
+
+	// Wait for a timeline synchronization point before reading from the buffer.
+	struct wlr_drm_syncobj_timeline *wait_timeline;
+	uint64_t wait_point;
+};
+
+/**
+ * Sets the buffer's backing buffer.
+ *
+ * If the buffer is NULL, the buffer node will not be displayed. If options is
+ * NULL, empty options are used.
+ */
+void wlr_scene_buffer_set_buffer_with_options(struct wlr_scene_buffer *scene_buffer,
+	struct wlr_buffer *buffer, const struct wlr_scene_buffer_set_buffer_options *options);
+
 /**
  * Sets the buffer's opaque region. This is an optimization hint used to
  * determine if buffers which reside under this one need to be rendered or not.
@@ -470,6 +553,31 @@ void wlr_scene_output_destroy(struct wlr_scene_output *scene_output);
  */
 void wlr_scene_output_set_position(struct wlr_scene_output *scene_output,
 	int lx, int ly);
+/**
+ * Allow up to max_layers of the top-most scene buffers to be offloaded to
+ * output layers (see struct wlr_output_layer) instead of being composited.
+ * Buffers rejected by the backend are composited as usual. Zero disables
+ * output layers, which is the default.
+ *
+ * The output layers are owned by the scene output: the compositor must not
+ * create other output layers on the same output. Output layers are disabled
+ * whenever direct scan-out isn't allowed, e.g. during screen capture.
+ */
+void wlr_scene_output_set_max_layers(struct wlr_scene_output *scene_output,
+	size_t max_layers);
+/**
+ * Pace frames for variable refresh rate. The range is the refresh rate range
+ * supported by the output while adaptive sync is enabled, in mHz. Zero
+ * disables frame pacing, which is the default.
+ *
+ * While adaptive sync is enabled and the buffer covering the largest area of
+ * the output updates at a steady rate below the maximum refresh rate,
+ * wlr_scene_output_commit() defers commits so that content frames are
+ * displayed at stable intervals. Content slower than the minimum refresh rate
+ * is displayed for several refresh cycles of equal length.
+ */
+void wlr_scene_output_set_vrr_range(struct wlr_scene_output *scene_output,
+	int32_t min_refresh, int32_t max_refresh);
 
 struct wlr_scene_output_state_options {
 	struct wlr_scene_timer *timer;
@@ -67,6 +67,11 @@ struct wlr_seat_client {
 		int32_t last_discrete[2];
 		double acc_axis[2];
 	} value120;
+
+	// private state
+
+	// Keymap last sent to all of the client's keyboards
+	struct wlr_shared_keymap *sent_keymap;
 };
 
 struct wlr_touch_point {
@@ -189,11 +194,33 @@ struct wlr_seat_pointer_state {
 	uint32_t grab_serial;
 	uint32_t grab_time;
 
+	// Number of motion events merged into another one, see
+	// wlr_seat_pointer_set_motion_coalescing()
+	uint64_t coalesced_motion_events;
+
 	struct wl_listener surface_destroy;
 
 	struct {
 		struct wl_signal focus_change; // struct wlr_seat_pointer_focus_change_event
+		// Emitted right before coalesced motion is sent to the focused client
+		struct wl_signal motion_flush;
 	} events;
+
+	// private state
+
+	struct {
+		bool enabled;
+		int64_t interval_ns; // zero if not rate-limited
+		int64_t last_flush_ns;
+		bool pending, pending_frame;
+
+		bool has_position;
+		uint32_t time_msec;
+		double sx, sy;
+		double sent_sx, sent_sy;
+
+		struct wl_event_source *timer;
+	} coalesce;
 };
 
 struct wlr_seat_keyboard_state {
@@ -229,6 +256,7 @@ struct wlr_seat_touch_state {
 };
 
 struct wlr_primary_selection_source;
+struct wlr_input_latency_tracker;
 
 struct wlr_seat {
 	struct wl_global *global;
@@ -257,6 +285,8 @@ struct wlr_seat {
 	struct wlr_seat_keyboard_state keyboard_state;
 	struct wlr_seat_touch_state touch_state;
 
+	struct wlr_input_latency_tracker *latency_tracker; // may be NULL
+
 	struct wl_listener display_destroy;
 	struct wl_listener selection_source_destroy;
 	struct wl_listener primary_selection_source_destroy;
@@ -416,6 +446,22 @@ void wlr_seat_pointer_send_axis(struct wlr_seat *wlr_seat, uint32_t time_msec,
  */
 void wlr_seat_pointer_send_frame(struct wlr_seat *wlr_seat);
 
+/**
+ * Enable or disable pointer motion coalescing.
+ *
+ * When enabled, motion events sent to the focused client are merged until
+ * the next pointer frame: only the last position is sent. Relative motion
+ * events sent through wlr_relative_pointer_v1 are summed, both accelerated
+ * and unaccelerated deltas.
+ *
+ * If max_rate (in mHz) is positive, frames which only contain motion are
+ * additionally limited to max_rate per second, for instance the refresh rate
+ * of the output the pointer is on. Other pointer events (buttons, axis, focus
+ * changes) send the pending motion right away.
+ */
+void wlr_seat_pointer_set_motion_coalescing(struct wlr_seat *wlr_seat,
+	bool enabled, int32_t max_rate);
+
 /**
  * Notify the seat of a pointer enter event to the given surface and request it
  * to be the focused surface for the pointer. Pass surface-local coordinates
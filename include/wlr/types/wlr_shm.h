@@ -21,6 +21,11 @@ struct wlr_renderer;
  *
  * Currently, accessing two buffers concurrently via
  * wlr_buffer_begin_data_ptr_access() will return an error.
+ *
+ * A SIGBUS handler is installed while a wl_shm global exists, to protect
+ * against clients shrinking the files backing their pools. A handler which was
+ * installed beforehand is called for faults outside of these pools. Pools
+ * sealed with F_SEAL_SHRINK can't trigger SIGBUS and bypass the handler.
  */
 struct wlr_shm;
 
@@ -81,6 +81,9 @@ enum wlr_xwayland_icccm_input_model {
  * The inner struct wlr_surface is valid once the associate event is emitted.
  * Compositors can set up e.g. map and unmap listeners at this point. The
  * struct wlr_surface becomes invalid when the dissociate event is emitted.
+ *
+ * X11 properties are read asynchronously: the associate event is only emitted
+ * once the initial window properties (and has_alpha) are known.
  */
 struct wlr_xwayland_surface {
 	xcb_window_t window_id;
@@ -173,6 +176,14 @@ struct wlr_xwayland_surface {
 	} events;
 
 	void *data;
+
+	// private state
+
+	struct wl_list hash_link; // wlr_xwm.surface_buckets
+	struct wl_list client_list_link; // wlr_xwm.client_list
+
+	// Number of property replies to wait for before emitting associate
+	size_t pending_associate_replies;
 };
 
 struct wlr_xwayland_surface_configure_event {
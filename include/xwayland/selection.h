@@ -2,9 +2,12 @@
 #define XWAYLAND_SELECTION_H
 
 #include <stdbool.h>
+#include <time.h>
 #include <xcb/xfixes.h>
 #include <wayland-util.h>
 
+// Selection data is sent to X11 clients in chunks of this size, and read from
+// them in windows of this size
 #define INCR_CHUNK_SIZE (64 * 1024)
 
 #define XDND_VERSION 5
@@ -12,6 +15,7 @@
 struct wlr_primary_selection_source;
 
 struct wlr_xwm_selection;
+struct xwm_selection_targets;
 
 struct wlr_drag;
 struct wlr_data_source;
@@ -27,12 +31,19 @@ struct wlr_xwm_selection_transfer {
 	struct wl_event_source *event_source;
 	struct wl_list link;
 
+	struct timespec start_time;
+	size_t bytes_transferred;
+
 	// when sending to x11
 	xcb_selection_request_event_t request;
 
 	// when receiving from x11
-	int property_start;
-	xcb_get_property_reply_t *property_reply;
+	int property_start; // bytes of property_reply already written
+	uint32_t property_offset; // next window to request, in 32-bit units
+	bool property_requested;
+	bool incr_chunk_pending; // a new INCR chunk is waiting to be read
+	xcb_get_property_reply_t *property_reply; // window being written
+	xcb_get_property_reply_t *next_property_reply; // window read ahead
 	xcb_window_t incoming_window;
 };
 
@@ -46,6 +57,9 @@ struct wlr_xwm_selection {
 
 	struct wl_list incoming;
 	struct wl_list outgoing;
+
+	// X11 selection targets being read, if any
+	struct xwm_selection_targets *pending_targets;
 };
 
 struct wlr_xwm_selection_transfer *
@@ -62,6 +76,8 @@ void xwm_selection_transfer_init(struct wlr_xwm_selection_transfer *transfer,
 	struct wlr_xwm_selection *selection);
 void xwm_selection_transfer_destroy(
 	struct wlr_xwm_selection_transfer *transfer);
+void xwm_selection_transfer_log_complete(
+	struct wlr_xwm_selection_transfer *transfer);
 
 void xwm_selection_transfer_destroy_outgoing(
 	struct wlr_xwm_selection_transfer *transfer);
@@ -78,6 +94,7 @@ void xwm_handle_selection_destroy_notify(struct wlr_xwm *xwm,
 		xcb_destroy_notify_event_t *event);
 
 void xwm_get_incr_chunk(struct wlr_xwm_selection_transfer *transfer);
+void xwm_selection_targets_destroy(struct xwm_selection_targets *targets);
 void xwm_handle_selection_notify(struct wlr_xwm *xwm,
 	xcb_selection_notify_event_t *event);
 int xwm_handle_xfixes_selection_notify(struct wlr_xwm *xwm,
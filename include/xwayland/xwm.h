@@ -3,6 +3,7 @@
 
 #include <wayland-server-core.h>
 #include <wlr/config.h>
+#include <wlr/util/log.h>
 #include <wlr/xwayland.h>
 #include <xcb/render.h>
 #include "config.h"
@@ -92,6 +93,14 @@ enum atom_name {
 	ATOM_LAST // keep last
 };
 
+/**
+ * Handles the reply to a request queued with xwm_queue_reply(). reply is NULL
+ * if the request failed, otherwise the handler takes ownership of it. arg is
+ * passed through from xwm_queue_reply().
+ */
+typedef void (*xwm_reply_handler_t)(struct wlr_xwm *xwm, void *reply,
+	void *data, uint32_t arg);
+
 struct wlr_xwm {
 	struct wlr_xwayland *xwayland;
 	struct wl_event_source *event_source;
@@ -117,8 +126,19 @@ struct wlr_xwm {
 	struct wl_list surfaces; // wlr_xwayland_surface.link
 	// Surfaces in bottom-to-top stacking order, for _NET_CLIENT_LIST_STACKING
 	struct wl_list surfaces_in_stack_order; // wlr_xwayland_surface.stack_link
+	// Mapped surfaces in map order, for _NET_CLIENT_LIST
+	struct wl_list client_list; // wlr_xwayland_surface.client_list_link
 	struct wl_list unpaired_surfaces; // wlr_xwayland_surface.unpaired_link
+	// Surfaces indexed by window ID
+	struct wl_list *surface_buckets; // wlr_xwayland_surface.hash_link
+	int surface_buckets_bits;
+	size_t surfaces_len;
+
+	// Pending _NET_CLIENT_LIST/_NET_CLIENT_LIST_STACKING upload
+	struct wl_event_source *client_lists_idle;
+	bool client_list_dirty, client_list_stacking_dirty;
 	struct wl_list pending_startup_ids; // pending_startup_id
+	struct wl_list pending_replies; // xwm_pending_reply.link
 
 	struct wlr_drag *drag;
 	struct wlr_xwayland_surface *drag_focus;
@@ -157,7 +177,27 @@ int xwm_handle_selection_client_message(struct wlr_xwm *xwm,
 
 void xwm_set_seat(struct wlr_xwm *xwm, struct wlr_seat *seat);
 
+/**
+ * Wait for the reply to a request without blocking: the handler is invoked
+ * from the XWM event source once the reply arrives. Replies are handled in
+ * request order. Requests still pending when the XWM is destroyed are
+ * completed with a NULL reply.
+ */
+void xwm_queue_reply(struct wlr_xwm *xwm, unsigned int sequence,
+	xwm_reply_handler_t handler, void *data, uint32_t arg);
+/**
+ * Drop the pending replies queued with the specified data, without invoking
+ * their handlers.
+ */
+void xwm_cancel_replies(struct wlr_xwm *xwm, void *data);
+
 char *xwm_get_atom_name(struct wlr_xwm *xwm, xcb_atom_t atom);
+/**
+ * Log a debug message followed by the name of an atom. The name is fetched
+ * asynchronously.
+ */
+void xwm_log_atom_name(struct wlr_xwm *xwm, xcb_atom_t atom,
+	const char *fmt, ...) _WLR_ATTRIB_PRINTF(3, 4);
 bool xwm_atoms_contains(struct wlr_xwm *xwm, xcb_atom_t *atoms,
 	size_t num_atoms, enum atom_name needle);
 
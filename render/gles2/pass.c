@@ -3,6 +3,8 @@
 #include <assert.h>
 #include <pixman.h>
 #include <time.h>
+#include <unistd.h>
+#include <wlr/render/drm_syncobj.h>
 #include <wlr/types/wlr_matrix.h>
 #include <wlr/util/transform.h>
 #include "render/gles2.h"
@@ -37,16 +39,35 @@ static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 		clock_gettime(CLOCK_MONOTONIC, &timer->cpu_end);
 	}
 
-	glFlush();
+	bool ok = true;
+	if (pass->signal_timeline != NULL) {
+		EGLSyncKHR sync = wlr_egl_create_sync(renderer->egl, -1);
+		glFlush();
+		int sync_file_fd = -1;
+		if (sync != EGL_NO_SYNC_KHR) {
+			sync_file_fd = wlr_egl_dup_fence_fd(renderer->egl, sync);
+			wlr_egl_destroy_sync(renderer->egl, sync);
+		}
+		if (sync_file_fd >= 0) {
+			ok = wlr_drm_syncobj_timeline_import_sync_file(pass->signal_timeline,
+				pass->signal_point, sync_file_fd);
+			close(sync_file_fd);
+		} else {
+			ok = false;
+		}
+	} else {
+		glFlush();
+	}
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
 	pop_gles2_debug(renderer);
 	wlr_egl_restore_context(&pass->prev_ctx);
 
+	wlr_drm_syncobj_timeline_unref(pass->signal_timeline);
 	wlr_buffer_unlock(pass->buffer->buffer);
 	free(pass);
 
-	return true;
+	return ok;
 }
 
 static void render(const struct wlr_box *box, const pixman_region32_t *clip, GLint attrib) {
@@ -138,12 +159,35 @@ static void setup_blending(enum wlr_render_blend_mode mode) {
 	}
 }
 
+static bool wait_timeline(struct wlr_gles2_renderer *renderer,
+		struct wlr_drm_syncobj_timeline *timeline, uint64_t point) {
+	int sync_file_fd = wlr_drm_syncobj_timeline_export_sync_file(timeline, point);
+	if (sync_file_fd < 0) {
+		return false;
+	}
+
+	EGLSyncKHR sync = wlr_egl_create_sync(renderer->egl, sync_file_fd);
+	close(sync_file_fd);
+	if (sync == EGL_NO_SYNC_KHR) {
+		return false;
+	}
+
+	bool ok = wlr_egl_wait_sync(renderer->egl, sync);
+	wlr_egl_destroy_sync(renderer->egl, sync);
+	return ok;
+}
+
 static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 		const struct wlr_render_texture_options *options) {
 	struct wlr_gles2_render_pass *pass = get_render_pass(wlr_pass);
 	struct wlr_gles2_renderer *renderer = pass->buffer->renderer;
 	struct wlr_gles2_texture *texture = gles2_get_texture(options->texture);
 
+	if (options->wait_timeline != NULL && !wait_timeline(renderer,
+			options->wait_timeline, options->wait_point)) {
+		return;
+	}
+
 	struct wlr_gles2_tex_shader *shader = NULL;
 
 	switch (texture->target) {
@@ -248,7 +292,8 @@ static const char *reset_status_str(GLenum status) {
 }
 
 struct wlr_gles2_render_pass *begin_gles2_buffer_pass(struct wlr_gles2_buffer *buffer,
-		struct wlr_egl_context *prev_ctx, struct wlr_gles2_render_timer *timer) {
+		struct wlr_egl_context *prev_ctx, struct wlr_gles2_render_timer *timer,
+		struct wlr_drm_syncobj_timeline *signal_timeline, uint64_t signal_point) {
 	struct wlr_gles2_renderer *renderer = buffer->renderer;
 	struct wlr_buffer *wlr_buffer = buffer->buffer;
 
@@ -276,6 +321,10 @@ struct wlr_gles2_render_pass *begin_gles2_buffer_pass(struct wlr_gles2_buffer *b
 	pass->buffer = buffer;
 	pass->timer = timer;
 	pass->prev_ctx = *prev_ctx;
+	if (signal_timeline != NULL) {
+		pass->signal_timeline = wlr_drm_syncobj_timeline_ref(signal_timeline);
+		pass->signal_point = signal_point;
+	}
 
 	matrix_projection(pass->projection_matrix, wlr_buffer->width, wlr_buffer->height,
 		WL_OUTPUT_TRANSFORM_FLIPPED_180);
@@ -16,6 +16,7 @@
 #include <wlr/types/wlr_matrix.h>
 #include <wlr/util/box.h>
 #include <wlr/util/log.h>
+#include <xf86drm.h>
 #include "render/egl.h"
 #include "render/gles2.h"
 #include "render/pixel_format.h"
@@ -264,7 +265,8 @@ static struct wlr_render_pass *gles2_begin_buffer_pass(struct wlr_renderer *wlr_
 		return NULL;
 	}
 
-	struct wlr_gles2_render_pass *pass = begin_gles2_buffer_pass(buffer, &prev_ctx, timer);
+	struct wlr_gles2_render_pass *pass = begin_gles2_buffer_pass(buffer,
+		&prev_ctx, timer, options->signal_timeline, options->signal_point);
 	if (!pass) {
 		return NULL;
 	}
@@ -624,6 +626,16 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl) {
 		load_gl_proc(&renderer->procs.glGetInteger64vEXT, "glGetInteger64vEXT");
 	}
 
+	if (egl->exts.KHR_fence_sync && egl->exts.KHR_wait_sync &&
+			egl->exts.ANDROID_native_fence_sync) {
+		int drm_fd = gles2_get_drm_fd(&renderer->wlr_renderer);
+		uint64_t cap_syncobj_timeline;
+		if (drm_fd >= 0 && drmGetCap(drm_fd, DRM_CAP_SYNCOBJ_TIMELINE,
+				&cap_syncobj_timeline) == 0) {
+			renderer->wlr_renderer.features.timeline = cap_syncobj_timeline != 0;
+		}
+	}
+
 	if (renderer->exts.KHR_debug) {
 		glEnable(GL_DEBUG_OUTPUT_KHR);
 		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_KHR);
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <stdlib.h>
+#include <wlr/util/log.h>
 #include "render/pixman.h"
 
 static const struct wlr_render_pass_impl render_pass_impl;
@@ -16,8 +17,182 @@ static struct wlr_pixman_texture *get_texture(struct wlr_texture *wlr_texture) {
 	return texture;
 }
 
+enum pixman_pass_op_type {
+	PIXMAN_PASS_OP_COMPOSITE,
+	// Plain copy of the source pixels, same format, no transform nor blending
+	PIXMAN_PASS_OP_BLT,
+	// Solid fill of the destination, no blending
+	PIXMAN_PASS_OP_FILL,
+};
+
+/**
+ * A composite operation recorded by a deferred render pass. Images are owned
+ * by the operation and never mutated once recorded, so that tiles can be
+ * composited concurrently.
+ *
+ * Blits and fills keep a source image around, so that they can fall back to
+ * a regular composite operation if pixman can't handle them.
+ */
+struct pixman_pass_op {
+	enum pixman_pass_op_type type;
+	pixman_op_t op;
+	pixman_image_t *src, *mask; // mask may be NULL
+	uint32_t fill_pixel; // PIXMAN_PASS_OP_FILL only
+	int32_t src_x, src_y, dest_x, dest_y, width, height;
+	pixman_region32_t clip;
+	bool has_clip;
+};
+
+// Tiles are bands of full rows, which keeps memory accesses sequential
+#define TILE_HEIGHT 64
+
+static void pass_op_finish(struct pixman_pass_op *op) {
+	pixman_image_unref(op->src);
+	if (op->mask != NULL) {
+		pixman_image_unref(op->mask);
+	}
+	pixman_region32_fini(&op->clip);
+}
+
+static bool pass_op_execute_fast(const struct pixman_pass_op *op,
+		pixman_image_t *dst, const pixman_region32_t *clip) {
+	// Unlike composite operations, fills and blits don't clip to the image
+	int dst_width = pixman_image_get_width(dst);
+	int dst_height = pixman_image_get_height(dst);
+	pixman_box32_t dest_box = {
+		.x1 = op->dest_x > 0 ? op->dest_x : 0,
+		.y1 = op->dest_y > 0 ? op->dest_y : 0,
+		.x2 = op->dest_x + op->width < dst_width ? op->dest_x + op->width : dst_width,
+		.y2 = op->dest_y + op->height < dst_height ? op->dest_y + op->height : dst_height,
+	};
+	const pixman_box32_t *rects = &dest_box;
+	int rects_len = 1;
+	if (clip != NULL) {
+		rects = pixman_region32_rectangles((pixman_region32_t *)clip, &rects_len);
+	}
+
+	uint32_t *dst_bits = pixman_image_get_data(dst);
+	int dst_stride = pixman_image_get_stride(dst) / sizeof(uint32_t);
+	for (int i = 0; i < rects_len; i++) {
+		int x1 = rects[i].x1 > dest_box.x1 ? rects[i].x1 : dest_box.x1;
+		int y1 = rects[i].y1 > dest_box.y1 ? rects[i].y1 : dest_box.y1;
+		int x2 = rects[i].x2 < dest_box.x2 ? rects[i].x2 : dest_box.x2;
+		int y2 = rects[i].y2 < dest_box.y2 ? rects[i].y2 : dest_box.y2;
+		if (x1 >= x2 || y1 >= y2) {
+			continue;
+		}
+
+		bool ok;
+		if (op->type == PIXMAN_PASS_OP_FILL) {
+			ok = pixman_fill(dst_bits, dst_stride, 32,
+				x1, y1, x2 - x1, y2 - y1, op->fill_pixel);
+		} else {
+			ok = pixman_blt(pixman_image_get_data(op->src), dst_bits,
+				pixman_image_get_stride(op->src) / sizeof(uint32_t), dst_stride,
+				32, 32, op->src_x + x1 - op->dest_x, op->src_y + y1 - op->dest_y,
+				x1, y1, x2 - x1, y2 - y1);
+		}
+		if (!ok) {
+			// Rectangles already written will just be written again
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void pass_op_execute(const struct pixman_pass_op *op,
+		pixman_image_t *dst, const pixman_region32_t *clip) {
+	if (op->type != PIXMAN_PASS_OP_COMPOSITE &&
+			pass_op_execute_fast(op, dst, clip)) {
+		return;
+	}
+
+	pixman_image_set_clip_region32(dst, (pixman_region32_t *)clip);
+	pixman_image_composite32(op->op, op->src, op->mask, dst,
+		op->src_x, op->src_y, 0, 0, op->dest_x, op->dest_y,
+		op->width, op->height);
+	pixman_image_set_clip_region32(dst, NULL);
+}
+
+static void render_tile(void *data, int tile) {
+	struct wlr_pixman_render_pass *pass = data;
+	pixman_image_t *image = pass->buffer->image;
+	int width = pixman_image_get_width(image);
+	int height = pixman_image_get_height(image);
+
+	int y = tile * TILE_HEIGHT;
+	int tile_height = height - y < TILE_HEIGHT ? height - y : TILE_HEIGHT;
+
+	// Each thread needs its own destination image to set a clip on
+	pixman_image_t *dst = pixman_image_create_bits_no_clear(
+		pixman_image_get_format(image), width, height,
+		pixman_image_get_data(image), pixman_image_get_stride(image));
+	if (dst == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create pixman image");
+		return;
+	}
+
+	pixman_region32_t clip;
+	pixman_region32_init(&clip);
+
+	struct pixman_pass_op *op;
+	wl_array_for_each(op, &pass->ops) {
+		if (op->has_clip) {
+			pixman_region32_intersect_rect(&clip, &op->clip,
+				0, y, width, tile_height);
+		} else {
+			pixman_region32_fini(&clip);
+			pixman_region32_init_rect(&clip, 0, y, width, tile_height);
+		}
+		if (!pixman_region32_not_empty(&clip)) {
+			continue;
+		}
+
+		pass_op_execute(op, dst, &clip);
+	}
+
+	pixman_region32_fini(&clip);
+	pixman_image_unref(dst);
+}
+
 static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 	struct wlr_pixman_render_pass *pass = get_render_pass(wlr_pass);
+	struct wlr_pixman_renderer *renderer = pass->buffer->renderer;
+
+	if (pass->ops.size > 0) {
+		int height = pixman_image_get_height(pass->buffer->image);
+		int tiles_len = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+		if (renderer->tile_pool != NULL && tiles_len > 1) {
+			// pixman validates images lazily, on their first use after a
+			// change: do it here, since images (e.g. solid fills) may be
+			// shared between operations and workers
+			struct pixman_pass_op *op;
+			wl_array_for_each(op, &pass->ops) {
+				pixman_image_composite32(op->op, op->src, op->mask,
+					pass->buffer->image, 0, 0, 0, 0, 0, 0, 0, 0);
+			}
+
+			pixman_tile_pool_run(renderer->tile_pool, render_tile, pass, tiles_len);
+		} else {
+			for (int i = 0; i < tiles_len; i++) {
+				render_tile(pass, i);
+			}
+		}
+	}
+
+	struct pixman_pass_op *op;
+	wl_array_for_each(op, &pass->ops) {
+		pass_op_finish(op);
+	}
+	wl_array_release(&pass->ops);
+
+	struct wlr_buffer **src_buffer_ptr;
+	wl_array_for_each(src_buffer_ptr, &pass->src_buffers) {
+		wlr_buffer_end_data_ptr_access(*src_buffer_ptr);
+		wlr_buffer_unlock(*src_buffer_ptr);
+	}
+	wl_array_release(&pass->src_buffers);
 
 	wlr_buffer_end_data_ptr_access(pass->buffer->buffer);
 	wlr_buffer_unlock(pass->buffer->buffer);
@@ -26,6 +201,64 @@ static bool render_pass_submit(struct wlr_render_pass *wlr_pass) {
 	return true;
 }
 
+static void pass_add_op(struct wlr_pixman_render_pass *pass,
+		const struct pixman_pass_op *op, const pixman_region32_t *clip) {
+	struct pixman_pass_op *recorded = wl_array_add(&pass->ops, sizeof(*recorded));
+	if (recorded == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return;
+	}
+
+	*recorded = *op;
+	pixman_image_ref(recorded->src);
+	if (recorded->mask != NULL) {
+		pixman_image_ref(recorded->mask);
+	}
+
+	pixman_region32_init(&recorded->clip);
+	recorded->has_clip = clip != NULL;
+	if (clip != NULL) {
+		pixman_region32_copy(&recorded->clip, clip);
+	}
+}
+
+/**
+ * Start reading from a texture. Deferred passes keep the source buffers
+ * accessed until the pass is submitted.
+ */
+static bool pass_begin_texture_access(struct wlr_pixman_render_pass *pass,
+		struct wlr_pixman_texture *texture) {
+	if (texture->buffer == NULL) {
+		return true;
+	}
+
+	if (pass->deferred) {
+		struct wlr_buffer **src_buffer_ptr;
+		wl_array_for_each(src_buffer_ptr, &pass->src_buffers) {
+			if (*src_buffer_ptr == texture->buffer) {
+				return true;
+			}
+		}
+	}
+
+	if (!begin_pixman_data_ptr_access(texture->buffer, &texture->image,
+			WLR_BUFFER_DATA_PTR_ACCESS_READ)) {
+		return false;
+	}
+
+	if (pass->deferred) {
+		struct wlr_buffer **src_buffer_ptr =
+			wl_array_add(&pass->src_buffers, sizeof(*src_buffer_ptr));
+		if (src_buffer_ptr == NULL) {
+			wlr_buffer_end_data_ptr_access(texture->buffer);
+			return false;
+		}
+		*src_buffer_ptr = wlr_buffer_lock(texture->buffer);
+	}
+
+	return true;
+}
+
 static pixman_op_t get_pixman_blending(enum wlr_render_blend_mode mode) {
 	switch (mode) {
 	case WLR_RENDER_BLEND_MODE_PREMULTIPLIED:
@@ -36,17 +269,59 @@ static pixman_op_t get_pixman_blending(enum wlr_render_blend_mode mode) {
 	abort();
 }
 
+/**
+ * Get the raw pixel for a premultiplied color in a 32bpp format with 8-bit
+ * channels, rounded the same way pixman does for solid fills.
+ */
+static bool get_fill_pixel(pixman_format_code_t format,
+		const struct pixman_color *color, uint32_t *pixel) {
+	// Other formats (e.g. 2101010) are left to pixman
+	if (PIXMAN_FORMAT_BPP(format) != 32 || PIXMAN_FORMAT_R(format) != 8 ||
+			PIXMAN_FORMAT_G(format) != 8 || PIXMAN_FORMAT_B(format) != 8 ||
+			(PIXMAN_FORMAT_A(format) != 0 && PIXMAN_FORMAT_A(format) != 8)) {
+		return false;
+	}
+
+	uint32_t a = color->alpha >> 8, r = color->red >> 8,
+		g = color->green >> 8, b = color->blue >> 8;
+	switch (PIXMAN_FORMAT_TYPE(format)) {
+	case PIXMAN_TYPE_ARGB:
+		*pixel = a << 24 | r << 16 | g << 8 | b;
+		return true;
+	case PIXMAN_TYPE_ABGR:
+		*pixel = a << 24 | b << 16 | g << 8 | r;
+		return true;
+	default:
+		return false;
+	}
+}
+
 static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 		const struct wlr_render_texture_options *options) {
 	struct wlr_pixman_render_pass *pass = get_render_pass(wlr_pass);
 	struct wlr_pixman_texture *texture = get_texture(options->texture);
 	struct wlr_pixman_buffer *buffer = pass->buffer;
 
-	if (texture->buffer != NULL && !begin_pixman_data_ptr_access(texture->buffer,
-			&texture->image, WLR_BUFFER_DATA_PTR_ACCESS_READ)) {
+	if (!pass_begin_texture_access(pass, texture)) {
 		return;
 	}
 
+	// Deferred passes composite from a separate image sharing the texture
+	// data, so that each operation gets its own transform and filter
+	pixman_image_t *src_image = texture->image;
+	if (pass->deferred) {
+		src_image = pixman_image_create_bits_no_clear(
+			pixman_image_get_format(texture->image),
+			pixman_image_get_width(texture->image),
+			pixman_image_get_height(texture->image),
+			pixman_image_get_data(texture->image),
+			pixman_image_get_stride(texture->image));
+		if (src_image == NULL) {
+			wlr_log(WLR_ERROR, "Failed to create pixman image");
+			return;
+		}
+	}
+
 	struct wlr_fbox src_fbox;
 	wlr_render_texture_options_get_src_box(options, &src_fbox);
 	struct wlr_box src_box = {
@@ -62,11 +337,15 @@ static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 	pixman_image_t *mask = NULL;
 	float alpha = wlr_render_texture_options_get_alpha(options);
 	if (alpha != 1) {
-		mask = pixman_image_create_solid_fill(&(struct pixman_color){
+		mask = pixman_renderer_get_solid_fill(buffer->renderer, &(struct pixman_color){
 			.alpha = 0xFFFF * alpha,
 		});
 	}
 
+	pixman_op_t op = get_pixman_blending(options->blend_mode);
+	enum pixman_pass_op_type op_type = PIXMAN_PASS_OP_COMPOSITE;
+	enum wlr_scale_filter_mode filter_mode = options->filter_mode;
+
 	struct wlr_box orig_box;
 	wlr_box_transform(&orig_box, &dst_box, options->transform,
 		buffer->buffer->width, buffer->buffer->height);
@@ -117,40 +396,70 @@ static void render_pass_add_texture(struct wlr_render_pass *wlr_pass,
 		pixman_transform_scale(&transform, NULL,
 			pixman_double_to_fixed(src_box.width / (double)orig_box.width),
 			pixman_double_to_fixed(src_box.height / (double)orig_box.height));
-		pixman_image_set_transform(texture->image, &transform);
+		pixman_image_set_transform(src_image, &transform);
+
+		// Without scaling, pixel centers map to pixel centers: nearest
+		// filtering gives the same result and hits pixman's rotation fast
+		// paths instead of the generic bilinear fetcher
+		if (orig_box.width == src_box.width && orig_box.height == src_box.height) {
+			filter_mode = WLR_SCALE_FILTER_NEAREST;
+		}
 
 		dest_x = dest_y = 0;
 		width = buffer->buffer->width;
 		height = buffer->buffer->height;
 	} else {
-		pixman_image_set_transform(texture->image, NULL);
+		pixman_image_set_transform(src_image, NULL);
 		dest_x = dst_box.x;
 		dest_y = dst_box.y;
 		width = src_box.width;
 		height = src_box.height;
+
+		// Opaque copies between identical formats boil down to a memcpy
+		pixman_format_code_t src_format = pixman_image_get_format(src_image);
+		if (mask == NULL && PIXMAN_FORMAT_BPP(src_format) == 32 &&
+				src_format == pixman_image_get_format(buffer->image) &&
+				(op == PIXMAN_OP_SRC || PIXMAN_FORMAT_A(src_format) == 0) &&
+				src_box.x >= 0 && src_box.y >= 0 &&
+				src_box.x + src_box.width <= pixman_image_get_width(src_image) &&
+				src_box.y + src_box.height <= pixman_image_get_height(src_image)) {
+			op_type = PIXMAN_PASS_OP_BLT;
+		}
 	}
 
-	switch (options->filter_mode) {
+	switch (filter_mode) {
 	case WLR_SCALE_FILTER_BILINEAR:
-		pixman_image_set_filter(texture->image, PIXMAN_FILTER_BILINEAR, NULL, 0);
+		pixman_image_set_filter(src_image, PIXMAN_FILTER_BILINEAR, NULL, 0);
 		break;
 	case WLR_SCALE_FILTER_NEAREST:
-		pixman_image_set_filter(texture->image, PIXMAN_FILTER_NEAREST, NULL, 0);
+		pixman_image_set_filter(src_image, PIXMAN_FILTER_NEAREST, NULL, 0);
 		break;
 	}
 
-	pixman_op_t op = get_pixman_blending(options->blend_mode);
+	struct pixman_pass_op pass_op = {
+		.type = op_type,
+		.op = op,
+		.src = src_image,
+		.mask = mask,
+		.src_x = src_box.x,
+		.src_y = src_box.y,
+		.dest_x = dest_x,
+		.dest_y = dest_y,
+		.width = width,
+		.height = height,
+	};
 
-	pixman_image_set_clip_region32(buffer->image, (pixman_region32_t *)options->clip);
-	pixman_image_composite32(op, texture->image, mask,
-		buffer->image, src_box.x, src_box.y, 0, 0, dest_x, dest_y,
-		width, height);
-	pixman_image_set_clip_region32(buffer->image, NULL);
+	if (pass->deferred) {
+		pass_add_op(pass, &pass_op, options->clip);
+		pixman_image_unref(src_image);
+	} else {
+		pass_op_execute(&pass_op, buffer->image, options->clip);
 
-	pixman_image_set_transform(texture->image, NULL);
+		pixman_image_set_transform(texture->image, NULL);
 
-	if (texture->buffer != NULL) {
-		wlr_buffer_end_data_ptr_access(texture->buffer);
+		if (texture->buffer != NULL) {
+			wlr_buffer_end_data_ptr_access(texture->buffer);
+		}
 	}
 
 	if (mask != NULL) {
@@ -175,12 +484,31 @@ static void render_pass_add_rect(struct wlr_render_pass *wlr_pass,
 		.alpha = options->color.a * 0xFFFF,
 	};
 
-	pixman_image_t *fill = pixman_image_create_solid_fill(&color);
+	pixman_image_t *fill = pixman_renderer_get_solid_fill(buffer->renderer, &color);
+	if (fill == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create pixman image");
+		return;
+	}
 
-	pixman_image_set_clip_region32(buffer->image, (pixman_region32_t *)options->clip);
-	pixman_image_composite32(op, fill, NULL, buffer->image,
-		0, 0, 0, 0, box.x, box.y, box.width, box.height);
-	pixman_image_set_clip_region32(buffer->image, NULL);
+	struct pixman_pass_op pass_op = {
+		.type = PIXMAN_PASS_OP_COMPOSITE,
+		.op = op,
+		.src = fill,
+		.dest_x = box.x,
+		.dest_y = box.y,
+		.width = box.width,
+		.height = box.height,
+	};
+	if (op == PIXMAN_OP_SRC && get_fill_pixel(pixman_image_get_format(buffer->image),
+			&color, &pass_op.fill_pixel)) {
+		pass_op.type = PIXMAN_PASS_OP_FILL;
+	}
+
+	if (pass->deferred) {
+		pass_add_op(pass, &pass_op, options->clip);
+	} else {
+		pass_op_execute(&pass_op, buffer->image, options->clip);
+	}
 
 	pixman_image_unref(fill);
 }
@@ -209,5 +537,10 @@ struct wlr_pixman_render_pass *begin_pixman_render_pass(
 	wlr_buffer_lock(buffer->buffer);
 	pass->buffer = buffer;
 
+	// Record operations and composite them in parallel on submit
+	pass->deferred = buffer->renderer->tile_pool != NULL;
+	wl_array_init(&pass->ops);
+	wl_array_init(&pass->src_buffers);
+
 	return pass;
 }
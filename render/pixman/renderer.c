@@ -1,7 +1,10 @@
+#define _POSIX_C_SOURCE 200809L
 #include <assert.h>
 #include <drm_fourcc.h>
 #include <pixman.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <wayland-server.h>
 #include <wlr/render/interface.h>
 #include <wlr/util/box.h>
@@ -269,6 +272,31 @@ static struct wlr_texture *pixman_texture_from_buffer(
 	return &texture->wlr_texture;
 }
 
+pixman_image_t *pixman_renderer_get_solid_fill(
+		struct wlr_pixman_renderer *renderer, const struct pixman_color *color) {
+	for (size_t i = 0; i < WLR_PIXMAN_SOLID_FILLS_CAP; i++) {
+		if (renderer->solid_fills[i].image != NULL &&
+				memcmp(&renderer->solid_fills[i].color, color, sizeof(*color)) == 0) {
+			return pixman_image_ref(renderer->solid_fills[i].image);
+		}
+	}
+
+	pixman_image_t *image = pixman_image_create_solid_fill(color);
+	if (image == NULL) {
+		return NULL;
+	}
+
+	size_t i = renderer->solid_fills_next;
+	renderer->solid_fills_next = (i + 1) % WLR_PIXMAN_SOLID_FILLS_CAP;
+	if (renderer->solid_fills[i].image != NULL) {
+		pixman_image_unref(renderer->solid_fills[i].image);
+	}
+	renderer->solid_fills[i].color = *color;
+	renderer->solid_fills[i].image = pixman_image_ref(image);
+
+	return image;
+}
+
 static void pixman_destroy(struct wlr_renderer *wlr_renderer) {
 	struct wlr_pixman_renderer *renderer = get_renderer(wlr_renderer);
 
@@ -283,6 +311,13 @@ static void pixman_destroy(struct wlr_renderer *wlr_renderer) {
 	}
 
 	wlr_drm_format_set_finish(&renderer->drm_formats);
+	pixman_tile_pool_destroy(renderer->tile_pool);
+
+	for (size_t i = 0; i < WLR_PIXMAN_SOLID_FILLS_CAP; i++) {
+		if (renderer->solid_fills[i].image != NULL) {
+			pixman_image_unref(renderer->solid_fills[i].image);
+		}
+	}
 
 	free(renderer);
 }
@@ -319,6 +354,32 @@ static const struct wlr_renderer_impl renderer_impl = {
 	.begin_buffer_pass = pixman_begin_buffer_pass,
 };
 
+#define MAX_THREADS 16
+
+static int get_threads_len(void) {
+	// Worker threads are opt-in
+	const char *env = getenv("WLR_RENDERER_PIXMAN_THREADS");
+	if (env == NULL) {
+		return 1;
+	}
+
+	long threads_len;
+	if (strcmp(env, "auto") == 0) {
+		threads_len = sysconf(_SC_NPROCESSORS_ONLN);
+		if (threads_len < 1) {
+			return 1;
+		}
+	} else {
+		char *end;
+		threads_len = strtol(env, &end, 10);
+		if (*env == '\0' || *end != '\0' || threads_len < 1) {
+			wlr_log(WLR_ERROR, "Invalid WLR_RENDERER_PIXMAN_THREADS value: %s", env);
+			return 1;
+		}
+	}
+	return threads_len < MAX_THREADS ? threads_len : MAX_THREADS;
+}
+
 struct wlr_renderer *wlr_pixman_renderer_create(void) {
 	struct wlr_pixman_renderer *renderer = calloc(1, sizeof(*renderer));
 	if (renderer == NULL) {
@@ -340,6 +401,12 @@ struct wlr_renderer *wlr_pixman_renderer_create(void) {
 			DRM_FORMAT_MOD_LINEAR);
 	}
 
+	// The thread submitting a render pass composites tiles too
+	int threads_len = get_threads_len();
+	if (threads_len > 1) {
+		renderer->tile_pool = pixman_tile_pool_create(threads_len - 1);
+	}
+
 	return &renderer->wlr_renderer;
 }
 
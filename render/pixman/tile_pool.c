@@ -0,0 +1,145 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <wlr/util/log.h>
+#include "render/pixman.h"
+
+struct wlr_pixman_tile_pool {
+	pthread_t *threads;
+	int threads_len;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t start_cond, done_cond;
+
+	// Current job, protected by the mutex
+	pixman_tile_func_t func;
+	void *data;
+	int tiles_len, next_tile, tiles_done;
+	bool stopping;
+};
+
+// Must be called with the mutex locked
+static void pool_run_tiles(struct wlr_pixman_tile_pool *pool) {
+	while (pool->func != NULL && pool->next_tile < pool->tiles_len) {
+		int tile = pool->next_tile++;
+		pixman_tile_func_t func = pool->func;
+		void *data = pool->data;
+
+		pthread_mutex_unlock(&pool->mutex);
+		func(data, tile);
+		pthread_mutex_lock(&pool->mutex);
+
+		pool->tiles_done++;
+		if (pool->tiles_done == pool->tiles_len) {
+			pthread_cond_signal(&pool->done_cond);
+		}
+	}
+}
+
+static void *pool_worker(void *data) {
+	struct wlr_pixman_tile_pool *pool = data;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (!pool->stopping) {
+		pool_run_tiles(pool);
+		if (!pool->stopping) {
+			pthread_cond_wait(&pool->start_cond, &pool->mutex);
+		}
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+struct wlr_pixman_tile_pool *pixman_tile_pool_create(int threads_len) {
+	struct wlr_pixman_tile_pool *pool = calloc(1, sizeof(*pool));
+	if (pool == NULL) {
+		return NULL;
+	}
+
+	pool->threads = calloc(threads_len, sizeof(pool->threads[0]));
+	if (pool->threads == NULL) {
+		free(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->start_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+
+	// Signals are handled by the event loop on the main thread, keep them
+	// blocked in the workers. Synchronous signals raised by the workers
+	// themselves must stay deliverable: e.g. SIGBUS is raised when a client
+	// truncates a shm buffer being read, and is handled by wlr_shm.
+	sigset_t signals, prev_signals;
+	sigfillset(&signals);
+	sigdelset(&signals, SIGBUS);
+	sigdelset(&signals, SIGSEGV);
+	sigdelset(&signals, SIGFPE);
+	sigdelset(&signals, SIGILL);
+	pthread_sigmask(SIG_SETMASK, &signals, &prev_signals);
+
+	for (int i = 0; i < threads_len; i++) {
+		if (pthread_create(&pool->threads[pool->threads_len], NULL,
+				pool_worker, pool) != 0) {
+			wlr_log(WLR_ERROR, "Failed to create pixman worker thread");
+			break;
+		}
+		pool->threads_len++;
+	}
+
+	pthread_sigmask(SIG_SETMASK, &prev_signals, NULL);
+
+	wlr_log(WLR_DEBUG, "Created pixman tile pool with %d worker threads",
+		pool->threads_len);
+	return pool;
+}
+
+void pixman_tile_pool_destroy(struct wlr_pixman_tile_pool *pool) {
+	if (pool == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->stopping = true;
+	pthread_cond_broadcast(&pool->start_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (int i = 0; i < pool->threads_len; i++) {
+		pthread_join(pool->threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->start_cond);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool->threads);
+	free(pool);
+}
+
+void pixman_tile_pool_run(struct wlr_pixman_tile_pool *pool,
+		pixman_tile_func_t func, void *data, int tiles_len) {
+	if (tiles_len == 0) {
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+
+	pool->func = func;
+	pool->data = data;
+	pool->tiles_len = tiles_len;
+	pool->next_tile = 0;
+	pool->tiles_done = 0;
+	pthread_cond_broadcast(&pool->start_cond);
+
+	// The calling thread helps out instead of sitting idle
+	pool_run_tiles(pool);
+	while (pool->tiles_done < pool->tiles_len) {
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	}
+
+	pool->func = NULL;
+	pool->data = NULL;
+
+	pthread_mutex_unlock(&pool->mutex);
+}
@@ -318,6 +318,11 @@ struct wlr_render_pass *wlr_renderer_begin_buffer_pass(struct wlr_renderer *rend
 		options = &default_options;
 	}
 
+	if (!renderer->features.timeline && options->signal_timeline != NULL) {
+		wlr_log(WLR_ERROR, "Renderer doesn't support timelines");
+		return NULL;
+	}
+
 	return renderer->impl->begin_buffer_pass(renderer, buffer, options);
 }
 
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/interfaces/wlr_output.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/pixman.h>
+#include <wlr/render/swapchain.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+
+/* Checks the ordering of commits, present and frame events when states are
+ * queued with wlr_output_queue_state() on a headless output.
+ *
+ * Events are recorded as a string: 'c' for a commit with a buffer, 'p' for a
+ * presented frame, 'd' for a discarded frame and 'f' for a frame event. */
+
+#define TIMEOUT_MS 5000
+
+struct test {
+	struct wl_display *display;
+	struct wlr_backend *backend;
+	struct wlr_renderer *renderer;
+	struct wlr_allocator *allocator;
+	struct wlr_output *output;
+	struct wl_event_source *timeout;
+
+	int phase;
+	char events[64];
+	size_t events_len;
+	bool failed;
+
+	struct wl_listener new_output;
+	struct wl_listener commit;
+	struct wl_listener present;
+	struct wl_listener frame;
+};
+
+static void fail(struct test *test, const char *msg) {
+	fprintf(stderr, "FAIL: %s (events: \"%s\")\n", msg, test->events);
+	test->failed = true;
+	wl_display_terminate(test->display);
+}
+
+static void record(struct test *test, char event) {
+	if (test->events_len + 1 < sizeof(test->events)) {
+		test->events[test->events_len++] = event;
+	}
+}
+
+/**
+ * Commit or queue a new frame. Returns false on failure.
+ */
+static bool submit_frame(struct test *test, bool queue) {
+	struct wlr_output *output = test->output;
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	if (!output->enabled) {
+		wlr_output_state_set_enabled(&state, true);
+	}
+	if (!wlr_output_configure_primary_swapchain(output, &state,
+			&output->swapchain)) {
+		wlr_output_state_finish(&state);
+		return false;
+	}
+	struct wlr_buffer *buffer = wlr_swapchain_acquire(output->swapchain, NULL);
+	if (buffer == NULL) {
+		wlr_output_state_finish(&state);
+		return false;
+	}
+	wlr_output_state_set_buffer(&state, buffer);
+	wlr_buffer_unlock(buffer);
+
+	bool ok = queue ? wlr_output_queue_state(output, &state) :
+		wlr_output_commit_state(output, &state);
+	wlr_output_state_finish(&state);
+	return ok;
+}
+
+static void handle_commit(struct wl_listener *listener, void *data) {
+	struct test *test = wl_container_of(listener, test, commit);
+	struct wlr_output_event_commit *event = data;
+	if (event->state->committed & WLR_OUTPUT_STATE_BUFFER) {
+		record(test, 'c');
+	}
+}
+
+static void handle_present(struct wl_listener *listener, void *data) {
+	struct test *test = wl_container_of(listener, test, present);
+	struct wlr_output_event_present *event = data;
+	record(test, event->presented ? 'p' : 'd');
+}
+
+static void handle_frame(struct wl_listener *listener, void *data) {
+	struct test *test = wl_container_of(listener, test, frame);
+	struct wlr_output *output = test->output;
+	record(test, 'f');
+
+	if (output->commit_in_flight || !wl_list_empty(&output->commit_queue)) {
+		fail(test, "frame event sent while a commit is in flight");
+		return;
+	}
+
+	switch (test->phase++) {
+	case 0:
+		// The two queued frames must have been submitted on the next frame
+		// events, without any frame event sent to the compositor in-between
+		if (strcmp(test->events, "cpcpcpf") != 0) {
+			fail(test, "unexpected event order with queued frames");
+			return;
+		}
+
+		// A discarded frame must resume the queue
+		if (!submit_frame(test, false) || !submit_frame(test, true)) {
+			fail(test, "failed to submit frames");
+			return;
+		}
+		struct wlr_output_event_present event = {
+			.commit_seq = output->commit_seq,
+			.presented = false,
+		};
+		wlr_output_send_present(output, &event);
+		break;
+	case 1:
+		if (strcmp(test->events, "cpcpcpfcdpcpf") != 0) {
+			fail(test, "unexpected event order with a discarded frame");
+			return;
+		}
+		wl_display_terminate(test->display);
+		break;
+	}
+}
+
+static void handle_new_output(struct wl_listener *listener, void *data) {
+	struct test *test = wl_container_of(listener, test, new_output);
+	struct wlr_output *output = data;
+
+	test->output = output;
+	wlr_output_init_render(output, test->allocator, test->renderer);
+
+	test->commit.notify = handle_commit;
+	wl_signal_add(&output->events.commit, &test->commit);
+	test->present.notify = handle_present;
+	wl_signal_add(&output->events.present, &test->present);
+	test->frame.notify = handle_frame;
+	wl_signal_add(&output->events.frame, &test->frame);
+
+	// Enable the output, then queue two frames while the first one is in
+	// flight
+	if (!submit_frame(test, false) || !submit_frame(test, true) ||
+			!submit_frame(test, true)) {
+		fail(test, "failed to submit frames");
+		return;
+	}
+	if (output->commit_queue_len != 2) {
+		fail(test, "frames weren't queued");
+	}
+}
+
+static int handle_timeout(void *data) {
+	struct test *test = data;
+	fail(test, "timed out");
+	return 0;
+}
+
+int main(void) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	struct test test = {0};
+	test.display = wl_display_create();
+	struct wl_event_loop *loop = wl_display_get_event_loop(test.display);
+	test.backend = wlr_headless_backend_create(test.display);
+	test.renderer = wlr_pixman_renderer_create();
+	if (test.backend == NULL || test.renderer == NULL) {
+		return EXIT_FAILURE;
+	}
+	test.allocator = wlr_allocator_autocreate(test.backend, test.renderer);
+	if (test.allocator == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	test.new_output.notify = handle_new_output;
+	wl_signal_add(&test.backend->events.new_output, &test.new_output);
+
+	test.timeout = wl_event_loop_add_timer(loop, handle_timeout, &test);
+	wl_event_source_timer_update(test.timeout, TIMEOUT_MS);
+
+	if (!wlr_backend_start(test.backend)) {
+		return EXIT_FAILURE;
+	}
+	wlr_headless_add_output(test.backend, 64, 64);
+
+	wl_display_run(test.display);
+
+	if (test.output != NULL) {
+		wl_list_remove(&test.commit.link);
+		wl_list_remove(&test.present.link);
+		wl_list_remove(&test.frame.link);
+	}
+	wl_list_remove(&test.new_output.link);
+	wl_event_source_remove(test.timeout);
+	wlr_backend_destroy(test.backend);
+	wlr_allocator_destroy(test.allocator);
+	wlr_renderer_destroy(test.renderer);
+	wl_display_destroy(test.display);
+	return test.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -5,10 +5,12 @@
 #include <wlr/render/swapchain.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_compositor.h>
+#include <wlr/util/addon.h>
 #include <wlr/util/log.h>
 #include <wlr/util/region.h>
 #include <wlr/util/transform.h>
 #include "render/allocator/allocator.h"
+#include "render/drm_format_set.h"
 #include "types/wlr_buffer.h"
 #include "types/wlr_output.h"
 
@@ -174,7 +176,183 @@ static bool output_pick_cursor_format(struct wlr_output *output,
 	return output_pick_format(output, display_formats, format, DRM_FORMAT_ARGB8888);
 }
 
-static struct wlr_buffer *render_cursor_buffer(struct wlr_output_cursor *cursor) {
+// Maximum number of cursor buffers rendered from a single image
+#define CURSOR_BUFFER_CACHE_CAP 4
+
+struct output_cursor_buffer {
+	struct wl_list link; // output_cursor_buffer_cache.buffers
+	struct wlr_buffer *buffer;
+
+	struct wlr_fbox src_box;
+	int dst_width, dst_height;
+	enum wl_output_transform transform;
+};
+
+/**
+ * Cursor buffers rendered from an immutable image, attached to the image.
+ * The cursor buffers are shared by all outputs using the same allocator.
+ */
+struct output_cursor_buffer_cache {
+	struct wlr_addon addon; // owned by the allocator
+	struct wlr_allocator *allocator;
+	struct wl_list buffers; // output_cursor_buffer.link, most recent first
+	size_t buffers_len;
+
+	struct wl_listener allocator_destroy;
+};
+
+static void cursor_buffer_destroy(struct output_cursor_buffer *cached) {
+	wl_list_remove(&cached->link);
+	wlr_buffer_drop(cached->buffer);
+	free(cached);
+}
+
+static void cursor_buffer_cache_destroy(struct output_cursor_buffer_cache *cache) {
+	struct output_cursor_buffer *cached, *tmp;
+	wl_list_for_each_safe(cached, tmp, &cache->buffers, link) {
+		cursor_buffer_destroy(cached);
+	}
+	wl_list_remove(&cache->allocator_destroy.link);
+	wlr_addon_finish(&cache->addon);
+	free(cache);
+}
+
+static void cursor_buffer_cache_handle_addon_destroy(struct wlr_addon *addon) {
+	struct output_cursor_buffer_cache *cache = wl_container_of(addon, cache, addon);
+	cursor_buffer_cache_destroy(cache);
+}
+
+static const struct wlr_addon_interface cursor_buffer_cache_addon_impl = {
+	.name = "output_cursor_buffer_cache",
+	.destroy = cursor_buffer_cache_handle_addon_destroy,
+};
+
+static void cursor_buffer_cache_handle_allocator_destroy(
+		struct wl_listener *listener, void *data) {
+	struct output_cursor_buffer_cache *cache =
+		wl_container_of(listener, cache, allocator_destroy);
+	cursor_buffer_cache_destroy(cache);
+}
+
+static struct output_cursor_buffer_cache *cursor_buffer_cache_get_or_create(
+		struct wlr_buffer *image, struct wlr_allocator *allocator) {
+	struct wlr_addon *addon = wlr_addon_find(&image->addons, allocator,
+		&cursor_buffer_cache_addon_impl);
+	if (addon != NULL) {
+		struct output_cursor_buffer_cache *cache =
+			wl_container_of(addon, cache, addon);
+		return cache;
+	}
+
+	struct output_cursor_buffer_cache *cache = calloc(1, sizeof(*cache));
+	if (cache == NULL) {
+		return NULL;
+	}
+	cache->allocator = allocator;
+	wl_list_init(&cache->buffers);
+	wlr_addon_init(&cache->addon, &image->addons, allocator,
+		&cursor_buffer_cache_addon_impl);
+	cache->allocator_destroy.notify = cursor_buffer_cache_handle_allocator_destroy;
+	wl_signal_add(&allocator->events.destroy, &cache->allocator_destroy);
+	return cache;
+}
+
+static bool cursor_buffer_has_format(struct wlr_buffer *buffer,
+		const struct wlr_drm_format *format) {
+	struct wlr_dmabuf_attributes dmabuf;
+	struct wlr_shm_attributes shm;
+	if (wlr_buffer_get_dmabuf(buffer, &dmabuf)) {
+		return dmabuf.format == format->format &&
+			wlr_drm_format_has(format, dmabuf.modifier);
+	} else if (wlr_buffer_get_shm(buffer, &shm)) {
+		return shm.format == format->format;
+	}
+	return false;
+}
+
+static struct output_cursor_buffer *cursor_buffer_cache_find(
+		struct output_cursor_buffer_cache *cache, struct wlr_output_cursor *cursor,
+		enum wl_output_transform transform, const struct wlr_swapchain *swapchain) {
+	struct output_cursor_buffer *cached;
+	wl_list_for_each(cached, &cache->buffers, link) {
+		if (cached->transform == transform &&
+				cached->dst_width == (int)cursor->width &&
+				cached->dst_height == (int)cursor->height &&
+				cached->src_box.x == cursor->src_box.x &&
+				cached->src_box.y == cursor->src_box.y &&
+				cached->src_box.width == cursor->src_box.width &&
+				cached->src_box.height == cursor->src_box.height &&
+				cached->buffer->width == swapchain->width &&
+				cached->buffer->height == swapchain->height &&
+				cursor_buffer_has_format(cached->buffer, &swapchain->format)) {
+			return cached;
+		}
+	}
+	return NULL;
+}
+
+static void cursor_buffer_cache_add(struct output_cursor_buffer_cache *cache,
+		struct wlr_output_cursor *cursor, enum wl_output_transform transform,
+		struct wlr_buffer *buffer) {
+	struct output_cursor_buffer *cached = calloc(1, sizeof(*cached));
+	if (cached == NULL) {
+		wlr_buffer_drop(buffer);
+		return;
+	}
+	cached->buffer = buffer;
+	cached->src_box = cursor->src_box;
+	cached->dst_width = cursor->width;
+	cached->dst_height = cursor->height;
+	cached->transform = transform;
+	wl_list_insert(&cache->buffers, &cached->link);
+	cache->buffers_len++;
+
+	if (cache->buffers_len > CURSOR_BUFFER_CACHE_CAP) {
+		struct output_cursor_buffer *oldest =
+			wl_container_of(cache->buffers.prev, oldest, link);
+		cursor_buffer_destroy(oldest);
+		cache->buffers_len--;
+	}
+}
+
+static bool render_cursor(struct wlr_output_cursor *cursor,
+		struct wlr_buffer *buffer, enum wl_output_transform transform) {
+	struct wlr_output *output = cursor->output;
+
+	struct wlr_box dst_box = {
+		.width = cursor->width,
+		.height = cursor->height,
+	};
+	wlr_box_transform(&dst_box, &dst_box, wlr_output_transform_invert(output->transform),
+		buffer->width, buffer->height);
+
+	struct wlr_render_pass *pass =
+		wlr_renderer_begin_buffer_pass(output->renderer, buffer, NULL);
+	if (pass == NULL) {
+		return false;
+	}
+
+	wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
+		.box = { .width = buffer->width, .height = buffer->height },
+		.blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+	});
+	wlr_render_pass_add_texture(pass, &(struct wlr_render_texture_options){
+		.texture = cursor->texture,
+		.src_box = cursor->src_box,
+		.dst_box = dst_box,
+		.transform = transform,
+	});
+
+	return wlr_render_pass_submit(pass);
+}
+
+/**
+ * Get a cursor buffer suitable for the output's cursor plane. If image is
+ * not NULL, the texture has been created from it and rendered buffers are
+ * cached.
+ */
+static struct wlr_buffer *render_cursor_buffer(struct wlr_output_cursor *cursor,
+		struct wlr_buffer *image) {
 	struct wlr_output *output = cursor->output;
 
 	struct wlr_texture *texture = cursor->texture;
@@ -183,8 +361,7 @@ static struct wlr_buffer *render_cursor_buffer(struct wlr_output_cursor *cursor)
 	}
 
 	struct wlr_allocator *allocator = output->allocator;
-	struct wlr_renderer *renderer = output->renderer;
-	assert(allocator != NULL && renderer != NULL);
+	assert(allocator != NULL && output->renderer != NULL);
 
 	int width = cursor->width;
 	int height = cursor->height;
@@ -218,48 +395,55 @@ static struct wlr_buffer *render_cursor_buffer(struct wlr_output_cursor *cursor)
 		}
 	}
 
-	struct wlr_buffer *buffer =
-		wlr_swapchain_acquire(output->cursor_swapchain, NULL);
-	if (buffer == NULL) {
-		return NULL;
+	enum wl_output_transform transform = wlr_output_transform_invert(cursor->transform);
+	transform = wlr_output_transform_compose(transform, output->transform);
+
+	// The swapchain holds the cursor format, cached buffers are allocated
+	// separately so that they don't get recycled
+	struct output_cursor_buffer_cache *cache = NULL;
+	if (image != NULL) {
+		cache = cursor_buffer_cache_get_or_create(image, allocator);
 	}
 
-	struct wlr_box dst_box = {
-		.width = cursor->width,
-		.height = cursor->height,
-	};
-	wlr_box_transform(&dst_box, &dst_box, wlr_output_transform_invert(output->transform),
-		buffer->width, buffer->height);
+	struct wlr_buffer *buffer;
+	if (cache != NULL) {
+		struct output_cursor_buffer *cached = cursor_buffer_cache_find(cache,
+			cursor, transform, output->cursor_swapchain);
+		if (cached != NULL) {
+			wl_list_remove(&cached->link);
+			wl_list_insert(&cache->buffers, &cached->link);
+			return wlr_buffer_lock(cached->buffer);
+		}
 
-	struct wlr_render_pass *pass = wlr_renderer_begin_buffer_pass(renderer, buffer, NULL);
-	if (pass == NULL) {
-		wlr_buffer_unlock(buffer);
+		buffer = wlr_allocator_create_buffer(allocator, width, height,
+			&output->cursor_swapchain->format);
+	} else {
+		buffer = wlr_swapchain_acquire(output->cursor_swapchain, NULL);
+	}
+	if (buffer == NULL) {
 		return NULL;
 	}
 
-	enum wl_output_transform transform = wlr_output_transform_invert(cursor->transform);
-	transform = wlr_output_transform_compose(transform, output->transform);
-
-	wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
-		.box = { .width = buffer->width, .height = buffer->height },
-		.blend_mode = WLR_RENDER_BLEND_MODE_NONE,
-	});
-	wlr_render_pass_add_texture(pass, &(struct wlr_render_texture_options){
-		.texture = texture,
-		.src_box = cursor->src_box,
-		.dst_box = dst_box,
-		.transform = transform,
-	});
-
-	if (!wlr_render_pass_submit(pass)) {
-		wlr_buffer_unlock(buffer);
+	if (!render_cursor(cursor, buffer, transform)) {
+		if (cache != NULL) {
+			wlr_buffer_drop(buffer);
+		} else {
+			wlr_buffer_unlock(buffer);
+		}
 		return NULL;
 	}
 
+	if (cache != NULL) {
+		// The cache owns the buffer
+		struct wlr_buffer *locked = wlr_buffer_lock(buffer);
+		cursor_buffer_cache_add(cache, cursor, transform, buffer);
+		return locked;
+	}
 	return buffer;
 }
 
-static bool output_cursor_attempt_hardware(struct wlr_output_cursor *cursor) {
+static bool output_cursor_attempt_hardware(struct wlr_output_cursor *cursor,
+		struct wlr_buffer *image) {
 	struct wlr_output *output = cursor->output;
 
 	if (!output->impl->set_cursor ||
@@ -281,7 +465,7 @@ static bool output_cursor_attempt_hardware(struct wlr_output_cursor *cursor) {
 
 	struct wlr_buffer *buffer = NULL;
 	if (texture != NULL) {
-		buffer = render_cursor_buffer(cursor);
+		buffer = render_cursor_buffer(cursor, image);
 		if (buffer == NULL) {
 			wlr_log(WLR_DEBUG, "Failed to render cursor buffer");
 			return false;
@@ -330,14 +514,14 @@ bool wlr_output_cursor_set_buffer(struct wlr_output_cursor *cursor,
 	hotspot_x /= cursor->output->scale;
 	hotspot_y /= cursor->output->scale;
 
-	return output_cursor_set_texture(cursor, texture, true, &src_box,
+	return output_cursor_set_texture(cursor, NULL, texture, true, &src_box,
 		dst_width, dst_height, WL_OUTPUT_TRANSFORM_NORMAL, hotspot_x, hotspot_y);
 }
 
 bool output_cursor_set_texture(struct wlr_output_cursor *cursor,
-		struct wlr_texture *texture, bool own_texture, const struct wlr_fbox *src_box,
-		int dst_width, int dst_height, enum wl_output_transform transform,
-		int32_t hotspot_x, int32_t hotspot_y) {
+		struct wlr_buffer *buffer, struct wlr_texture *texture, bool own_texture,
+		const struct wlr_fbox *src_box, int dst_width, int dst_height,
+		enum wl_output_transform transform, int32_t hotspot_x, int32_t hotspot_y) {
 	struct wlr_output *output = cursor->output;
 
 	output_cursor_reset(cursor);
@@ -364,7 +548,7 @@ bool output_cursor_set_texture(struct wlr_output_cursor *cursor,
 	cursor->texture = texture;
 	cursor->own_texture = own_texture;
 
-	if (output_cursor_attempt_hardware(cursor)) {
+	if (output_cursor_attempt_hardware(cursor, buffer)) {
 		return true;
 	}
 
@@ -407,6 +407,7 @@ void wlr_output_init(struct wlr_output *output, struct wlr_backend *backend,
 	wl_list_init(&output->cursors);
 	wl_list_init(&output->layers);
 	wl_list_init(&output->resources);
+	wl_list_init(&output->commit_queue);
 	wl_signal_init(&output->events.frame);
 	wl_signal_init(&output->events.damage);
 	wl_signal_init(&output->events.needs_frame);
@@ -459,6 +460,10 @@ void wlr_output_destroy(struct wlr_output *output) {
 		wlr_output_layer_destroy(layer);
 	}
 
+	wlr_output_trace_destroy(output->trace);
+	wlr_output_frame_scheduler_destroy(output->frame_scheduler);
+	output_queue_finish(output);
+
 	wlr_swapchain_destroy(output->cursor_swapchain);
 	wlr_buffer_unlock(output->cursor_front_buffer);
 
@@ -727,6 +732,19 @@ static bool output_basic_test(struct wlr_output *output,
 		}
 	}
 
+	uint32_t timeline_fields =
+		WLR_OUTPUT_STATE_WAIT_TIMELINE | WLR_OUTPUT_STATE_SIGNAL_TIMELINE;
+	if (state->committed & timeline_fields) {
+		if (!output->backend->features.timeline) {
+			wlr_log(WLR_DEBUG, "Wait/signal timelines are not supported for this output");
+			return false;
+		}
+		if (!(state->committed & WLR_OUTPUT_STATE_BUFFER)) {
+			wlr_log(WLR_DEBUG, "Tried to set a wait/signal timeline without a buffer");
+			return false;
+		}
+	}
+
 	return true;
 }
 
@@ -764,8 +782,10 @@ bool wlr_output_test(struct wlr_output *output) {
 	return wlr_output_test_state(output, &state);
 }
 
-bool wlr_output_commit_state(struct wlr_output *output,
+bool output_commit_state(struct wlr_output *output,
 		const struct wlr_output_state *state) {
+	output_trace(output, WLR_OUTPUT_TRACE_COMMIT_BEGIN);
+
 	uint32_t unchanged = output_compare_state(output, state);
 
 	// Create a shallow copy of the state with only the fields which have been
@@ -799,18 +819,26 @@ bool wlr_output_commit_state(struct wlr_output *output,
 	};
 	wl_signal_emit_mutable(&output->events.precommit, &pre_event);
 
+	output_trace(output, WLR_OUTPUT_TRACE_BACKEND_COMMIT_BEGIN);
 	if (!output->impl->commit(output, &pending)) {
 		if (new_back_buffer) {
 			wlr_buffer_unlock(pending.buffer);
 		}
 		return false;
 	}
+	output_trace(output, WLR_OUTPUT_TRACE_BACKEND_COMMIT_END);
 
 	output->commit_seq++;
 
+	if (output->frame_scheduler != NULL &&
+			(pending.committed & WLR_OUTPUT_STATE_BUFFER)) {
+		output_frame_scheduler_handle_commit(output->frame_scheduler);
+	}
+
 	if (output_pending_enabled(output, state)) {
 		output->frame_pending = true;
 		output->needs_frame = false;
+		output->commit_in_flight = true;
 	}
 
 	output_apply_state(output, &pending);
@@ -826,9 +854,22 @@ bool wlr_output_commit_state(struct wlr_output *output,
 		wlr_buffer_unlock(pending.buffer);
 	}
 
+	if (output->trace != NULL) {
+		output_trace_record(output, WLR_OUTPUT_TRACE_COMMIT_END, NULL,
+			output->commit_seq);
+	}
+
 	return true;
 }
 
+bool wlr_output_commit_state(struct wlr_output *output,
+		const struct wlr_output_state *state) {
+	if (!wl_list_empty(&output->commit_queue)) {
+		return output_queue_commit_state(output, state);
+	}
+	return output_commit_state(output, state);
+}
+
 bool wlr_output_commit(struct wlr_output *output) {
 	// Make sure the pending state is cleared before the output is committed
 	struct wlr_output_state state = {0};
@@ -848,18 +889,54 @@ void wlr_output_attach_buffer(struct wlr_output *output,
 	wlr_output_state_set_buffer(&output->pending, buffer);
 }
 
-void wlr_output_send_frame(struct wlr_output *output) {
+void output_emit_frame(struct wlr_output *output) {
 	output->frame_pending = false;
+	if (output->frame_scheduler != NULL) {
+		output_frame_scheduler_handle_frame(output->frame_scheduler);
+	}
 	if (output->enabled) {
+		output_trace(output, WLR_OUTPUT_TRACE_FRAME);
 		wl_signal_emit_mutable(&output->events.frame, output);
 	}
 }
 
+void wlr_output_send_frame(struct wlr_output *output) {
+	// The backend is ready for a new frame: submit the next queued state. The
+	// frame event is held back until that state is done, since the backend
+	// can't accept another one before.
+	if (output_queue_handle_frame(output)) {
+		return;
+	}
+
+	// The frame stays pending until the scheduler sends it
+	if (output->enabled && output->frame_scheduler != NULL &&
+			output_frame_scheduler_delay_frame(output->frame_scheduler)) {
+		return;
+	}
+	output_emit_frame(output);
+}
+
+void output_begin_backend_update(struct wlr_output *output) {
+	assert(!output->frame_pending);
+	output->frame_pending = true;
+	output->commit_in_flight = true;
+}
+
+void output_finish_backend_update(struct wlr_output *output) {
+	// Only wake up the compositor if it asked for a frame in the meantime
+	if (output->needs_frame || !wl_list_empty(&output->commit_queue)) {
+		wlr_output_send_frame(output);
+		return;
+	}
+	output->frame_pending = false;
+	output->commit_in_flight = false;
+}
+
 static void schedule_frame_handle_idle_timer(void *data) {
 	struct wlr_output *output = data;
 	output->idle_frame = NULL;
 	if (!output->frame_pending) {
-		wlr_output_send_frame(output);
+		output_emit_frame(output);
 	}
 }
 
@@ -873,6 +950,8 @@ void wlr_output_schedule_frame(struct wlr_output *output) {
 		return;
 	}
 
+	output_trace(output, WLR_OUTPUT_TRACE_SCHEDULE_FRAME);
+
 	// We're using an idle timer here in case a buffer swap happens right after
 	// this function is called
 	output->idle_frame = wl_event_loop_add_idle(output->event_loop,
@@ -894,6 +973,22 @@ void wlr_output_send_present(struct wlr_output *output,
 		event->when = &now;
 	}
 
+	if (output->trace != NULL) {
+		output_trace_record(output, event->presented ?
+			WLR_OUTPUT_TRACE_PRESENT : WLR_OUTPUT_TRACE_DISCARD,
+			event->when, event->commit_seq);
+	}
+
+	if (output->frame_scheduler != NULL) {
+		output_frame_scheduler_handle_present(output->frame_scheduler, event);
+	}
+
+	// The frame won't be followed by a frame event, e.g. because the session
+	// is inactive: don't hold queued states back forever
+	if (!event->presented) {
+		output_queue_handle_discard(output);
+	}
+
 	wl_signal_emit_mutable(&output->events.present, event);
 }
 
@@ -991,6 +1086,14 @@ const struct wlr_drm_format_set *wlr_output_get_primary_formats(
 	return formats;
 }
 
+bool wlr_output_preimport_buffer(struct wlr_output *output,
+		struct wlr_buffer *buffer) {
+	if (!output->enabled || output->impl->preimport_buffer == NULL) {
+		return false;
+	}
+	return output->impl->preimport_buffer(output, buffer);
+}
+
 bool wlr_output_is_direct_scanout_allowed(struct wlr_output *output) {
 	if (output->attach_render_locks > 0) {
 		wlr_log(WLR_DEBUG, "Direct scan-out disabled by lock");
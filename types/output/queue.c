@@ -0,0 +1,289 @@
+#include <stdlib.h>
+#include <wlr/render/drm_syncobj.h>
+#include <wlr/util/log.h>
+#include "types/wlr_output.h"
+
+// Maximum number of buffers waiting for a frame in FIFO mode
+#define FIFO_CAP 2
+
+struct output_queued_state {
+	struct wl_list link; // wlr_output.commit_queue
+	// Holds references to the wait and signal timelines
+	struct wlr_output_state state;
+};
+
+static void output_state_drop_timelines(struct wlr_output_state *state) {
+	wlr_drm_syncobj_timeline_unref(state->wait_timeline);
+	wlr_drm_syncobj_timeline_unref(state->signal_timeline);
+	state->wait_timeline = NULL;
+	state->signal_timeline = NULL;
+	state->committed &= ~(WLR_OUTPUT_STATE_WAIT_TIMELINE |
+		WLR_OUTPUT_STATE_SIGNAL_TIMELINE);
+}
+
+/**
+ * Signal the release point of a buffer which will never be displayed, as soon
+ * as the buffer is ready.
+ */
+static void output_state_release_buffer(struct wlr_output_state *state) {
+	if (!(state->committed & WLR_OUTPUT_STATE_SIGNAL_TIMELINE)) {
+		return;
+	}
+
+	bool ok;
+	if (state->committed & WLR_OUTPUT_STATE_WAIT_TIMELINE) {
+		ok = wlr_drm_syncobj_timeline_transfer(state->signal_timeline,
+			state->signal_point, state->wait_timeline, state->wait_point);
+	} else {
+		ok = wlr_drm_syncobj_timeline_signal(state->signal_timeline,
+			state->signal_point);
+	}
+	if (!ok) {
+		wlr_log(WLR_ERROR, "Failed to signal release point of superseded buffer");
+	}
+}
+
+/**
+ * Apply the fields of src on top of dst. Timelines are referenced, output
+ * layers are borrowed.
+ */
+static bool output_state_merge(struct wlr_output_state *dst,
+		const struct wlr_output_state *src) {
+	// Do the only fallible operation first, so that dst is left untouched on
+	// error
+	if (src->committed & WLR_OUTPUT_STATE_GAMMA_LUT) {
+		const uint16_t *r = src->gamma_lut;
+		const uint16_t *g = src->gamma_lut + src->gamma_lut_size;
+		const uint16_t *b = src->gamma_lut + 2 * src->gamma_lut_size;
+		if (!wlr_output_state_set_gamma_lut(dst, src->gamma_lut_size, r, g, b)) {
+			return false;
+		}
+	}
+
+	if (src->committed & WLR_OUTPUT_STATE_BUFFER) {
+		// Damage is relative to the last displayed frame, so the damage of a
+		// superseded buffer still applies
+		bool full_damage = !(src->committed & WLR_OUTPUT_STATE_DAMAGE) ||
+			((dst->committed & WLR_OUTPUT_STATE_BUFFER) &&
+			!(dst->committed & WLR_OUTPUT_STATE_DAMAGE));
+		if (full_damage) {
+			pixman_region32_clear(&dst->damage);
+			dst->committed &= ~WLR_OUTPUT_STATE_DAMAGE;
+		} else {
+			pixman_region32_union(&dst->damage, &dst->damage, &src->damage);
+			dst->committed |= WLR_OUTPUT_STATE_DAMAGE;
+		}
+
+		output_state_drop_timelines(dst);
+		if (src->committed & WLR_OUTPUT_STATE_WAIT_TIMELINE) {
+			wlr_output_state_set_wait_timeline(dst,
+				wlr_drm_syncobj_timeline_ref(src->wait_timeline), src->wait_point);
+		}
+		if (src->committed & WLR_OUTPUT_STATE_SIGNAL_TIMELINE) {
+			wlr_output_state_set_signal_timeline(dst,
+				wlr_drm_syncobj_timeline_ref(src->signal_timeline), src->signal_point);
+		}
+
+		wlr_output_state_set_buffer(dst, src->buffer);
+		dst->tearing_page_flip = src->tearing_page_flip;
+	}
+
+	if (src->committed & WLR_OUTPUT_STATE_ENABLED) {
+		dst->enabled = src->enabled;
+	}
+	if (src->committed & WLR_OUTPUT_STATE_MODE) {
+		dst->mode_type = src->mode_type;
+		dst->mode = src->mode;
+		dst->custom_mode.width = src->custom_mode.width;
+		dst->custom_mode.height = src->custom_mode.height;
+		dst->custom_mode.refresh = src->custom_mode.refresh;
+	}
+	if (src->committed & WLR_OUTPUT_STATE_SCALE) {
+		dst->scale = src->scale;
+	}
+	if (src->committed & WLR_OUTPUT_STATE_TRANSFORM) {
+		dst->transform = src->transform;
+	}
+	if (src->committed & WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED) {
+		dst->adaptive_sync_enabled = src->adaptive_sync_enabled;
+	}
+	if (src->committed & WLR_OUTPUT_STATE_RENDER_FORMAT) {
+		dst->render_format = src->render_format;
+	}
+	if (src->committed & WLR_OUTPUT_STATE_SUBPIXEL) {
+		dst->subpixel = src->subpixel;
+	}
+	if (src->committed & WLR_OUTPUT_STATE_LAYERS) {
+		wlr_output_state_set_layers(dst, src->layers, src->layers_len);
+	}
+
+	dst->allow_reconfiguration |= src->allow_reconfiguration;
+	dst->committed |= src->committed & (WLR_OUTPUT_STATE_ENABLED |
+		WLR_OUTPUT_STATE_MODE | WLR_OUTPUT_STATE_SCALE |
+		WLR_OUTPUT_STATE_TRANSFORM | WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED |
+		WLR_OUTPUT_STATE_RENDER_FORMAT | WLR_OUTPUT_STATE_SUBPIXEL);
+	return true;
+}
+
+static void queued_state_destroy(struct output_queued_state *queued) {
+	output_state_drop_timelines(&queued->state);
+	wlr_output_state_finish(&queued->state);
+	free(queued);
+}
+
+void wlr_output_set_commit_mode(struct wlr_output *output,
+		enum wlr_output_commit_mode mode) {
+	output->commit_mode = mode;
+}
+
+bool wlr_output_queue_state(struct wlr_output *output,
+		const struct wlr_output_state *state) {
+	if (state->committed & WLR_OUTPUT_STATE_LAYERS) {
+		wlr_log(WLR_DEBUG, "States with output layers can't be queued");
+		return false;
+	}
+
+	if (!output->commit_in_flight) {
+		return wlr_output_commit_state(output, state);
+	}
+
+	struct output_queued_state *last = NULL;
+	if (!wl_list_empty(&output->commit_queue)) {
+		last = wl_container_of(output->commit_queue.prev, last, link);
+	}
+
+	bool supersede = last != NULL &&
+		(last->state.committed & WLR_OUTPUT_STATE_BUFFER) &&
+		(state->committed & WLR_OUTPUT_STATE_BUFFER);
+	if (last != NULL && (!supersede ||
+			output->commit_mode == WLR_OUTPUT_COMMIT_MAILBOX ||
+			output->commit_queue_len >= FIFO_CAP)) {
+		if (supersede) {
+			output_state_release_buffer(&last->state);
+		}
+		return output_state_merge(&last->state, state);
+	}
+
+	struct output_queued_state *queued = calloc(1, sizeof(*queued));
+	if (queued == NULL) {
+		return false;
+	}
+	wlr_output_state_init(&queued->state);
+	if (!output_state_merge(&queued->state, state)) {
+		wlr_output_state_finish(&queued->state);
+		free(queued);
+		return false;
+	}
+
+	wl_list_insert(output->commit_queue.prev, &queued->link);
+	output->commit_queue_len++;
+	return true;
+}
+
+bool output_queue_commit_state(struct wlr_output *output,
+		const struct wlr_output_state *state) {
+	// Commit listeners may queue new states
+	struct wl_list queue;
+	wl_list_init(&queue);
+	wl_list_insert_list(&queue, &output->commit_queue);
+	wl_list_init(&output->commit_queue);
+	size_t queue_len = output->commit_queue_len;
+	output->commit_queue_len = 0;
+
+	struct wlr_output_state merged;
+	wlr_output_state_init(&merged);
+
+	bool ok = true;
+	struct output_queued_state *queued;
+	wl_list_for_each(queued, &queue, link) {
+		if (!output_state_merge(&merged, &queued->state)) {
+			ok = false;
+			break;
+		}
+	}
+	ok = ok && output_state_merge(&merged, state) &&
+		output_commit_state(output, &merged);
+
+	struct output_queued_state *tmp;
+	if (ok) {
+		wl_list_for_each_safe(queued, tmp, &queue, link) {
+			if (queued->state.buffer != merged.buffer) {
+				output_state_release_buffer(&queued->state);
+			}
+			wl_list_remove(&queued->link);
+			queued_state_destroy(queued);
+		}
+	} else {
+		// Put the states back in front of the ones queued in the meantime
+		wl_list_insert_list(&output->commit_queue, &queue);
+		output->commit_queue_len += queue_len;
+	}
+
+	output_state_drop_timelines(&merged);
+	wlr_output_state_finish(&merged);
+	return ok;
+}
+
+static bool output_queue_submit(struct wlr_output *output) {
+	if (wl_list_empty(&output->commit_queue)) {
+		return false;
+	}
+
+	// Commit listeners may queue new states
+	struct output_queued_state *queued =
+		wl_container_of(output->commit_queue.next, queued, link);
+	wl_list_remove(&queued->link);
+	output->commit_queue_len--;
+
+	if (!output_commit_state(output, &queued->state)) {
+		wlr_log(WLR_ERROR, "Failed to commit queued state for output %s",
+			output->name);
+		output_state_release_buffer(&queued->state);
+	}
+	queued_state_destroy(queued);
+
+	return output->commit_in_flight;
+}
+
+bool output_queue_handle_frame(struct wlr_output *output) {
+	output->commit_in_flight = false;
+	return output_queue_submit(output);
+}
+
+static void output_queue_handle_idle(void *data) {
+	struct wlr_output *output = data;
+	output->commit_queue_idle = NULL;
+
+	// A frame event may have submitted the next state in the meantime
+	if (!output->commit_in_flight) {
+		output_queue_submit(output);
+	}
+}
+
+void output_queue_handle_discard(struct wlr_output *output) {
+	output->commit_in_flight = false;
+	if (wl_list_empty(&output->commit_queue) ||
+			output->commit_queue_idle != NULL) {
+		return;
+	}
+
+	// Some backends send a frame event right after the discarded present
+	// event, let them go first
+	output->commit_queue_idle = wl_event_loop_add_idle(output->event_loop,
+		output_queue_handle_idle, output);
+}
+
+void output_queue_finish(struct wlr_output *output) {
+	struct output_queued_state *queued, *tmp;
+	wl_list_for_each_safe(queued, tmp, &output->commit_queue, link) {
+		output_state_release_buffer(&queued->state);
+		wl_list_remove(&queued->link);
+		queued_state_destroy(queued);
+	}
+	output->commit_queue_len = 0;
+
+	if (output->commit_queue_idle != NULL) {
+		wl_event_source_remove(output->commit_queue_idle);
+		output->commit_queue_idle = NULL;
+	}
+}
@@ -0,0 +1,223 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <time.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_scene.h>
+#include "types/wlr_scene.h"
+#include "util/time.h"
+
+// Content updates further apart than this are considered a pause
+#define CONTENT_TIMEOUT_NSEC (250 * 1000 * 1000)
+// Number of content frames required before the cadence is trusted
+#define CONTENT_MIN_SAMPLES 4
+// Commits which are due within this delay aren't deferred
+#define COMMIT_SLACK_NSEC (1000 * 1000)
+
+static int64_t get_current_time_nsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return timespec_to_nsec(&now);
+}
+
+static void pacing_reset_content(struct wlr_scene_output *scene_output) {
+	scene_output->pacing.last_content = 0;
+	scene_output->pacing.content_interval = 0;
+	scene_output->pacing.content_samples = 0;
+	scene_output->pacing.repeat = 1;
+}
+
+/**
+ * Returns the interval between two refresh cycles, or zero if frames
+ * shouldn't be paced.
+ */
+static int64_t pacing_get_slot(struct wlr_scene_output *scene_output,
+		int64_t now) {
+	struct wlr_output *output = scene_output->output;
+	if (scene_output->pacing.max_interval == 0 ||
+			output->adaptive_sync_status != WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED ||
+			scene_output->pacing.content == NULL ||
+			scene_output->pacing.content_samples < CONTENT_MIN_SAMPLES ||
+			now - scene_output->pacing.last_content > CONTENT_TIMEOUT_NSEC) {
+		return 0;
+	}
+
+	// Content at least as fast as the output doesn't need pacing
+	int64_t interval = scene_output->pacing.content_interval;
+	if (interval <= scene_output->pacing.min_interval) {
+		return 0;
+	}
+
+	int64_t slot = interval / scene_output->pacing.repeat;
+	if (slot < scene_output->pacing.min_interval) {
+		slot = scene_output->pacing.min_interval;
+	}
+	return slot;
+}
+
+static void pacing_arm_timer(struct wlr_scene_output *scene_output,
+		int64_t delay) {
+	// Round up, a zero delay would disarm the timer
+	int delay_ms = (delay + 999999) / 1000000;
+	if (delay_ms <= 0) {
+		delay_ms = 1;
+	}
+	wl_event_source_timer_update(scene_output->pacing.timer, delay_ms);
+}
+
+static int pacing_handle_timer(void *data) {
+	struct wlr_scene_output *scene_output = data;
+	wlr_output_schedule_frame(scene_output->output);
+	return 0;
+}
+
+static void pacing_handle_output_present(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_output *scene_output =
+		wl_container_of(listener, scene_output, pacing.output_present);
+	struct wlr_output_event_present *event = data;
+	if (!event->presented) {
+		return;
+	}
+
+	scene_output->pacing.last_present = timespec_to_nsec(event->when);
+
+	// Repeat the current content frame if the next one is due after the
+	// output would fall below its minimum refresh rate
+	int64_t now = get_current_time_nsec();
+	int64_t slot = pacing_get_slot(scene_output, now);
+	if (slot != 0 && scene_output->pacing.repeat > 1) {
+		pacing_arm_timer(scene_output,
+			scene_output->pacing.last_present + slot - now);
+	}
+}
+
+static void pacing_handle_content_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_output *scene_output =
+		wl_container_of(listener, scene_output, pacing.content_destroy);
+	scene_output_pacing_set_content(scene_output, NULL);
+}
+
+void scene_output_pacing_init(struct wlr_scene_output *scene_output) {
+	wl_list_init(&scene_output->pacing.output_present.link);
+	wl_list_init(&scene_output->pacing.content_destroy.link);
+	scene_output->pacing.repeat = 1;
+}
+
+void scene_output_pacing_finish(struct wlr_scene_output *scene_output) {
+	wlr_scene_output_set_vrr_range(scene_output, 0, 0);
+}
+
+void wlr_scene_output_set_vrr_range(struct wlr_scene_output *scene_output,
+		int32_t min_refresh, int32_t max_refresh) {
+	if (min_refresh <= 0 || max_refresh < min_refresh) {
+		scene_output_pacing_set_content(scene_output, NULL);
+		wl_list_remove(&scene_output->pacing.output_present.link);
+		wl_list_init(&scene_output->pacing.output_present.link);
+		if (scene_output->pacing.timer != NULL) {
+			wl_event_source_remove(scene_output->pacing.timer);
+			scene_output->pacing.timer = NULL;
+		}
+		scene_output->pacing.min_interval = 0;
+		scene_output->pacing.max_interval = 0;
+		return;
+	}
+
+	struct wlr_output *output = scene_output->output;
+	if (scene_output->pacing.timer == NULL) {
+		scene_output->pacing.timer = wl_event_loop_add_timer(
+			output->event_loop, pacing_handle_timer, scene_output);
+		if (scene_output->pacing.timer == NULL) {
+			return;
+		}
+
+		scene_output->pacing.output_present.notify =
+			pacing_handle_output_present;
+		wl_signal_add(&output->events.present,
+			&scene_output->pacing.output_present);
+	}
+
+	scene_output->pacing.min_interval = 1000000000000 / max_refresh;
+	scene_output->pacing.max_interval = 1000000000000 / min_refresh;
+	pacing_reset_content(scene_output);
+}
+
+void scene_output_pacing_set_content(struct wlr_scene_output *scene_output,
+		struct wlr_scene_buffer *scene_buffer) {
+	if (scene_output->pacing.content == scene_buffer) {
+		return;
+	}
+
+	wl_list_remove(&scene_output->pacing.content_destroy.link);
+	wl_list_init(&scene_output->pacing.content_destroy.link);
+	scene_output->pacing.content = scene_buffer;
+	pacing_reset_content(scene_output);
+
+	if (scene_buffer != NULL) {
+		scene_output->pacing.content_destroy.notify =
+			pacing_handle_content_destroy;
+		wl_signal_add(&scene_buffer->node.events.destroy,
+			&scene_output->pacing.content_destroy);
+	}
+}
+
+void scene_buffer_pacing_handle_update(struct wlr_scene_buffer *scene_buffer) {
+	struct wlr_scene_output *scene_output = scene_buffer->primary_output;
+	if (scene_output == NULL || scene_output->pacing.content != scene_buffer) {
+		return;
+	}
+
+	int64_t now = get_current_time_nsec();
+	int64_t last = scene_output->pacing.last_content;
+	scene_output->pacing.last_content = now;
+	if (last == 0) {
+		return;
+	}
+
+	int64_t interval = now - last;
+	if (interval > CONTENT_TIMEOUT_NSEC) {
+		// The content was paused, start over
+		scene_output->pacing.content_interval = 0;
+		scene_output->pacing.content_samples = 0;
+		return;
+	}
+
+	// Exponential moving average, to smooth out the client's jitter
+	if (scene_output->pacing.content_interval == 0) {
+		scene_output->pacing.content_interval = interval;
+	} else {
+		scene_output->pacing.content_interval +=
+			(interval - scene_output->pacing.content_interval) / 8;
+	}
+	scene_output->pacing.content_samples++;
+
+	// Frame multiplication: display each content frame for as many refresh
+	// cycles as needed to stay above the minimum refresh rate
+	int64_t max_interval = scene_output->pacing.max_interval;
+	int64_t content_interval = scene_output->pacing.content_interval;
+	scene_output->pacing.repeat = 1;
+	if (content_interval > max_interval) {
+		scene_output->pacing.repeat =
+			(content_interval + max_interval - 1) / max_interval;
+	}
+}
+
+bool scene_output_pacing_defer(struct wlr_scene_output *scene_output) {
+	if (scene_output->pacing.last_present == 0) {
+		return false;
+	}
+
+	int64_t now = get_current_time_nsec();
+	int64_t slot = pacing_get_slot(scene_output, now);
+	if (slot == 0) {
+		return false;
+	}
+
+	int64_t due = scene_output->pacing.last_present + slot;
+	if (now + COMMIT_SLACK_NSEC >= due) {
+		return false;
+	}
+
+	pacing_arm_timer(scene_output, due - now);
+	return true;
+}
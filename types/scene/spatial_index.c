@@ -0,0 +1,392 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/util/box.h>
+#include <wlr/util/log.h>
+#include "types/wlr_scene.h"
+
+/*
+ * The spatial index is a sparse uniform grid over the layout-local boxes of
+ * the enabled leaf nodes (rects and buffers) of a scene. Cells are stored in a
+ * hash table keyed by cell coordinates, and each cell holds the nodes which
+ * intersect it. Nodes covering too many cells (e.g. wallpapers spanning all
+ * outputs) are kept in a separate list instead, which is always scanned.
+ *
+ * Stacking order is tracked with a per-node sequence number assigned by a
+ * depth-first walk of the tree, only re-computed after topology changes.
+ */
+
+#define CELL_SIZE 256
+#define LARGE_NODE_CELLS 64
+#define INITIAL_BUCKETS 64
+
+struct scene_index_cell {
+	int x, y;
+	struct scene_index_cell *next; // in the same bucket
+
+	struct wl_array nodes; // struct wlr_scene_node *
+};
+
+static int cell_coord(int v) {
+	// Floor division, which C doesn't provide for negative numbers
+	return v >= 0 ? v / CELL_SIZE : -((-(v + 1)) / CELL_SIZE) - 1;
+}
+
+static uint32_t cell_hash(int x, int y) {
+	return (uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u;
+}
+
+struct scene_index_cell_range {
+	int x1, y1, x2, y2; // inclusive
+};
+
+static void box_cell_range(const struct wlr_box *box,
+		struct scene_index_cell_range *range) {
+	range->x1 = cell_coord(box->x);
+	range->y1 = cell_coord(box->y);
+	range->x2 = cell_coord(box->x + box->width - 1);
+	range->y2 = cell_coord(box->y + box->height - 1);
+}
+
+static int64_t cell_range_len(const struct scene_index_cell_range *range) {
+	return (int64_t)(range->x2 - range->x1 + 1) * (range->y2 - range->y1 + 1);
+}
+
+struct scene_index *scene_index_create(void) {
+	struct scene_index *index = calloc(1, sizeof(*index));
+	if (index == NULL) {
+		return NULL;
+	}
+
+	index->buckets = calloc(INITIAL_BUCKETS, sizeof(index->buckets[0]));
+	if (index->buckets == NULL) {
+		free(index);
+		return NULL;
+	}
+	index->buckets_len = INITIAL_BUCKETS;
+
+	wl_list_init(&index->large);
+	wl_array_init(&index->candidates);
+	index->order_dirty = true;
+
+	return index;
+}
+
+static void cell_destroy(struct scene_index_cell *cell) {
+	wl_array_release(&cell->nodes);
+	free(cell);
+}
+
+void scene_index_destroy(struct scene_index *index) {
+	if (index == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < index->buckets_len; i++) {
+		struct scene_index_cell *cell = index->buckets[i];
+		while (cell != NULL) {
+			struct scene_index_cell *next = cell->next;
+			cell_destroy(cell);
+			cell = next;
+		}
+	}
+
+	struct wlr_scene_node *node, *tmp;
+	wl_list_for_each_safe(node, tmp, &index->large, index.large_link) {
+		wl_list_remove(&node->index.large_link);
+		node->index.indexed = false;
+	}
+
+	wl_array_release(&index->candidates);
+	free(index->buckets);
+	free(index);
+}
+
+static struct scene_index_cell *index_find_cell(struct scene_index *index,
+		int x, int y) {
+	size_t bucket = cell_hash(x, y) & (index->buckets_len - 1);
+	for (struct scene_index_cell *cell = index->buckets[bucket]; cell != NULL;
+			cell = cell->next) {
+		if (cell->x == x && cell->y == y) {
+			return cell;
+		}
+	}
+	return NULL;
+}
+
+static void index_rehash(struct scene_index *index) {
+	size_t buckets_len = index->buckets_len * 2;
+	struct scene_index_cell **buckets = calloc(buckets_len, sizeof(buckets[0]));
+	if (buckets == NULL) {
+		// Keep the current table, chains will just get longer
+		return;
+	}
+
+	for (size_t i = 0; i < index->buckets_len; i++) {
+		struct scene_index_cell *cell = index->buckets[i];
+		while (cell != NULL) {
+			struct scene_index_cell *next = cell->next;
+			size_t bucket = cell_hash(cell->x, cell->y) & (buckets_len - 1);
+			cell->next = buckets[bucket];
+			buckets[bucket] = cell;
+			cell = next;
+		}
+	}
+
+	free(index->buckets);
+	index->buckets = buckets;
+	index->buckets_len = buckets_len;
+}
+
+static bool index_cell_add(struct scene_index *index, int x, int y,
+		struct wlr_scene_node *node) {
+	struct scene_index_cell *cell = index_find_cell(index, x, y);
+	if (cell == NULL) {
+		cell = calloc(1, sizeof(*cell));
+		if (cell == NULL) {
+			return false;
+		}
+		cell->x = x;
+		cell->y = y;
+		wl_array_init(&cell->nodes);
+
+		if (index->cells_len >= index->buckets_len) {
+			index_rehash(index);
+		}
+
+		size_t bucket = cell_hash(x, y) & (index->buckets_len - 1);
+		cell->next = index->buckets[bucket];
+		index->buckets[bucket] = cell;
+		index->cells_len++;
+	}
+
+	struct wlr_scene_node **ptr = wl_array_add(&cell->nodes, sizeof(*ptr));
+	if (ptr == NULL) {
+		return false;
+	}
+	*ptr = node;
+	return true;
+}
+
+static void index_cell_remove(struct scene_index *index, int x, int y,
+		struct wlr_scene_node *node) {
+	size_t bucket = cell_hash(x, y) & (index->buckets_len - 1);
+	struct scene_index_cell **link = &index->buckets[bucket];
+	while (*link != NULL && ((*link)->x != x || (*link)->y != y)) {
+		link = &(*link)->next;
+	}
+
+	struct scene_index_cell *cell = *link;
+	if (cell == NULL) {
+		return;
+	}
+
+	struct wlr_scene_node **nodes = cell->nodes.data;
+	size_t nodes_len = cell->nodes.size / sizeof(nodes[0]);
+	for (size_t i = 0; i < nodes_len; i++) {
+		if (nodes[i] == node) {
+			nodes[i] = nodes[nodes_len - 1];
+			cell->nodes.size -= sizeof(nodes[0]);
+			break;
+		}
+	}
+
+	if (cell->nodes.size == 0) {
+		*link = cell->next;
+		cell_destroy(cell);
+		index->cells_len--;
+	}
+}
+
+void scene_index_remove(struct scene_index *index, struct wlr_scene_node *node) {
+	if (!node->index.indexed) {
+		return;
+	}
+
+	if (node->index.large) {
+		wl_list_remove(&node->index.large_link);
+	} else {
+		struct scene_index_cell_range range;
+		box_cell_range(&node->index.box, &range);
+		for (int y = range.y1; y <= range.y2; y++) {
+			for (int x = range.x1; x <= range.x2; x++) {
+				index_cell_remove(index, x, y, node);
+			}
+		}
+	}
+
+	node->index.indexed = false;
+	node->index.large = false;
+}
+
+void scene_index_update(struct scene_index *index, struct wlr_scene_node *node,
+		const struct wlr_box *box) {
+	assert(node->type != WLR_SCENE_NODE_TREE);
+
+	if (node->index.indexed && wlr_box_equal(&node->index.box, box)) {
+		return;
+	}
+
+	scene_index_remove(index, node);
+
+	if (wlr_box_empty(box)) {
+		// Empty nodes never intersect anything
+		return;
+	}
+
+	node->index.box = *box;
+	node->index.indexed = true;
+
+	struct scene_index_cell_range range;
+	box_cell_range(box, &range);
+	if (cell_range_len(&range) > LARGE_NODE_CELLS) {
+		node->index.large = true;
+		wl_list_insert(&index->large, &node->index.large_link);
+		return;
+	}
+
+	for (int y = range.y1; y <= range.y2; y++) {
+		for (int x = range.x1; x <= range.x2; x++) {
+			if (!index_cell_add(index, x, y, node)) {
+				// Fall back to the large node list, which can't fail
+				wlr_log(WLR_ERROR, "Allocation failed");
+				scene_index_remove(index, node);
+				node->index.box = *box;
+				node->index.indexed = true;
+				node->index.large = true;
+				wl_list_insert(&index->large, &node->index.large_link);
+				return;
+			}
+		}
+	}
+}
+
+void scene_index_invalidate_order(struct scene_index *index) {
+	index->order_dirty = true;
+}
+
+static void index_assign_order(struct wlr_scene_node *node, uint32_t *order) {
+	node->index.order = (*order)++;
+
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &scene_tree->children, link) {
+			index_assign_order(child, order);
+		}
+	}
+}
+
+static void index_add_candidate(struct scene_index *index, struct wl_array *candidates,
+		struct wlr_scene_node *node, const struct wlr_box *box) {
+	if (node->index.query_seq == index->query_seq) {
+		return;
+	}
+	node->index.query_seq = index->query_seq;
+
+	struct wlr_box intersection;
+	if (!wlr_box_intersection(&intersection, &node->index.box, box)) {
+		return;
+	}
+
+	struct wlr_scene_node **ptr = wl_array_add(candidates, sizeof(*ptr));
+	if (ptr != NULL) {
+		*ptr = node;
+	}
+}
+
+static void index_add_cell_candidates(struct scene_index *index,
+		struct wl_array *candidates, struct scene_index_cell *cell,
+		const struct wlr_box *box) {
+	struct wlr_scene_node **node_ptr;
+	wl_array_for_each(node_ptr, &cell->nodes) {
+		index_add_candidate(index, candidates, *node_ptr, box);
+	}
+}
+
+static int compare_node_order_desc(const void *_a, const void *_b) {
+	const struct wlr_scene_node *a = *(struct wlr_scene_node *const *)_a;
+	const struct wlr_scene_node *b = *(struct wlr_scene_node *const *)_b;
+	if (a->index.order == b->index.order) {
+		return 0;
+	}
+	return a->index.order < b->index.order ? 1 : -1;
+}
+
+bool scene_index_nodes_in_box(struct scene_index *index,
+		struct wlr_scene_tree *root, const struct wlr_box *box,
+		scene_node_box_iterator_func_t iterator, void *user_data) {
+	if (wlr_box_empty(box)) {
+		return false;
+	}
+
+	if (index->order_dirty) {
+		uint32_t order = 0;
+		index_assign_order(&root->node, &order);
+		index->order_dirty = false;
+	}
+
+	// The iterator may trigger nested queries, only the outermost one can use
+	// the shared candidate array
+	struct wl_array nested_candidates;
+	struct wl_array *candidates = &index->candidates;
+	if (index->querying) {
+		wl_array_init(&nested_candidates);
+		candidates = &nested_candidates;
+	}
+	candidates->size = 0;
+
+	index->query_seq++;
+
+	struct wlr_scene_node *node;
+	wl_list_for_each(node, &index->large, index.large_link) {
+		index_add_candidate(index, candidates, node, box);
+	}
+
+	struct scene_index_cell_range range;
+	box_cell_range(box, &range);
+	if (cell_range_len(&range) > (int64_t)index->cells_len) {
+		// Cheaper to walk all populated cells than the requested range
+		for (size_t i = 0; i < index->buckets_len; i++) {
+			for (struct scene_index_cell *cell = index->buckets[i];
+					cell != NULL; cell = cell->next) {
+				if (cell->x >= range.x1 && cell->x <= range.x2 &&
+						cell->y >= range.y1 && cell->y <= range.y2) {
+					index_add_cell_candidates(index, candidates, cell, box);
+				}
+			}
+		}
+	} else {
+		for (int y = range.y1; y <= range.y2; y++) {
+			for (int x = range.x1; x <= range.x2; x++) {
+				struct scene_index_cell *cell = index_find_cell(index, x, y);
+				if (cell != NULL) {
+					index_add_cell_candidates(index, candidates, cell, box);
+				}
+			}
+		}
+	}
+
+	struct wlr_scene_node **nodes = candidates->data;
+	size_t nodes_len = candidates->size / sizeof(nodes[0]);
+	qsort(nodes, nodes_len, sizeof(nodes[0]), compare_node_order_desc);
+
+	bool was_querying = index->querying;
+	index->querying = true;
+
+	bool found = false;
+	for (size_t i = 0; i < nodes_len; i++) {
+		struct wlr_scene_node *node = nodes[i];
+		if (iterator(node, node->index.box.x, node->index.box.y, user_data)) {
+			found = true;
+			break;
+		}
+	}
+
+	index->querying = was_querying;
+	if (candidates != &index->candidates) {
+		wl_array_release(candidates);
+	}
+
+	return found;
+}
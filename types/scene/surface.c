@@ -3,6 +3,7 @@
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/types/wlr_scene.h>
 #include <wlr/types/wlr_fractional_scale_v1.h>
+#include <wlr/types/wlr_linux_drm_syncobj_v1.h>
 #include <wlr/types/wlr_presentation_time.h>
 #include <wlr/util/transform.h>
 #include "types/wlr_scene.h"
@@ -160,8 +161,18 @@ static void surface_reconfigure(struct wlr_scene_surface *scene_surface) {
 	if (surface->buffer) {
 		client_buffer_mark_next_can_damage(surface->buffer);
 
-		wlr_scene_buffer_set_buffer_with_damage(scene_buffer,
-			&surface->buffer->base, &surface->buffer_damage);
+		struct wlr_scene_buffer_set_buffer_options options = {
+			.damage = &surface->buffer_damage,
+		};
+		const struct wlr_linux_drm_syncobj_surface_v1_state *syncobj_state =
+			wlr_linux_drm_syncobj_v1_get_surface_state(surface);
+		if (syncobj_state != NULL) {
+			options.wait_timeline = syncobj_state->acquire_timeline;
+			options.wait_point = syncobj_state->acquire_point;
+		}
+
+		wlr_scene_buffer_set_buffer_with_options(scene_buffer,
+			&surface->buffer->base, &options);
 	} else {
 		wlr_scene_buffer_set_buffer(scene_buffer, NULL);
 	}
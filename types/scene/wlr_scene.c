@@ -1,13 +1,18 @@
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <errno.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <wlr/backend.h>
+#include <wlr/render/drm_syncobj.h>
 #include <wlr/render/swapchain.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/types/wlr_damage_ring.h>
 #include <wlr/types/wlr_linux_dmabuf_v1.h>
+#include <wlr/types/wlr_output_layer.h>
 #include <wlr/types/wlr_presentation_time.h>
 #include <wlr/types/wlr_scene.h>
 #include <wlr/util/log.h>
@@ -18,6 +23,7 @@
 #include "types/wlr_scene.h"
 #include "util/array.h"
 #include "util/env.h"
+#include "util/region.h"
 #include "util/time.h"
 
 #define HIGHLIGHT_DAMAGE_FADEOUT_TIME 250
@@ -56,6 +62,13 @@ struct wlr_scene *scene_node_get_root(struct wlr_scene_node *node) {
 	return scene;
 }
 
+static void scene_node_invalidate_order(struct wlr_scene_node *node) {
+	struct wlr_scene *scene = scene_node_get_root(node);
+	if (scene->index != NULL) {
+		scene_index_invalidate_order(scene->index);
+	}
+}
+
 static void scene_node_init(struct wlr_scene_node *node,
 		enum wlr_scene_node_type type, struct wlr_scene_tree *parent) {
 	*node = (struct wlr_scene_node){
@@ -71,6 +84,7 @@ static void scene_node_init(struct wlr_scene_node *node,
 
 	if (parent != NULL) {
 		wl_list_insert(parent->children.prev, &node->link);
+		scene_node_invalidate_order(&parent->node);
 	}
 
 	wlr_addon_set_init(&node->addons);
@@ -96,6 +110,10 @@ void wlr_scene_node_destroy(struct wlr_scene_node *node) {
 	wlr_scene_node_set_enabled(node, false);
 
 	struct wlr_scene *scene = scene_node_get_root(node);
+	if (scene->index != NULL && node->type != WLR_SCENE_NODE_TREE) {
+		scene_index_remove(scene->index, node);
+	}
+
 	if (node->type == WLR_SCENE_NODE_BUFFER) {
 		struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(node);
 
@@ -112,6 +130,7 @@ void wlr_scene_node_destroy(struct wlr_scene_node *node) {
 
 		wlr_texture_destroy(scene_buffer->texture);
 		wlr_buffer_unlock(scene_buffer->buffer);
+		wlr_drm_syncobj_timeline_unref(scene_buffer->wait_timeline);
 		pixman_region32_fini(&scene_buffer->opaque_region);
 	} else if (node->type == WLR_SCENE_NODE_TREE) {
 		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
@@ -134,6 +153,10 @@ void wlr_scene_node_destroy(struct wlr_scene_node *node) {
 				&scene_tree->children, link) {
 			wlr_scene_node_destroy(child);
 		}
+
+		if (scene_tree == &scene->tree) {
+			scene_index_destroy(scene->index);
+		}
 	}
 
 	wl_list_remove(&node->link);
@@ -171,6 +194,13 @@ struct wlr_scene *wlr_scene_create(void) {
 	scene->direct_scanout = !env_parse_bool("WLR_SCENE_DISABLE_DIRECT_SCANOUT");
 	scene->calculate_visibility = !env_parse_bool("WLR_SCENE_DISABLE_VISIBILITY");
 
+	if (!env_parse_bool("WLR_SCENE_DISABLE_SPATIAL_INDEX")) {
+		scene->index = scene_index_create();
+		if (scene->index == NULL) {
+			wlr_log(WLR_ERROR, "Failed to create scene spatial index");
+		}
+	}
+
 	return scene;
 }
 
@@ -188,9 +218,6 @@ struct wlr_scene_tree *wlr_scene_tree_create(struct wlr_scene_tree *parent) {
 
 static void scene_node_get_size(struct wlr_scene_node *node, int *lx, int *ly);
 
-typedef bool (*scene_node_box_iterator_func_t)(struct wlr_scene_node *node,
-	int sx, int sy, void *data);
-
 static bool _scene_nodes_in_box(struct wlr_scene_node *node, struct wlr_box *box,
 		scene_node_box_iterator_func_t iterator, void *user_data, int lx, int ly) {
 	if (!node->enabled) {
@@ -224,6 +251,19 @@ static bool _scene_nodes_in_box(struct wlr_scene_node *node, struct wlr_box *box
 
 static bool scene_nodes_in_box(struct wlr_scene_node *node, struct wlr_box *box,
 		scene_node_box_iterator_func_t iterator, void *user_data) {
+	// The spatial index covers the whole scene, so it can only answer queries
+	// made against the root node
+	if (node->parent == NULL) {
+		struct wlr_scene *scene = scene_node_get_root(node);
+		if (scene->index != NULL) {
+			if (!node->enabled) {
+				return false;
+			}
+			return scene_index_nodes_in_box(scene->index, &scene->tree,
+				box, iterator, user_data);
+		}
+	}
+
 	int x, y;
 	wlr_scene_node_coords(node, &x, &y);
 
@@ -270,23 +310,53 @@ struct scene_update_data {
 	bool calculate_visibility;
 };
 
-static uint32_t region_area(pixman_region32_t *region) {
+static uint32_t region_area_in_box(const pixman_region32_t *region,
+		const struct wlr_box *box) {
 	uint32_t area = 0;
 
 	int nrects;
-	pixman_box32_t *rects = pixman_region32_rectangles(region, &nrects);
+	const pixman_box32_t *rects = pixman_region32_rectangles(region, &nrects);
 	for (int i = 0; i < nrects; ++i) {
-		area += (rects[i].x2 - rects[i].x1) * (rects[i].y2 - rects[i].y1);
+		int x1 = rects[i].x1 > box->x ? rects[i].x1 : box->x;
+		int y1 = rects[i].y1 > box->y ? rects[i].y1 : box->y;
+		int x2 = rects[i].x2 < box->x + box->width ? rects[i].x2 : box->x + box->width;
+		int y2 = rects[i].y2 < box->y + box->height ? rects[i].y2 : box->y + box->height;
+		if (x1 < x2 && y1 < y2) {
+			area += (x2 - x1) * (y2 - y1);
+		}
 	}
 
 	return area;
 }
 
-static void scale_output_damage(pixman_region32_t *damage, float scale) {
-	wlr_region_scale(damage, damage, scale);
+static void scene_output_scratch_check(struct wlr_scene_output *scene_output,
+		size_t prev_alloc) {
+	if (scene_output->scratch.rects.alloc != prev_alloc) {
+		scene_output->scratch.growths++;
+	}
+}
+
+static void scene_output_region_scale_xy(struct wlr_scene_output *scene_output,
+		pixman_region32_t *dst, const pixman_region32_t *src,
+		float scale_x, float scale_y) {
+	size_t prev_alloc = scene_output->scratch.rects.alloc;
+	region_scale_xy(dst, src, scale_x, scale_y, &scene_output->scratch.rects);
+	scene_output_scratch_check(scene_output, prev_alloc);
+}
+
+static void scene_output_region_expand(struct wlr_scene_output *scene_output,
+		pixman_region32_t *dst, const pixman_region32_t *src, int distance) {
+	size_t prev_alloc = scene_output->scratch.rects.alloc;
+	region_expand(dst, src, distance, &scene_output->scratch.rects);
+	scene_output_scratch_check(scene_output, prev_alloc);
+}
+
+static void scale_output_damage(struct wlr_scene_output *scene_output,
+		pixman_region32_t *damage, float scale) {
+	scene_output_region_scale_xy(scene_output, damage, damage, scale, scale);
 
 	if (floor(scale) != scale) {
-		wlr_region_expand(damage, damage, 1);
+		scene_output_region_expand(scene_output, damage, damage, 1);
 	}
 }
 
@@ -299,12 +369,15 @@ struct render_data {
 	struct wlr_scene_output *output;
 
 	struct wlr_render_pass *render_pass;
-	pixman_region32_t damage;
+	pixman_region32_t *damage;
 };
 
 static void transform_output_damage(pixman_region32_t *damage, const struct render_data *data) {
 	enum wl_output_transform transform = wlr_output_transform_invert(data->transform);
-	wlr_region_transform(damage, damage, transform, data->trans_width, data->trans_height);
+	size_t prev_alloc = data->output->scratch.rects.alloc;
+	region_transform(damage, damage, transform, data->trans_width, data->trans_height,
+		&data->output->scratch.rects);
+	scene_output_scratch_check(data->output, prev_alloc);
 }
 
 static void transform_output_box(struct wlr_box *box, const struct render_data *data) {
@@ -319,16 +392,15 @@ static void scene_damage_outputs(struct wlr_scene *scene, pixman_region32_t *dam
 
 	struct wlr_scene_output *scene_output;
 	wl_list_for_each(scene_output, &scene->outputs, link) {
-		pixman_region32_t output_damage;
-		pixman_region32_init(&output_damage);
-		pixman_region32_copy(&output_damage, damage);
-		pixman_region32_translate(&output_damage,
+		pixman_region32_t *output_damage = &scene_output->scratch.damage;
+		pixman_region32_copy(output_damage, damage);
+		pixman_region32_translate(output_damage,
 			-scene_output->x, -scene_output->y);
-		scale_output_damage(&output_damage, scene_output->output->scale);
-		if (wlr_damage_ring_add(&scene_output->damage_ring, &output_damage)) {
+		scale_output_damage(scene_output, output_damage,
+			scene_output->output->scale);
+		if (wlr_damage_ring_add(&scene_output->damage_ring, output_damage)) {
 			wlr_output_schedule_frame(scene_output->output);
 		}
-		pixman_region32_fini(&output_damage);
 	}
 }
 
@@ -371,13 +443,8 @@ static void update_node_update_outputs(struct wlr_scene_node *node,
 		wlr_output_effective_resolution(scene_output->output,
 			&output_box.width, &output_box.height);
 
-		pixman_region32_t intersection;
-		pixman_region32_init(&intersection);
-		pixman_region32_intersect_rect(&intersection, &node->visible,
-			output_box.x, output_box.y, output_box.width, output_box.height);
-
-		if (pixman_region32_not_empty(&intersection)) {
-			uint32_t overlap = region_area(&intersection);
+		uint32_t overlap = region_area_in_box(&node->visible, &output_box);
+		if (overlap > 0) {
 			if (overlap >= largest_overlap) {
 				largest_overlap = overlap;
 				scene_buffer->primary_output = scene_output;
@@ -386,8 +453,6 @@ static void update_node_update_outputs(struct wlr_scene_node *node,
 			active_outputs |= 1ull << scene_output->index;
 			count++;
 		}
-
-		pixman_region32_fini(&intersection);
 	}
 
 	if (old_primary_output != scene_buffer->primary_output) {
@@ -528,12 +593,59 @@ static void scene_update_region(struct wlr_scene *scene,
 	scene_nodes_in_box(&scene->tree.node, &box, scene_node_update_iterator, &data);
 
 	pixman_region32_fini(&visible);
+
+	// Visibility only changes inside the update region, render lists of
+	// outputs which don't overlap it are still valid
+	struct wlr_scene_output *scene_output;
+	wl_list_for_each(scene_output, &scene->outputs, link) {
+		struct wlr_box intersection;
+		if (wlr_box_intersection(&intersection, &box,
+				&scene_output->render_list_box)) {
+			scene_output->render_list_dirty = true;
+		}
+	}
+}
+
+static void scene_node_update_index(struct scene_index *index,
+		struct wlr_scene_node *node, int lx, int ly, bool enabled) {
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		struct wlr_scene_tree *scene_tree = wlr_scene_tree_from_node(node);
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &scene_tree->children, link) {
+			scene_node_update_index(index, child, lx + child->x, ly + child->y,
+				enabled && child->enabled);
+		}
+		return;
+	}
+
+	if (!enabled) {
+		scene_index_remove(index, node);
+		return;
+	}
+
+	struct wlr_box box = { .x = lx, .y = ly };
+	scene_node_get_size(node, &box.width, &box.height);
+	scene_index_update(index, node, &box);
+}
+
+static void scene_node_reindex(struct wlr_scene *scene,
+		struct wlr_scene_node *node) {
+	if (scene->index == NULL) {
+		return;
+	}
+
+	int x, y;
+	bool enabled = wlr_scene_node_coords(node, &x, &y);
+	scene_node_update_index(scene->index, node, x, y, enabled);
 }
 
 static void scene_node_update(struct wlr_scene_node *node,
 		pixman_region32_t *damage) {
 	struct wlr_scene *scene = scene_node_get_root(node);
 
+	// The index must reflect the new geometry before visibility is updated
+	scene_node_reindex(scene, node);
+
 	int x, y;
 	if (!wlr_scene_node_coords(node, &x, &y)) {
 		if (damage) {
@@ -628,12 +740,89 @@ struct wlr_scene_buffer *wlr_scene_buffer_create(struct wlr_scene_tree *parent,
 	return scene_buffer;
 }
 
-void wlr_scene_buffer_set_buffer_with_damage(struct wlr_scene_buffer *scene_buffer,
-		struct wlr_buffer *buffer, const pixman_region32_t *damage) {
+/**
+ * Check whether a buffer node at the given layout coordinates exactly covers
+ * an output's logical box, without cropping nor transforming, as required by
+ * direct scan-out.
+ */
+static bool scene_buffer_covers_output(struct wlr_scene_buffer *scene_buffer,
+		int lx, int ly, const struct wlr_box *logical,
+		enum wl_output_transform transform) {
+	int default_width = scene_buffer->buffer->width;
+	int default_height = scene_buffer->buffer->height;
+	wlr_output_transform_coords(scene_buffer->transform,
+		&default_width, &default_height);
+	struct wlr_fbox default_box = {
+		.width = default_width,
+		.height = default_height,
+	};
+
+	if (!wlr_fbox_empty(&scene_buffer->src_box) &&
+			!wlr_fbox_equal(&scene_buffer->src_box, &default_box)) {
+		return false;
+	}
+
+	if (scene_buffer->transform != transform) {
+		return false;
+	}
+
+	struct wlr_box node_box = { .x = lx, .y = ly };
+	scene_node_get_size(&scene_buffer->node, &node_box.width, &node_box.height);
+
+	return wlr_box_equal(logical, &node_box);
+}
+
+/**
+ * Direct scan-out kicks in when a buffer covers a whole output. Import such
+ * buffers ahead of time, so that the first scanned out frame doesn't pay for
+ * it.
+ */
+static void scene_buffer_preimport(struct wlr_scene_buffer *scene_buffer) {
+	struct wlr_scene_output *scene_output = scene_buffer->primary_output;
+	if (scene_output == NULL || !scene_output->scene->direct_scanout) {
+		return;
+	}
+
+	int lx, ly;
+	if (!wlr_scene_node_coords(&scene_buffer->node, &lx, &ly)) {
+		return;
+	}
+
+	struct wlr_output *output = scene_output->output;
+	struct wlr_box logical = { .x = scene_output->x, .y = scene_output->y };
+	wlr_output_effective_resolution(output, &logical.width, &logical.height);
+	if (!scene_buffer_covers_output(scene_buffer, lx, ly, &logical,
+			output->transform)) {
+		return;
+	}
+
+	wlr_output_preimport_buffer(output, scene_buffer->buffer);
+}
+
+void wlr_scene_buffer_set_buffer_with_options(struct wlr_scene_buffer *scene_buffer,
+		struct wlr_buffer *buffer,
+		const struct wlr_scene_buffer_set_buffer_options *options) {
+	const struct wlr_scene_buffer_set_buffer_options default_options = {0};
+	if (options == NULL) {
+		options = &default_options;
+	}
+
+	const pixman_region32_t *damage = options->damage;
+
 	// specifying a region for a NULL buffer doesn't make sense. We need to know
 	// about the buffer to scale the buffer local coordinates down to scene
 	// coordinates.
 	assert(buffer || !damage);
+	assert(buffer || !options->wait_timeline);
+
+	wlr_drm_syncobj_timeline_unref(scene_buffer->wait_timeline);
+	scene_buffer->wait_timeline = NULL;
+	scene_buffer->wait_point = 0;
+	if (options->wait_timeline != NULL) {
+		scene_buffer->wait_timeline =
+			wlr_drm_syncobj_timeline_ref(options->wait_timeline);
+		scene_buffer->wait_point = options->wait_point;
+	}
 
 	bool update = false;
 
@@ -651,6 +840,9 @@ void wlr_scene_buffer_set_buffer_with_damage(struct wlr_scene_buffer *scene_buff
 
 		wlr_buffer_unlock(scene_buffer->buffer);
 		scene_buffer->buffer = wlr_buffer_lock(buffer);
+
+		scene_buffer_preimport(scene_buffer);
+		scene_buffer_pacing_handle_update(scene_buffer);
 	} else {
 		wlr_buffer_unlock(scene_buffer->buffer);
 		update = true;
@@ -664,6 +856,11 @@ void wlr_scene_buffer_set_buffer_with_damage(struct wlr_scene_buffer *scene_buff
 		return;
 	}
 
+	// The buffer size may still affect the node size if only one of the
+	// destination dimensions is set
+	scene_node_reindex(scene_node_get_root(&scene_buffer->node),
+		&scene_buffer->node);
+
 	int lx, ly;
 	if (!wlr_scene_node_coords(&scene_buffer->node, &lx, &ly)) {
 		return;
@@ -711,7 +908,7 @@ void wlr_scene_buffer_set_buffer_with_damage(struct wlr_scene_buffer *scene_buff
 		float output_scale_y = output_scale * scale_y;
 		pixman_region32_t output_damage;
 		pixman_region32_init(&output_damage);
-		wlr_region_scale_xy(&output_damage, &trans_damage,
+		scene_output_region_scale_xy(scene_output, &output_damage, &trans_damage,
 			output_scale_x, output_scale_y);
 
 		// One output pixel will match (buffer_scale_x)x(buffer_scale_y) buffer pixels.
@@ -730,16 +927,14 @@ void wlr_scene_buffer_set_buffer_with_damage(struct wlr_scene_buffer *scene_buff
 		int dist_y = floor(buffer_scale_y) != buffer_scale_y ?
 			(int)ceilf(output_scale_y / 2.0f) : 0;
 		// TODO: expand with per-axis distances
-		wlr_region_expand(&output_damage, &output_damage,
+		scene_output_region_expand(scene_output, &output_damage, &output_damage,
 			dist_x >= dist_y ? dist_x : dist_y);
 
-		pixman_region32_t cull_region;
-		pixman_region32_init(&cull_region);
-		pixman_region32_copy(&cull_region, &scene_buffer->node.visible);
-		scale_output_damage(&cull_region, output_scale);
-		pixman_region32_translate(&cull_region, -lx * output_scale, -ly * output_scale);
-		pixman_region32_intersect(&output_damage, &output_damage, &cull_region);
-		pixman_region32_fini(&cull_region);
+		pixman_region32_t *cull_region = &scene_output->scratch.damage;
+		pixman_region32_copy(cull_region, &scene_buffer->node.visible);
+		scale_output_damage(scene_output, cull_region, output_scale);
+		pixman_region32_translate(cull_region, -lx * output_scale, -ly * output_scale);
+		pixman_region32_intersect(&output_damage, &output_damage, cull_region);
 
 		pixman_region32_translate(&output_damage,
 			(int)round((lx - scene_output->x) * output_scale),
@@ -754,9 +949,17 @@ void wlr_scene_buffer_set_buffer_with_damage(struct wlr_scene_buffer *scene_buff
 	pixman_region32_fini(&fallback_damage);
 }
 
+void wlr_scene_buffer_set_buffer_with_damage(struct wlr_scene_buffer *scene_buffer,
+		struct wlr_buffer *buffer, const pixman_region32_t *damage) {
+	const struct wlr_scene_buffer_set_buffer_options options = {
+		.damage = damage,
+	};
+	wlr_scene_buffer_set_buffer_with_options(scene_buffer, buffer, &options);
+}
+
 void wlr_scene_buffer_set_buffer(struct wlr_scene_buffer *scene_buffer,
 		struct wlr_buffer *buffer)  {
-	wlr_scene_buffer_set_buffer_with_damage(scene_buffer, buffer, NULL);
+	wlr_scene_buffer_set_buffer_with_options(scene_buffer, buffer, NULL);
 }
 
 void wlr_scene_buffer_set_opaque_region(struct wlr_scene_buffer *scene_buffer,
@@ -935,6 +1138,7 @@ void wlr_scene_node_place_above(struct wlr_scene_node *node,
 
 	wl_list_remove(&node->link);
 	wl_list_insert(&sibling->link, &node->link);
+	scene_node_invalidate_order(node);
 	scene_node_update(node, NULL);
 }
 
@@ -949,6 +1153,7 @@ void wlr_scene_node_place_below(struct wlr_scene_node *node,
 
 	wl_list_remove(&node->link);
 	wl_list_insert(sibling->link.prev, &node->link);
+	scene_node_invalidate_order(node);
 	scene_node_update(node, NULL);
 }
 
@@ -994,6 +1199,7 @@ void wlr_scene_node_reparent(struct wlr_scene_node *node,
 	wl_list_remove(&node->link);
 	node->parent = new_parent;
 	wl_list_insert(new_parent->children.prev, &node->link);
+	scene_node_invalidate_order(node);
 	scene_node_update(node, &visible);
 }
 
@@ -1104,20 +1310,50 @@ struct wlr_scene_node *wlr_scene_node_at(struct wlr_scene_node *node,
 struct render_list_entry {
 	struct wlr_scene_node *node;
 	bool sent_dmabuf_feedback;
+	bool output_layer; // displayed by an accepted output layer
 	int x, y;
 };
 
+/**
+ * Block until a timeline point is signalled, for renderers which can't wait
+ * for it on the GPU.
+ */
+static bool scene_wait_timeline_cpu(struct wlr_drm_syncobj_timeline *timeline,
+		uint64_t point) {
+	bool signalled;
+	if (!wlr_drm_syncobj_timeline_check(timeline, point, 0, &signalled)) {
+		return false;
+	} else if (signalled) {
+		return true;
+	}
+
+	int sync_file_fd = wlr_drm_syncobj_timeline_export_sync_file(timeline, point);
+	if (sync_file_fd < 0) {
+		return false;
+	}
+
+	struct pollfd pollfd = { .fd = sync_file_fd, .events = POLLIN };
+	int ret;
+	do {
+		ret = poll(&pollfd, 1, -1);
+	} while (ret < 0 && errno == EINTR);
+	close(sync_file_fd);
+	if (ret < 0) {
+		wlr_log_errno(WLR_ERROR, "poll() failed");
+		return false;
+	}
+	return true;
+}
+
 static void scene_entry_render(struct render_list_entry *entry, const struct render_data *data) {
 	struct wlr_scene_node *node = entry->node;
 
-	pixman_region32_t render_region;
-	pixman_region32_init(&render_region);
-	pixman_region32_copy(&render_region, &node->visible);
-	pixman_region32_translate(&render_region, -data->logical.x, -data->logical.y);
-	scale_output_damage(&render_region, data->scale);
-	pixman_region32_intersect(&render_region, &render_region, &data->damage);
-	if (!pixman_region32_not_empty(&render_region)) {
-		pixman_region32_fini(&render_region);
+	pixman_region32_t *render_region = &data->output->scratch.render_region;
+	pixman_region32_copy(render_region, &node->visible);
+	pixman_region32_translate(render_region, -data->logical.x, -data->logical.y);
+	scale_output_damage(data->output, render_region, data->scale);
+	pixman_region32_intersect(render_region, render_region, data->damage);
+	if (!pixman_region32_not_empty(render_region)) {
 		return;
 	}
 
@@ -1128,14 +1364,14 @@ static void scene_entry_render(struct render_list_entry *entry, const struct ren
 	scene_node_get_size(node, &dst_box.width, &dst_box.height);
 	scale_box(&dst_box, data->scale);
 
-	pixman_region32_t opaque;
-	pixman_region32_init(&opaque);
-	scene_node_opaque_region(node, dst_box.x, dst_box.y, &opaque);
-	scale_output_damage(&opaque, data->scale);
-	pixman_region32_subtract(&opaque, &render_region, &opaque);
+	pixman_region32_t *opaque = &data->output->scratch.opaque;
+	pixman_region32_clear(opaque);
+	scene_node_opaque_region(node, dst_box.x, dst_box.y, opaque);
+	scale_output_damage(data->output, opaque, data->scale);
+	pixman_region32_subtract(opaque, render_region, opaque);
 
 	transform_output_box(&dst_box, data);
-	transform_output_damage(&render_region, data);
+	transform_output_damage(render_region, data);
 
 	switch (node->type) {
 	case WLR_SCENE_NODE_TREE:
@@ -1152,7 +1388,7 @@ static void scene_entry_render(struct render_list_entry *entry, const struct ren
 				.b = scene_rect->color[2],
 				.a = scene_rect->color[3],
 			},
-			.clip = &render_region,
+			.clip = render_region,
 		});
 		break;
 	case WLR_SCENE_NODE_BUFFER:;
@@ -1165,6 +1401,18 @@ static void scene_entry_render(struct render_list_entry *entry, const struct ren
 			break;
 		}
 
+		struct wlr_drm_syncobj_timeline *wait_timeline = NULL;
+		uint64_t wait_point = 0;
+		if (scene_buffer->wait_timeline != NULL) {
+			if (data->output->output->renderer->features.timeline) {
+				wait_timeline = scene_buffer->wait_timeline;
+				wait_point = scene_buffer->wait_point;
+			} else if (!scene_wait_timeline_cpu(scene_buffer->wait_timeline,
+					scene_buffer->wait_point)) {
+				break;
+			}
+		}
+
 		enum wl_output_transform transform =
 			wlr_output_transform_invert(scene_buffer->transform);
 		transform = wlr_output_transform_compose(transform, data->transform);
@@ -1174,11 +1422,13 @@ static void scene_entry_render(struct render_list_entry *entry, const struct ren
 			.src_box = scene_buffer->src_box,
 			.dst_box = dst_box,
 			.transform = transform,
-			.clip = &render_region,
+			.clip = render_region,
 			.alpha = &scene_buffer->opacity,
 			.filter_mode = scene_buffer->filter_mode,
-			.blend_mode = pixman_region32_not_empty(&opaque) ?
+			.blend_mode = pixman_region32_not_empty(opaque) ?
 				WLR_RENDER_BLEND_MODE_PREMULTIPLIED : WLR_RENDER_BLEND_MODE_NONE,
+			.wait_timeline = wait_timeline,
+			.wait_point = wait_point,
 		});
 
 		struct wlr_scene_output_sample_event sample_event = {
@@ -1188,9 +1438,6 @@ static void scene_entry_render(struct render_list_entry *entry, const struct ren
 		wl_signal_emit_mutable(&scene_buffer->events.output_sample, &sample_event);
 		break;
 	}
-
-	pixman_region32_fini(&opaque);
-	pixman_region32_fini(&render_region);
 }
 
 static void scene_handle_presentation_destroy(struct wl_listener *listener,
@@ -1255,6 +1502,7 @@ static void scene_node_output_update(struct wlr_scene_node *node,
 
 static void scene_output_update_geometry(struct wlr_scene_output *scene_output,
 		bool force_update) {
+	scene_output->render_list_dirty = true;
 	wlr_damage_ring_add_whole(&scene_output->damage_ring);
 	wlr_output_schedule_frame(scene_output->output);
 
@@ -1262,6 +1510,27 @@ static void scene_output_update_geometry(struct wlr_scene_output *scene_output,
 			&scene_output->scene->outputs, NULL, force_update ? scene_output : NULL);
 }
 
+static void scene_output_layer_set_buffer(struct scene_output_layer *layer,
+	struct wlr_scene_buffer *buffer);
+
+/**
+ * Make the layer assignment of a committed output state current. Only layers
+ * the backend accepted in that commit are considered displayed.
+ */
+static void scene_output_commit_layers(struct wlr_scene_output *scene_output) {
+	for (size_t i = 0; i < scene_output->layers_len; i++) {
+		struct scene_output_layer *layer = &scene_output->layers[i];
+		bool sent_feedback = layer->pending_feedback ||
+			(layer->sent_feedback && layer->buffer == layer->pending_buffer);
+		scene_output_layer_set_buffer(layer, layer->pending_buffer);
+		layer->node_box = layer->pending_node_box;
+		layer->accepted = layer->pending_buffer != NULL &&
+			scene_output->layer_states[i].accepted;
+		layer->sent_feedback = layer->pending_buffer != NULL && sent_feedback;
+		layer->pending_feedback = false;
+	}
+}
+
 static void scene_output_handle_commit(struct wl_listener *listener, void *data) {
 	struct wlr_scene_output *scene_output = wl_container_of(listener,
 		scene_output, output_commit);
@@ -1278,6 +1547,11 @@ static void scene_output_handle_commit(struct wl_listener *listener, void *data)
 		scene_output_update_geometry(scene_output, force_update);
 	}
 
+	if ((state->committed & WLR_OUTPUT_STATE_LAYERS) &&
+			state->layers == scene_output->layer_states) {
+		scene_output_commit_layers(scene_output);
+	}
+
 	// if the output has been committed with a certain damage, we know that region
 	// will be acknowledged by the backend so we don't need to keep track of it
 	// anymore
@@ -1322,6 +1596,13 @@ struct wlr_scene_output *wlr_scene_output_create(struct wlr_scene *scene,
 	pixman_region32_init(&scene_output->pending_commit_damage);
 	wl_list_init(&scene_output->damage_highlight_regions);
 
+	wl_array_init(&scene_output->scratch.rects);
+	pixman_region32_init(&scene_output->scratch.damage);
+	pixman_region32_init(&scene_output->scratch.render_damage);
+	pixman_region32_init(&scene_output->scratch.render_region);
+	pixman_region32_init(&scene_output->scratch.opaque);
+	pixman_region32_init(&scene_output->scratch.background);
+
 	int prev_output_index = -1;
 	struct wl_list *prev_output_link = &scene->outputs;
 
@@ -1341,6 +1622,8 @@ struct wlr_scene_output *wlr_scene_output_create(struct wlr_scene *scene,
 
 	wl_signal_init(&scene_output->events.destroy);
 
+	scene_output_pacing_init(scene_output);
+
 	scene_output->output_commit.notify = scene_output_handle_commit;
 	wl_signal_add(&output->events.commit, &scene_output->output_commit);
 
@@ -1355,6 +1638,8 @@ struct wlr_scene_output *wlr_scene_output_create(struct wlr_scene *scene,
 	return scene_output;
 }
 
+static void scene_output_destroy_layers(struct wlr_scene_output *scene_output);
+
 static void highlight_region_destroy(struct highlight_region *damage) {
 	wl_list_remove(&damage->link);
 	pixman_region32_fini(&damage->region);
@@ -1376,6 +1661,9 @@ void wlr_scene_output_destroy(struct wlr_scene_output *scene_output) {
 		highlight_region_destroy(damage);
 	}
 
+	scene_output_destroy_layers(scene_output);
+	scene_output_pacing_finish(scene_output);
+
 	wlr_addon_finish(&scene_output->addon);
 	wlr_damage_ring_finish(&scene_output->damage_ring);
 	pixman_region32_fini(&scene_output->pending_commit_damage);
@@ -1385,6 +1673,13 @@ void wlr_scene_output_destroy(struct wlr_scene_output *scene_output) {
 	wl_list_remove(&scene_output->output_needs_frame.link);
 
 	wl_array_release(&scene_output->render_list);
+	wl_array_release(&scene_output->scratch.rects);
+	pixman_region32_fini(&scene_output->scratch.damage);
+	pixman_region32_fini(&scene_output->scratch.render_damage);
+	pixman_region32_fini(&scene_output->scratch.render_region);
+	pixman_region32_fini(&scene_output->scratch.opaque);
+	pixman_region32_fini(&scene_output->scratch.background);
+	wlr_drm_syncobj_timeline_unref(scene_output->in_timeline);
 	free(scene_output);
 }
 
@@ -1412,6 +1707,142 @@ void wlr_scene_output_set_position(struct wlr_scene_output *scene_output,
 	scene_output_update_geometry(scene_output, false);
 }
 
+static void scene_output_layer_set_buffer(struct scene_output_layer *layer,
+		struct wlr_scene_buffer *buffer) {
+	if (layer->buffer == buffer) {
+		return;
+	}
+
+	wl_list_remove(&layer->buffer_destroy.link);
+	wl_list_init(&layer->buffer_destroy.link);
+	layer->buffer = buffer;
+	if (buffer != NULL) {
+		wl_signal_add(&buffer->node.events.destroy, &layer->buffer_destroy);
+	}
+}
+
+static void scene_output_layer_handle_buffer_destroy(struct wl_listener *listener,
+		void *data) {
+	struct scene_output_layer *layer =
+		wl_container_of(listener, layer, buffer_destroy);
+	scene_output_layer_set_buffer(layer, NULL);
+}
+
+static void scene_output_layer_set_pending_buffer(struct scene_output_layer *layer,
+		struct wlr_scene_buffer *buffer) {
+	layer->pending_feedback = false;
+	if (layer->pending_buffer == buffer) {
+		return;
+	}
+
+	wl_list_remove(&layer->pending_buffer_destroy.link);
+	wl_list_init(&layer->pending_buffer_destroy.link);
+	layer->pending_buffer = buffer;
+	if (buffer != NULL) {
+		wl_signal_add(&buffer->node.events.destroy, &layer->pending_buffer_destroy);
+	}
+}
+
+static void scene_output_layer_handle_pending_buffer_destroy(
+		struct wl_listener *listener, void *data) {
+	struct scene_output_layer *layer =
+		wl_container_of(listener, layer, pending_buffer_destroy);
+	scene_output_layer_set_pending_buffer(layer, NULL);
+}
+
+static void scene_buffer_send_dmabuf_feedback(const struct wlr_scene *scene,
+	struct wlr_scene_buffer *scene_buffer,
+	const struct wlr_linux_dmabuf_feedback_v1_init_options *options);
+
+static void scene_output_layer_handle_feedback(struct wl_listener *listener,
+		void *data) {
+	struct scene_output_layer *layer =
+		wl_container_of(listener, layer, layer_feedback);
+	const struct wlr_output_layer_feedback_event *event = data;
+	struct wlr_scene_output *scene_output = layer->scene_output;
+
+	// Emitted while the output state is being committed
+	if (layer->pending_buffer == NULL ||
+			layer->pending_buffer->primary_output != scene_output) {
+		return;
+	}
+	layer->pending_feedback = true;
+
+	struct wlr_linux_dmabuf_feedback_v1_init_options options = {
+		.main_renderer = scene_output->output->renderer,
+		.output_layer_feedback_event = event,
+	};
+	scene_buffer_send_dmabuf_feedback(scene_output->scene, layer->pending_buffer,
+		&options);
+}
+
+static void scene_output_destroy_layers(struct wlr_scene_output *scene_output) {
+	for (size_t i = 0; i < scene_output->layers_len; i++) {
+		struct scene_output_layer *layer = &scene_output->layers[i];
+		wl_list_remove(&layer->buffer_destroy.link);
+		wl_list_remove(&layer->pending_buffer_destroy.link);
+		wl_list_remove(&layer->layer_feedback.link);
+		wlr_output_layer_destroy(layer->layer);
+	}
+
+	free(scene_output->layers);
+	free(scene_output->layer_states);
+	scene_output->layers = NULL;
+	scene_output->layer_states = NULL;
+	scene_output->layers_len = 0;
+}
+
+void wlr_scene_output_set_max_layers(struct wlr_scene_output *scene_output,
+		size_t max_layers) {
+	if (scene_output->layers_len == max_layers) {
+		return;
+	}
+
+	bool had_accepted = false;
+	for (size_t i = 0; i < scene_output->layers_len; i++) {
+		had_accepted = had_accepted || scene_output->layers[i].accepted;
+	}
+	if (had_accepted) {
+		// The primary buffer may be stale below the layers
+		wlr_damage_ring_add_whole(&scene_output->damage_ring);
+		wlr_output_schedule_frame(scene_output->output);
+	}
+
+	scene_output_destroy_layers(scene_output);
+	if (max_layers == 0) {
+		return;
+	}
+
+	scene_output->layers = calloc(max_layers, sizeof(scene_output->layers[0]));
+	scene_output->layer_states =
+		calloc(max_layers, sizeof(scene_output->layer_states[0]));
+	if (scene_output->layers == NULL || scene_output->layer_states == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		scene_output_destroy_layers(scene_output);
+		return;
+	}
+
+	for (size_t i = 0; i < max_layers; i++) {
+		struct scene_output_layer *layer = &scene_output->layers[i];
+		layer->layer = wlr_output_layer_create(scene_output->output);
+		if (layer->layer == NULL) {
+			wlr_log(WLR_ERROR, "Failed to create output layer");
+			scene_output_destroy_layers(scene_output);
+			return;
+		}
+
+		layer->scene_output = scene_output;
+		wl_list_init(&layer->buffer_destroy.link);
+		layer->buffer_destroy.notify = scene_output_layer_handle_buffer_destroy;
+		wl_list_init(&layer->pending_buffer_destroy.link);
+		layer->pending_buffer_destroy.notify =
+			scene_output_layer_handle_pending_buffer_destroy;
+		layer->layer_feedback.notify = scene_output_layer_handle_feedback;
+		wl_signal_add(&layer->layer->events.feedback, &layer->layer_feedback);
+		scene_output->layers_len++;
+	}
+}
+
 static bool scene_node_invisible(struct wlr_scene_node *node) {
 	if (node->type == WLR_SCENE_NODE_TREE) {
 		return true;
@@ -1484,13 +1915,11 @@ static void output_state_apply_damage(const struct render_data *data,
 		struct wlr_output_state *state) {
 	struct wlr_scene_output *output = data->output;
 
-	pixman_region32_t frame_damage;
-	pixman_region32_init(&frame_damage);
-	pixman_region32_copy(&frame_damage, &output->damage_ring.current);
-	transform_output_damage(&frame_damage, data);
+	pixman_region32_t *frame_damage = &output->scratch.damage;
+	pixman_region32_copy(frame_damage, &output->damage_ring.current);
+	transform_output_damage(frame_damage, data);
 	pixman_region32_union(&output->pending_commit_damage,
-		&output->pending_commit_damage, &frame_damage);
-	pixman_region32_fini(&frame_damage);
+		&output->pending_commit_damage, frame_damage);
 
 	wlr_output_state_set_damage(state, &output->pending_commit_damage);
 }
@@ -1558,28 +1987,8 @@ static bool scene_entry_try_direct_scanout(struct render_list_entry *entry,
 	}
 
 	struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(node);
-
-	int default_width = buffer->buffer->width;
-	int default_height = buffer->buffer->height;
-	wlr_output_transform_coords(buffer->transform, &default_width, &default_height);
-	struct wlr_fbox default_box = {
-		.width = default_width,
-		.height = default_height,
-	};
-
-	if (!wlr_fbox_empty(&buffer->src_box) &&
-			!wlr_fbox_equal(&buffer->src_box, &default_box)) {
-		return false;
-	}
-
-	if (buffer->transform != data->transform) {
-		return false;
-	}
-
-	struct wlr_box node_box = { .x = entry->x, .y = entry->y };
-	scene_node_get_size(node, &node_box.width, &node_box.height);
-
-	if (!wlr_box_equal(&data->logical, &node_box)) {
+	if (!scene_buffer_covers_output(buffer, entry->x, entry->y,
+			&data->logical, data->transform)) {
 		return false;
 	}
 
@@ -1600,6 +2009,10 @@ static bool scene_entry_try_direct_scanout(struct render_list_entry *entry,
 	}
 
 	wlr_output_state_set_buffer(&pending, buffer->buffer);
+	if (buffer->wait_timeline != NULL) {
+		wlr_output_state_set_wait_timeline(&pending,
+			buffer->wait_timeline, buffer->wait_point);
+	}
 
 	if (!wlr_output_test_state(scene_output->output, &pending)) {
 		wlr_output_state_finish(&pending);
@@ -1617,6 +2030,237 @@ static bool scene_entry_try_direct_scanout(struct render_list_entry *entry,
 	return true;
 }
 
+static bool scene_entry_get_layer_box(struct render_list_entry *entry,
+		const struct render_data *data, struct wlr_box *dst_box) {
+	struct wlr_scene_node *node = entry->node;
+	if (node->type != WLR_SCENE_NODE_BUFFER) {
+		return false;
+	}
+
+	// Output layers can't blend nor transform buffers, nor wait for
+	// timeline points
+	struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(node);
+	if (scene_buffer->opacity != 1 ||
+			scene_buffer->transform != data->transform ||
+			scene_buffer->wait_timeline != NULL) {
+		return false;
+	}
+
+	struct wlr_box node_box = { .x = entry->x, .y = entry->y };
+	scene_node_get_size(node, &node_box.width, &node_box.height);
+
+	// Output layers can't be clipped either, so the whole buffer must be
+	// visible on this output
+	struct wlr_box intersection;
+	if (!wlr_box_intersection(&intersection, &node_box, &data->logical) ||
+			!wlr_box_equal(&intersection, &node_box)) {
+		return false;
+	}
+
+	pixman_box32_t node_rect = {
+		.x1 = node_box.x,
+		.y1 = node_box.y,
+		.x2 = node_box.x + node_box.width,
+		.y2 = node_box.y + node_box.height,
+	};
+	if (pixman_region32_contains_rectangle(&node->visible, &node_rect) !=
+			PIXMAN_REGION_IN) {
+		return false;
+	}
+
+	*dst_box = (struct wlr_box){
+		.x = node_box.x - data->logical.x,
+		.y = node_box.y - data->logical.y,
+		.width = node_box.width,
+		.height = node_box.height,
+	};
+	scale_box(dst_box, data->scale);
+	transform_output_box(dst_box, data);
+	return true;
+}
+
+static void scene_output_try_layers(struct wlr_scene_output *scene_output,
+		struct wlr_output_state *state, const struct render_data *data,
+		struct render_list_entry *list_data, int list_len) {
+	struct wlr_output *output = scene_output->output;
+
+	if (scene_output->scene->debug_damage_option ==
+			WLR_SCENE_DEBUG_DAMAGE_HIGHLIGHT) {
+		return;
+	}
+	if (state->committed & (WLR_OUTPUT_STATE_MODE |
+			WLR_OUTPUT_STATE_ENABLED |
+			WLR_OUTPUT_STATE_RENDER_FORMAT)) {
+		return;
+	}
+	if (!wlr_output_is_direct_scanout_allowed(output)) {
+		return;
+	}
+
+	// Output layers are stacked on top of the primary buffer, so only a run
+	// of top-most entries can be offloaded. Layers are ordered from bottom to
+	// top in the state, unused layers are left at the bottom.
+	size_t layers_len = scene_output->layers_len;
+	size_t candidates_len = 0;
+	while (candidates_len < layers_len && (int)candidates_len < list_len) {
+		struct render_list_entry *entry = &list_data[candidates_len];
+		struct wlr_box dst_box;
+		if (!scene_entry_get_layer_box(entry, data, &dst_box)) {
+			break;
+		}
+
+		size_t i = layers_len - 1 - candidates_len;
+		struct scene_output_layer *layer = &scene_output->layers[i];
+		struct wlr_scene_buffer *scene_buffer =
+			wlr_scene_buffer_from_node(entry->node);
+
+		scene_output_layer_set_pending_buffer(layer, scene_buffer);
+		layer->pending_node_box = (struct wlr_box){ .x = entry->x, .y = entry->y };
+		scene_node_get_size(entry->node, &layer->pending_node_box.width,
+			&layer->pending_node_box.height);
+
+		scene_output->layer_states[i].buffer = scene_buffer->buffer;
+		scene_output->layer_states[i].src_box = scene_buffer->src_box;
+		scene_output->layer_states[i].dst_box = dst_box;
+
+		candidates_len++;
+	}
+
+	if (candidates_len == 0) {
+		return;
+	}
+
+	bool ok = wlr_output_test_state(output, state);
+
+	// Rejected layers are composited into the primary buffer, below all
+	// layers: accepted layers under a rejected one would be displayed on top
+	// of it. Disable them and test again.
+	bool demoted = false, rejected = false;
+	for (size_t i = layers_len; ok && i-- > layers_len - candidates_len;) {
+		struct wlr_output_layer_state *layer_state = &scene_output->layer_states[i];
+		if (!layer_state->accepted) {
+			rejected = true;
+		} else if (rejected) {
+			layer_state->buffer = NULL;
+			scene_output_layer_set_pending_buffer(&scene_output->layers[i], NULL);
+			demoted = true;
+		}
+	}
+	if (ok && demoted) {
+		ok = wlr_output_test_state(output, state);
+
+		rejected = false;
+		for (size_t i = layers_len; ok && i-- > layers_len - candidates_len;) {
+			struct wlr_output_layer_state *layer_state =
+				&scene_output->layer_states[i];
+			if (layer_state->buffer == NULL) {
+				continue;
+			}
+			if (!layer_state->accepted) {
+				rejected = true;
+			} else if (rejected) {
+				ok = false;
+			}
+		}
+	}
+
+	if (!ok) {
+		for (size_t i = 0; i < layers_len; i++) {
+			scene_output_layer_set_pending_buffer(&scene_output->layers[i], NULL);
+			scene_output->layer_states[i] = (struct wlr_output_layer_state){
+				.layer = scene_output->layers[i].layer,
+			};
+		}
+		return;
+	}
+
+	for (size_t i = layers_len - candidates_len; i < layers_len; i++) {
+		struct wlr_output_layer_state *layer_state = &scene_output->layer_states[i];
+		if (layer_state->buffer == NULL) {
+			continue;
+		}
+
+		struct render_list_entry *entry = &list_data[layers_len - 1 - i];
+		struct wlr_scene_buffer *scene_buffer =
+			wlr_scene_buffer_from_node(entry->node);
+
+		if (!layer_state->accepted) {
+			// Don't override feedback the backend already sent for this
+			// layer on a previous commit with the composition feedback
+			struct scene_output_layer *layer = &scene_output->layers[i];
+			entry->sent_dmabuf_feedback =
+				layer->buffer == scene_buffer && layer->sent_feedback;
+			continue;
+		}
+
+		entry->output_layer = true;
+
+		struct wlr_scene_output_sample_event sample_event = {
+			.output = scene_output,
+			.direct_scanout = true,
+		};
+		wl_signal_emit_mutable(&scene_buffer->events.output_sample, &sample_event);
+	}
+}
+
+static bool scene_output_layers_has_accepted(struct wlr_scene_output *scene_output,
+		struct wlr_scene_buffer *scene_buffer, bool pending) {
+	for (size_t i = 0; i < scene_output->layers_len; i++) {
+		struct scene_output_layer *layer = &scene_output->layers[i];
+		if (pending) {
+			if (layer->pending_buffer == scene_buffer &&
+					scene_output->layer_states[i].accepted) {
+				return true;
+			}
+		} else if (layer->buffer == scene_buffer && layer->accepted) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool scene_output_layer_damage(struct wlr_scene_output *scene_output,
+		const struct wlr_box *box, float scale) {
+	pixman_region32_t *damage = &scene_output->scratch.damage;
+	pixman_region32_clear(damage);
+	pixman_region32_union_rect(damage, damage, box->x - scene_output->x,
+		box->y - scene_output->y, box->width, box->height);
+	scale_output_damage(scene_output, damage, scale);
+	return wlr_damage_ring_add(&scene_output->damage_ring, damage);
+}
+
+/**
+ * Damage buffers entering or leaving output layers with the pending layer
+ * assignment: the primary buffer is stale below accepted layers, and buffers
+ * entering a layer must not be painted twice.
+ *
+ * Returns true if damage was added.
+ */
+static bool scene_output_damage_layers(struct wlr_scene_output *scene_output,
+		float scale) {
+	bool damaged = false;
+	for (size_t i = 0; i < scene_output->layers_len; i++) {
+		struct scene_output_layer *layer = &scene_output->layers[i];
+		if (layer->buffer != NULL && layer->accepted &&
+				!scene_output_layers_has_accepted(scene_output, layer->buffer, true)) {
+			damaged |= scene_output_layer_damage(scene_output, &layer->node_box, scale);
+		}
+	}
+
+	for (size_t i = 0; i < scene_output->layers_len; i++) {
+		struct scene_output_layer *layer = &scene_output->layers[i];
+		bool accepted = layer->pending_buffer != NULL &&
+			scene_output->layer_states[i].accepted;
+		if (accepted && !scene_output_layers_has_accepted(scene_output,
+				layer->pending_buffer, false)) {
+			damaged |= scene_output_layer_damage(scene_output,
+				&layer->pending_node_box, scale);
+		}
+	}
+
+	return damaged;
+}
+
 bool wlr_scene_output_commit(struct wlr_scene_output *scene_output,
 		const struct wlr_scene_output_state_options *options) {
 	if (!scene_output->output->needs_frame && !pixman_region32_not_empty(
@@ -1624,6 +2268,11 @@ bool wlr_scene_output_commit(struct wlr_scene_output *scene_output,
 		return true;
 	}
 
+	if (scene_output_pacing_defer(scene_output)) {
+		// A frame will be scheduled when the commit is due
+		return true;
+	}
+
 	bool ok = false;
 	struct wlr_output_state state;
 	wlr_output_state_init(&state);
@@ -1641,6 +2290,56 @@ out:
 	return ok;
 }
 
+static struct wlr_scene_buffer *render_list_find_largest_buffer(
+		struct render_list_entry *list_data, int list_len,
+		const struct wlr_box *box) {
+	struct wlr_scene_buffer *largest = NULL;
+	int64_t largest_area = 0;
+	for (int i = 0; i < list_len; i++) {
+		struct wlr_scene_node *node = list_data[i].node;
+		if (node->type != WLR_SCENE_NODE_BUFFER) {
+			continue;
+		}
+
+		const pixman_box32_t *extents = pixman_region32_extents(&node->visible);
+		int x1 = extents->x1 > box->x ? extents->x1 : box->x;
+		int y1 = extents->y1 > box->y ? extents->y1 : box->y;
+		int x2 = extents->x2 < box->x + box->width ?
+			extents->x2 : box->x + box->width;
+		int y2 = extents->y2 < box->y + box->height ?
+			extents->y2 : box->y + box->height;
+		if (x2 <= x1 || y2 <= y1) {
+			continue;
+		}
+
+		int64_t area = (int64_t)(x2 - x1) * (y2 - y1);
+		if (area > largest_area) {
+			largest = wlr_scene_buffer_from_node(node);
+			largest_area = area;
+		}
+	}
+	return largest;
+}
+
+static struct wlr_drm_syncobj_timeline *scene_output_get_in_timeline(
+		struct wlr_scene_output *scene_output) {
+	struct wlr_output *output = scene_output->output;
+	if (!output->backend->features.timeline ||
+			!output->renderer->features.timeline) {
+		return NULL;
+	}
+
+	if (scene_output->in_timeline == NULL) {
+		int drm_fd = wlr_backend_get_drm_fd(output->backend);
+		if (drm_fd < 0) {
+			return NULL;
+		}
+		scene_output->in_timeline = wlr_drm_syncobj_timeline_create(drm_fd);
+	}
+
+	return scene_output->in_timeline;
+}
+
 bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 		struct wlr_output_state *state, const struct wlr_scene_output_state_options *options) {
 	struct wlr_scene_output_state_options default_options = {0};
@@ -1649,6 +2348,7 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 	}
 	struct wlr_scene_timer *timer = options->timer;
 	struct timespec start_time;
+	size_t start_growths = scene_output->scratch.growths;
 	if (timer) {
 		clock_gettime(CLOCK_MONOTONIC, &start_time);
 		wlr_scene_timer_finish(timer);
@@ -1661,6 +2361,7 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 	}
 
 	struct wlr_output *output = scene_output->output;
+	output_trace(output, WLR_OUTPUT_TRACE_BUILD_STATE_BEGIN);
 	enum wlr_scene_debug_damage_option debug_damage =
 		scene_output->scene->debug_damage_option;
 
@@ -1696,19 +2397,54 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 	render_data.logical.width = render_data.trans_width / render_data.scale;
 	render_data.logical.height = render_data.trans_height / render_data.scale;
 
-	struct render_list_constructor_data list_con = {
-		.box = render_data.logical,
-		.render_list = &scene_output->render_list,
-		.calculate_visibility = scene_output->scene->calculate_visibility,
-	};
+	if (scene_output->render_list_dirty ||
+			!wlr_box_equal(&scene_output->render_list_box, &render_data.logical)) {
+		struct render_list_constructor_data list_con = {
+			.box = render_data.logical,
+			.render_list = &scene_output->render_list,
+			.calculate_visibility = scene_output->scene->calculate_visibility,
+		};
+
+		size_t prev_alloc = list_con.render_list->alloc;
+		list_con.render_list->size = 0;
+		scene_nodes_in_box(&scene_output->scene->tree.node, &list_con.box,
+			construct_render_list_iterator, &list_con);
+		array_realloc(list_con.render_list, list_con.render_list->size);
+		if (list_con.render_list->alloc != prev_alloc) {
+			scene_output->scratch.growths++;
+		}
 
-	list_con.render_list->size = 0;
-	scene_nodes_in_box(&scene_output->scene->tree.node, &list_con.box,
-		construct_render_list_iterator, &list_con);
-	array_realloc(list_con.render_list, list_con.render_list->size);
+		scene_output->render_list_box = render_data.logical;
+		scene_output->render_list_dirty = false;
+	}
+
+	struct render_list_entry *list_data = scene_output->render_list.data;
+	int list_len = scene_output->render_list.size / sizeof(*list_data);
 
-	struct render_list_entry *list_data = list_con.render_list->data;
-	int list_len = list_con.render_list->size / sizeof(*list_data);
+	if (scene_output->pacing.max_interval != 0) {
+		scene_output_pacing_set_content(scene_output,
+			render_list_find_largest_buffer(list_data, list_len,
+				&render_data.logical));
+	}
+
+	// Per-frame state of entries reused from a previous frame
+	for (int i = 0; i < list_len; i++) {
+		list_data[i].sent_dmabuf_feedback = false;
+		list_data[i].output_layer = false;
+	}
+
+	// Disable all layers by default, so that they don't stay displayed on
+	// top of a direct scan-out buffer
+	if (scene_output->layers_len > 0) {
+		for (size_t i = 0; i < scene_output->layers_len; i++) {
+			scene_output_layer_set_pending_buffer(&scene_output->layers[i], NULL);
+			scene_output->layer_states[i] = (struct wlr_output_layer_state){
+				.layer = scene_output->layers[i].layer,
+			};
+		}
+		wlr_output_state_set_layers(state, scene_output->layer_states,
+			scene_output->layers_len);
+	}
 
 	if (debug_damage == WLR_SCENE_DEBUG_DAMAGE_RERENDER) {
 		wlr_damage_ring_add_whole(&scene_output->damage_ring);
@@ -1725,13 +2461,25 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 			scanout ? "enabled" : "disabled");
 	}
 
+	if (scene_output->layers_len > 0) {
+		if (!scanout) {
+			scene_output_try_layers(scene_output, state, &render_data,
+				list_data, list_len);
+		}
+		if (scene_output_damage_layers(scene_output, render_data.scale)) {
+			output_state_apply_damage(&render_data, state);
+		}
+	}
+
 	if (scanout) {
 		if (timer) {
 			struct timespec end_time, duration;
 			clock_gettime(CLOCK_MONOTONIC, &end_time);
 			timespec_sub(&duration, &end_time, &start_time);
 			timer->pre_render_duration = timespec_to_nsec(&duration);
+			timer->scratch_growths = scene_output->scratch.growths - start_growths;
 		}
+		output_trace(output, WLR_OUTPUT_TRACE_BUILD_STATE_END);
 		return true;
 	}
 
@@ -1743,6 +2491,7 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 		// add the current frame's damage if there is damage
 		if (pixman_region32_not_empty(&scene_output->damage_ring.current)) {
 			struct highlight_region *current_damage = calloc(1, sizeof(*current_damage));
+			scene_output->scratch.growths++;
 			if (current_damage) {
 				pixman_region32_init(&current_damage->region);
 				pixman_region32_copy(&current_damage->region,
@@ -1794,9 +2543,17 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 		timer->pre_render_duration = timespec_to_nsec(&duration);
 	}
 
+	// Let KMS wait for rendering to complete instead of blocking
+	struct wlr_drm_syncobj_timeline *in_timeline =
+		scene_output_get_in_timeline(scene_output);
+	uint64_t in_point = in_timeline != NULL ? ++scene_output->in_point : 0;
+
+	output_trace(output, WLR_OUTPUT_TRACE_RENDER_BEGIN);
 	struct wlr_render_pass *render_pass = wlr_renderer_begin_buffer_pass(output->renderer, buffer,
 			&(struct wlr_buffer_pass_options){
 		.timer = timer ? timer->render_timer : NULL,
+		.signal_timeline = in_timeline,
+		.signal_point = in_point,
 	});
 	if (render_pass == NULL) {
 		wlr_buffer_unlock(buffer);
@@ -1805,13 +2562,31 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 
 	render_data.render_pass = render_pass;
 
-	pixman_region32_init(&render_data.damage);
+	render_data.damage = &scene_output->scratch.render_damage;
 	wlr_damage_ring_rotate_buffer(&scene_output->damage_ring, buffer,
-		&render_data.damage);
+		render_data.damage);
+
+	// Nothing needs to be painted below opaque output layers. The area will
+	// be damaged again when the layer goes away.
+	if (floor(render_data.scale) == render_data.scale) {
+		for (int i = 0; i < list_len; i++) {
+			struct render_list_entry *entry = &list_data[i];
+			if (!entry->output_layer) {
+				continue;
+			}
+
+			pixman_region32_t *opaque = &scene_output->scratch.opaque;
+			pixman_region32_clear(opaque);
+			scene_node_opaque_region(entry->node, entry->x, entry->y, opaque);
+			pixman_region32_translate(opaque, -scene_output->x, -scene_output->y);
+			scene_output_region_scale_xy(scene_output, opaque, opaque,
+				render_data.scale, render_data.scale);
+			pixman_region32_subtract(render_data.damage, render_data.damage, opaque);
+		}
+	}
 
-	pixman_region32_t background;
-	pixman_region32_init(&background);
-	pixman_region32_copy(&background, &render_data.damage);
+	pixman_region32_t *background = &scene_output->scratch.background;
+	pixman_region32_copy(background, render_data.damage);
 
 	// Cull areas of the background that are occluded by opaque regions of
 	// scene nodes above. Those scene nodes will just render atop having us
@@ -1825,36 +2600,39 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 			// that may have been omitted from the render list via the black
 			// rect optimization. In order to ensure we don't cull background
 			// rendering in that black rect region, consider the node's visibility.
-			pixman_region32_t opaque;
-			pixman_region32_init(&opaque);
-			scene_node_opaque_region(entry->node, entry->x, entry->y, &opaque);
-			pixman_region32_intersect(&opaque, &opaque, &entry->node->visible);
-
-			pixman_region32_translate(&opaque, -scene_output->x, -scene_output->y);
-			wlr_region_scale(&opaque, &opaque, render_data.scale);
-			pixman_region32_subtract(&background, &background, &opaque);
-			pixman_region32_fini(&opaque);
+			pixman_region32_t *opaque = &scene_output->scratch.opaque;
+			pixman_region32_clear(opaque);
+			scene_node_opaque_region(entry->node, entry->x, entry->y, opaque);
+			pixman_region32_intersect(opaque, opaque, &entry->node->visible);
+
+			pixman_region32_translate(opaque, -scene_output->x, -scene_output->y);
+			scene_output_region_scale_xy(scene_output, opaque, opaque,
+				render_data.scale, render_data.scale);
+			pixman_region32_subtract(background, background, opaque);
 		}
 
 		if (floor(render_data.scale) != render_data.scale) {
-			wlr_region_expand(&background, &background, 1);
+			scene_output_region_expand(scene_output, background, background, 1);
 
 			// reintersect with the damage because we never want to render
 			// outside of the damage region
-			pixman_region32_intersect(&background, &background, &render_data.damage);
+			pixman_region32_intersect(background, background, render_data.damage);
 		}
 	}
 
-	transform_output_damage(&background, &render_data);
+	transform_output_damage(background, &render_data);
 	wlr_render_pass_add_rect(render_pass, &(struct wlr_render_rect_options){
 		.box = { .width = buffer->width, .height = buffer->height },
 		.color = { .r = 0, .g = 0, .b = 0, .a = 1 },
-		.clip = &background,
+		.clip = background,
 	});
-	pixman_region32_fini(&background);
 
 	for (int i = list_len - 1; i >= 0; i--) {
 		struct render_list_entry *entry = &list_data[i];
+		if (entry->output_layer) {
+			continue;
+		}
+
 		scene_entry_render(entry, &render_data);
 
 		if (entry->node->type == WLR_SCENE_NODE_BUFFER) {
@@ -1887,9 +2665,7 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 		}
 	}
 
-	wlr_output_add_software_cursors_to_render_pass(output, render_pass, &render_data.damage);
-
-	pixman_region32_fini(&render_data.damage);
+	wlr_output_add_software_cursors_to_render_pass(output, render_pass, render_data.damage);
 
 	if (!wlr_render_pass_submit(render_pass)) {
 		wlr_buffer_unlock(buffer);
@@ -1903,11 +2679,20 @@ bool wlr_scene_output_build_state(struct wlr_scene_output *scene_output,
 	wlr_output_state_set_buffer(state, buffer);
 	wlr_buffer_unlock(buffer);
 
+	if (in_timeline != NULL) {
+		wlr_output_state_set_wait_timeline(state, in_timeline, in_point);
+	}
+
+	if (timer) {
+		timer->scratch_growths = scene_output->scratch.growths - start_growths;
+	}
+
 	if (debug_damage == WLR_SCENE_DEBUG_DAMAGE_HIGHLIGHT &&
 			!wl_list_empty(&scene_output->damage_highlight_regions)) {
 		wlr_output_schedule_frame(scene_output->output);
 	}
 
+	output_trace(output, WLR_OUTPUT_TRACE_BUILD_STATE_END);
 	return true;
 }
 
@@ -9,6 +9,7 @@
 #include <wlr/types/wlr_seat.h>
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/util/log.h>
+#include "types/wlr_keyboard.h"
 #include "types/wlr_seat.h"
 #include "util/global.h"
 
@@ -106,6 +107,8 @@ static void seat_client_destroy(struct wlr_seat_client *client) {
 		wl_resource_set_user_data(resource, NULL);
 	}
 
+	shared_keymap_unref(client->sent_keymap);
+
 	wl_list_remove(&client->link);
 	free(client);
 }
@@ -216,6 +219,7 @@ void wlr_seat_destroy(struct wlr_seat *seat) {
 		return;
 	}
 
+	wlr_seat_pointer_set_motion_coalescing(seat, false, 0);
 	wlr_seat_pointer_clear_focus(seat);
 	wlr_seat_keyboard_clear_focus(seat);
 
@@ -273,6 +277,7 @@ struct wlr_seat *wlr_seat_create(struct wl_display *display, const char *name) {
 	seat->pointer_state.grab = pointer_grab;
 
 	wl_signal_init(&seat->pointer_state.events.focus_change);
+	wl_signal_init(&seat->pointer_state.events.motion_flush);
 
 	// keyboard state
 	struct wlr_seat_keyboard_grab *keyboard_grab = calloc(1, sizeof(*keyboard_grab));
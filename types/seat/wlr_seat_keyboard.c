@@ -9,6 +9,7 @@
 #include <wlr/types/wlr_data_device.h>
 #include <wlr/util/log.h>
 #include "types/wlr_data_device.h"
+#include "types/wlr_keyboard.h"
 #include "types/wlr_seat.h"
 
 static void default_keyboard_enter(struct wlr_seat_keyboard_grab *grab,
@@ -331,17 +332,38 @@ void wlr_seat_keyboard_notify_modifiers(struct wlr_seat *seat,
 void wlr_seat_keyboard_notify_key(struct wlr_seat *seat, uint32_t time,
 		uint32_t key, uint32_t state) {
 	clock_gettime(CLOCK_MONOTONIC, &seat->last_event);
+	if (seat->latency_tracker != NULL) {
+		input_latency_tracker_handle_input(seat->latency_tracker,
+			seat->keyboard_state.focused_surface, time);
+	}
 	struct wlr_seat_keyboard_grab *grab = seat->keyboard_state.grab;
 	grab->interface->key(grab, time, key, state);
 }
 
 
-static void seat_client_send_keymap(struct wlr_seat_client *client,
-		struct wlr_keyboard *keyboard) {
+/**
+ * Send the keymap of a keyboard to the client's keyboard resources.
+ * new_resource is a keyboard resource which hasn't received any keymap yet,
+ * or NULL.
+ */
+static void seat_client_send_keymap_to(struct wlr_seat_client *client,
+		struct wlr_keyboard *keyboard, struct wl_resource *new_resource) {
 	if (!keyboard) {
 		return;
 	}
 
+	// Keyboards with identical keymaps share the same wlr_shared_keymap:
+	// switching between them doesn't require a new keymap
+	if (keyboard->shared_keymap != NULL &&
+			keyboard->shared_keymap == client->sent_keymap) {
+		if (new_resource != NULL) {
+			wl_keyboard_send_keymap(new_resource,
+				WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1, keyboard->keymap_fd,
+				keyboard->keymap_size);
+		}
+		return;
+	}
+
 	enum wl_keyboard_keymap_format format;
 	int fd, devnull = -1;
 	uint32_t size;
@@ -371,11 +393,22 @@ static void seat_client_send_keymap(struct wlr_seat_client *client,
 		wl_keyboard_send_keymap(resource, format, fd, size);
 	}
 
+	shared_keymap_unref(client->sent_keymap);
+	client->sent_keymap = NULL;
+	if (keyboard->shared_keymap != NULL) {
+		client->sent_keymap = shared_keymap_ref(keyboard->shared_keymap);
+	}
+
 	if (devnull >= 0) {
 		close(devnull);
 	}
 }
 
+static void seat_client_send_keymap(struct wlr_seat_client *client,
+		struct wlr_keyboard *keyboard) {
+	seat_client_send_keymap_to(client, keyboard, NULL);
+}
+
 static void seat_client_send_repeat_info(struct wlr_seat_client *client,
 		struct wlr_keyboard *keyboard) {
 	if (!keyboard) {
@@ -417,7 +450,7 @@ void seat_client_create_keyboard(struct wlr_seat_client *seat_client,
 	if (keyboard == NULL) {
 		return;
 	}
-	seat_client_send_keymap(seat_client, keyboard);
+	seat_client_send_keymap_to(seat_client, keyboard, resource);
 	seat_client_send_repeat_info(seat_client, keyboard);
 
 	struct wlr_seat_client *focused_client =
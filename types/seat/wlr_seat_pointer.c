@@ -8,6 +8,13 @@
 #include <wlr/util/log.h>
 #include "types/wlr_seat.h"
 #include "util/set.h"
+#include "util/time.h"
+
+static int64_t get_current_time_nsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return timespec_to_nsec(&now);
+}
 
 static void default_pointer_enter(struct wlr_seat_pointer_grab *grab,
 		struct wlr_surface *surface, double sx, double sy) {
@@ -164,6 +171,8 @@ void wlr_seat_pointer_enter(struct wlr_seat *wlr_seat,
 		return;
 	}
 
+	seat_pointer_flush_motion(wlr_seat);
+
 	struct wlr_seat_client *client = NULL;
 	if (surface) {
 		struct wl_client *wl_client = wl_resource_get_client(surface->resource);
@@ -232,8 +241,8 @@ void wlr_seat_pointer_warp(struct wlr_seat *wlr_seat, double sx, double sy) {
 	wlr_seat->pointer_state.sy = sy;
 }
 
-void wlr_seat_pointer_send_motion(struct wlr_seat *wlr_seat, uint32_t time,
-		double sx, double sy) {
+static void seat_pointer_send_motion_raw(struct wlr_seat *wlr_seat,
+		uint32_t time, double sx, double sy, double last_sx, double last_sy) {
 	struct wlr_seat_client *client = wlr_seat->pointer_state.focused_client;
 	if (client == NULL) {
 		return;
@@ -244,16 +253,124 @@ void wlr_seat_pointer_send_motion(struct wlr_seat *wlr_seat, uint32_t time,
 	// since that is what a client receives.
 	wl_fixed_t sx_fixed = wl_fixed_from_double(sx);
 	wl_fixed_t sy_fixed = wl_fixed_from_double(sy);
-	if (wl_fixed_from_double(wlr_seat->pointer_state.sx) != sx_fixed ||
-			wl_fixed_from_double(wlr_seat->pointer_state.sy) != sy_fixed) {
-		struct wl_resource *resource;
-		wl_resource_for_each(resource, &client->pointers) {
-			if (wlr_seat_client_from_pointer_resource(resource) == NULL) {
-				continue;
-			}
+	if (wl_fixed_from_double(last_sx) == sx_fixed &&
+			wl_fixed_from_double(last_sy) == sy_fixed) {
+		return;
+	}
+
+	struct wl_resource *resource;
+	wl_resource_for_each(resource, &client->pointers) {
+		if (wlr_seat_client_from_pointer_resource(resource) == NULL) {
+			continue;
+		}
+
+		wl_pointer_send_motion(resource, time, sx_fixed, sy_fixed);
+	}
+}
+
+static void seat_pointer_send_frame_raw(struct wlr_seat *wlr_seat) {
+	struct wlr_seat_client *client = wlr_seat->pointer_state.focused_client;
+	if (client == NULL) {
+		return;
+	}
+
+	struct wl_resource *resource;
+	wl_resource_for_each(resource, &client->pointers) {
+		if (wlr_seat_client_from_pointer_resource(resource) == NULL) {
+			continue;
+		}
+
+		pointer_send_frame(resource);
+	}
+}
+
+void seat_pointer_defer_motion(struct wlr_seat *seat) {
+	seat->pointer_state.coalesce.pending = true;
+}
+
+void seat_pointer_flush_motion(struct wlr_seat *seat) {
+	struct wlr_seat_pointer_state *state = &seat->pointer_state;
+	if (!state->coalesce.pending) {
+		return;
+	}
+
+	state->coalesce.pending = false;
+	state->coalesce.last_flush_ns = get_current_time_nsec();
+	if (state->coalesce.timer != NULL) {
+		wl_event_source_timer_update(state->coalesce.timer, 0);
+	}
+
+	if (state->coalesce.has_position) {
+		state->coalesce.has_position = false;
+		seat_pointer_send_motion_raw(seat, state->coalesce.time_msec,
+			state->coalesce.sx, state->coalesce.sy,
+			state->coalesce.sent_sx, state->coalesce.sent_sy);
+	}
+
+	wl_signal_emit_mutable(&state->events.motion_flush, seat);
+
+	if (state->coalesce.pending_frame) {
+		state->coalesce.pending_frame = false;
+		seat_pointer_send_frame_raw(seat);
+	}
+}
+
+static int seat_pointer_handle_coalesce_timer(void *data) {
+	struct wlr_seat *seat = data;
+	seat_pointer_flush_motion(seat);
+	return 0;
+}
+
+void wlr_seat_pointer_set_motion_coalescing(struct wlr_seat *wlr_seat,
+		bool enabled, int32_t max_rate) {
+	struct wlr_seat_pointer_state *state = &wlr_seat->pointer_state;
+	seat_pointer_flush_motion(wlr_seat);
+
+	state->coalesce.enabled = enabled;
+	state->coalesce.interval_ns = 0;
+	if (enabled && max_rate > 0) {
+		state->coalesce.interval_ns = 1000000000000 / max_rate;
+	}
+
+	if (state->coalesce.interval_ns == 0) {
+		if (state->coalesce.timer != NULL) {
+			wl_event_source_remove(state->coalesce.timer);
+			state->coalesce.timer = NULL;
+		}
+	} else if (state->coalesce.timer == NULL) {
+		struct wl_event_loop *loop =
+			wl_display_get_event_loop(wlr_seat->display);
+		state->coalesce.timer = wl_event_loop_add_timer(loop,
+			seat_pointer_handle_coalesce_timer, wlr_seat);
+		if (state->coalesce.timer == NULL) {
+			wlr_log(WLR_ERROR, "Failed to create pointer motion timer");
+			state->coalesce.interval_ns = 0;
+		}
+	}
+}
+
+void wlr_seat_pointer_send_motion(struct wlr_seat *wlr_seat, uint32_t time,
+		double sx, double sy) {
+	struct wlr_seat_pointer_state *state = &wlr_seat->pointer_state;
+	if (state->focused_client == NULL) {
+		return;
+	}
 
-			wl_pointer_send_motion(resource, time, sx_fixed, sy_fixed);
+	if (state->coalesce.enabled) {
+		if (state->coalesce.has_position) {
+			state->coalesced_motion_events++;
+		} else {
+			state->coalesce.has_position = true;
+			state->coalesce.sent_sx = state->sx;
+			state->coalesce.sent_sy = state->sy;
 		}
+		state->coalesce.time_msec = time;
+		state->coalesce.sx = sx;
+		state->coalesce.sy = sy;
+		seat_pointer_defer_motion(wlr_seat);
+	} else {
+		seat_pointer_send_motion_raw(wlr_seat, time, sx, sy,
+			state->sx, state->sy);
 	}
 
 	wlr_seat_pointer_warp(wlr_seat, sx, sy);
@@ -266,6 +383,8 @@ uint32_t wlr_seat_pointer_send_button(struct wlr_seat *wlr_seat, uint32_t time,
 		return 0;
 	}
 
+	seat_pointer_flush_motion(wlr_seat);
+
 	uint32_t serial = wlr_seat_client_next_serial(client);
 	struct wl_resource *resource;
 	wl_resource_for_each(resource, &client->pointers) {
@@ -327,6 +446,8 @@ void wlr_seat_pointer_send_axis(struct wlr_seat *wlr_seat, uint32_t time,
 		return;
 	}
 
+	seat_pointer_flush_motion(wlr_seat);
+
 	bool send_source = false;
 	if (wlr_seat->pointer_state.sent_axis_source) {
 		assert(wlr_seat->pointer_state.cached_axis_source == source);
@@ -389,21 +510,33 @@ void wlr_seat_pointer_send_axis(struct wlr_seat *wlr_seat, uint32_t time,
 }
 
 void wlr_seat_pointer_send_frame(struct wlr_seat *wlr_seat) {
-	struct wlr_seat_client *client = wlr_seat->pointer_state.focused_client;
-	if (client == NULL) {
+	struct wlr_seat_pointer_state *state = &wlr_seat->pointer_state;
+	if (state->focused_client == NULL) {
 		return;
 	}
 
-	wlr_seat->pointer_state.sent_axis_source = false;
+	state->sent_axis_source = false;
 
-	struct wl_resource *resource;
-	wl_resource_for_each(resource, &client->pointers) {
-		if (wlr_seat_client_from_pointer_resource(resource) == NULL) {
-			continue;
+	if (state->coalesce.pending) {
+		int64_t now = get_current_time_nsec();
+		int64_t due = state->coalesce.last_flush_ns + state->coalesce.interval_ns;
+		if (state->coalesce.interval_ns != 0 && now < due) {
+			// The frame only contains motion: send it once the rate allows
+			// it, along with the motion accumulated in the meantime
+			if (!state->coalesce.pending_frame) {
+				state->coalesce.pending_frame = true;
+				// Round up, a zero delay would disarm the timer
+				int delay_ms = (due - now + 999999) / 1000000;
+				wl_event_source_timer_update(state->coalesce.timer, delay_ms);
+			}
+			return;
 		}
 
-		pointer_send_frame(resource);
+		state->coalesce.pending_frame = false;
+		seat_pointer_flush_motion(wlr_seat);
 	}
+
+	seat_pointer_send_frame_raw(wlr_seat);
 }
 
 void wlr_seat_pointer_start_grab(struct wlr_seat *wlr_seat,
@@ -443,6 +576,10 @@ void wlr_seat_pointer_notify_clear_focus(struct wlr_seat *wlr_seat) {
 void wlr_seat_pointer_notify_motion(struct wlr_seat *wlr_seat, uint32_t time,
 		double sx, double sy) {
 	clock_gettime(CLOCK_MONOTONIC, &wlr_seat->last_event);
+	if (wlr_seat->latency_tracker != NULL) {
+		input_latency_tracker_handle_input(wlr_seat->latency_tracker,
+			wlr_seat->pointer_state.focused_surface, time);
+	}
 	struct wlr_seat_pointer_grab *grab = wlr_seat->pointer_state.grab;
 	grab->interface->motion(grab, time, sx, sy);
 }
@@ -450,6 +587,10 @@ void wlr_seat_pointer_notify_motion(struct wlr_seat *wlr_seat, uint32_t time,
 uint32_t wlr_seat_pointer_notify_button(struct wlr_seat *wlr_seat,
 		uint32_t time, uint32_t button, enum wlr_button_state state) {
 	clock_gettime(CLOCK_MONOTONIC, &wlr_seat->last_event);
+	if (wlr_seat->latency_tracker != NULL) {
+		input_latency_tracker_handle_input(wlr_seat->latency_tracker,
+			wlr_seat->pointer_state.focused_surface, time);
+	}
 
 	struct wlr_seat_pointer_state* pointer_state = &wlr_seat->pointer_state;
 
@@ -481,6 +622,10 @@ void wlr_seat_pointer_notify_axis(struct wlr_seat *wlr_seat, uint32_t time,
 		enum wlr_axis_orientation orientation, double value,
 		int32_t value_discrete, enum wlr_axis_source source) {
 	clock_gettime(CLOCK_MONOTONIC, &wlr_seat->last_event);
+	if (wlr_seat->latency_tracker != NULL) {
+		input_latency_tracker_handle_input(wlr_seat->latency_tracker,
+			wlr_seat->pointer_state.focused_surface, time);
+	}
 	struct wlr_seat_pointer_grab *grab = wlr_seat->pointer_state.grab;
 	grab->interface->axis(grab, time, orientation, value, value_discrete,
 		source);
@@ -183,6 +183,9 @@ uint32_t wlr_seat_touch_notify_down(struct wlr_seat *seat,
 		struct wlr_surface *surface, uint32_t time, int32_t touch_id, double sx,
 		double sy) {
 	clock_gettime(CLOCK_MONOTONIC, &seat->last_event);
+	if (seat->latency_tracker != NULL) {
+		input_latency_tracker_handle_input(seat->latency_tracker, surface, time);
+	}
 	struct wlr_seat_touch_grab *grab = seat->touch_state.grab;
 	struct wlr_touch_point *point =
 		touch_point_create(seat, touch_id, surface, sx, sy);
@@ -232,6 +235,11 @@ void wlr_seat_touch_notify_motion(struct wlr_seat *seat, uint32_t time,
 	point->sx = sx;
 	point->sy = sy;
 
+	if (seat->latency_tracker != NULL) {
+		input_latency_tracker_handle_input(seat->latency_tracker,
+			point->surface, time);
+	}
+
 	grab->interface->motion(grab, time, point);
 }
 
@@ -69,6 +69,18 @@ struct wlr_cursor_output_cursor {
 	struct wlr_xcursor *xcursor;
 	size_t xcursor_index;
 	struct wl_event_source *xcursor_timer;
+
+	// textures for the images of xcursor_textures_owner, indexed like
+	// wlr_xcursor.images
+	struct wlr_texture **xcursor_textures;
+	size_t xcursor_textures_len;
+	struct wlr_xcursor *xcursor_textures_owner;
+	struct wlr_renderer *xcursor_textures_renderer;
+};
+
+struct cursor_xcursor_buffer {
+	struct wlr_xcursor_image *image;
+	struct wlr_readonly_data_buffer *buffer;
 };
 
 struct wlr_cursor_state {
@@ -102,6 +114,9 @@ struct wlr_cursor_state {
 	// only when using an XCursor as the cursor image
 	struct wlr_xcursor_manager *xcursor_manager;
 	char *xcursor_name;
+	// Buffers wrapping the XCursor images displayed so far. Keeping them
+	// around allows outputs to reuse the cursor buffers rendered from them.
+	struct wl_array xcursor_buffers; // struct cursor_xcursor_buffer
 };
 
 struct wlr_cursor *wlr_cursor_create(void) {
@@ -116,6 +131,7 @@ struct wlr_cursor *wlr_cursor_create(void) {
 
 	wl_list_init(&cur->state->devices);
 	wl_list_init(&cur->state->output_cursors);
+	wl_array_init(&cur->state->xcursor_buffers);
 
 	// pointer signals
 	wl_signal_init(&cur->events.motion);
@@ -156,12 +172,29 @@ struct wlr_cursor *wlr_cursor_create(void) {
 
 static void cursor_output_cursor_reset_image(struct wlr_cursor_output_cursor *output_cursor);
 
+/**
+ * Must only be called once the output cursor no longer references any of the
+ * cached textures.
+ */
+static void output_cursor_finish_xcursor_textures(
+		struct wlr_cursor_output_cursor *output_cursor) {
+	for (size_t i = 0; i < output_cursor->xcursor_textures_len; i++) {
+		wlr_texture_destroy(output_cursor->xcursor_textures[i]);
+	}
+	free(output_cursor->xcursor_textures);
+	output_cursor->xcursor_textures = NULL;
+	output_cursor->xcursor_textures_len = 0;
+	output_cursor->xcursor_textures_owner = NULL;
+	output_cursor->xcursor_textures_renderer = NULL;
+}
+
 static void output_cursor_destroy(struct wlr_cursor_output_cursor *output_cursor) {
 	cursor_output_cursor_reset_image(output_cursor);
 	wl_list_remove(&output_cursor->layout_output_destroy.link);
 	wl_list_remove(&output_cursor->link);
 	wl_list_remove(&output_cursor->output_commit.link);
 	wlr_output_cursor_destroy(output_cursor->output_cursor);
+	output_cursor_finish_xcursor_textures(output_cursor);
 	free(output_cursor);
 }
 
@@ -238,6 +271,12 @@ static void cursor_reset_image(struct wlr_cursor *cur) {
 	cur->state->xcursor_manager = NULL;
 	free(cur->state->xcursor_name);
 	cur->state->xcursor_name = NULL;
+
+	struct cursor_xcursor_buffer *xcursor_buffer;
+	wl_array_for_each(xcursor_buffer, &cur->state->xcursor_buffers) {
+		readonly_data_buffer_drop(xcursor_buffer->buffer);
+	}
+	cur->state->xcursor_buffers.size = 0;
 }
 
 void wlr_cursor_destroy(struct wlr_cursor *cur) {
@@ -249,6 +288,7 @@ void wlr_cursor_destroy(struct wlr_cursor *cur) {
 		cursor_device_destroy(device);
 	}
 
+	wl_array_release(&cur->state->xcursor_buffers);
 	free(cur->state);
 }
 
@@ -462,16 +502,85 @@ static int handle_xcursor_timer(void *data) {
 	return 0;
 }
 
-static void output_cursor_set_xcursor_image(struct wlr_cursor_output_cursor *output_cursor, size_t i) {
-	struct wlr_xcursor_image *image = output_cursor->xcursor->images[i];
+static struct wlr_buffer *cursor_get_xcursor_buffer(struct wlr_cursor *cur,
+		struct wlr_xcursor_image *image) {
+	struct cursor_xcursor_buffer *xcursor_buffer;
+	wl_array_for_each(xcursor_buffer, &cur->state->xcursor_buffers) {
+		if (xcursor_buffer->image == image) {
+			return &xcursor_buffer->buffer->base;
+		}
+	}
 
 	struct wlr_readonly_data_buffer *ro_buffer = readonly_data_buffer_create(
 		DRM_FORMAT_ARGB8888, 4 * image->width, image->width, image->height, image->buffer);
 	if (ro_buffer == NULL) {
+		return NULL;
+	}
+
+	xcursor_buffer = wl_array_add(&cur->state->xcursor_buffers,
+		sizeof(*xcursor_buffer));
+	if (xcursor_buffer == NULL) {
+		readonly_data_buffer_drop(ro_buffer);
+		return NULL;
+	}
+	xcursor_buffer->image = image;
+	xcursor_buffer->buffer = ro_buffer;
+	return &ro_buffer->base;
+}
+
+static void output_cursor_set_xcursor_image(struct wlr_cursor_output_cursor *output_cursor, size_t i) {
+	struct wlr_xcursor *xcursor = output_cursor->xcursor;
+	struct wlr_xcursor_image *image = xcursor->images[i];
+
+	struct wlr_buffer *buffer = cursor_get_xcursor_buffer(output_cursor->cursor, image);
+	if (buffer == NULL) {
 		return;
 	}
-	wlr_output_cursor_set_buffer(output_cursor->output_cursor, &ro_buffer->base, image->hotspot_x, image->hotspot_y);
-	wlr_buffer_drop(&ro_buffer->base);
+
+	// XCursor images never change, so the textures uploaded from them can be
+	// re-used across animation frames. The previous cache is only released
+	// once the output cursor has switched to a texture from the new one.
+	struct wlr_output *output = output_cursor->output_cursor->output;
+	bool stale = output_cursor->xcursor_textures_owner != xcursor ||
+		output_cursor->xcursor_textures_len != xcursor->image_count ||
+		output_cursor->xcursor_textures_renderer != output->renderer;
+	struct wlr_texture **textures = output_cursor->xcursor_textures;
+	if (stale) {
+		textures = calloc(xcursor->image_count, sizeof(*textures));
+		if (textures == NULL) {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+			return;
+		}
+	}
+
+	struct wlr_texture *texture = textures[i];
+	if (texture == NULL) {
+		texture = wlr_texture_from_buffer(output->renderer, buffer);
+		if (texture == NULL) {
+			if (stale) {
+				free(textures);
+			}
+			return;
+		}
+		textures[i] = texture;
+	}
+
+	struct wlr_fbox src_box = {
+		.width = texture->width,
+		.height = texture->height,
+	};
+	output_cursor_set_texture(output_cursor->output_cursor, buffer, texture, false,
+		&src_box, texture->width / output->scale, texture->height / output->scale,
+		WL_OUTPUT_TRANSFORM_NORMAL, image->hotspot_x / output->scale,
+		image->hotspot_y / output->scale);
+
+	if (stale) {
+		output_cursor_finish_xcursor_textures(output_cursor);
+		output_cursor->xcursor_textures = textures;
+		output_cursor->xcursor_textures_len = xcursor->image_count;
+		output_cursor->xcursor_textures_owner = xcursor;
+		output_cursor->xcursor_textures_renderer = output->renderer;
+	}
 
 	output_cursor->xcursor_index = i;
 
@@ -527,7 +636,7 @@ static void cursor_output_cursor_update(struct wlr_cursor_output_cursor *output_
 			}
 		}
 
-		output_cursor_set_texture(output_cursor->output_cursor, texture, true,
+		output_cursor_set_texture(output_cursor->output_cursor, NULL, texture, true,
 			&src_box, dst_width, dst_height, WL_OUTPUT_TRANSFORM_NORMAL,
 			hotspot_x, hotspot_y);
 	} else if (cur->state->surface != NULL) {
@@ -542,7 +651,7 @@ static void cursor_output_cursor_update(struct wlr_cursor_output_cursor *output_
 		int dst_width = surface->current.width;
 		int dst_height = surface->current.height;
 
-		output_cursor_set_texture(output_cursor->output_cursor, texture, false,
+		output_cursor_set_texture(output_cursor->output_cursor, NULL, texture, false,
 			&src_box, dst_width, dst_height, surface->current.transform,
 			hotspot_x, hotspot_y);
 
@@ -571,14 +680,19 @@ static void cursor_output_cursor_update(struct wlr_cursor_output_cursor *output_
 		if (xcursor == NULL) {
 			wlr_log(WLR_DEBUG, "XCursor theme is missing '%s' cursor", name);
 			wlr_output_cursor_set_buffer(output_cursor->output_cursor, NULL, 0, 0);
+			output_cursor_finish_xcursor_textures(output_cursor);
 			return;
 		}
 
 		output_cursor->xcursor = xcursor;
 		output_cursor_set_xcursor_image(output_cursor, 0);
+		return;
 	} else {
 		wlr_output_cursor_set_buffer(output_cursor->output_cursor, NULL, 0, 0);
 	}
+
+	// The output cursor no longer shows an XCursor image
+	output_cursor_finish_xcursor_textures(output_cursor);
 }
 
 static void output_cursor_output_handle_output_commit(
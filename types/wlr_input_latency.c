@@ -0,0 +1,418 @@
+#define _POSIX_C_SOURCE 200809L
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_input_latency.h>
+#include <wlr/util/addon.h>
+#include <wlr/util/log.h>
+#include "types/wlr_seat.h"
+#include "util/time.h"
+
+#define HISTOGRAM_BUCKET_NSEC (500 * 1000)
+// The last bucket collects all samples above 100ms
+#define HISTOGRAM_BUCKETS 200
+// Inputs the client hasn't responded to within this delay are dropped
+#define INPUT_TIMEOUT_MSEC 1000
+// Maximum number of output commits waiting for presentation
+#define IN_FLIGHT_CAP 4
+// Statistics are logged every time this many samples have been recorded
+#define LOG_INTERVAL 256
+
+struct latency_sample {
+	// CLOCK_MONOTONIC timestamps
+	int64_t input_ns, dispatch_ns, surface_commit_ns, output_commit_ns;
+};
+
+struct latency_in_flight {
+	uint32_t commit_seq;
+	struct latency_sample sample;
+};
+
+struct latency_output {
+	struct wlr_input_latency_tracker *tracker;
+	struct wlr_output *output;
+	struct wlr_addon addon;
+	struct wl_list link; // wlr_input_latency_tracker.outputs
+
+	// Earliest input committed by a client but not yet by the output
+	bool has_waiting;
+	struct latency_sample waiting;
+
+	struct latency_in_flight in_flight[IN_FLIGHT_CAP];
+	size_t in_flight_len;
+
+	uint64_t histogram[HISTOGRAM_BUCKETS];
+	uint64_t samples;
+	int64_t max_ns;
+	int64_t compositor_sum_ns, client_sum_ns, display_sum_ns;
+
+	struct wl_listener commit;
+	struct wl_listener present;
+};
+
+struct latency_surface {
+	struct wlr_input_latency_tracker *tracker;
+	struct wlr_surface *surface;
+	struct wlr_addon addon;
+	struct wl_list link; // wlr_input_latency_tracker.surfaces
+
+	// Earliest input the client hasn't responded to yet, zero if none
+	int64_t input_ns, dispatch_ns;
+
+	struct wl_listener commit;
+};
+
+struct wlr_input_latency_tracker {
+	struct wlr_seat *seat;
+
+	struct wl_list outputs; // latency_output.link
+	struct wl_list surfaces; // latency_surface.link
+
+	struct wl_listener seat_destroy;
+};
+
+static int64_t get_current_time_nsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return timespec_to_nsec(&now);
+}
+
+static void latency_output_destroy(struct latency_output *latency_output) {
+	wlr_addon_finish(&latency_output->addon);
+	wl_list_remove(&latency_output->link);
+	wl_list_remove(&latency_output->commit.link);
+	wl_list_remove(&latency_output->present.link);
+	free(latency_output);
+}
+
+static void output_addon_destroy(struct wlr_addon *addon) {
+	struct latency_output *latency_output =
+		wl_container_of(addon, latency_output, addon);
+	latency_output_destroy(latency_output);
+}
+
+static const struct wlr_addon_interface output_addon_impl = {
+	.name = "wlr_input_latency_output",
+	.destroy = output_addon_destroy,
+};
+
+static void log_stats(struct latency_output *latency_output) {
+	struct wlr_input_latency_stats stats;
+	wlr_input_latency_tracker_get_stats(latency_output->tracker,
+		latency_output->output, &stats);
+	wlr_log(WLR_DEBUG, "Input latency on output %s over %" PRIu64 " frames: "
+		"p50 %.1f ms, p99 %.1f ms, max %.1f ms "
+		"(compositor %.1f ms, client %.1f ms, display %.1f ms)",
+		latency_output->output->name, stats.samples,
+		stats.p50_ns / 1e6, stats.p99_ns / 1e6, stats.max_ns / 1e6,
+		stats.compositor_mean_ns / 1e6, stats.client_mean_ns / 1e6,
+		stats.display_mean_ns / 1e6);
+}
+
+static void latency_output_record(struct latency_output *latency_output,
+		const struct latency_sample *sample, int64_t present_ns) {
+	int64_t latency = present_ns - sample->input_ns;
+	if (latency < 0) {
+		// The input device doesn't use CLOCK_MONOTONIC
+		return;
+	}
+
+	size_t bucket = latency / HISTOGRAM_BUCKET_NSEC;
+	if (bucket >= HISTOGRAM_BUCKETS) {
+		bucket = HISTOGRAM_BUCKETS - 1;
+	}
+	latency_output->histogram[bucket]++;
+	latency_output->samples++;
+	if (latency > latency_output->max_ns) {
+		latency_output->max_ns = latency;
+	}
+
+	latency_output->compositor_sum_ns +=
+		(sample->dispatch_ns - sample->input_ns) +
+		(sample->output_commit_ns - sample->surface_commit_ns);
+	latency_output->client_sum_ns +=
+		sample->surface_commit_ns - sample->dispatch_ns;
+	latency_output->display_sum_ns += present_ns - sample->output_commit_ns;
+
+	if (latency_output->samples % LOG_INTERVAL == 0) {
+		log_stats(latency_output);
+	}
+}
+
+static void latency_output_handle_commit(struct wl_listener *listener,
+		void *data) {
+	struct latency_output *latency_output =
+		wl_container_of(listener, latency_output, commit);
+	struct wlr_output_event_commit *event = data;
+	if (!(event->state->committed & WLR_OUTPUT_STATE_BUFFER) ||
+			!latency_output->has_waiting) {
+		return;
+	}
+
+	if (latency_output->in_flight_len == IN_FLIGHT_CAP) {
+		// The backend doesn't send presentation events, drop the oldest
+		memmove(&latency_output->in_flight[0], &latency_output->in_flight[1],
+			(IN_FLIGHT_CAP - 1) * sizeof(latency_output->in_flight[0]));
+		latency_output->in_flight_len--;
+	}
+
+	struct latency_in_flight *in_flight =
+		&latency_output->in_flight[latency_output->in_flight_len++];
+	in_flight->commit_seq = latency_output->output->commit_seq;
+	in_flight->sample = latency_output->waiting;
+	in_flight->sample.output_commit_ns = timespec_to_nsec(event->when);
+	latency_output->has_waiting = false;
+}
+
+static void latency_output_handle_present(struct wl_listener *listener,
+		void *data) {
+	struct latency_output *latency_output =
+		wl_container_of(listener, latency_output, present);
+	struct wlr_output_event_present *event = data;
+
+	// Commits are presented in order: the ones preceding this commit will
+	// never be presented
+	size_t n = 0;
+	while (n < latency_output->in_flight_len &&
+			(int32_t)(latency_output->in_flight[n].commit_seq -
+			event->commit_seq) <= 0) {
+		struct latency_in_flight *in_flight = &latency_output->in_flight[n];
+		if (in_flight->commit_seq == event->commit_seq && event->presented &&
+				event->when != NULL) {
+			latency_output_record(latency_output, &in_flight->sample,
+				timespec_to_nsec(event->when));
+		}
+		n++;
+	}
+
+	latency_output->in_flight_len -= n;
+	memmove(&latency_output->in_flight[0], &latency_output->in_flight[n],
+		latency_output->in_flight_len * sizeof(latency_output->in_flight[0]));
+}
+
+static struct latency_output *latency_output_get_or_create(
+		struct wlr_input_latency_tracker *tracker, struct wlr_output *output) {
+	struct wlr_addon *addon =
+		wlr_addon_find(&output->addons, tracker, &output_addon_impl);
+	if (addon != NULL) {
+		struct latency_output *latency_output =
+			wl_container_of(addon, latency_output, addon);
+		return latency_output;
+	}
+
+	struct latency_output *latency_output = calloc(1, sizeof(*latency_output));
+	if (latency_output == NULL) {
+		return NULL;
+	}
+
+	latency_output->tracker = tracker;
+	latency_output->output = output;
+	wlr_addon_init(&latency_output->addon, &output->addons, tracker,
+		&output_addon_impl);
+	wl_list_insert(&tracker->outputs, &latency_output->link);
+
+	latency_output->commit.notify = latency_output_handle_commit;
+	wl_signal_add(&output->events.commit, &latency_output->commit);
+	latency_output->present.notify = latency_output_handle_present;
+	wl_signal_add(&output->events.present, &latency_output->present);
+
+	return latency_output;
+}
+
+static void latency_surface_destroy(struct latency_surface *latency_surface) {
+	wlr_addon_finish(&latency_surface->addon);
+	wl_list_remove(&latency_surface->link);
+	wl_list_remove(&latency_surface->commit.link);
+	free(latency_surface);
+}
+
+static void surface_addon_destroy(struct wlr_addon *addon) {
+	struct latency_surface *latency_surface =
+		wl_container_of(addon, latency_surface, addon);
+	latency_surface_destroy(latency_surface);
+}
+
+static const struct wlr_addon_interface surface_addon_impl = {
+	.name = "wlr_input_latency_surface",
+	.destroy = surface_addon_destroy,
+};
+
+static void latency_surface_handle_commit(struct wl_listener *listener,
+		void *data) {
+	struct latency_surface *latency_surface =
+		wl_container_of(listener, latency_surface, commit);
+	struct wlr_surface *surface = latency_surface->surface;
+	if (latency_surface->input_ns == 0 ||
+			!(surface->current.committed & WLR_SURFACE_STATE_BUFFER)) {
+		return;
+	}
+
+	struct latency_sample sample = {
+		.input_ns = latency_surface->input_ns,
+		.dispatch_ns = latency_surface->dispatch_ns,
+		.surface_commit_ns = get_current_time_nsec(),
+	};
+	latency_surface->input_ns = latency_surface->dispatch_ns = 0;
+
+	struct wlr_surface_output *surface_output;
+	wl_list_for_each(surface_output, &surface->current_outputs, link) {
+		struct latency_output *latency_output = latency_output_get_or_create(
+			latency_surface->tracker, surface_output->output);
+		if (latency_output == NULL || latency_output->has_waiting) {
+			continue;
+		}
+		latency_output->waiting = sample;
+		latency_output->has_waiting = true;
+	}
+}
+
+void input_latency_tracker_handle_input(struct wlr_input_latency_tracker *tracker,
+		struct wlr_surface *surface, uint32_t time_msec) {
+	if (surface == NULL) {
+		return;
+	}
+
+	struct latency_surface *latency_surface;
+	struct wlr_addon *addon =
+		wlr_addon_find(&surface->addons, tracker, &surface_addon_impl);
+	if (addon != NULL) {
+		latency_surface = wl_container_of(addon, latency_surface, addon);
+	} else {
+		latency_surface = calloc(1, sizeof(*latency_surface));
+		if (latency_surface == NULL) {
+			return;
+		}
+		latency_surface->tracker = tracker;
+		latency_surface->surface = surface;
+		wlr_addon_init(&latency_surface->addon, &surface->addons, tracker,
+			&surface_addon_impl);
+		wl_list_insert(&tracker->surfaces, &latency_surface->link);
+		latency_surface->commit.notify = latency_surface_handle_commit;
+		wl_signal_add(&surface->events.commit, &latency_surface->commit);
+	}
+
+	int64_t now = get_current_time_nsec();
+	if (latency_surface->input_ns != 0 &&
+			now - latency_surface->dispatch_ns < INPUT_TIMEOUT_MSEC * 1000000LL) {
+		// Keep the earliest input the client hasn't responded to
+		return;
+	}
+
+	// Input timestamps are the low 32 bits of a millisecond timestamp
+	int64_t now_msec = now / 1000000;
+	uint32_t age = (uint32_t)now_msec - time_msec;
+	if (age > INPUT_TIMEOUT_MSEC) {
+		// Stale or bogus timestamp, fall back to the dispatch time
+		age = 0;
+	}
+	latency_surface->input_ns = (now_msec - age) * 1000000;
+	latency_surface->dispatch_ns = now;
+}
+
+static void tracker_handle_seat_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_latency_tracker *tracker =
+		wl_container_of(listener, tracker, seat_destroy);
+	wlr_input_latency_tracker_destroy(tracker);
+}
+
+struct wlr_input_latency_tracker *wlr_input_latency_tracker_create(
+		struct wlr_seat *seat) {
+	if (seat->latency_tracker != NULL) {
+		wlr_log(WLR_ERROR, "Seat %s already has a latency tracker", seat->name);
+		return NULL;
+	}
+
+	struct wlr_input_latency_tracker *tracker = calloc(1, sizeof(*tracker));
+	if (tracker == NULL) {
+		return NULL;
+	}
+
+	tracker->seat = seat;
+	wl_list_init(&tracker->outputs);
+	wl_list_init(&tracker->surfaces);
+
+	tracker->seat_destroy.notify = tracker_handle_seat_destroy;
+	wl_signal_add(&seat->events.destroy, &tracker->seat_destroy);
+
+	seat->latency_tracker = tracker;
+	return tracker;
+}
+
+void wlr_input_latency_tracker_destroy(struct wlr_input_latency_tracker *tracker) {
+	if (tracker == NULL) {
+		return;
+	}
+
+	struct latency_output *latency_output, *latency_output_tmp;
+	wl_list_for_each_safe(latency_output, latency_output_tmp,
+			&tracker->outputs, link) {
+		latency_output_destroy(latency_output);
+	}
+	struct latency_surface *latency_surface, *latency_surface_tmp;
+	wl_list_for_each_safe(latency_surface, latency_surface_tmp,
+			&tracker->surfaces, link) {
+		latency_surface_destroy(latency_surface);
+	}
+
+	tracker->seat->latency_tracker = NULL;
+	wl_list_remove(&tracker->seat_destroy.link);
+	free(tracker);
+}
+
+static int64_t histogram_percentile(const struct latency_output *latency_output,
+		uint64_t permille) {
+	uint64_t rank = (latency_output->samples * permille + 999) / 1000;
+	uint64_t count = 0;
+	for (size_t i = 0; i < HISTOGRAM_BUCKETS - 1; i++) {
+		count += latency_output->histogram[i];
+		if (count >= rank) {
+			int64_t bound = (int64_t)(i + 1) * HISTOGRAM_BUCKET_NSEC;
+			return bound < latency_output->max_ns ?
+				bound : latency_output->max_ns;
+		}
+	}
+	return latency_output->max_ns;
+}
+
+bool wlr_input_latency_tracker_get_stats(struct wlr_input_latency_tracker *tracker,
+		struct wlr_output *output, struct wlr_input_latency_stats *stats) {
+	memset(stats, 0, sizeof(*stats));
+
+	struct wlr_addon *addon =
+		wlr_addon_find(&output->addons, tracker, &output_addon_impl);
+	if (addon == NULL) {
+		return false;
+	}
+	struct latency_output *latency_output =
+		wl_container_of(addon, latency_output, addon);
+	if (latency_output->samples == 0) {
+		return false;
+	}
+
+	int64_t samples = latency_output->samples;
+	*stats = (struct wlr_input_latency_stats){
+		.samples = latency_output->samples,
+		.p50_ns = histogram_percentile(latency_output, 500),
+		.p99_ns = histogram_percentile(latency_output, 990),
+		.max_ns = latency_output->max_ns,
+		.compositor_mean_ns = latency_output->compositor_sum_ns / samples,
+		.client_mean_ns = latency_output->client_sum_ns / samples,
+		.display_mean_ns = latency_output->display_sum_ns / samples,
+	};
+	return true;
+}
+
+void wlr_input_latency_tracker_reset_stats(struct wlr_input_latency_tracker *tracker) {
+	struct latency_output *latency_output;
+	wl_list_for_each(latency_output, &tracker->outputs, link) {
+		memset(latency_output->histogram, 0, sizeof(latency_output->histogram));
+		latency_output->samples = 0;
+		latency_output->max_ns = 0;
+		latency_output->compositor_sum_ns = 0;
+		latency_output->client_sum_ns = 0;
+		latency_output->display_sum_ns = 0;
+	}
+}
@@ -1,7 +1,6 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/mman.h>
 #include <unistd.h>
 #include <wayland-server-core.h>
 #include <wlr/interfaces/wlr_keyboard.h>
@@ -12,6 +11,80 @@
 #include "util/shm.h"
 #include "util/time.h"
 
+// Keymaps in use by at least one keyboard or client, shared process-wide
+static struct wl_list keymap_cache = { &keymap_cache, &keymap_cache };
+
+static uint64_t hash_keymap_string(const char *str, size_t size) {
+	// 64-bit FNV-1a
+	uint64_t hash = 0xcbf29ce484222325;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= (unsigned char)str[i];
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+/**
+ * Get the shared keymap for a serialized keymap, taking ownership of the
+ * string.
+ */
+static struct wlr_shared_keymap *shared_keymap_get(char *str) {
+	size_t size = strlen(str) + 1;
+	uint64_t hash = hash_keymap_string(str, size);
+
+	struct wlr_shared_keymap *keymap;
+	wl_list_for_each(keymap, &keymap_cache, link) {
+		if (keymap->hash == hash && keymap->size == size &&
+				memcmp(keymap->string, str, size) == 0) {
+			free(str);
+			return shared_keymap_ref(keymap);
+		}
+	}
+
+	keymap = calloc(1, sizeof(*keymap));
+	if (keymap == NULL) {
+		free(str);
+		return NULL;
+	}
+
+	keymap->fd = allocate_sealed_shm_file(str, size);
+	if (keymap->fd < 0) {
+		wlr_log(WLR_ERROR, "Failed to allocate shm file for keymap");
+		free(keymap);
+		free(str);
+		return NULL;
+	}
+
+	keymap->string = str;
+	keymap->size = size;
+	keymap->hash = hash;
+	keymap->n_refs = 1;
+	wl_list_insert(&keymap_cache, &keymap->link);
+	return keymap;
+}
+
+struct wlr_shared_keymap *shared_keymap_ref(struct wlr_shared_keymap *keymap) {
+	keymap->n_refs++;
+	return keymap;
+}
+
+void shared_keymap_unref(struct wlr_shared_keymap *keymap) {
+	if (keymap == NULL) {
+		return;
+	}
+
+	assert(keymap->n_refs > 0);
+	keymap->n_refs--;
+	if (keymap->n_refs > 0) {
+		return;
+	}
+
+	wl_list_remove(&keymap->link);
+	close(keymap->fd);
+	free(keymap->string);
+	free(keymap);
+}
+
 struct wlr_keyboard *wlr_keyboard_from_input_device(
 		struct wlr_input_device *input_device) {
 	assert(input_device->type == WLR_INPUT_DEVICE_KEYBOARD);
@@ -142,12 +215,10 @@ static void keyboard_unset_keymap(struct wlr_keyboard *kb) {
 	kb->keymap = NULL;
 	xkb_state_unref(kb->xkb_state);
 	kb->xkb_state = NULL;
-	free(kb->keymap_string);
+	shared_keymap_unref(kb->shared_keymap);
+	kb->shared_keymap = NULL;
 	kb->keymap_string = NULL;
 	kb->keymap_size = 0;
-	if (kb->keymap_fd >= 0) {
-		close(kb->keymap_fd);
-	}
 	kb->keymap_fd = -1;
 }
 
@@ -200,31 +271,19 @@ bool wlr_keyboard_set_keymap(struct wlr_keyboard *kb, struct xkb_keymap *keymap)
 		wlr_log(WLR_ERROR, "Failed to get string version of keymap");
 		goto error_xkb_state;
 	}
-	size_t keymap_size = strlen(keymap_str) + 1;
-
-	int rw_fd = -1, ro_fd = -1;
-	if (!allocate_shm_file_pair(keymap_size, &rw_fd, &ro_fd)) {
-		wlr_log(WLR_ERROR, "Failed to allocate shm file for keymap");
-		goto error_keymap_str;
-	}
 
-	void *dst = mmap(NULL, keymap_size, PROT_READ | PROT_WRITE, MAP_SHARED, rw_fd, 0);
-	close(rw_fd);
-	if (dst == MAP_FAILED) {
-		wlr_log_errno(WLR_ERROR, "mmap failed");
-		close(ro_fd);
-		goto error_keymap_str;
+	struct wlr_shared_keymap *shared_keymap = shared_keymap_get(keymap_str);
+	if (shared_keymap == NULL) {
+		goto error_xkb_state;
 	}
 
-	memcpy(dst, keymap_str, keymap_size);
-	munmap(dst, keymap_size);
-
 	keyboard_unset_keymap(kb);
 	kb->keymap = xkb_keymap_ref(keymap);
 	kb->xkb_state = xkb_state;
-	kb->keymap_string = keymap_str;
-	kb->keymap_size = keymap_size;
-	kb->keymap_fd = ro_fd;
+	kb->shared_keymap = shared_keymap;
+	kb->keymap_string = shared_keymap->string;
+	kb->keymap_size = shared_keymap->size;
+	kb->keymap_fd = shared_keymap->fd;
 
 	const char *led_names[WLR_LED_COUNT] = {
 		XKB_LED_NAME_NUM,
@@ -261,8 +320,6 @@ bool wlr_keyboard_set_keymap(struct wlr_keyboard *kb, struct xkb_keymap *keymap)
 
 	return true;
 
-error_keymap_str:
-	free(keymap_str);
 error_xkb_state:
 	xkb_state_unref(xkb_state);
 	return false;
@@ -298,6 +355,9 @@ bool wlr_keyboard_keymaps_match(struct xkb_keymap *km1,
 	if (!km1 || !km2) {
 		return false;
 	}
+	if (km1 == km2) {
+		return true;
+	}
 	char *km1_str = xkb_keymap_get_as_string(km1, XKB_KEYMAP_FORMAT_TEXT_V1);
 	char *km2_str = xkb_keymap_get_as_string(km2, XKB_KEYMAP_FORMAT_TEXT_V1);
 	bool result = strcmp(km1_str, km2_str) == 0;
@@ -0,0 +1,592 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <wlr/render/drm_syncobj.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_linux_drm_syncobj_v1.h>
+#include <wlr/util/addon.h>
+#include <wlr/util/log.h>
+#include <xf86drm.h>
+#include "linux-drm-syncobj-v1-protocol.h"
+#include "render/dmabuf.h"
+
+#define LINUX_DRM_SYNCOBJ_V1_VERSION 1
+
+struct wlr_linux_drm_syncobj_surface_v1 {
+	struct wl_resource *resource;
+	struct wlr_surface *surface;
+	struct wlr_addon addon;
+
+	struct wlr_linux_drm_syncobj_surface_v1_state pending, current;
+	struct wl_list commits; // wlr_linux_drm_syncobj_surface_v1_commit.link
+	// Sequence number of the surface state the current state has been
+	// updated for
+	uint32_t current_seq;
+
+	struct wl_listener surface_client_commit;
+	struct wl_listener surface_commit;
+};
+
+// A surface commit with explicit synchronization, not applied yet
+struct wlr_linux_drm_syncobj_surface_v1_commit {
+	struct wlr_linux_drm_syncobj_surface_v1 *surface;
+	struct wl_list link; // wlr_linux_drm_syncobj_surface_v1.commits
+	uint32_t seq;
+	struct wlr_linux_drm_syncobj_surface_v1_state state;
+
+	// Set while the cached surface state is locked until the acquire point
+	// materializes
+	bool waiting;
+	struct wlr_drm_syncobj_timeline_waiter waiter;
+	struct wl_listener waiter_ready;
+};
+
+// Signals a release point once the compositor is done with a buffer
+struct wlr_linux_drm_syncobj_buffer_release {
+	struct wlr_buffer *buffer;
+	struct wlr_drm_syncobj_timeline *timeline;
+	uint64_t point;
+
+	struct wl_listener buffer_release;
+	struct wl_listener buffer_destroy;
+};
+
+static const struct wp_linux_drm_syncobj_manager_v1_interface manager_impl;
+static const struct wp_linux_drm_syncobj_timeline_v1_interface timeline_impl;
+static const struct wp_linux_drm_syncobj_surface_v1_interface surface_impl;
+
+static struct wlr_linux_drm_syncobj_manager_v1 *manager_from_resource(
+		struct wl_resource *resource) {
+	assert(wl_resource_instance_of(resource,
+		&wp_linux_drm_syncobj_manager_v1_interface, &manager_impl));
+	return wl_resource_get_user_data(resource);
+}
+
+static struct wlr_drm_syncobj_timeline *timeline_from_resource(
+		struct wl_resource *resource) {
+	assert(wl_resource_instance_of(resource,
+		&wp_linux_drm_syncobj_timeline_v1_interface, &timeline_impl));
+	return wl_resource_get_user_data(resource);
+}
+
+// Returns NULL if the surface object is inert
+static struct wlr_linux_drm_syncobj_surface_v1 *surface_from_resource(
+		struct wl_resource *resource) {
+	assert(wl_resource_instance_of(resource,
+		&wp_linux_drm_syncobj_surface_v1_interface, &surface_impl));
+	return wl_resource_get_user_data(resource);
+}
+
+static void resource_handle_destroy(struct wl_client *client,
+		struct wl_resource *resource) {
+	wl_resource_destroy(resource);
+}
+
+static void state_set_acquire(struct wlr_linux_drm_syncobj_surface_v1_state *state,
+		struct wlr_drm_syncobj_timeline *timeline, uint64_t point) {
+	wlr_drm_syncobj_timeline_unref(state->acquire_timeline);
+	state->acquire_timeline = timeline ? wlr_drm_syncobj_timeline_ref(timeline) : NULL;
+	state->acquire_point = point;
+}
+
+static void state_set_release(struct wlr_linux_drm_syncobj_surface_v1_state *state,
+		struct wlr_drm_syncobj_timeline *timeline, uint64_t point) {
+	wlr_drm_syncobj_timeline_unref(state->release_timeline);
+	state->release_timeline = timeline ? wlr_drm_syncobj_timeline_ref(timeline) : NULL;
+	state->release_point = point;
+}
+
+static void state_finish(struct wlr_linux_drm_syncobj_surface_v1_state *state) {
+	state_set_acquire(state, NULL, 0);
+	state_set_release(state, NULL, 0);
+}
+
+static void state_move(struct wlr_linux_drm_syncobj_surface_v1_state *dst,
+		struct wlr_linux_drm_syncobj_surface_v1_state *src) {
+	state_finish(dst);
+	*dst = *src;
+	*src = (struct wlr_linux_drm_syncobj_surface_v1_state){0};
+}
+
+static void buffer_release_destroy(
+		struct wlr_linux_drm_syncobj_buffer_release *release) {
+	wl_list_remove(&release->buffer_release.link);
+	wl_list_remove(&release->buffer_destroy.link);
+	wlr_drm_syncobj_timeline_unref(release->timeline);
+	free(release);
+}
+
+static void buffer_release_signal(
+		struct wlr_linux_drm_syncobj_buffer_release *release,
+		bool destroyed) {
+	// Let the release point follow the GPU accesses still in flight, if the
+	// buffer carries implicit fences for them. Otherwise, the buffer is idle.
+	struct wlr_dmabuf_attributes dmabuf;
+	if (!destroyed && wlr_buffer_get_dmabuf(release->buffer, &dmabuf)) {
+		int sync_file_fd = dmabuf_export_sync_file(dmabuf.fd[0],
+			DMA_BUF_SYNC_WRITE);
+		if (sync_file_fd >= 0) {
+			bool ok = wlr_drm_syncobj_timeline_import_sync_file(
+				release->timeline, release->point, sync_file_fd);
+			close(sync_file_fd);
+			if (ok) {
+				return;
+			}
+		}
+	}
+
+	wlr_drm_syncobj_timeline_signal(release->timeline, release->point);
+}
+
+static void buffer_release_handle_release(struct wl_listener *listener,
+		void *data) {
+	struct wlr_linux_drm_syncobj_buffer_release *release =
+		wl_container_of(listener, release, buffer_release);
+	buffer_release_signal(release, false);
+	buffer_release_destroy(release);
+}
+
+static void buffer_release_handle_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_linux_drm_syncobj_buffer_release *release =
+		wl_container_of(listener, release, buffer_destroy);
+	buffer_release_signal(release, true);
+	buffer_release_destroy(release);
+}
+
+static bool buffer_release_create(struct wlr_buffer *buffer,
+		struct wlr_drm_syncobj_timeline *timeline, uint64_t point) {
+	struct wlr_linux_drm_syncobj_buffer_release *release =
+		calloc(1, sizeof(*release));
+	if (release == NULL) {
+		return false;
+	}
+
+	release->buffer = buffer;
+	release->timeline = wlr_drm_syncobj_timeline_ref(timeline);
+	release->point = point;
+
+	release->buffer_release.notify = buffer_release_handle_release;
+	wl_signal_add(&buffer->events.release, &release->buffer_release);
+	release->buffer_destroy.notify = buffer_release_handle_destroy;
+	wl_signal_add(&buffer->events.destroy, &release->buffer_destroy);
+
+	return true;
+}
+
+static void surface_commit_destroy(
+		struct wlr_linux_drm_syncobj_surface_v1_commit *commit) {
+	if (commit->waiting) {
+		wl_list_remove(&commit->waiter_ready.link);
+		wlr_drm_syncobj_timeline_waiter_finish(&commit->waiter);
+	}
+	wl_list_remove(&commit->link);
+	state_finish(&commit->state);
+	free(commit);
+}
+
+static void surface_commit_handle_waiter_ready(struct wl_listener *listener,
+		void *data) {
+	struct wlr_linux_drm_syncobj_surface_v1_commit *commit =
+		wl_container_of(listener, commit, waiter_ready);
+
+	wl_list_remove(&commit->waiter_ready.link);
+	wlr_drm_syncobj_timeline_waiter_finish(&commit->waiter);
+	commit->waiting = false;
+
+	// May apply the state, and destroy the commit
+	wlr_surface_unlock_cached(commit->surface->surface, commit->seq);
+}
+
+static void surface_destroy(struct wlr_linux_drm_syncobj_surface_v1 *surface,
+		bool surface_alive) {
+	if (surface == NULL) {
+		return;
+	}
+
+	wlr_addon_finish(&surface->addon);
+	wl_list_remove(&surface->surface_client_commit.link);
+	wl_list_remove(&surface->surface_commit.link);
+	wl_resource_set_user_data(surface->resource, NULL);
+
+	// Don't leave cached states locked forever: their acquire points are
+	// discarded along with this object
+	struct wlr_linux_drm_syncobj_surface_v1_commit *commit, *tmp;
+	wl_list_for_each_safe(commit, tmp, &surface->commits, link) {
+		bool waiting = commit->waiting;
+		uint32_t seq = commit->seq;
+		surface_commit_destroy(commit);
+		if (waiting && surface_alive) {
+			wlr_surface_unlock_cached(surface->surface, seq);
+		}
+	}
+
+	state_finish(&surface->pending);
+	state_finish(&surface->current);
+	free(surface);
+}
+
+static void surface_handle_set_acquire_point(struct wl_client *client,
+		struct wl_resource *resource, struct wl_resource *timeline_resource,
+		uint32_t point_hi, uint32_t point_lo) {
+	struct wlr_linux_drm_syncobj_surface_v1 *surface =
+		surface_from_resource(resource);
+	if (surface == NULL) {
+		wl_resource_post_error(resource,
+			WP_LINUX_DRM_SYNCOBJ_SURFACE_V1_ERROR_NO_SURFACE,
+			"The surface has been destroyed");
+		return;
+	}
+
+	struct wlr_drm_syncobj_timeline *timeline =
+		timeline_from_resource(timeline_resource);
+	uint64_t point = (uint64_t)point_hi << 32 | point_lo;
+	state_set_acquire(&surface->pending, timeline, point);
+}
+
+static void surface_handle_set_release_point(struct wl_client *client,
+		struct wl_resource *resource, struct wl_resource *timeline_resource,
+		uint32_t point_hi, uint32_t point_lo) {
+	struct wlr_linux_drm_syncobj_surface_v1 *surface =
+		surface_from_resource(resource);
+	if (surface == NULL) {
+		wl_resource_post_error(resource,
+			WP_LINUX_DRM_SYNCOBJ_SURFACE_V1_ERROR_NO_SURFACE,
+			"The surface has been destroyed");
+		return;
+	}
+
+	struct wlr_drm_syncobj_timeline *timeline =
+		timeline_from_resource(timeline_resource);
+	uint64_t point = (uint64_t)point_hi << 32 | point_lo;
+	state_set_release(&surface->pending, timeline, point);
+}
+
+static const struct wp_linux_drm_syncobj_surface_v1_interface surface_impl = {
+	.destroy = resource_handle_destroy,
+	.set_acquire_point = surface_handle_set_acquire_point,
+	.set_release_point = surface_handle_set_release_point,
+};
+
+static void surface_handle_resource_destroy(struct wl_resource *resource) {
+	struct wlr_linux_drm_syncobj_surface_v1 *surface =
+		surface_from_resource(resource);
+	surface_destroy(surface, true);
+}
+
+static void surface_addon_destroy(struct wlr_addon *addon) {
+	struct wlr_linux_drm_syncobj_surface_v1 *surface =
+		wl_container_of(addon, surface, addon);
+	surface_destroy(surface, false);
+}
+
+static const struct wlr_addon_interface surface_addon_impl = {
+	.name = "wp_linux_drm_syncobj_surface_v1",
+	.destroy = surface_addon_destroy,
+};
+
+static bool check_pending_state(struct wlr_linux_drm_syncobj_surface_v1 *surface) {
+	const struct wlr_surface_state *surface_state = &surface->surface->pending;
+	const struct wlr_linux_drm_syncobj_surface_v1_state *state = &surface->pending;
+
+	bool has_buffer = (surface_state->committed & WLR_SURFACE_STATE_BUFFER) &&
+		surface_state->buffer != NULL;
+	if (!has_buffer) {
+		if (state->acquire_timeline != NULL || state->release_timeline != NULL) {
+			wl_resource_post_error(surface->resource,
+				WP_LINUX_DRM_SYNCOBJ_SURFACE_V1_ERROR_NO_BUFFER,
+				"Acquire or release point set but no buffer attached");
+			return false;
+		}
+		return true;
+	}
+
+	if (state->acquire_timeline == NULL) {
+		wl_resource_post_error(surface->resource,
+			WP_LINUX_DRM_SYNCOBJ_SURFACE_V1_ERROR_NO_ACQUIRE_POINT,
+			"Buffer attached but no acquire point set");
+		return false;
+	}
+	if (state->release_timeline == NULL) {
+		wl_resource_post_error(surface->resource,
+			WP_LINUX_DRM_SYNCOBJ_SURFACE_V1_ERROR_NO_RELEASE_POINT,
+			"Buffer attached but no release point set");
+		return false;
+	}
+
+	if (state->acquire_timeline == state->release_timeline &&
+			state->acquire_point >= state->release_point) {
+		wl_resource_post_error(surface->resource,
+			WP_LINUX_DRM_SYNCOBJ_SURFACE_V1_ERROR_CONFLICTING_POINTS,
+			"Acquire point must be lower than release point on the same timeline");
+		return false;
+	}
+
+	struct wlr_dmabuf_attributes dmabuf;
+	if (!wlr_buffer_get_dmabuf(surface_state->buffer, &dmabuf)) {
+		wl_resource_post_error(surface->resource,
+			WP_LINUX_DRM_SYNCOBJ_SURFACE_V1_ERROR_UNSUPPORTED_BUFFER,
+			"Only DMA-BUF buffers are supported");
+		return false;
+	}
+
+	return true;
+}
+
+static void surface_handle_surface_client_commit(struct wl_listener *listener,
+		void *data) {
+	struct wlr_linux_drm_syncobj_surface_v1 *surface =
+		wl_container_of(listener, surface, surface_client_commit);
+
+	if (!check_pending_state(surface)) {
+		return;
+	}
+	if (surface->pending.acquire_timeline == NULL) {
+		// No buffer attached, the current state is left as is
+		return;
+	}
+
+	struct wlr_linux_drm_syncobj_surface_v1_commit *commit =
+		calloc(1, sizeof(*commit));
+	if (commit == NULL) {
+		wl_resource_post_no_memory(surface->resource);
+		return;
+	}
+
+	commit->surface = surface;
+	commit->seq = surface->surface->pending.seq;
+	state_move(&commit->state, &surface->pending);
+	wl_list_insert(surface->commits.prev, &commit->link);
+
+	// The compositor must be able to wait for the acquire point without
+	// blocking. Hold the state back until the point has materialized, i.e.
+	// the client has submitted the work signalling it.
+	bool materialized = false;
+	if (!wlr_drm_syncobj_timeline_check(commit->state.acquire_timeline,
+			commit->state.acquire_point, DRM_SYNCOBJ_WAIT_FLAGS_WAIT_AVAILABLE,
+			&materialized)) {
+		wl_resource_post_no_memory(surface->resource);
+		return;
+	}
+	if (materialized) {
+		return;
+	}
+
+	struct wl_client *client = wl_resource_get_client(surface->resource);
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(wl_client_get_display(client));
+	if (!wlr_drm_syncobj_timeline_waiter_init(&commit->waiter,
+			commit->state.acquire_timeline, commit->state.acquire_point,
+			DRM_SYNCOBJ_WAIT_FLAGS_WAIT_AVAILABLE, loop)) {
+		wl_resource_post_no_memory(surface->resource);
+		return;
+	}
+
+	commit->waiting = true;
+	commit->waiter_ready.notify = surface_commit_handle_waiter_ready;
+	wl_signal_add(&commit->waiter.events.ready, &commit->waiter_ready);
+
+	wlr_surface_lock_pending(surface->surface);
+}
+
+// Other commit listeners may query the state before our own listener runs,
+// so this is called from both
+static void surface_update_current(struct wlr_linux_drm_syncobj_surface_v1 *surface) {
+	struct wlr_surface *wlr_surface = surface->surface;
+
+	if (surface->current_seq == wlr_surface->current.seq) {
+		return;
+	}
+	surface->current_seq = wlr_surface->current.seq;
+
+	if (!(wlr_surface->current.committed & WLR_SURFACE_STATE_BUFFER)) {
+		return;
+	}
+
+	struct wlr_linux_drm_syncobj_surface_v1_commit *commit, *found = NULL;
+	wl_list_for_each(commit, &surface->commits, link) {
+		if (commit->seq == wlr_surface->current.seq) {
+			found = commit;
+			break;
+		}
+	}
+
+	if (found == NULL) {
+		// NULL buffer
+		state_finish(&surface->current);
+		return;
+	}
+
+	assert(!found->waiting);
+	state_move(&surface->current, &found->state);
+	surface_commit_destroy(found);
+
+	struct wlr_buffer *buffer = wlr_surface->current.buffer;
+	if (buffer != NULL && !buffer_release_create(buffer,
+			surface->current.release_timeline, surface->current.release_point)) {
+		wl_resource_post_no_memory(surface->resource);
+	}
+}
+
+static void surface_handle_surface_commit(struct wl_listener *listener,
+		void *data) {
+	struct wlr_linux_drm_syncobj_surface_v1 *surface =
+		wl_container_of(listener, surface, surface_commit);
+	surface_update_current(surface);
+}
+
+static void manager_handle_get_surface(struct wl_client *client,
+		struct wl_resource *resource, uint32_t id,
+		struct wl_resource *surface_resource) {
+	struct wlr_surface *wlr_surface = wlr_surface_from_resource(surface_resource);
+
+	if (wlr_addon_find(&wlr_surface->addons, NULL, &surface_addon_impl) != NULL) {
+		wl_resource_post_error(resource,
+			WP_LINUX_DRM_SYNCOBJ_MANAGER_V1_ERROR_SURFACE_EXISTS,
+			"wp_linux_drm_syncobj_surface_v1 already created for this surface");
+		return;
+	}
+
+	struct wlr_linux_drm_syncobj_surface_v1 *surface = calloc(1, sizeof(*surface));
+	if (surface == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+
+	uint32_t version = wl_resource_get_version(resource);
+	surface->resource = wl_resource_create(client,
+		&wp_linux_drm_syncobj_surface_v1_interface, version, id);
+	if (surface->resource == NULL) {
+		wl_client_post_no_memory(client);
+		free(surface);
+		return;
+	}
+	wl_resource_set_implementation(surface->resource, &surface_impl,
+		surface, surface_handle_resource_destroy);
+
+	surface->surface = wlr_surface;
+	surface->current_seq = wlr_surface->current.seq;
+	wl_list_init(&surface->commits);
+
+	wlr_addon_init(&surface->addon, &wlr_surface->addons, NULL,
+		&surface_addon_impl);
+
+	surface->surface_client_commit.notify = surface_handle_surface_client_commit;
+	wl_signal_add(&wlr_surface->events.client_commit,
+		&surface->surface_client_commit);
+	surface->surface_commit.notify = surface_handle_surface_commit;
+	wl_signal_add(&wlr_surface->events.commit, &surface->surface_commit);
+}
+
+static const struct wp_linux_drm_syncobj_timeline_v1_interface timeline_impl = {
+	.destroy = resource_handle_destroy,
+};
+
+static void timeline_handle_resource_destroy(struct wl_resource *resource) {
+	struct wlr_drm_syncobj_timeline *timeline = timeline_from_resource(resource);
+	wlr_drm_syncobj_timeline_unref(timeline);
+}
+
+static void manager_handle_import_timeline(struct wl_client *client,
+		struct wl_resource *resource, uint32_t id, int drm_syncobj_fd) {
+	struct wlr_linux_drm_syncobj_manager_v1 *manager =
+		manager_from_resource(resource);
+
+	struct wlr_drm_syncobj_timeline *timeline =
+		wlr_drm_syncobj_timeline_import(manager->drm_fd, drm_syncobj_fd);
+	close(drm_syncobj_fd);
+	if (timeline == NULL) {
+		wl_resource_post_error(resource,
+			WP_LINUX_DRM_SYNCOBJ_MANAGER_V1_ERROR_INVALID_TIMELINE,
+			"Failed to import drm_syncobj timeline");
+		return;
+	}
+
+	uint32_t version = wl_resource_get_version(resource);
+	struct wl_resource *timeline_resource = wl_resource_create(client,
+		&wp_linux_drm_syncobj_timeline_v1_interface, version, id);
+	if (timeline_resource == NULL) {
+		wlr_drm_syncobj_timeline_unref(timeline);
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(timeline_resource, &timeline_impl,
+		timeline, timeline_handle_resource_destroy);
+}
+
+static const struct wp_linux_drm_syncobj_manager_v1_interface manager_impl = {
+	.destroy = resource_handle_destroy,
+	.get_surface = manager_handle_get_surface,
+	.import_timeline = manager_handle_import_timeline,
+};
+
+static void manager_bind(struct wl_client *client, void *data,
+		uint32_t version, uint32_t id) {
+	struct wlr_linux_drm_syncobj_manager_v1 *manager = data;
+
+	struct wl_resource *resource = wl_resource_create(client,
+		&wp_linux_drm_syncobj_manager_v1_interface, version, id);
+	if (resource == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(resource, &manager_impl, manager, NULL);
+}
+
+static void manager_handle_display_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_linux_drm_syncobj_manager_v1 *manager =
+		wl_container_of(listener, manager, display_destroy);
+	wl_list_remove(&manager->display_destroy.link);
+	wl_global_destroy(manager->global);
+	free(manager);
+}
+
+struct wlr_linux_drm_syncobj_manager_v1 *wlr_linux_drm_syncobj_manager_v1_create(
+		struct wl_display *display, uint32_t version, int drm_fd) {
+	assert(version <= LINUX_DRM_SYNCOBJ_V1_VERSION);
+
+	uint64_t cap_syncobj_timeline;
+	if (drmGetCap(drm_fd, DRM_CAP_SYNCOBJ_TIMELINE, &cap_syncobj_timeline) != 0 ||
+			cap_syncobj_timeline == 0) {
+		wlr_log(WLR_INFO, "DRM_CAP_SYNCOBJ_TIMELINE not supported, "
+			"linux-drm-syncobj-v1 disabled");
+		return NULL;
+	}
+
+	struct wlr_linux_drm_syncobj_manager_v1 *manager = calloc(1, sizeof(*manager));
+	if (manager == NULL) {
+		return NULL;
+	}
+
+	manager->drm_fd = drm_fd;
+
+	manager->global = wl_global_create(display,
+		&wp_linux_drm_syncobj_manager_v1_interface, version, manager,
+		manager_bind);
+	if (manager->global == NULL) {
+		free(manager);
+		return NULL;
+	}
+
+	manager->display_destroy.notify = manager_handle_display_destroy;
+	wl_display_add_destroy_listener(display, &manager->display_destroy);
+
+	return manager;
+}
+
+const struct wlr_linux_drm_syncobj_surface_v1_state *
+wlr_linux_drm_syncobj_v1_get_surface_state(struct wlr_surface *wlr_surface) {
+	struct wlr_addon *addon =
+		wlr_addon_find(&wlr_surface->addons, NULL, &surface_addon_impl);
+	if (addon == NULL) {
+		return NULL;
+	}
+
+	struct wlr_linux_drm_syncobj_surface_v1 *surface =
+		wl_container_of(addon, surface, addon);
+	surface_update_current(surface);
+	return &surface->current;
+}
@@ -0,0 +1,229 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <stdlib.h>
+#include <time.h>
+#include <wlr/types/wlr_output_frame_scheduler.h>
+#include <wlr/util/log.h>
+#include "types/wlr_output.h"
+#include "util/time.h"
+
+// Number of frames the render duration prediction is based on
+#define DURATIONS_CAP 32
+// Number of frames sent without delay after a missed deadline
+#define MISS_BACKOFF_FRAMES 16
+#define DEFAULT_MARGIN_NS 2000000
+// Delays shorter than this aren't worth a timer
+#define MIN_DELAY_NS 1000000
+
+struct wlr_output_frame_scheduler {
+	struct wlr_output *output;
+	struct wl_event_source *timer;
+	int64_t margin_ns;
+
+	int64_t durations[DURATIONS_CAP]; // ring buffer
+	size_t durations_len, durations_next;
+
+	int64_t frame_ns; // when the last frame event was sent, zero if committed
+	int64_t reported_ns; // render duration reported for the next commit
+	int64_t vblank_ns; // last hardware vblank timestamp, zero if unknown
+	int64_t refresh_ns; // refresh period from presentation feedback
+	int64_t target_ns; // vblank targeted by the delayed frame, zero if none
+	int backoff_frames;
+	bool delayed; // a frame event is waiting for the timer
+
+	struct wlr_output_frame_scheduler_stats stats;
+};
+
+static int64_t get_current_time_nsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return timespec_to_nsec(&now);
+}
+
+static int handle_timer(void *data) {
+	struct wlr_output_frame_scheduler *scheduler = data;
+	output_emit_frame(scheduler->output);
+	return 0;
+}
+
+struct wlr_output_frame_scheduler *wlr_output_frame_scheduler_create(
+		struct wlr_output *output) {
+	if (output->frame_scheduler != NULL) {
+		wlr_log(WLR_ERROR, "Output %s already has a frame scheduler",
+			output->name);
+		return NULL;
+	}
+
+	struct wlr_output_frame_scheduler *scheduler = calloc(1, sizeof(*scheduler));
+	if (scheduler == NULL) {
+		return NULL;
+	}
+
+	scheduler->timer = wl_event_loop_add_timer(output->event_loop,
+		handle_timer, scheduler);
+	if (scheduler->timer == NULL) {
+		free(scheduler);
+		return NULL;
+	}
+
+	scheduler->output = output;
+	scheduler->margin_ns = DEFAULT_MARGIN_NS;
+	output->frame_scheduler = scheduler;
+
+	return scheduler;
+}
+
+void wlr_output_frame_scheduler_destroy(
+		struct wlr_output_frame_scheduler *scheduler) {
+	if (scheduler == NULL) {
+		return;
+	}
+
+	struct wlr_output *output = scheduler->output;
+	output->frame_scheduler = NULL;
+
+	// Don't lose a delayed frame event
+	bool delayed = scheduler->delayed;
+	wl_event_source_remove(scheduler->timer);
+	free(scheduler);
+
+	if (delayed) {
+		output_emit_frame(output);
+	}
+}
+
+void wlr_output_frame_scheduler_set_margin(
+		struct wlr_output_frame_scheduler *scheduler, int64_t margin_ns) {
+	assert(margin_ns >= 0);
+	scheduler->margin_ns = margin_ns;
+}
+
+void wlr_output_frame_scheduler_report_render_duration(
+		struct wlr_output_frame_scheduler *scheduler, int64_t duration_ns) {
+	if (duration_ns > scheduler->reported_ns) {
+		scheduler->reported_ns = duration_ns;
+	}
+}
+
+static int64_t predict_render_duration(
+		const struct wlr_output_frame_scheduler *scheduler) {
+	// Worst case over the window: a late frame costs a full refresh cycle,
+	// an early one only costs a bit of latency
+	int64_t max = 0;
+	for (size_t i = 0; i < scheduler->durations_len; i++) {
+		if (scheduler->durations[i] > max) {
+			max = scheduler->durations[i];
+		}
+	}
+	return max;
+}
+
+void wlr_output_frame_scheduler_get_stats(
+		struct wlr_output_frame_scheduler *scheduler,
+		struct wlr_output_frame_scheduler_stats *stats) {
+	*stats = scheduler->stats;
+	stats->predicted_render_ns = predict_render_duration(scheduler);
+}
+
+static int64_t get_refresh_nsec(const struct wlr_output_frame_scheduler *scheduler) {
+	if (scheduler->refresh_ns > 0) {
+		return scheduler->refresh_ns;
+	}
+	if (scheduler->output->refresh > 0) {
+		return 1000000000000LL / scheduler->output->refresh;
+	}
+	return 0;
+}
+
+bool output_frame_scheduler_delay_frame(
+		struct wlr_output_frame_scheduler *scheduler) {
+	scheduler->target_ns = 0;
+
+	if (scheduler->backoff_frames > 0) {
+		scheduler->backoff_frames--;
+		return false;
+	}
+
+	int64_t refresh_ns = get_refresh_nsec(scheduler);
+	if (refresh_ns == 0 || scheduler->durations_len == 0) {
+		return false;
+	}
+
+	// Backends send frame events right after vblank. Use the hardware
+	// timestamp if there is a recent one.
+	int64_t now = get_current_time_nsec();
+	int64_t vblank_ns = scheduler->vblank_ns;
+	if (vblank_ns == 0 || vblank_ns > now || now - vblank_ns >= refresh_ns) {
+		vblank_ns = now;
+	}
+
+	int64_t target_ns = vblank_ns + refresh_ns;
+	int64_t delay_ns = target_ns - predict_render_duration(scheduler) -
+		scheduler->margin_ns - now;
+	if (delay_ns < MIN_DELAY_NS) {
+		return false;
+	}
+
+	// Round down, the timer has millisecond granularity
+	wl_event_source_timer_update(scheduler->timer, delay_ns / 1000000);
+
+	scheduler->target_ns = target_ns;
+	scheduler->delayed = true;
+	scheduler->stats.delayed_frames++;
+	scheduler->stats.last_delay_ns = delay_ns;
+	return true;
+}
+
+void output_frame_scheduler_handle_frame(
+		struct wlr_output_frame_scheduler *scheduler) {
+	if (scheduler->delayed) {
+		wl_event_source_timer_update(scheduler->timer, 0);
+		scheduler->delayed = false;
+	}
+	scheduler->frame_ns = get_current_time_nsec();
+	scheduler->reported_ns = 0;
+	scheduler->stats.frames++;
+}
+
+void output_frame_scheduler_handle_commit(
+		struct wlr_output_frame_scheduler *scheduler) {
+	if (scheduler->frame_ns == 0) {
+		// Not a response to a frame event
+		return;
+	}
+
+	int64_t now = get_current_time_nsec();
+	int64_t duration_ns = now - scheduler->frame_ns;
+	if (scheduler->reported_ns > duration_ns) {
+		duration_ns = scheduler->reported_ns;
+	}
+
+	scheduler->durations[scheduler->durations_next] = duration_ns;
+	scheduler->durations_next = (scheduler->durations_next + 1) % DURATIONS_CAP;
+	if (scheduler->durations_len < DURATIONS_CAP) {
+		scheduler->durations_len++;
+	}
+
+	if (scheduler->target_ns != 0 && now > scheduler->target_ns) {
+		scheduler->stats.missed_frames++;
+		scheduler->backoff_frames = MISS_BACKOFF_FRAMES;
+	}
+
+	scheduler->frame_ns = 0;
+	scheduler->reported_ns = 0;
+	scheduler->target_ns = 0;
+}
+
+void output_frame_scheduler_handle_present(
+		struct wlr_output_frame_scheduler *scheduler,
+		const struct wlr_output_event_present *event) {
+	if (!event->presented) {
+		return;
+	}
+	if (event->refresh > 0) {
+		scheduler->refresh_ns = event->refresh;
+	}
+	if ((event->flags & WLR_OUTPUT_PRESENT_VSYNC) && event->when != NULL) {
+		scheduler->vblank_ns = timespec_to_nsec(event->when);
+	}
+}
@@ -0,0 +1,126 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <stdlib.h>
+#include <time.h>
+#include <wlr/types/wlr_output_trace.h>
+#include <wlr/util/log.h>
+#include "types/wlr_output.h"
+#include "util/time.h"
+
+struct wlr_output_trace {
+	struct wlr_output *output;
+
+	struct wlr_output_trace_event *events;
+	size_t capacity; // power of two
+	uint64_t head, tail; // write and read positions
+	uint64_t dropped;
+};
+
+struct wlr_output_trace *wlr_output_trace_create(struct wlr_output *output,
+		size_t capacity) {
+	assert(capacity > 0);
+
+	if (output->trace != NULL) {
+		wlr_log(WLR_ERROR, "Output %s is already traced", output->name);
+		return NULL;
+	}
+
+	size_t ring_capacity = 1;
+	while (ring_capacity < capacity) {
+		ring_capacity *= 2;
+	}
+
+	struct wlr_output_trace *trace = calloc(1, sizeof(*trace));
+	if (trace == NULL) {
+		return NULL;
+	}
+
+	trace->events = calloc(ring_capacity, sizeof(trace->events[0]));
+	if (trace->events == NULL) {
+		free(trace);
+		return NULL;
+	}
+
+	trace->output = output;
+	trace->capacity = ring_capacity;
+	output->trace = trace;
+
+	return trace;
+}
+
+void wlr_output_trace_destroy(struct wlr_output_trace *trace) {
+	if (trace == NULL) {
+		return;
+	}
+
+	trace->output->trace = NULL;
+	free(trace->events);
+	free(trace);
+}
+
+void output_trace_record(struct wlr_output *output,
+		enum wlr_output_trace_stage stage, const struct timespec *when,
+		uint32_t commit_seq) {
+	struct wlr_output_trace *trace = output->trace;
+
+	struct timespec now;
+	if (when == NULL) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		when = &now;
+	}
+
+	if (trace->head - trace->tail == trace->capacity) {
+		trace->tail++;
+		trace->dropped++;
+	}
+
+	trace->events[trace->head & (trace->capacity - 1)] =
+		(struct wlr_output_trace_event){
+			.stage = stage,
+			.time_ns = timespec_to_nsec(when),
+			.commit_seq = commit_seq,
+		};
+	trace->head++;
+}
+
+size_t wlr_output_trace_read(struct wlr_output_trace *trace,
+		struct wlr_output_trace_event *events, size_t len) {
+	size_t n = 0;
+	while (n < len && trace->tail != trace->head) {
+		events[n++] = trace->events[trace->tail & (trace->capacity - 1)];
+		trace->tail++;
+	}
+	return n;
+}
+
+uint64_t wlr_output_trace_get_dropped(struct wlr_output_trace *trace) {
+	return trace->dropped;
+}
+
+const char *wlr_output_trace_stage_name(enum wlr_output_trace_stage stage) {
+	switch (stage) {
+	case WLR_OUTPUT_TRACE_SCHEDULE_FRAME:
+		return "schedule_frame";
+	case WLR_OUTPUT_TRACE_FRAME:
+		return "frame";
+	case WLR_OUTPUT_TRACE_BUILD_STATE_BEGIN:
+		return "build_state_begin";
+	case WLR_OUTPUT_TRACE_RENDER_BEGIN:
+		return "render_begin";
+	case WLR_OUTPUT_TRACE_BUILD_STATE_END:
+		return "build_state_end";
+	case WLR_OUTPUT_TRACE_COMMIT_BEGIN:
+		return "commit_begin";
+	case WLR_OUTPUT_TRACE_BACKEND_COMMIT_BEGIN:
+		return "backend_commit_begin";
+	case WLR_OUTPUT_TRACE_BACKEND_COMMIT_END:
+		return "backend_commit_end";
+	case WLR_OUTPUT_TRACE_COMMIT_END:
+		return "commit_end";
+	case WLR_OUTPUT_TRACE_PRESENT:
+		return "present";
+	case WLR_OUTPUT_TRACE_DISCARD:
+		return "discard";
+	}
+	return "unknown";
+}
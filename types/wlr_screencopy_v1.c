@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <drm_fourcc.h>
 #include <wlr/interfaces/wlr_output.h>
 #include <wlr/render/allocator.h>
@@ -7,6 +8,7 @@
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_screencopy_v1.h>
 #include <wlr/backend.h>
+#include <wlr/util/addon.h>
 #include <wlr/util/box.h>
 #include <wlr/util/log.h>
 #include <wlr/util/transform.h>
@@ -22,6 +24,31 @@ struct screencopy_damage {
 	struct pixman_region32 damage;
 	struct wl_listener output_precommit;
 	struct wl_listener output_destroy;
+
+	// Compositor-owned copy of the last shm capture with damage, its contents
+	// are only outdated in the damaged region. Only that region needs to be
+	// read back from the output, the rest is copied from here.
+	void *shadow_data; // NULL if none
+	uint32_t shadow_format;
+	size_t shadow_stride;
+	struct wlr_box shadow_box;
+
+	// Client buffer which received the last capture with damage, only the
+	// damaged rows need to be copied into it again
+	struct wlr_buffer *last_buffer; // may be NULL
+	struct wl_listener last_buffer_destroy;
+};
+
+/**
+ * A texture for an output buffer, kept around across captures. The texture
+ * is imported from the DMA-BUF attributes instead of the buffer itself, so
+ * that it doesn't keep the buffer locked: the swapchain can re-use the buffer
+ * as soon as the output is done with it.
+ */
+struct screencopy_texture {
+	struct wlr_texture *texture;
+	struct wlr_addon addon; // wlr_buffer.addons, owned by the renderer
+	struct wl_listener renderer_destroy;
 };
 
 static const struct zwlr_screencopy_frame_v1_interface frame_impl;
@@ -66,7 +93,32 @@ static void screencopy_damage_handle_output_precommit(
 	screencopy_damage_accumulate(damage, event->state);
 }
 
+static void screencopy_damage_set_last_buffer(struct screencopy_damage *damage,
+		struct wlr_buffer *buffer) {
+	wl_list_remove(&damage->last_buffer_destroy.link);
+	wl_list_init(&damage->last_buffer_destroy.link);
+	damage->last_buffer = buffer;
+	if (buffer != NULL) {
+		wl_signal_add(&buffer->events.destroy, &damage->last_buffer_destroy);
+	}
+}
+
+static void screencopy_damage_handle_last_buffer_destroy(
+		struct wl_listener *listener, void *data) {
+	struct screencopy_damage *damage =
+		wl_container_of(listener, damage, last_buffer_destroy);
+	screencopy_damage_set_last_buffer(damage, NULL);
+}
+
+static void screencopy_damage_clear_shadow(struct screencopy_damage *damage) {
+	free(damage->shadow_data);
+	damage->shadow_data = NULL;
+	screencopy_damage_set_last_buffer(damage, NULL);
+}
+
 static void screencopy_damage_destroy(struct screencopy_damage *damage) {
+	screencopy_damage_clear_shadow(damage);
+	wl_list_remove(&damage->last_buffer_destroy.link);
 	wl_list_remove(&damage->output_destroy.link);
 	wl_list_remove(&damage->output_precommit.link);
 	wl_list_remove(&damage->link);
@@ -101,6 +153,10 @@ static struct screencopy_damage *screencopy_damage_create(
 	wl_signal_add(&output->events.destroy, &damage->output_destroy);
 	damage->output_destroy.notify = screencopy_damage_handle_output_destroy;
 
+	wl_list_init(&damage->last_buffer_destroy.link);
+	damage->last_buffer_destroy.notify =
+		screencopy_damage_handle_last_buffer_destroy;
+
 	return damage;
 }
 
@@ -111,6 +167,85 @@ static struct screencopy_damage *screencopy_damage_get_or_create(
 	return damage ? damage : screencopy_damage_create(client, output);
 }
 
+static void screencopy_texture_destroy(struct screencopy_texture *sc_texture) {
+	wlr_texture_destroy(sc_texture->texture);
+	wl_list_remove(&sc_texture->renderer_destroy.link);
+	wlr_addon_finish(&sc_texture->addon);
+	free(sc_texture);
+}
+
+static void screencopy_texture_addon_destroy(struct wlr_addon *addon) {
+	struct screencopy_texture *sc_texture =
+		wl_container_of(addon, sc_texture, addon);
+	screencopy_texture_destroy(sc_texture);
+}
+
+static const struct wlr_addon_interface screencopy_texture_addon_impl = {
+	.name = "wlr_screencopy_texture_v1",
+	.destroy = screencopy_texture_addon_destroy,
+};
+
+static void screencopy_texture_handle_renderer_destroy(
+		struct wl_listener *listener, void *data) {
+	struct screencopy_texture *sc_texture =
+		wl_container_of(listener, sc_texture, renderer_destroy);
+	screencopy_texture_destroy(sc_texture);
+}
+
+/**
+ * Get a texture for a buffer committed on the output. Textures for DMA-BUFs
+ * are cached until the buffer is destroyed. The caller must release the
+ * texture with screencopy_put_texture().
+ */
+static struct wlr_texture *screencopy_get_texture(struct wlr_renderer *renderer,
+		struct wlr_buffer *buffer) {
+	struct wlr_addon *addon = wlr_addon_find(&buffer->addons, renderer,
+		&screencopy_texture_addon_impl);
+	if (addon != NULL) {
+		struct screencopy_texture *sc_texture =
+			wl_container_of(addon, sc_texture, addon);
+		return sc_texture->texture;
+	}
+
+	struct wlr_dmabuf_attributes dmabuf;
+	if (!wlr_buffer_get_dmabuf(buffer, &dmabuf)) {
+		return wlr_texture_from_buffer(renderer, buffer);
+	}
+
+	struct screencopy_texture *sc_texture = calloc(1, sizeof(*sc_texture));
+	if (sc_texture == NULL) {
+		return wlr_texture_from_buffer(renderer, buffer);
+	}
+
+	sc_texture->texture = wlr_texture_from_dmabuf(renderer, &dmabuf);
+	if (sc_texture->texture == NULL) {
+		free(sc_texture);
+		return NULL;
+	}
+
+	wlr_addon_init(&sc_texture->addon, &buffer->addons, renderer,
+		&screencopy_texture_addon_impl);
+	sc_texture->renderer_destroy.notify =
+		screencopy_texture_handle_renderer_destroy;
+	wl_signal_add(&renderer->events.destroy, &sc_texture->renderer_destroy);
+
+	return sc_texture->texture;
+}
+
+static void screencopy_put_texture(struct wlr_renderer *renderer,
+		struct wlr_buffer *buffer, struct wlr_texture *texture) {
+	struct wlr_addon *addon = wlr_addon_find(&buffer->addons, renderer,
+		&screencopy_texture_addon_impl);
+	if (addon != NULL) {
+		struct screencopy_texture *sc_texture =
+			wl_container_of(addon, sc_texture, addon);
+		if (sc_texture->texture == texture) {
+			return;
+		}
+	}
+	wlr_texture_destroy(texture);
+}
+
 static void client_unref(struct wlr_screencopy_v1_client *client) {
 	assert(client->ref > 0);
 
@@ -189,8 +324,96 @@ static void frame_send_ready(struct wlr_screencopy_frame_v1 *frame,
 		tv_sec_hi, tv_sec_lo, when->tv_nsec);
 }
 
+/**
+ * Update the shadow copy of the capture from the output texture, reading back
+ * only the damaged region if the shadow is up-to-date elsewhere. Returns false
+ * on failure, and sets full if the whole capture has been read back.
+ */
+static bool frame_update_shadow(struct wlr_screencopy_frame_v1 *frame,
+		struct screencopy_damage *damage, const pixman_region32_t *region,
+		struct wlr_texture *texture, uint32_t format, size_t stride,
+		bool *full) {
+	if (damage->shadow_data != NULL && damage->shadow_format == format &&
+			damage->shadow_stride == stride &&
+			wlr_box_equal(&damage->shadow_box, &frame->box)) {
+		*full = false;
+
+		int rects_len;
+		const pixman_box32_t *rects = pixman_region32_rectangles(region, &rects_len);
+		for (int i = 0; i < rects_len; i++) {
+			if (!wlr_texture_read_pixels(texture, &(struct wlr_texture_read_pixels_options) {
+					.data = damage->shadow_data,
+					.format = format,
+					.stride = stride,
+					.dst_x = rects[i].x1 - frame->box.x,
+					.dst_y = rects[i].y1 - frame->box.y,
+					.src_box = {
+						.x = rects[i].x1,
+						.y = rects[i].y1,
+						.width = rects[i].x2 - rects[i].x1,
+						.height = rects[i].y2 - rects[i].y1,
+					},
+				})) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	*full = true;
+
+	screencopy_damage_clear_shadow(damage);
+	void *data = malloc(stride * frame->box.height);
+	if (data == NULL) {
+		return false;
+	}
+	if (!wlr_texture_read_pixels(texture, &(struct wlr_texture_read_pixels_options) {
+				.data = data,
+				.format = format,
+				.stride = stride,
+				.src_box = frame->box,
+			})) {
+		free(data);
+		return false;
+	}
+
+	damage->shadow_data = data;
+	damage->shadow_format = format;
+	damage->shadow_stride = stride;
+	damage->shadow_box = frame->box;
+	return true;
+}
+
+/**
+ * Copy the rows of the shadow covered by the region into the client buffer.
+ */
+static void frame_copy_shadow_rows(struct wlr_screencopy_frame_v1 *frame,
+		struct screencopy_damage *damage, const pixman_region32_t *region,
+		void *data) {
+	size_t stride = damage->shadow_stride;
+
+	// Rectangles are sorted by band, rows shared between rectangles of a
+	// band are only copied once
+	int copied_y2 = 0;
+	int rects_len;
+	const pixman_box32_t *rects = pixman_region32_rectangles(region, &rects_len);
+	for (int i = 0; i < rects_len; i++) {
+		int y1 = rects[i].y1 - frame->box.y;
+		int y2 = rects[i].y2 - frame->box.y;
+		if (y1 < copied_y2) {
+			y1 = copied_y2;
+		}
+		if (y1 >= y2) {
+			continue;
+		}
+		memcpy((char *)data + y1 * stride,
+			(char *)damage->shadow_data + y1 * stride, (y2 - y1) * stride);
+		copied_y2 = y2;
+	}
+}
+
 static bool frame_shm_copy(struct wlr_screencopy_frame_v1 *frame,
-		struct wlr_buffer *src_buffer) {
+		struct wlr_buffer *src_buffer, struct screencopy_damage *damage) {
 	struct wlr_output *output = frame->output;
 	struct wlr_renderer *renderer = output->renderer;
 	assert(renderer);
@@ -205,19 +428,43 @@ static bool frame_shm_copy(struct wlr_screencopy_frame_v1 *frame,
 
 	bool ok = false;
 
-	struct wlr_texture *texture = wlr_texture_from_buffer(renderer, src_buffer);
+	struct wlr_texture *texture = screencopy_get_texture(renderer, src_buffer);
 	if (!texture) {
 		goto out;
 	}
 
-	ok = wlr_texture_read_pixels(texture, &(struct wlr_texture_read_pixels_options) {
-		.data = data,
-		.format = format,
-		.stride = stride,
-		.src_box = frame->box,
-	});
+	if (damage != NULL) {
+		pixman_region32_t region;
+		pixman_region32_init(&region);
+		pixman_region32_intersect_rect(&region, &damage->damage,
+			frame->box.x, frame->box.y, frame->box.width, frame->box.height);
+
+		bool full;
+		ok = frame_update_shadow(frame, damage, &region, texture, format,
+			stride, &full);
+		if (ok && !full && damage->last_buffer == frame->buffer) {
+			// The client buffer still holds the previous capture
+			frame_copy_shadow_rows(frame, damage, &region, data);
+		} else if (ok) {
+			memcpy(data, damage->shadow_data, stride * frame->box.height);
+		}
+		pixman_region32_fini(&region);
 
-	wlr_texture_destroy(texture);
+		if (ok) {
+			screencopy_damage_set_last_buffer(damage, frame->buffer);
+		} else {
+			screencopy_damage_clear_shadow(damage);
+		}
+	} else {
+		ok = wlr_texture_read_pixels(texture, &(struct wlr_texture_read_pixels_options) {
+			.data = data,
+			.format = format,
+			.stride = stride,
+			.src_box = frame->box,
+		});
+	}
+
+	screencopy_put_texture(renderer, src_buffer, texture);
 
 out:
 	wlr_buffer_end_data_ptr_access(frame->buffer);
@@ -231,9 +478,7 @@ static bool frame_dma_copy(struct wlr_screencopy_frame_v1 *frame,
 	struct wlr_renderer *renderer = output->renderer;
 	assert(renderer);
 
-
-	struct wlr_texture *src_tex =
-		wlr_texture_from_buffer(renderer, src_buffer);
+	struct wlr_texture *src_tex = screencopy_get_texture(renderer, src_buffer);
 	if (src_tex == NULL) {
 		return false;
 	}
@@ -264,7 +509,7 @@ static bool frame_dma_copy(struct wlr_screencopy_frame_v1 *frame,
 	ok = wlr_render_pass_submit(pass);
 
 out:
-	wlr_texture_destroy(src_tex);
+	screencopy_put_texture(renderer, src_buffer, src_tex);
 	return ok;
 }
 
@@ -285,9 +530,9 @@ static void frame_handle_output_commit(struct wl_listener *listener,
 		return;
 	}
 
+	struct screencopy_damage *damage = NULL;
 	if (frame->with_damage) {
-		struct screencopy_damage *damage =
-			screencopy_damage_get_or_create(frame->client, output);
+		damage = screencopy_damage_get_or_create(frame->client, output);
 		if (damage && !pixman_region32_not_empty(&damage->damage)) {
 			return;
 		}
@@ -310,7 +555,7 @@ static void frame_handle_output_commit(struct wl_listener *listener,
 		}
 		break;
 	case WLR_BUFFER_CAP_DATA_PTR:
-		if (!frame_shm_copy(frame, src_buffer)) {
+		if (!frame_shm_copy(frame, src_buffer, damage)) {
 			goto err;
 		}
 		break;
@@ -1,10 +1,13 @@
-#define _DEFAULT_SOURCE // for MAP_ANONYMOUS
+#define _GNU_SOURCE // for MAP_ANONYMOUS and F_GET_SEALS
 #include <assert.h>
 #include <drm_fourcc.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <stdatomic.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <wayland-server.h>
 #include <wlr/interfaces/wlr_buffer.h>
@@ -36,6 +39,7 @@ struct wlr_shm_pool {
 	struct wl_list buffers; // wlr_shm_buffer.link
 	int fd;
 	struct wlr_shm_mapping *mapping;
+	bool sealed; // the file can't shrink
 };
 
 /**
@@ -50,12 +54,22 @@ struct wlr_shm_mapping {
 	void *data;
 	size_t size;
 	bool dropped; // false while a wlr_shm_pool references this mapping
+	size_t accessors; // number of buffers with data pointer access
+	bool tracked; // in the mapping table
 };
 
-struct wlr_shm_sigbus_data {
-	struct wlr_shm_mapping *mapping;
-	struct sigaction prev_action;
-	struct wlr_shm_sigbus_data *_Atomic next;
+/**
+ * Mappings which may trigger SIGBUS, sorted by address. Mappings never
+ * overlap, so a binary search on the start address finds the faulting one.
+ *
+ * Published tables are never mutated, so that they can be read from the
+ * signal handler: updates build a new table and swap the pointer. Updates
+ * only happen on the event loop thread, while no other thread accesses the
+ * buffers.
+ */
+struct wlr_shm_mapping_table {
+	size_t len;
+	struct wlr_shm_mapping *mappings[];
 };
 
 struct wlr_shm_buffer {
@@ -69,11 +83,16 @@ struct wlr_shm_buffer {
 
 	struct wl_listener release;
 
-	struct wlr_shm_sigbus_data sigbus_data;
+	struct wlr_shm_mapping *access_mapping; // while accessing the data pointer
 };
 
 // Needs to be a lock-free atomic because it's accessed from a signal handler
-static struct wlr_shm_sigbus_data *_Atomic sigbus_data = NULL;
+static struct wlr_shm_mapping_table *_Atomic mapping_table = NULL;
+
+// The SIGBUS handler is installed while a wl_shm global or a tracked mapping
+// exists, instead of around each data pointer access
+static size_t sigbus_handler_refs = 0;
+static struct sigaction sigbus_prev_action;
 
 static const struct wl_buffer_interface wl_buffer_impl;
 static const struct wl_shm_pool_interface pool_impl;
@@ -104,7 +123,138 @@ static struct wlr_shm *shm_from_resource(struct wl_resource *resource) {
 	return wl_resource_get_user_data(resource);
 }
 
-static struct wlr_shm_mapping *mapping_create(int fd, size_t size) {
+static void handle_sigbus(int sig, siginfo_t *info, void *context);
+
+static bool sigbus_handler_ref(void) {
+	if (sigbus_handler_refs == 0) {
+		if (!atomic_is_lock_free(&mapping_table)) {
+			wlr_log(WLR_ERROR, "Lock-free atomic pointers are required");
+			return false;
+		}
+
+		// SIGBUS is triggered if a client shrinks the backing file, and then we
+		// try to access the mapping
+		struct sigaction new_action = {
+			.sa_sigaction = handle_sigbus,
+			.sa_flags = SA_SIGINFO | SA_NODEFER,
+		};
+		if (sigaction(SIGBUS, &new_action, &sigbus_prev_action) != 0) {
+			wlr_log_errno(WLR_ERROR, "sigaction failed");
+			return false;
+		}
+	}
+	sigbus_handler_refs++;
+	return true;
+}
+
+static void sigbus_handler_unref(void) {
+	assert(sigbus_handler_refs > 0);
+	sigbus_handler_refs--;
+	if (sigbus_handler_refs == 0) {
+		if (sigaction(SIGBUS, &sigbus_prev_action, NULL) != 0) {
+			wlr_log_errno(WLR_ERROR, "sigaction failed");
+		}
+	}
+}
+
+/**
+ * Find the index of the first mapping starting after addr.
+ */
+static size_t mapping_table_upper_bound(const struct wlr_shm_mapping_table *table,
+		uintptr_t addr) {
+	size_t lo = 0, hi = table->len;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if ((uintptr_t)table->mappings[mid]->data <= addr) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+static bool mapping_table_insert(struct wlr_shm_mapping *mapping) {
+	struct wlr_shm_mapping_table *old = mapping_table;
+	size_t old_len = old != NULL ? old->len : 0;
+
+	struct wlr_shm_mapping_table *table =
+		malloc(sizeof(*table) + (old_len + 1) * sizeof(table->mappings[0]));
+	if (table == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+
+	size_t i = old != NULL ? mapping_table_upper_bound(old, (uintptr_t)mapping->data) : 0;
+	if (i > 0) {
+		memcpy(table->mappings, old->mappings, i * sizeof(table->mappings[0]));
+	}
+	table->mappings[i] = mapping;
+	if (old_len > i) {
+		memcpy(&table->mappings[i + 1], &old->mappings[i],
+			(old_len - i) * sizeof(table->mappings[0]));
+	}
+	table->len = old_len + 1;
+
+	mapping_table = table;
+	free(old);
+	return true;
+}
+
+static void mapping_table_remove(struct wlr_shm_mapping *mapping) {
+	struct wlr_shm_mapping_table *table = mapping_table;
+	size_t i = mapping_table_upper_bound(table, (uintptr_t)mapping->data);
+	assert(i > 0 && table->mappings[i - 1] == mapping);
+
+	// Shift in place: a concurrent lookup may see a duplicate entry, but never
+	// an entry which doesn't point to a live mapping
+	memmove(&table->mappings[i - 1], &table->mappings[i],
+		(table->len - i) * sizeof(table->mappings[0]));
+	table->len--;
+
+	if (table->len == 0) {
+		mapping_table = NULL;
+		free(table);
+	}
+}
+
+static bool mapping_track(struct wlr_shm_mapping *mapping) {
+	if (!sigbus_handler_ref()) {
+		return false;
+	}
+	if (!mapping_table_insert(mapping)) {
+		sigbus_handler_unref();
+		return false;
+	}
+	mapping->tracked = true;
+	return true;
+}
+
+static void mapping_untrack(struct wlr_shm_mapping *mapping) {
+	if (!mapping->tracked) {
+		return;
+	}
+	mapping_table_remove(mapping);
+	mapping->tracked = false;
+	sigbus_handler_unref();
+}
+
+/**
+ * Check whether a mapping of the file can never trigger SIGBUS: the file must
+ * be sealed against shrinking, and already cover the whole mapping.
+ */
+static bool fd_covers_mapping(int fd, size_t size, bool sealed) {
+	if (!sealed) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		return false;
+	}
+	return st.st_size >= 0 && (size_t)st.st_size >= size;
+}
+
+static struct wlr_shm_mapping *mapping_create(int fd, size_t size, bool sealed) {
 	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
 	if (data == MAP_FAILED) {
 		wlr_log_errno(WLR_DEBUG, "mmap failed");
@@ -119,20 +269,25 @@ static struct wlr_shm_mapping *mapping_create(int fd, size_t size) {
 
 	mapping->data = data;
 	mapping->size = size;
+
+	// Mappings of sealed files large enough can't trigger SIGBUS, skip the
+	// bookkeeping
+	if (!fd_covers_mapping(fd, size, sealed) && !mapping_track(mapping)) {
+		munmap(data, size);
+		free(mapping);
+		return NULL;
+	}
+
 	return mapping;
 }
 
 static void mapping_consider_destroy(struct wlr_shm_mapping *mapping) {
-	if (!mapping->dropped) {
+	if (!mapping->dropped || mapping->accessors > 0) {
 		return;
 	}
 
-	for (struct wlr_shm_sigbus_data *cur = sigbus_data; cur != NULL; cur = cur->next) {
-		if (cur->mapping == mapping) {
-			return;
-		}
-	}
-
+	// Untrack before unmapping, the address range may be re-used right away
+	mapping_untrack(mapping);
 	munmap(mapping->data, mapping->size);
 	free(mapping);
 }
@@ -183,19 +338,20 @@ static bool buffer_get_shm(struct wlr_buffer *wlr_buffer,
 }
 
 static void handle_sigbus(int sig, siginfo_t *info, void *context) {
-	assert(sigbus_data != NULL);
-	struct sigaction prev_action = sigbus_data->prev_action;
+	struct sigaction prev_action = sigbus_prev_action;
 
-	// Check whether the offending address is inside of the wl_shm_pool's mapped
+	// Check whether the offending address is inside of a wl_shm_pool's mapped
 	// space
 	uintptr_t addr = (uintptr_t)info->si_addr;
+	struct wlr_shm_mapping_table *table = mapping_table;
 	struct wlr_shm_mapping *mapping = NULL;
-	for (struct wlr_shm_sigbus_data *data = sigbus_data; data != NULL; data = data->next) {
-		uintptr_t mapping_start = (uintptr_t)data->mapping->data;
-		size_t mapping_size = data->mapping->size;
-		if (addr >= mapping_start && addr < mapping_start + mapping_size) {
-			mapping = data->mapping;
-			break;
+	if (table != NULL) {
+		size_t i = mapping_table_upper_bound(table, addr);
+		if (i > 0) {
+			struct wlr_shm_mapping *candidate = table->mappings[i - 1];
+			if (addr < (uintptr_t)candidate->data + candidate->size) {
+				mapping = candidate;
+			}
 		}
 	}
 	if (mapping == NULL) {
@@ -224,35 +380,11 @@ static bool buffer_begin_data_ptr_access(struct wlr_buffer *wlr_buffer,
 		uint32_t flags, void **data, uint32_t *format, size_t *stride) {
 	struct wlr_shm_buffer *buffer = wl_container_of(wlr_buffer, buffer, base);
 
-	if (!atomic_is_lock_free(&sigbus_data)) {
-		wlr_log(WLR_ERROR, "Lock-free atomic pointers are required");
-		return false;
-	}
-
-	// Install a SIGBUS handler. SIGBUS is triggered if the client shrinks the
-	// backing file, and then we try to access the mapping.
-	struct sigaction prev_action;
-	if (sigbus_data == NULL) {
-		struct sigaction new_action = {
-			.sa_sigaction = handle_sigbus,
-			.sa_flags = SA_SIGINFO | SA_NODEFER,
-		};
-		if (sigaction(SIGBUS, &new_action, &prev_action) != 0) {
-			wlr_log_errno(WLR_ERROR, "sigaction failed");
-			return false;
-		}
-	} else {
-		prev_action = sigbus_data->prev_action;
-	}
-
+	// The SIGBUS handler is already installed and the mapping is already
+	// tracked, only keep the mapping alive until the access ends
 	struct wlr_shm_mapping *mapping = buffer->pool->mapping;
-
-	buffer->sigbus_data = (struct wlr_shm_sigbus_data){
-		.mapping = mapping,
-		.prev_action = prev_action,
-		.next = sigbus_data,
-	};
-	sigbus_data = &buffer->sigbus_data;
+	mapping->accessors++;
+	buffer->access_mapping = mapping;
 
 	*data = (char *)mapping->data + buffer->offset;
 	*format = buffer->drm_format;
@@ -263,24 +395,12 @@ static bool buffer_begin_data_ptr_access(struct wlr_buffer *wlr_buffer,
 static void buffer_end_data_ptr_access(struct wlr_buffer *wlr_buffer) {
 	struct wlr_shm_buffer *buffer = wl_container_of(wlr_buffer, buffer, base);
 
-	if (sigbus_data == &buffer->sigbus_data) {
-		sigbus_data = buffer->sigbus_data.next;
-	} else {
-		for (struct wlr_shm_sigbus_data *cur = sigbus_data; cur != NULL; cur = cur->next) {
-			if (cur->next == &buffer->sigbus_data) {
-				cur->next = buffer->sigbus_data.next;
-				break;
-			}
-		}
-	}
+	struct wlr_shm_mapping *mapping = buffer->access_mapping;
+	buffer->access_mapping = NULL;
 
-	if (sigbus_data == NULL) {
-		if (sigaction(SIGBUS, &buffer->sigbus_data.prev_action, NULL) != 0) {
-			wlr_log_errno(WLR_ERROR, "sigaction failed");
-		}
-	}
-
-	mapping_consider_destroy(buffer->sigbus_data.mapping);
+	assert(mapping->accessors > 0);
+	mapping->accessors--;
+	mapping_consider_destroy(mapping);
 }
 
 static const struct wlr_buffer_impl buffer_impl = {
@@ -386,7 +506,7 @@ static void pool_handle_resize(struct wl_client *client,
 		return;
 	}
 
-	struct wlr_shm_mapping *mapping = mapping_create(pool->fd, size);
+	struct wlr_shm_mapping *mapping = mapping_create(pool->fd, size, pool->sealed);
 	if (mapping == NULL) {
 		wl_resource_post_error(pool_resource, WL_SHM_ERROR_INVALID_FD,
 			"Failed to create memory mapping");
@@ -419,6 +539,16 @@ static void pool_handle_resource_destroy(struct wl_resource *resource) {
 	pool_consider_destroy(pool);
 }
 
+static bool fd_is_shrink_sealed(int fd) {
+#ifdef F_GET_SEALS
+	int seals = fcntl(fd, F_GET_SEALS);
+	// Seals can't be removed once set
+	return seals >= 0 && (seals & F_SEAL_SHRINK);
+#else
+	return false;
+#endif
+}
+
 static void shm_handle_create_pool(struct wl_client *client,
 		struct wl_resource *shm_resource, uint32_t id, int fd, int32_t size) {
 	struct wlr_shm *shm = shm_from_resource(shm_resource);
@@ -429,7 +559,8 @@ static void shm_handle_create_pool(struct wl_client *client,
 		goto error_fd;
 	}
 
-	struct wlr_shm_mapping *mapping = mapping_create(fd, size);
+	bool sealed = fd_is_shrink_sealed(fd);
+	struct wlr_shm_mapping *mapping = mapping_create(fd, size, sealed);
 	if (mapping == NULL) {
 		wl_resource_post_error(shm_resource, WL_SHM_ERROR_INVALID_FD,
 			"Failed to create memory mapping");
@@ -455,6 +586,7 @@ static void shm_handle_create_pool(struct wl_client *client,
 	pool->mapping = mapping;
 	pool->shm = shm;
 	pool->fd = fd;
+	pool->sealed = sealed;
 	wl_list_init(&pool->buffers);
 	return;
 
@@ -491,6 +623,7 @@ static void handle_display_destroy(struct wl_listener *listener, void *data) {
 	struct wlr_shm *shm = wl_container_of(listener, shm, display_destroy);
 	wl_list_remove(&shm->display_destroy.link);
 	wl_global_destroy(shm->global);
+	sigbus_handler_unref();
 	free(shm->formats);
 	free(shm);
 }
@@ -528,10 +661,17 @@ struct wlr_shm *wlr_shm_create(struct wl_display *display, uint32_t version,
 		shm->formats[i] = convert_drm_format_to_wl_shm(formats[i]);
 	}
 
+	if (!sigbus_handler_ref()) {
+		free(shm->formats);
+		free(shm);
+		return NULL;
+	}
+
 	shm->global = wl_global_create(display, &wl_shm_interface, SHM_VERSION,
 		shm, shm_bind);
 	if (shm->global == NULL) {
 		wlr_log(WLR_ERROR, "wl_global_create failed");
+		sigbus_handler_unref();
 		free(shm->formats);
 		free(shm);
 		return NULL;
@@ -3,6 +3,7 @@
 #include <limits.h>
 #include <stdlib.h>
 #include <wlr/util/region.h>
+#include "util/region.h"
 
 void wlr_region_scale(pixman_region32_t *dst, const pixman_region32_t *src,
 		float scale) {
@@ -11,6 +12,35 @@ void wlr_region_scale(pixman_region32_t *dst, const pixman_region32_t *src,
 
 void wlr_region_scale_xy(pixman_region32_t *dst, const pixman_region32_t *src,
 		float scale_x, float scale_y) {
+	struct wl_array rects;
+	wl_array_init(&rects);
+	region_scale_xy(dst, src, scale_x, scale_y, &rects);
+	wl_array_release(&rects);
+}
+
+void wlr_region_transform(pixman_region32_t *dst, const pixman_region32_t *src,
+		enum wl_output_transform transform, int width, int height) {
+	struct wl_array rects;
+	wl_array_init(&rects);
+	region_transform(dst, src, transform, width, height, &rects);
+	wl_array_release(&rects);
+}
+
+void wlr_region_expand(pixman_region32_t *dst, const pixman_region32_t *src,
+		int distance) {
+	struct wl_array rects;
+	wl_array_init(&rects);
+	region_expand(dst, src, distance, &rects);
+	wl_array_release(&rects);
+}
+
+static pixman_box32_t *scratch_rects(struct wl_array *scratch, int nrects) {
+	scratch->size = 0;
+	return wl_array_add(scratch, nrects * sizeof(pixman_box32_t));
+}
+
+void region_scale_xy(pixman_region32_t *dst, const pixman_region32_t *src,
+		float scale_x, float scale_y, struct wl_array *scratch) {
 	if (scale_x == 1.0 && scale_y == 1.0) {
 		pixman_region32_copy(dst, src);
 		return;
@@ -19,7 +49,12 @@ void wlr_region_scale_xy(pixman_region32_t *dst, const pixman_region32_t *src,
 	int nrects;
 	const pixman_box32_t *src_rects = pixman_region32_rectangles(src, &nrects);
 
-	pixman_box32_t *dst_rects = malloc(nrects * sizeof(pixman_box32_t));
+	if (nrects == 0) {
+		pixman_region32_clear(dst);
+		return;
+	}
+
+	pixman_box32_t *dst_rects = scratch_rects(scratch, nrects);
 	if (dst_rects == NULL) {
 		return;
 	}
@@ -33,11 +68,11 @@ void wlr_region_scale_xy(pixman_region32_t *dst, const pixman_region32_t *src,
 
 	pixman_region32_fini(dst);
 	pixman_region32_init_rects(dst, dst_rects, nrects);
-	free(dst_rects);
 }
 
-void wlr_region_transform(pixman_region32_t *dst, const pixman_region32_t *src,
-		enum wl_output_transform transform, int width, int height) {
+void region_transform(pixman_region32_t *dst, const pixman_region32_t *src,
+		enum wl_output_transform transform, int width, int height,
+		struct wl_array *scratch) {
 	if (transform == WL_OUTPUT_TRANSFORM_NORMAL) {
 		pixman_region32_copy(dst, src);
 		return;
@@ -46,7 +81,12 @@ void wlr_region_transform(pixman_region32_t *dst, const pixman_region32_t *src,
 	int nrects;
 	const pixman_box32_t *src_rects = pixman_region32_rectangles(src, &nrects);
 
-	pixman_box32_t *dst_rects = malloc(nrects * sizeof(pixman_box32_t));
+	if (nrects == 0) {
+		pixman_region32_clear(dst);
+		return;
+	}
+
+	pixman_box32_t *dst_rects = scratch_rects(scratch, nrects);
 	if (dst_rects == NULL) {
 		return;
 	}
@@ -106,11 +146,10 @@ void wlr_region_transform(pixman_region32_t *dst, const pixman_region32_t *src,
 
 	pixman_region32_fini(dst);
 	pixman_region32_init_rects(dst, dst_rects, nrects);
-	free(dst_rects);
 }
 
-void wlr_region_expand(pixman_region32_t *dst, const pixman_region32_t *src,
-		int distance) {
+void region_expand(pixman_region32_t *dst, const pixman_region32_t *src,
+		int distance, struct wl_array *scratch) {
 	assert(distance >= 0);
 
 	if (distance == 0) {
@@ -121,7 +160,12 @@ void wlr_region_expand(pixman_region32_t *dst, const pixman_region32_t *src,
 	int nrects;
 	const pixman_box32_t *src_rects = pixman_region32_rectangles(src, &nrects);
 
-	pixman_box32_t *dst_rects = malloc(nrects * sizeof(pixman_box32_t));
+	if (nrects == 0) {
+		pixman_region32_clear(dst);
+		return;
+	}
+
+	pixman_box32_t *dst_rects = scratch_rects(scratch, nrects);
 	if (dst_rects == NULL) {
 		return;
 	}
@@ -135,7 +179,6 @@ void wlr_region_expand(pixman_region32_t *dst, const pixman_region32_t *src,
 
 	pixman_region32_fini(dst);
 	pixman_region32_init_rects(dst, dst_rects, nrects);
-	free(dst_rects);
 }
 
 void wlr_region_rotated_bounds(pixman_region32_t *dst, const pixman_region32_t *src,
@@ -1,4 +1,4 @@
-#define _POSIX_C_SOURCE 200112L
+#define _GNU_SOURCE // for memfd_create and F_ADD_SEALS
 #include <errno.h>
 #include <fcntl.h>
 #include <string.h>
@@ -96,3 +96,53 @@ bool allocate_shm_file_pair(size_t size, int *rw_fd_ptr, int *ro_fd_ptr) {
 	*ro_fd_ptr = ro_fd;
 	return true;
 }
+
+static bool write_shm_file(int fd, const void *data, size_t size) {
+	int ret;
+	do {
+		ret = ftruncate(fd, size);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0) {
+		return false;
+	}
+
+	void *dst = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (dst == MAP_FAILED) {
+		return false;
+	}
+	memcpy(dst, data, size);
+	munmap(dst, size);
+	return true;
+}
+
+int allocate_sealed_shm_file(const void *data, size_t size) {
+#ifdef MFD_ALLOW_SEALING
+	// Sealing may be unavailable (e.g. blocked by a seccomp filter, or
+	// unsupported by the filesystem): fall back to an unsealed file then
+	int fd = memfd_create("wlroots", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd >= 0) {
+		if (!write_shm_file(fd, data, size)) {
+			close(fd);
+			return -1;
+		}
+		// The write seal requires all writable mappings to be gone
+		if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW |
+				F_SEAL_WRITE | F_SEAL_SEAL) == 0) {
+			return fd;
+		}
+		close(fd);
+	}
+#endif
+
+	int rw_fd, ro_fd;
+	if (!allocate_shm_file_pair(size, &rw_fd, &ro_fd)) {
+		return -1;
+	}
+	bool ok = write_shm_file(rw_fd, data, size);
+	close(rw_fd);
+	if (!ok) {
+		close(ro_fd);
+		return -1;
+	}
+	return ro_fd;
+}
@@ -1,5 +1,6 @@
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
@@ -56,142 +57,174 @@ xwm_selection_find_incoming_transfer_by_window(
 	return NULL;
 }
 
-static bool xwm_selection_transfer_get_incoming_selection_property(
-		struct wlr_xwm_selection_transfer *transfer, bool delete) {
+static void handle_property_reply(struct wlr_xwm *xwm, void *reply,
+	void *data, uint32_t arg);
+
+/**
+ * Request the next window of the selection property. Properties are read
+ * INCR_CHUNK_SIZE bytes at a time, which bounds the memory used by a transfer
+ * regardless of the size of the property. The X server deletes the property
+ * along with its last window, which lets the X11 client prepare the next INCR
+ * chunk while the current one is written to the Wayland client.
+ */
+static void xwm_selection_transfer_request_property(
+		struct wlr_xwm_selection_transfer *transfer) {
 	struct wlr_xwm *xwm = transfer->selection->xwm;
 
 	xcb_get_property_cookie_t cookie = xcb_get_property(
 		xwm->xcb_conn,
-		delete,
+		1, // delete
 		transfer->incoming_window,
 		xwm->atoms[WL_SELECTION],
 		XCB_GET_PROPERTY_TYPE_ANY,
-		0, // offset
-		0x1fffffff // length
+		transfer->property_offset,
+		INCR_CHUNK_SIZE / 4 // length, in 32-bit units
 	);
+	xcb_flush(xwm->xcb_conn);
+
+	transfer->property_requested = true;
+	xwm_queue_reply(xwm, cookie.sequence, handle_property_reply, transfer, 0);
+}
 
+static void xwm_selection_transfer_set_property_reply(
+		struct wlr_xwm_selection_transfer *transfer,
+		xcb_get_property_reply_t *reply) {
+	assert(transfer->property_reply == NULL);
+	transfer->property_reply = reply;
 	transfer->property_start = 0;
-	transfer->property_reply =
-		xcb_get_property_reply(xwm->xcb_conn, cookie, NULL);
 
-	if (!transfer->property_reply) {
-		wlr_log(WLR_ERROR, "cannot get selection property");
-		return false;
+	if (reply->bytes_after > 0) {
+		// Fetch the next window while this one is being written
+		transfer->property_offset += xcb_get_property_value_length(reply) / 4;
+		xwm_selection_transfer_request_property(transfer);
+	} else {
+		transfer->property_offset = 0;
 	}
-
-	return true;
 }
 
-static void xwm_notify_ready_for_next_incr_chunk(
+static int handle_wl_client_writable(int fd, uint32_t mask, void *data);
+
+/**
+ * Write the received property windows to the Wayland client, until the client
+ * stops accepting data or we run out of data to write.
+ */
+static void xwm_selection_transfer_write(
 		struct wlr_xwm_selection_transfer *transfer) {
-	struct wlr_xwm *xwm = transfer->selection->xwm;
-	assert(transfer->incr);
+	while (transfer->property_reply != NULL) {
+		xcb_get_property_reply_t *reply = transfer->property_reply;
+		char *value = xcb_get_property_value(reply);
+		int value_len = xcb_get_property_value_length(reply);
+
+		if (transfer->property_start < value_len &&
+				transfer->wl_client_fd >= 0) {
+			ssize_t len = write(transfer->wl_client_fd,
+				value + transfer->property_start,
+				value_len - transfer->property_start);
+			if (len == -1 && errno == EAGAIN) {
+				if (transfer->event_source == NULL) {
+					struct wl_event_loop *loop = wl_display_get_event_loop(
+						transfer->selection->xwm->xwayland->wl_display);
+					transfer->event_source = wl_event_loop_add_fd(loop,
+						transfer->wl_client_fd, WL_EVENT_WRITABLE,
+						handle_wl_client_writable, transfer);
+				}
+				return;
+			} else if (len == -1) {
+				wlr_log_errno(WLR_ERROR, "write error to target fd %d",
+					transfer->wl_client_fd);
+				xwm_selection_transfer_destroy(transfer);
+				return;
+			}
 
-	wlr_log(WLR_DEBUG, "deleting property");
-	xcb_delete_property(xwm->xcb_conn, transfer->incoming_window,
-		xwm->atoms[WL_SELECTION]);
-	xcb_flush(xwm->xcb_conn);
+			transfer->property_start += len;
+			transfer->bytes_transferred += len;
+			continue;
+		}
+
+		// Done with this window. If the Wayland client closed its pipe
+		// prematurely, keep draining the X11 client anyways.
+		bool last = reply->bytes_after == 0;
+		bool empty = value_len == 0;
+		xwm_selection_transfer_destroy_property_reply(transfer);
+
+		if (transfer->next_property_reply != NULL) {
+			xcb_get_property_reply_t *next = transfer->next_property_reply;
+			transfer->next_property_reply = NULL;
+			xwm_selection_transfer_set_property_reply(transfer, next);
+		} else if (!last) {
+			// Wait for the next window
+			break;
+		} else if (!transfer->incr || empty) {
+			// A zero-length chunk terminates INCR transfers
+			xwm_selection_transfer_log_complete(transfer);
+			xwm_selection_transfer_destroy(transfer);
+			return;
+		} else if (transfer->incr_chunk_pending) {
+			transfer->incr_chunk_pending = false;
+			xwm_selection_transfer_request_property(transfer);
+		}
+	}
 
 	xwm_selection_transfer_remove_event_source(transfer);
-	xwm_selection_transfer_destroy_property_reply(transfer);
 }
 
-/**
- * Write the X11 selection to a Wayland client. Returns a nonzero value if the
- * Wayland client might become writeable again in the future.
- */
-static int write_selection_property_to_wl_client(int fd, uint32_t mask,
-		void *data) {
+static int handle_wl_client_writable(int fd, uint32_t mask, void *data) {
 	struct wlr_xwm_selection_transfer *transfer = data;
+	xwm_selection_transfer_write(transfer);
+	return 0;
+}
 
-	char *property = xcb_get_property_value(transfer->property_reply);
-	int remainder = xcb_get_property_value_length(transfer->property_reply) -
-		transfer->property_start;
+static void handle_property_reply(struct wlr_xwm *xwm, void *reply,
+		void *data, uint32_t arg) {
+	struct wlr_xwm_selection_transfer *transfer = data;
+	xcb_get_property_reply_t *property_reply = reply;
 
-	ssize_t len = write(fd, property + transfer->property_start, remainder);
-	if (len == -1) {
-		wlr_log_errno(WLR_ERROR, "write error to target fd %d", fd);
-		xwm_selection_transfer_destroy(transfer);
-		return 0;
+	transfer->property_requested = false;
+	if (property_reply == NULL) {
+		wlr_log(WLR_ERROR, "cannot get selection property");
+		return;
 	}
 
-	wlr_log(WLR_DEBUG,
-		"wrote %zd (total %zd, remaining %d) of %d bytes to fd %d",
-		len, transfer->property_start + len, remainder,
-		xcb_get_property_value_length(transfer->property_reply), fd);
-
-	if (len < remainder) {
-		transfer->property_start += len;
-		return 1;
-	} else if (transfer->incr) {
-		xwm_notify_ready_for_next_incr_chunk(transfer);
-	} else {
-		wlr_log(WLR_DEBUG, "transfer complete");
-		xwm_selection_transfer_destroy(transfer);
+	if (!transfer->incr && property_reply->type == xwm->atoms[INCR]) {
+		// The data will be sent in chunks, starting with the next property
+		// change. The INCR property itself is deleted by now.
+		wlr_log(WLR_DEBUG, "starting incremental transfer");
+		transfer->incr = true;
+		free(property_reply);
+		if (transfer->incr_chunk_pending) {
+			transfer->incr_chunk_pending = false;
+			xwm_selection_transfer_request_property(transfer);
+		}
+		return;
 	}
 
-	return 0;
-}
-
-static void xwm_write_selection_property_to_wl_client(
-		struct wlr_xwm_selection_transfer *transfer) {
-	if (transfer->incr && transfer->wl_client_fd < 0) {
-		// Wayland client closed its pipe prematurely before the X11 client finished
-		// its incremental transfer. Continue draining the X11 client.
-		xwm_notify_ready_for_next_incr_chunk(transfer);
+	if (transfer->property_reply != NULL) {
+		// Still writing the previous window
+		assert(transfer->next_property_reply == NULL);
+		transfer->next_property_reply = property_reply;
 		return;
 	}
 
-	bool wl_client_finished_consuming = !write_selection_property_to_wl_client(
-			transfer->wl_client_fd, WL_EVENT_WRITABLE, transfer);
-	if (!wl_client_finished_consuming) {
-		// Wrote out part of the property to the Wayland client, but the client was
-		// unable to accept all of it. Schedule an event to asynchronously complete
-		// the transfer.
-		struct wl_event_loop *loop =
-			wl_display_get_event_loop(transfer->selection->xwm->xwayland->wl_display);
-		transfer->event_source = wl_event_loop_add_fd(loop,
-			transfer->wl_client_fd, WL_EVENT_WRITABLE,
-			write_selection_property_to_wl_client, transfer);
-	}
+	xwm_selection_transfer_set_property_reply(transfer, property_reply);
+	xwm_selection_transfer_write(transfer);
 }
 
 void xwm_get_incr_chunk(struct wlr_xwm_selection_transfer *transfer) {
 	wlr_log(WLR_DEBUG, "xwm_get_incr_chunk");
 
-	if (transfer->property_reply) {
-		wlr_log(WLR_ERROR, "X11 client offered a new property before we deleted");
+	if (transfer->property_reply || transfer->property_requested ||
+			transfer->next_property_reply) {
+		// Still busy with the previous chunk, read this one afterwards
+		transfer->incr_chunk_pending = true;
 		return;
 	}
 
-	if (!xwm_selection_transfer_get_incoming_selection_property(transfer, false)) {
-		return;
-	}
-
-	if (xcb_get_property_value_length(transfer->property_reply) > 0) {
-		xwm_write_selection_property_to_wl_client(transfer);
-	} else {
-		wlr_log(WLR_DEBUG, "incremental transfer complete");
-		xwm_selection_transfer_destroy(transfer);
-	}
+	xwm_selection_transfer_request_property(transfer);
 }
 
 static void xwm_selection_transfer_get_data(
 		struct wlr_xwm_selection_transfer *transfer) {
-	struct wlr_xwm *xwm = transfer->selection->xwm;
-
-	if (!xwm_selection_transfer_get_incoming_selection_property(transfer, true)) {
-		return;
-	}
-
-	if (transfer->property_reply->type == xwm->atoms[INCR]) {
-		transfer->incr = true;
-		xwm_selection_transfer_destroy_property_reply(transfer);
-	} else {
-		// Reply's ownership is transferred to wm, which is responsible for freeing
-		// it.
-		xwm_write_selection_property_to_wl_client(transfer);
-	}
+	xwm_selection_transfer_request_property(transfer);
 }
 
 static void source_send(struct wlr_xwm_selection *selection,
@@ -320,86 +353,66 @@ static const struct wlr_primary_selection_source_impl
 	.destroy = primary_selection_source_destroy,
 };
 
-static bool source_get_targets(struct wlr_xwm_selection *selection,
-		struct wl_array *mime_types, struct wl_array *mime_types_atoms) {
-	struct wlr_xwm *xwm = selection->xwm;
-
-	xcb_get_property_cookie_t cookie = xcb_get_property(xwm->xcb_conn,
-		1, // delete
-		selection->window,
-		xwm->atoms[WL_SELECTION],
-		XCB_GET_PROPERTY_TYPE_ANY,
-		0, // offset
-		4096 // length
-	);
+struct xwm_selection_targets {
+	struct wlr_xwm_selection *selection;
+	xcb_atom_t *atoms;
+	char **mime_types; // NULL if the atom isn't a MIME type
+	size_t len;
+	size_t pending; // number of atom names to wait for
+};
 
-	xcb_get_property_reply_t *reply =
-		xcb_get_property_reply(xwm->xcb_conn, cookie, NULL);
-	if (reply == NULL) {
-		return false;
+void xwm_selection_targets_destroy(struct xwm_selection_targets *targets) {
+	if (targets == NULL) {
+		return;
 	}
 
-	if (reply->type != XCB_ATOM_ATOM) {
-		free(reply);
-		return false;
+	struct wlr_xwm_selection *selection = targets->selection;
+	xwm_cancel_replies(selection->xwm, targets);
+	if (selection->pending_targets == targets) {
+		selection->pending_targets = NULL;
 	}
 
-	xcb_atom_t *value = xcb_get_property_value(reply);
-	for (uint32_t i = 0; i < reply->value_len; i++) {
-		char *mime_type = NULL;
+	for (size_t i = 0; i < targets->len; i++) {
+		free(targets->mime_types[i]);
+	}
+	free(targets->mime_types);
+	free(targets->atoms);
+	free(targets);
+}
 
-		if (value[i] == xwm->atoms[UTF8_STRING]) {
-			mime_type = strdup("text/plain;charset=utf-8");
-		} else if (value[i] == xwm->atoms[TEXT]) {
-			mime_type = strdup("text/plain");
-		} else if (value[i] != xwm->atoms[TARGETS] &&
-				value[i] != xwm->atoms[TIMESTAMP]) {
-			xcb_get_atom_name_cookie_t name_cookie =
-				xcb_get_atom_name(xwm->xcb_conn, value[i]);
-			xcb_get_atom_name_reply_t *name_reply =
-				xcb_get_atom_name_reply(xwm->xcb_conn, name_cookie, NULL);
-			if (name_reply == NULL) {
-				continue;
-			}
-			size_t len = xcb_get_atom_name_name_length(name_reply);
-			char *name = xcb_get_atom_name_name(name_reply); // not a C string
-			if (memchr(name, '/', len) != NULL) {
-				mime_type = malloc((len + 1) * sizeof(char));
-				if (mime_type == NULL) {
-					free(name_reply);
-					continue;
-				}
-				memcpy(mime_type, name, len);
-				mime_type[len] = '\0';
-			}
-			free(name_reply);
+static bool source_get_targets(struct xwm_selection_targets *targets,
+		struct wl_array *mime_types, struct wl_array *mime_types_atoms) {
+	for (size_t i = 0; i < targets->len; i++) {
+		if (targets->mime_types[i] == NULL) {
+			continue;
 		}
 
-		if (mime_type != NULL) {
-			char **mime_type_ptr =
-				wl_array_add(mime_types, sizeof(*mime_type_ptr));
-			if (mime_type_ptr == NULL) {
-				free(mime_type);
-				break;
-			}
-			*mime_type_ptr = mime_type;
+		char **mime_type_ptr =
+			wl_array_add(mime_types, sizeof(*mime_type_ptr));
+		if (mime_type_ptr == NULL) {
+			return false;
+		}
+		*mime_type_ptr = targets->mime_types[i];
+		targets->mime_types[i] = NULL;
 
-			xcb_atom_t *atom_ptr =
-				wl_array_add(mime_types_atoms, sizeof(*atom_ptr));
-			if (atom_ptr == NULL) {
-				break;
-			}
-			*atom_ptr = value[i];
+		xcb_atom_t *atom_ptr =
+			wl_array_add(mime_types_atoms, sizeof(*atom_ptr));
+		if (atom_ptr == NULL) {
+			return false;
 		}
+		*atom_ptr = targets->atoms[i];
 	}
 
-	free(reply);
 	return true;
 }
 
-static void xwm_selection_get_targets(struct wlr_xwm_selection *selection) {
+static void xwm_selection_set_targets(struct xwm_selection_targets *targets) {
 	// set the wayland selection to the X11 selection
+	struct wlr_xwm_selection *selection = targets->selection;
 	struct wlr_xwm *xwm = selection->xwm;
+	if (xwm->seat == NULL) {
+		return;
+	}
 
 	if (selection == &xwm->clipboard_selection) {
 		struct x11_data_source *source = calloc(1, sizeof(*source));
@@ -411,7 +424,7 @@ static void xwm_selection_get_targets(struct wlr_xwm_selection *selection) {
 		source->selection = selection;
 		wl_array_init(&source->mime_types_atoms);
 
-		bool ok = source_get_targets(selection, &source->base.mime_types,
+		bool ok = source_get_targets(targets, &source->base.mime_types,
 			&source->mime_types_atoms);
 		if (ok) {
 			wlr_seat_request_set_selection(xwm->seat, NULL, &source->base,
@@ -430,7 +443,7 @@ static void xwm_selection_get_targets(struct wlr_xwm_selection *selection) {
 		source->selection = selection;
 		wl_array_init(&source->mime_types_atoms);
 
-		bool ok = source_get_targets(selection, &source->base.mime_types,
+		bool ok = source_get_targets(targets, &source->base.mime_types,
 			&source->mime_types_atoms);
 		if (ok) {
 			wlr_seat_set_primary_selection(xwm->seat, &source->base,
@@ -438,11 +451,108 @@ static void xwm_selection_get_targets(struct wlr_xwm_selection *selection) {
 		} else {
 			wlr_primary_selection_source_destroy(&source->base);
 		}
-	} else if (selection == &xwm->dnd_selection) {
-		// TODO
 	}
 }
 
+static void handle_target_name_reply(struct wlr_xwm *xwm, void *reply,
+		void *data, uint32_t index) {
+	struct xwm_selection_targets *targets = data;
+	xcb_get_atom_name_reply_t *name_reply = reply;
+
+	if (name_reply != NULL) {
+		size_t len = xcb_get_atom_name_name_length(name_reply);
+		char *name = xcb_get_atom_name_name(name_reply); // not a C string
+		if (memchr(name, '/', len) != NULL) {
+			targets->mime_types[index] = strndup(name, len);
+		}
+		free(name_reply);
+	}
+
+	assert(targets->pending > 0);
+	targets->pending--;
+	if (targets->pending == 0) {
+		xwm_selection_set_targets(targets);
+		xwm_selection_targets_destroy(targets);
+	}
+}
+
+static void handle_targets_reply(struct wlr_xwm *xwm, void *reply,
+		void *data, uint32_t arg) {
+	struct xwm_selection_targets *targets = data;
+	xcb_get_property_reply_t *property_reply = reply;
+
+	if (property_reply == NULL || property_reply->type != XCB_ATOM_ATOM) {
+		free(property_reply);
+		xwm_selection_targets_destroy(targets);
+		return;
+	}
+
+	size_t len = property_reply->value_len;
+	targets->atoms = calloc(len, sizeof(*targets->atoms));
+	targets->mime_types = calloc(len, sizeof(*targets->mime_types));
+	if (len > 0 && (targets->atoms == NULL || targets->mime_types == NULL)) {
+		free(property_reply);
+		xwm_selection_targets_destroy(targets);
+		return;
+	}
+	targets->len = len;
+
+	// Resolve the names of all unknown atoms in one go
+	xcb_atom_t *value = xcb_get_property_value(property_reply);
+	for (size_t i = 0; i < len; i++) {
+		targets->atoms[i] = value[i];
+
+		if (value[i] == xwm->atoms[UTF8_STRING]) {
+			targets->mime_types[i] = strdup("text/plain;charset=utf-8");
+		} else if (value[i] == xwm->atoms[TEXT]) {
+			targets->mime_types[i] = strdup("text/plain");
+		} else if (value[i] != xwm->atoms[TARGETS] &&
+				value[i] != xwm->atoms[TIMESTAMP]) {
+			xcb_get_atom_name_cookie_t name_cookie =
+				xcb_get_atom_name(xwm->xcb_conn, value[i]);
+			xwm_queue_reply(xwm, name_cookie.sequence, handle_target_name_reply,
+				targets, i);
+			targets->pending++;
+		}
+	}
+	free(property_reply);
+
+	if (targets->pending == 0) {
+		xwm_selection_set_targets(targets);
+		xwm_selection_targets_destroy(targets);
+	}
+}
+
+static void xwm_selection_get_targets(struct wlr_xwm_selection *selection) {
+	struct wlr_xwm *xwm = selection->xwm;
+
+	if (selection != &xwm->clipboard_selection &&
+			selection != &xwm->primary_selection) {
+		// TODO: DND
+		return;
+	}
+
+	// A newer selection supersedes the one being read
+	xwm_selection_targets_destroy(selection->pending_targets);
+
+	struct xwm_selection_targets *targets = calloc(1, sizeof(*targets));
+	if (targets == NULL) {
+		return;
+	}
+	targets->selection = selection;
+	selection->pending_targets = targets;
+
+	xcb_get_property_cookie_t cookie = xcb_get_property(xwm->xcb_conn,
+		1, // delete
+		selection->window,
+		xwm->atoms[WL_SELECTION],
+		XCB_GET_PROPERTY_TYPE_ANY,
+		0, // offset
+		4096 // length
+	);
+	xwm_queue_reply(xwm, cookie.sequence, handle_targets_reply, targets, 0);
+}
+
 void xwm_handle_selection_notify(struct wlr_xwm *xwm,
 		xcb_selection_notify_event_t *event) {
 	wlr_log(WLR_DEBUG, "XCB_SELECTION_NOTIFY (selection=%u, property=%u, target=%u)",
@@ -48,6 +48,7 @@ static int xwm_selection_flush_source_data(
 	xcb_flush(transfer->selection->xwm->xcb_conn);
 	transfer->property_set = true;
 	size_t length = transfer->source_data.size;
+	transfer->bytes_transferred += length;
 	transfer->source_data.size = 0;
 	return length;
 }
@@ -70,19 +71,21 @@ static int xwm_data_source_read(int fd, uint32_t mask, void *data) {
 	struct wlr_xwm_selection_transfer *transfer = data;
 	struct wlr_xwm *xwm = transfer->selection->xwm;
 
-	void *p;
+	// Buffer at most one chunk: reading from the source is paused while a full
+	// chunk waits for the X11 client to consume the previous one
 	size_t current = transfer->source_data.size;
-	if (transfer->source_data.size < INCR_CHUNK_SIZE) {
-		p = wl_array_add(&transfer->source_data, INCR_CHUNK_SIZE);
-		if (p == NULL) {
+	assert(current < INCR_CHUNK_SIZE);
+	if (transfer->source_data.alloc < INCR_CHUNK_SIZE) {
+		if (wl_array_add(&transfer->source_data,
+				INCR_CHUNK_SIZE - current) == NULL) {
 			wlr_log(WLR_ERROR, "Could not allocate selection source_data");
 			goto error_out;
 		}
-	} else {
-		p = (char *)transfer->source_data.data + transfer->source_data.size;
+		transfer->source_data.size = current;
 	}
 
-	size_t available = transfer->source_data.alloc - current;
+	void *p = (char *)transfer->source_data.data + current;
+	size_t available = INCR_CHUNK_SIZE - current;
 	ssize_t len = read(fd, p, available);
 	if (len == -1) {
 		wlr_log_errno(WLR_ERROR, "read error from data source");
@@ -126,6 +129,7 @@ static int xwm_data_source_read(int fd, uint32_t mask, void *data) {
 		wlr_log(WLR_DEBUG, "non-incr transfer complete");
 		xwm_selection_flush_source_data(transfer);
 		xwm_selection_send_notify(xwm, &transfer->request, true);
+		xwm_selection_transfer_log_complete(transfer);
 		xwm_selection_transfer_destroy_outgoing(transfer);
 	} else if (len == 0 && transfer->incr) {
 		wlr_log(WLR_DEBUG, "incr transfer complete");
@@ -174,6 +178,7 @@ void xwm_send_incr_chunk(struct wlr_xwm_selection_transfer *transfer) {
 			wl_array_release(&transfer->source_data);
 			wl_array_init(&transfer->source_data);
 		} else {
+			xwm_selection_transfer_log_complete(transfer);
 			xwm_selection_transfer_destroy_outgoing(transfer);
 		}
 	}
@@ -411,12 +416,8 @@ void xwm_handle_selection_request(struct wlr_xwm *xwm,
 
 	// No xwayland surface focused, deny access to clipboard
 	if (xwm->focus_surface == NULL && xwm->drag_focus == NULL) {
-		if (wlr_log_get_verbosity() >= WLR_DEBUG) {
-			char *selection_name = xwm_get_atom_name(xwm, selection->atom);
-			wlr_log(WLR_DEBUG, "denying read access to selection %u (%s): "
-				"no xwayland surface focused", selection->atom, selection_name);
-			free(selection_name);
-		}
+		xwm_log_atom_name(xwm, selection->atom, "denying read access: "
+			"no xwayland surface focused, selection");
 		goto fail_notify_requestor;
 	}
 
@@ -7,6 +7,7 @@
 #include <wlr/types/wlr_data_device.h>
 #include <wlr/util/log.h>
 #include <xcb/xfixes.h>
+#include "util/time.h"
 #include "xwayland/selection.h"
 #include "xwayland/xwm.h"
 
@@ -32,12 +33,36 @@ void xwm_selection_transfer_destroy_property_reply(
 	transfer->property_reply = NULL;
 }
 
+static void xwm_selection_transfer_destroy_next_property_reply(
+		struct wlr_xwm_selection_transfer *transfer) {
+	free(transfer->next_property_reply);
+	transfer->next_property_reply = NULL;
+}
+
 void xwm_selection_transfer_init(struct wlr_xwm_selection_transfer *transfer,
 		struct wlr_xwm_selection *selection) {
 	*transfer = (struct wlr_xwm_selection_transfer){
 		.selection = selection,
 		.wl_client_fd = -1,
 	};
+	clock_gettime(CLOCK_MONOTONIC, &transfer->start_time);
+}
+
+void xwm_selection_transfer_log_complete(
+		struct wlr_xwm_selection_transfer *transfer) {
+	struct timespec now, duration;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	timespec_sub(&duration, &now, &transfer->start_time);
+	int64_t duration_nsec = timespec_to_nsec(&duration);
+
+	double throughput = 0;
+	if (duration_nsec > 0) {
+		throughput = (double)transfer->bytes_transferred / (1024 * 1024) *
+			1000000000.0 / duration_nsec;
+	}
+	wlr_log(WLR_DEBUG, "transfer %p complete: %zu bytes in %.1f ms (%.1f MiB/s)",
+		transfer, transfer->bytes_transferred,
+		(double)duration_nsec / 1000000, throughput);
 }
 
 void xwm_selection_transfer_destroy(
@@ -46,12 +71,14 @@ void xwm_selection_transfer_destroy(
 		return;
 	}
 
+	struct wlr_xwm *xwm = transfer->selection->xwm;
+	xwm_cancel_replies(xwm, transfer);
 	xwm_selection_transfer_destroy_property_reply(transfer);
+	xwm_selection_transfer_destroy_next_property_reply(transfer);
 	xwm_selection_transfer_remove_event_source(transfer);
 	xwm_selection_transfer_close_wl_client_fd(transfer);
 
 	if (transfer->incoming_window) {
-		struct wlr_xwm *xwm = transfer->selection->xwm;
 		xcb_destroy_window(xwm->xcb_conn, transfer->incoming_window);
 		xcb_flush(xwm->xcb_conn);
 	}
@@ -119,7 +146,9 @@ static int xwm_handle_selection_property_notify(struct wlr_xwm *xwm,
 				xwm_selection_find_incoming_transfer_by_window(selection,
 						event->window);
 			if (transfer) {
-				if (transfer->incr) {
+				// Replies are dispatched after events, so the first INCR
+				// chunk may show up before the INCR reply has been handled
+				if (transfer->incr || transfer->property_requested) {
 					xwm_get_incr_chunk(transfer);
 				}
 
@@ -260,6 +289,8 @@ void xwm_selection_finish(struct wlr_xwm_selection *selection) {
 		xwm_selection_transfer_destroy(incoming);
 	}
 
+	xwm_selection_targets_destroy(selection->pending_targets);
+
 	xcb_destroy_window(selection->xwm->xcb_conn, selection->window);
 }
 
@@ -2,6 +2,8 @@
 #define _POSIX_C_SOURCE 200809L
 #endif
 #include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <wlr/config.h>
@@ -16,6 +18,7 @@
 #include <xcb/composite.h>
 #include <xcb/render.h>
 #include <xcb/res.h>
+#include <xcb/xcbext.h>
 #include <xcb/xfixes.h>
 #include "xwayland/xwm.h"
 
@@ -101,6 +104,81 @@ struct pending_startup_id {
 	struct wl_list link;
 };
 
+struct xwm_pending_reply {
+	unsigned int sequence;
+	xwm_reply_handler_t handler;
+	void *data;
+	uint32_t arg;
+	struct wl_list link; // wlr_xwm.pending_replies
+};
+
+void xwm_queue_reply(struct wlr_xwm *xwm, unsigned int sequence,
+		xwm_reply_handler_t handler, void *data, uint32_t arg) {
+	struct xwm_pending_reply *pending = calloc(1, sizeof(*pending));
+	if (pending == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		// Don't leave the reply in the XCB queue
+		xcb_discard_reply(xwm->xcb_conn, sequence);
+		handler(xwm, NULL, data, arg);
+		return;
+	}
+
+	pending->sequence = sequence;
+	pending->handler = handler;
+	pending->data = data;
+	pending->arg = arg;
+	wl_list_insert(xwm->pending_replies.prev, &pending->link);
+}
+
+static void pending_reply_destroy(struct wlr_xwm *xwm,
+		struct xwm_pending_reply *pending) {
+	wl_list_remove(&pending->link);
+	free(pending);
+}
+
+void xwm_cancel_replies(struct wlr_xwm *xwm, void *data) {
+	struct xwm_pending_reply *pending, *tmp;
+	wl_list_for_each_safe(pending, tmp, &xwm->pending_replies, link) {
+		if (pending->data == data) {
+			xcb_discard_reply(xwm->xcb_conn, pending->sequence);
+			pending_reply_destroy(xwm, pending);
+		}
+	}
+}
+
+/**
+ * Handle the replies which have already been received, in request order.
+ * Returns the number of handled replies.
+ */
+static int xwm_dispatch_replies(struct wlr_xwm *xwm) {
+	int count = 0;
+	while (!wl_list_empty(&xwm->pending_replies)) {
+		struct xwm_pending_reply *pending =
+			wl_container_of(xwm->pending_replies.next, pending, link);
+
+		void *reply = NULL;
+		xcb_generic_error_t *error = NULL;
+		if (!xcb_poll_for_reply(xwm->xcb_conn, pending->sequence,
+				&reply, &error)) {
+			break;
+		}
+		if (error != NULL) {
+			wlr_log(WLR_DEBUG, "X11 request %u failed with error %u",
+				pending->sequence, error->error_code);
+			free(error);
+		}
+
+		// The handler may queue or cancel other requests
+		xwm_reply_handler_t handler = pending->handler;
+		void *data = pending->data;
+		uint32_t arg = pending->arg;
+		pending_reply_destroy(xwm, pending);
+		handler(xwm, reply, data, arg);
+		count++;
+	}
+	return count;
+}
+
 static const struct wlr_addon_interface surface_addon_impl;
 
 struct wlr_xwayland_surface *wlr_xwayland_surface_try_from_wlr_surface(
@@ -113,11 +191,56 @@ struct wlr_xwayland_surface *wlr_xwayland_surface_try_from_wlr_surface(
 	return xsurface;
 }
 
-// TODO: replace this with hash table?
+#define SURFACE_BUCKETS_MIN_BITS 6
+
+static size_t surface_bucket(struct wlr_xwm *xwm, xcb_window_t window_id) {
+	// Fibonacci hashing, so that the high bits of the window ID (which identify
+	// the X11 client) are mixed in
+	return (uint32_t)(window_id * 2654435761u) >> (32 - xwm->surface_buckets_bits);
+}
+
+static bool surface_buckets_init(struct wlr_xwm *xwm, int bits) {
+	size_t len = (size_t)1 << bits;
+	struct wl_list *buckets = calloc(len, sizeof(*buckets));
+	if (buckets == NULL) {
+		return false;
+	}
+	for (size_t i = 0; i < len; i++) {
+		wl_list_init(&buckets[i]);
+	}
+
+	free(xwm->surface_buckets);
+	xwm->surface_buckets = buckets;
+	xwm->surface_buckets_bits = bits;
+
+	struct wlr_xwayland_surface *surface;
+	wl_list_for_each(surface, &xwm->surfaces, link) {
+		wl_list_insert(&buckets[surface_bucket(xwm, surface->window_id)],
+			&surface->hash_link);
+	}
+	return true;
+}
+
+static void surface_buckets_insert(struct wlr_xwm *xwm,
+		struct wlr_xwayland_surface *surface) {
+	xwm->surfaces_len++;
+	// Keep the load factor below one. On allocation failure, the existing
+	// buckets just get longer.
+	if (xwm->surfaces_len > ((size_t)1 << xwm->surface_buckets_bits) &&
+			surface_buckets_init(xwm, xwm->surface_buckets_bits + 1)) {
+		// The surface was inserted during the rehash
+		return;
+	}
+
+	wl_list_insert(&xwm->surface_buckets[surface_bucket(xwm, surface->window_id)],
+		&surface->hash_link);
+}
+
 static struct wlr_xwayland_surface *lookup_surface(struct wlr_xwm *xwm,
 		xcb_window_t window_id) {
+	struct wl_list *bucket = &xwm->surface_buckets[surface_bucket(xwm, window_id)];
 	struct wlr_xwayland_surface *surface;
-	wl_list_for_each(surface, &xwm->surfaces, link) {
+	wl_list_for_each(surface, bucket, hash_link) {
 		if (surface->window_id == window_id) {
 			return surface;
 		}
@@ -133,6 +256,16 @@ static int xwayland_surface_handle_ping_timeout(void *data) {
 	return 1;
 }
 
+static void handle_geometry_reply(struct wlr_xwm *xwm, void *reply,
+		void *data, uint32_t arg) {
+	struct wlr_xwayland_surface *surface = data;
+	xcb_get_geometry_reply_t *geometry_reply = reply;
+	if (geometry_reply != NULL) {
+		surface->has_alpha = geometry_reply->depth == 32;
+	}
+	free(geometry_reply);
+}
+
 static struct wlr_xwayland_surface *xwayland_surface_create(
 		struct wlr_xwm *xwm, xcb_window_t window_id, int16_t x, int16_t y,
 		uint16_t width, uint16_t height, bool override_redirect) {
@@ -142,9 +275,6 @@ static struct wlr_xwayland_surface *xwayland_surface_create(
 		return NULL;
 	}
 
-	xcb_get_geometry_cookie_t geometry_cookie =
-		xcb_get_geometry(xwm->xcb_conn, window_id);
-
 	uint32_t values[1];
 	values[0] =
 		XCB_EVENT_MASK_FOCUS_CHANGE |
@@ -163,6 +293,7 @@ static struct wlr_xwayland_surface *xwayland_surface_create(
 	wl_list_init(&surface->stack_link);
 	wl_list_init(&surface->parent_link);
 	wl_list_init(&surface->unpaired_link);
+	wl_list_init(&surface->client_list_link);
 	wl_signal_init(&surface->events.destroy);
 	wl_signal_init(&surface->events.request_configure);
 	wl_signal_init(&surface->events.request_move);
@@ -186,13 +317,6 @@ static struct wlr_xwayland_surface *xwayland_surface_create(
 	wl_signal_init(&surface->events.ping_timeout);
 	wl_signal_init(&surface->events.set_geometry);
 
-	xcb_get_geometry_reply_t *geometry_reply =
-		xcb_get_geometry_reply(xwm->xcb_conn, geometry_cookie, NULL);
-	if (geometry_reply != NULL) {
-		surface->has_alpha = geometry_reply->depth == 32;
-	}
-	free(geometry_reply);
-
 	struct wl_display *display = xwm->xwayland->wl_display;
 	struct wl_event_loop *loop = wl_display_get_event_loop(display);
 	surface->ping_timer = wl_event_loop_add_timer(loop,
@@ -204,6 +328,12 @@ static struct wlr_xwayland_surface *xwayland_surface_create(
 	}
 
 	wl_list_insert(&xwm->surfaces, &surface->link);
+	surface_buckets_insert(xwm, surface);
+
+	xcb_get_geometry_cookie_t geometry_cookie =
+		xcb_get_geometry(xwm->xcb_conn, window_id);
+	xwm_queue_reply(xwm, geometry_cookie.sequence,
+		handle_geometry_reply, surface, 0);
 
 	wl_signal_emit_mutable(&xwm->xwayland->events.new_surface, surface);
 
@@ -238,40 +368,32 @@ static void xwm_send_wm_message(struct wlr_xwayland_surface *surface,
 	xcb_flush(xwm->xcb_conn);
 }
 
-static void xwm_set_net_client_list(struct wlr_xwm *xwm) {
-	// FIXME: _NET_CLIENT_LIST is expected to be ordered by map time, but the
-	// order of surfaces in `xwm->surfaces` is by creation time. The order of
-	// windows _NET_CLIENT_LIST exposed by wlroots is wrong.
-
-	size_t mapped_surfaces = 0;
-	struct wlr_xwayland_surface *surface;
-	wl_list_for_each(surface, &xwm->surfaces, link) {
-		if (surface->surface != NULL && surface->surface->mapped) {
-			mapped_surfaces++;
-		}
-	}
+static void xwm_upload_window_list(struct wlr_xwm *xwm, xcb_atom_t property,
+		const xcb_window_t *windows, size_t len) {
+	xcb_change_property(xwm->xcb_conn, XCB_PROP_MODE_REPLACE,
+			xwm->screen->root, property, XCB_ATOM_WINDOW, 32, len, windows);
+}
 
-	xcb_window_t *windows = malloc(sizeof(xcb_window_t) * mapped_surfaces);
+static void xwm_upload_client_list(struct wlr_xwm *xwm) {
+	size_t len = wl_list_length(&xwm->client_list);
+	xcb_window_t *windows = malloc(sizeof(xcb_window_t) * len);
 	if (!windows) {
 		return;
 	}
 
-	size_t index = 0;
-	wl_list_for_each(surface, &xwm->surfaces, link) {
-		if (surface->surface != NULL && surface->surface->mapped) {
-			windows[index++] = surface->window_id;
-		}
+	size_t i = 0;
+	struct wlr_xwayland_surface *xsurface;
+	wl_list_for_each(xsurface, &xwm->client_list, client_list_link) {
+		windows[i++] = xsurface->window_id;
 	}
 
-	xcb_change_property(xwm->xcb_conn, XCB_PROP_MODE_REPLACE,
-			xwm->screen->root, xwm->atoms[NET_CLIENT_LIST],
-			XCB_ATOM_WINDOW, 32, mapped_surfaces, windows);
+	xwm_upload_window_list(xwm, xwm->atoms[NET_CLIENT_LIST], windows, len);
 	free(windows);
 }
 
-static void xwm_set_net_client_list_stacking(struct wlr_xwm *xwm) {
-	size_t num_surfaces = wl_list_length(&xwm->surfaces_in_stack_order);
-	xcb_window_t *windows = malloc(sizeof(xcb_window_t) * num_surfaces);
+static void xwm_upload_client_list_stacking(struct wlr_xwm *xwm) {
+	size_t len = wl_list_length(&xwm->surfaces_in_stack_order);
+	xcb_window_t *windows = malloc(sizeof(xcb_window_t) * len);
 	if (!windows) {
 		return;
 	}
@@ -282,12 +404,67 @@ static void xwm_set_net_client_list_stacking(struct wlr_xwm *xwm) {
 		windows[i++] = xsurface->window_id;
 	}
 
-	xcb_change_property(xwm->xcb_conn, XCB_PROP_MODE_REPLACE, xwm->screen->root,
-			xwm->atoms[NET_CLIENT_LIST_STACKING], XCB_ATOM_WINDOW, 32, num_surfaces,
-			windows);
+	xwm_upload_window_list(xwm, xwm->atoms[NET_CLIENT_LIST_STACKING],
+		windows, len);
 	free(windows);
 }
 
+static void xwm_handle_client_lists_idle(void *data) {
+	struct wlr_xwm *xwm = data;
+	xwm->client_lists_idle = NULL;
+
+	if (xwm->client_list_dirty) {
+		xwm_upload_client_list(xwm);
+		xwm->client_list_dirty = false;
+	}
+	if (xwm->client_list_stacking_dirty) {
+		xwm_upload_client_list_stacking(xwm);
+		xwm->client_list_stacking_dirty = false;
+	}
+	xcb_flush(xwm->xcb_conn);
+}
+
+/**
+ * Re-upload the client lists once the current event loop iteration is done,
+ * so that a burst of changes results in a single update.
+ */
+static void xwm_schedule_client_lists_update(struct wlr_xwm *xwm) {
+	if (xwm->client_lists_idle != NULL) {
+		return;
+	}
+
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(xwm->xwayland->wl_display);
+	xwm->client_lists_idle =
+		wl_event_loop_add_idle(loop, xwm_handle_client_lists_idle, xwm);
+}
+
+static void xwm_client_list_add(struct wlr_xwm *xwm,
+		struct wlr_xwayland_surface *surface) {
+	// _NET_CLIENT_LIST is ordered by map time: append the window, unless the
+	// whole list is going to be uploaded anyways
+	wl_list_insert(xwm->client_list.prev, &surface->client_list_link);
+	if (!xwm->client_list_dirty) {
+		xcb_change_property(xwm->xcb_conn, XCB_PROP_MODE_APPEND,
+			xwm->screen->root, xwm->atoms[NET_CLIENT_LIST],
+			XCB_ATOM_WINDOW, 32, 1, &surface->window_id);
+		xcb_flush(xwm->xcb_conn);
+	}
+}
+
+static void xwm_client_list_remove(struct wlr_xwm *xwm,
+		struct wlr_xwayland_surface *surface) {
+	wl_list_remove(&surface->client_list_link);
+	wl_list_init(&surface->client_list_link);
+	xwm->client_list_dirty = true;
+	xwm_schedule_client_lists_update(xwm);
+}
+
+static void xwm_set_net_client_list_stacking(struct wlr_xwm *xwm) {
+	xwm->client_list_stacking_dirty = true;
+	xwm_schedule_client_lists_update(xwm);
+}
+
 static void xsurface_set_net_wm_state(struct wlr_xwayland_surface *xsurface);
 
 static void xwm_set_focus_window(struct wlr_xwm *xwm,
@@ -395,7 +572,10 @@ static void xsurface_set_net_wm_state(struct wlr_xwayland_surface *xsurface) {
 static void xwayland_surface_dissociate(struct wlr_xwayland_surface *xsurface) {
 	if (xsurface->surface != NULL) {
 		wlr_surface_unmap(xsurface->surface);
-		wl_signal_emit_mutable(&xsurface->events.dissociate, NULL);
+		// The associate event is only emitted once all properties are read
+		if (xsurface->pending_associate_replies == 0) {
+			wl_signal_emit_mutable(&xsurface->events.dissociate, NULL);
+		}
 
 		wl_list_remove(&xsurface->surface_commit.link);
 		wl_list_remove(&xsurface->surface_map.link);
@@ -427,7 +607,10 @@ static void xwayland_surface_destroy(struct wlr_xwayland_surface *xsurface) {
 	}
 
 	wl_list_remove(&xsurface->link);
+	wl_list_remove(&xsurface->hash_link);
+	xsurface->xwm->surfaces_len--;
 	wl_list_remove(&xsurface->parent_link);
+	wl_list_remove(&xsurface->client_list_link);
 
 	struct wlr_xwayland_surface *child, *next;
 	wl_list_for_each_safe(child, next, &xsurface->children, parent_link) {
@@ -438,6 +621,7 @@ static void xwayland_surface_destroy(struct wlr_xwayland_surface *xsurface) {
 
 	wl_list_remove(&xsurface->unpaired_link);
 
+	xwm_cancel_replies(xsurface->xwm, xsurface);
 	wl_event_source_remove(xsurface->ping_timer);
 
 	free(xsurface->title);
@@ -600,13 +784,7 @@ static void read_surface_parent(struct wlr_xwm *xwm,
 
 static void read_surface_client_id(struct wlr_xwm *xwm,
 		struct wlr_xwayland_surface *xsurface,
-		xcb_res_query_client_ids_cookie_t cookie) {
-	xcb_res_query_client_ids_reply_t *reply = xcb_res_query_client_ids_reply(
-		xwm->xcb_conn, cookie,  NULL);
-	if (reply == NULL) {
-		return;
-	}
-
+		xcb_res_query_client_ids_reply_t *reply) {
 	uint32_t *pid = NULL;
 	xcb_res_client_id_value_iterator_t iter =
 		xcb_res_query_client_ids_ids_iterator(reply);
@@ -618,12 +796,9 @@ static void read_surface_client_id(struct wlr_xwm *xwm,
 		}
 		xcb_res_client_id_value_next(&iter);
 	}
-	if (pid == NULL) {
-		free(reply);
-		return;
+	if (pid != NULL) {
+		xsurface->pid = *pid;
 	}
-	xsurface->pid = *pid;
-	free(reply);
 }
 
 static void read_surface_window_type(struct wlr_xwm *xwm,
@@ -817,6 +992,47 @@ char *xwm_get_atom_name(struct wlr_xwm *xwm, xcb_atom_t atom) {
 	return name;
 }
 
+static void handle_atom_name_log_reply(struct wlr_xwm *xwm, void *reply,
+		void *data, uint32_t atom) {
+	xcb_get_atom_name_reply_t *name_reply = reply;
+	char *msg = data;
+	if (name_reply != NULL) {
+		wlr_log(WLR_DEBUG, "%s %" PRIu32 " (%.*s)", msg, atom,
+			xcb_get_atom_name_name_length(name_reply),
+			xcb_get_atom_name_name(name_reply));
+	} else {
+		wlr_log(WLR_DEBUG, "%s %" PRIu32 " (null)", msg, atom);
+	}
+	free(name_reply);
+	free(msg);
+}
+
+void xwm_log_atom_name(struct wlr_xwm *xwm, xcb_atom_t atom,
+		const char *fmt, ...) {
+	if (wlr_log_get_verbosity() < WLR_DEBUG) {
+		return;
+	}
+
+	va_list args;
+	va_start(args, fmt);
+	int len = vsnprintf(NULL, 0, fmt, args);
+	va_end(args);
+	if (len < 0) {
+		return;
+	}
+
+	char *msg = malloc(len + 1);
+	if (msg == NULL) {
+		return;
+	}
+	va_start(args, fmt);
+	vsnprintf(msg, len + 1, fmt, args);
+	va_end(args);
+
+	xcb_get_atom_name_cookie_t cookie = xcb_get_atom_name(xwm->xcb_conn, atom);
+	xwm_queue_reply(xwm, cookie.sequence, handle_atom_name_log_reply, msg, atom);
+}
+
 static void read_surface_property(struct wlr_xwm *xwm,
 		struct wlr_xwayland_surface *xsurface, xcb_atom_t property,
 		xcb_get_property_reply_t *reply) {
@@ -847,29 +1063,28 @@ static void read_surface_property(struct wlr_xwm *xwm,
 		read_surface_role(xwm, xsurface, reply);
 	} else if (property == xwm->atoms[NET_STARTUP_ID]) {
 		read_surface_startup_id(xwm, xsurface, reply);
-	} else if (wlr_log_get_verbosity() >= WLR_DEBUG) {
-		char *prop_name = xwm_get_atom_name(xwm, property);
-		wlr_log(WLR_DEBUG, "unhandled X11 property %" PRIu32 " (%s) for window %" PRIu32,
-			property, prop_name ? prop_name : "(null)", xsurface->window_id);
-		free(prop_name);
+	} else {
+		xwm_log_atom_name(xwm, property, "unhandled X11 property for window %" PRIu32 ":",
+			xsurface->window_id);
 	}
 }
 
 static void xwayland_surface_handle_commit(struct wl_listener *listener, void *data) {
 	struct wlr_xwayland_surface *xsurface = wl_container_of(listener, xsurface, surface_commit);
-	if (wlr_surface_has_buffer(xsurface->surface)) {
+	if (xsurface->pending_associate_replies == 0 &&
+			wlr_surface_has_buffer(xsurface->surface)) {
 		wlr_surface_map(xsurface->surface);
 	}
 }
 
 static void xwayland_surface_handle_map(struct wl_listener *listener, void *data) {
 	struct wlr_xwayland_surface *xsurface = wl_container_of(listener, xsurface, surface_map);
-	xwm_set_net_client_list(xsurface->xwm);
+	xwm_client_list_add(xsurface->xwm, xsurface);
 }
 
 static void xwayland_surface_handle_unmap(struct wl_listener *listener, void *data) {
 	struct wlr_xwayland_surface *xsurface = wl_container_of(listener, xsurface, surface_unmap);
-	xwm_set_net_client_list(xsurface->xwm);
+	xwm_client_list_remove(xsurface->xwm, xsurface);
 }
 
 static void xwayland_surface_handle_addon_destroy(struct wlr_addon *addon) {
@@ -882,6 +1097,44 @@ static const struct wlr_addon_interface surface_addon_impl = {
 	.destroy = xwayland_surface_handle_addon_destroy,
 };
 
+static void xwayland_surface_handle_associate_reply(
+		struct wlr_xwayland_surface *xsurface) {
+	assert(xsurface->pending_associate_replies > 0);
+	xsurface->pending_associate_replies--;
+	if (xsurface->pending_associate_replies > 0 || xsurface->surface == NULL) {
+		return;
+	}
+
+	wl_signal_emit_mutable(&xsurface->events.associate, NULL);
+
+	// The surface may have been committed while properties were being read
+	if (xsurface->surface != NULL && wlr_surface_has_buffer(xsurface->surface)) {
+		wlr_surface_map(xsurface->surface);
+	}
+}
+
+static void handle_associate_property_reply(struct wlr_xwm *xwm, void *reply,
+		void *data, uint32_t property) {
+	struct wlr_xwayland_surface *xsurface = data;
+	if (reply == NULL) {
+		wlr_log(WLR_ERROR, "Failed to get window property");
+	} else {
+		read_surface_property(xwm, xsurface, property, reply);
+		free(reply);
+	}
+	xwayland_surface_handle_associate_reply(xsurface);
+}
+
+static void handle_associate_client_id_reply(struct wlr_xwm *xwm, void *reply,
+		void *data, uint32_t arg) {
+	struct wlr_xwayland_surface *xsurface = data;
+	if (reply != NULL) {
+		read_surface_client_id(xwm, xsurface, reply);
+		free(reply);
+	}
+	xwayland_surface_handle_associate_reply(xsurface);
+}
+
 static void xwayland_surface_associate(struct wlr_xwm *xwm,
 		struct wlr_xwayland_surface *xsurface, struct wlr_surface *surface) {
 	assert(xsurface->surface == NULL);
@@ -918,37 +1171,27 @@ static void xwayland_surface_associate(struct wlr_xwm *xwm,
 		xwm->atoms[NET_WM_NAME],
 	};
 
-	xcb_get_property_cookie_t cookies[sizeof(props) / sizeof(props[0])] = {0};
+	// Replies to a previous association may still be pending: since replies
+	// are handled in order, waiting for these as well is harmless
 	for (size_t i = 0; i < sizeof(props) / sizeof(props[0]); i++) {
-		cookies[i] = xcb_get_property(xwm->xcb_conn, 0, xsurface->window_id,
-			props[i], XCB_ATOM_ANY, 0, 2048);
+		xcb_get_property_cookie_t cookie = xcb_get_property(xwm->xcb_conn,
+			0, xsurface->window_id, props[i], XCB_ATOM_ANY, 0, 2048);
+		xwm_queue_reply(xwm, cookie.sequence, handle_associate_property_reply,
+			xsurface, props[i]);
+		xsurface->pending_associate_replies++;
 	}
 
-	xcb_res_query_client_ids_cookie_t client_id_cookie;
 	if (xwm->xres) {
 		xcb_res_client_id_spec_t spec = {
 			.client = xsurface->window_id,
 			.mask = XCB_RES_CLIENT_ID_MASK_LOCAL_CLIENT_PID
 		};
-		client_id_cookie = xcb_res_query_client_ids(xwm->xcb_conn, 1, &spec);
+		xcb_res_query_client_ids_cookie_t cookie =
+			xcb_res_query_client_ids(xwm->xcb_conn, 1, &spec);
+		xwm_queue_reply(xwm, cookie.sequence, handle_associate_client_id_reply,
+			xsurface, 0);
+		xsurface->pending_associate_replies++;
 	}
-
-	for (size_t i = 0; i < sizeof(props) / sizeof(props[0]); i++) {
-		xcb_get_property_reply_t *reply =
-			xcb_get_property_reply(xwm->xcb_conn, cookies[i], NULL);
-		if (reply == NULL) {
-			wlr_log(WLR_ERROR, "Failed to get window property");
-			return;
-		}
-		read_surface_property(xwm, xsurface, props[i], reply);
-		free(reply);
-	}
-
-	if (xwm->xres) {
-		read_surface_client_id(xwm, xsurface, client_id_cookie);
-	}
-
-	wl_signal_emit_mutable(&xsurface->events.associate, NULL);
 }
 
 static void xwm_handle_create_notify(struct wlr_xwm *xwm,
@@ -1154,6 +1397,18 @@ static void xwm_handle_unmap_notify(struct wlr_xwm *xwm,
 	}
 }
 
+static void handle_property_reply(struct wlr_xwm *xwm, void *reply,
+		void *data, uint32_t property) {
+	struct wlr_xwayland_surface *xsurface = data;
+	if (reply == NULL) {
+		wlr_log(WLR_ERROR, "Failed to get window property");
+		return;
+	}
+
+	read_surface_property(xwm, xsurface, property, reply);
+	free(reply);
+}
+
 static void xwm_handle_property_notify(struct wlr_xwm *xwm,
 		xcb_property_notify_event_t *ev) {
 	struct wlr_xwayland_surface *xsurface = lookup_surface(xwm, ev->window);
@@ -1163,15 +1418,8 @@ static void xwm_handle_property_notify(struct wlr_xwm *xwm,
 
 	xcb_get_property_cookie_t cookie =
 		xcb_get_property(xwm->xcb_conn, 0, xsurface->window_id, ev->atom, XCB_ATOM_ANY, 0, 2048);
-	xcb_get_property_reply_t *reply =
-		xcb_get_property_reply(xwm->xcb_conn, cookie, NULL);
-	if (reply == NULL) {
-		wlr_log(WLR_ERROR, "Failed to get window property");
-		return;
-	}
-
-	read_surface_property(xwm, xsurface, ev->atom, reply);
-	free(reply);
+	xwm_queue_reply(xwm, cookie.sequence, handle_property_reply, xsurface,
+		ev->atom);
 }
 
 static void xwm_handle_surface_id_message(struct wlr_xwm *xwm,
@@ -1356,11 +1604,9 @@ static void xwm_handle_net_wm_state_message(struct wlr_xwm *xwm,
 			changed = update_state(action, &xsurface->maximized_horz);
 		} else if (property == xwm->atoms[NET_WM_STATE_HIDDEN]) {
 			changed = update_state(action, &xsurface->minimized);
-		} else if (property != XCB_ATOM_NONE && wlr_log_get_verbosity() >= WLR_DEBUG) {
-			char *prop_name = xwm_get_atom_name(xwm, property);
-			wlr_log(WLR_DEBUG, "Unhandled NET_WM_STATE property change "
-				"%"PRIu32" (%s)", property, prop_name ? prop_name : "(null)");
-			free(prop_name);
+		} else if (property != XCB_ATOM_NONE) {
+			xwm_log_atom_name(xwm, property,
+				"Unhandled NET_WM_STATE property change");
 		}
 
 		if (changed) {
@@ -1420,11 +1666,8 @@ static void xwm_handle_wm_protocols_message(struct wlr_xwm *xwm,
 
 		wl_event_source_timer_update(surface->ping_timer, 0);
 		surface->pinging = false;
-	} else if (wlr_log_get_verbosity() >= WLR_DEBUG) {
-		char *type_name = xwm_get_atom_name(xwm, type);
-		wlr_log(WLR_DEBUG, "unhandled WM_PROTOCOLS client message %" PRIu32 " (%s)",
-			type, type_name ? type_name : "(null)");
-		free(type_name);
+	} else {
+		xwm_log_atom_name(xwm, type, "unhandled WM_PROTOCOLS client message");
 	}
 }
 
@@ -1549,12 +1792,8 @@ static void xwm_handle_client_message(struct wlr_xwm *xwm,
 		xwm_handle_net_startup_info_message(xwm, ev);
 	} else if (ev->type == xwm->atoms[WM_CHANGE_STATE]) {
 		xwm_handle_wm_change_state_message(xwm, ev);
-	} else if (!xwm_handle_selection_client_message(xwm, ev) &&
-			wlr_log_get_verbosity() >= WLR_DEBUG) {
-		char *type_name = xwm_get_atom_name(xwm, ev->type);
-		wlr_log(WLR_DEBUG, "unhandled x11 client message %" PRIu32 " (%s)", ev->type,
-			type_name ? type_name : "(null)");
-		free(type_name);
+	} else if (!xwm_handle_selection_client_message(xwm, ev)) {
+		xwm_log_atom_name(xwm, ev->type, "unhandled x11 client message");
 	}
 }
 
@@ -1723,6 +1962,8 @@ static int x11_event_handler(int fd, uint32_t mask, void *data) {
 		free(event);
 	}
 
+	count += xwm_dispatch_replies(xwm);
+
 	if (count) {
 		xcb_flush(xwm->xcb_conn);
 	}
@@ -1773,6 +2014,7 @@ static void handle_shell_v1_new_surface(struct wl_listener *listener,
 	wl_list_for_each(xsurface, &xwm->unpaired_surfaces, unpaired_link) {
 		if (xsurface->serial == shell_surface->serial) {
 			xwayland_surface_associate(xwm, xsurface, shell_surface->surface);
+			xcb_flush(xwm->xcb_conn);
 			return;
 		}
 	}
@@ -1904,6 +2146,17 @@ void xwm_destroy(struct wlr_xwm *xwm) {
 	wl_list_remove(&xwm->compositor_new_surface.link);
 	wl_list_remove(&xwm->compositor_destroy.link);
 	wl_list_remove(&xwm->shell_v1_new_surface.link);
+
+	while (!wl_list_empty(&xwm->pending_replies)) {
+		struct xwm_pending_reply *pending =
+			wl_container_of(xwm->pending_replies.next, pending, link);
+		xwm_reply_handler_t handler = pending->handler;
+		void *data = pending->data;
+		uint32_t arg = pending->arg;
+		pending_reply_destroy(xwm, pending);
+		handler(xwm, NULL, data, arg);
+	}
+
 	xcb_disconnect(xwm->xcb_conn);
 
 	struct pending_startup_id *pending, *next;
@@ -1911,6 +2164,11 @@ void xwm_destroy(struct wlr_xwm *xwm) {
 		pending_startup_id_destroy(pending);
 	}
 
+	if (xwm->client_lists_idle != NULL) {
+		wl_event_source_remove(xwm->client_lists_idle);
+	}
+	free(xwm->surface_buckets);
+
 	xwm->xwayland->xwm = NULL;
 	free(xwm);
 }
@@ -2151,10 +2409,17 @@ struct wlr_xwm *xwm_create(struct wlr_xwayland *xwayland, int wm_fd) {
 	xwm->xwayland = xwayland;
 	wl_list_init(&xwm->surfaces);
 	wl_list_init(&xwm->surfaces_in_stack_order);
+	wl_list_init(&xwm->client_list);
 	wl_list_init(&xwm->unpaired_surfaces);
 	wl_list_init(&xwm->pending_startup_ids);
+	wl_list_init(&xwm->pending_replies);
 	xwm->ping_timeout = 10000;
 
+	if (!surface_buckets_init(xwm, SURFACE_BUCKETS_MIN_BITS)) {
+		free(xwm);
+		return NULL;
+	}
+
 	xwm->xcb_conn = xcb_connect_to_fd(wm_fd, NULL);
 
 	int rc = xcb_connection_has_error(xwm->xcb_conn);